@@ -0,0 +1,270 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "BenchCompare.h"
+
+// The largest samples for which the exact distribution is computed.
+static const size_t ExactLimit = 25;
+
+double BenchComparer::median(std::vector<double> values)
+{
+	if (values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	size_t mid = values.size() / 2;
+	return values.size() % 2 != 0 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+double BenchComparer::smallestPValue(size_t n1, size_t n2)
+{
+	// One over the number of ways to order the two samples.
+	double ways = 1;
+	for (size_t i = 1; i <= n2; i++)
+		ways = ways * static_cast<double>(n1 + i) / static_cast<double>(i);
+	return 1 / ways;
+}
+
+double BenchComparer::mannWhitneyGreater(const std::vector<double>& x, const std::vector<double>& y)
+{
+	const size_t n1 = x.size();
+	const size_t n2 = y.size();
+	if (n1 == 0 || n2 == 0)
+		return 1;
+
+	//
+	// U counts the pairs in which x is the greater, ties counting a half.
+	//
+	double u = 0;
+	bool ties = false;
+	for (double a : x)
+	{
+		for (double b : y)
+		{
+			if (a > b)
+				u += 1;
+			else if (a == b)
+			{
+				u += 0.5;
+				ties = true;
+			}
+		}
+	}
+
+	if (!ties && n1 <= ExactLimit && n2 <= ExactLimit)
+	{
+		//
+		// counts[i][j][k] is the number of orderings of i x's and j y's
+		// with U = k; the largest value is either an x, above all j y's,
+		// or a y.
+		//
+		const size_t maxU = n1 * n2;
+		std::vector<std::vector<std::vector<double> > > counts(n1 + 1,
+			std::vector<std::vector<double> >(n2 + 1, std::vector<double>(maxU + 1, 0)));
+		for (size_t i = 0; i <= n1; i++)
+		{
+			for (size_t j = 0; j <= n2; j++)
+			{
+				if (i == 0 || j == 0)
+				{
+					counts[i][j][0] = 1;
+					continue;
+				}
+				for (size_t k = 0; k <= i * j; k++)
+				{
+					double c = counts[i][j - 1][k];
+					if (k >= j)
+						c += counts[i - 1][j][k - j];
+					counts[i][j][k] = c;
+				}
+			}
+		}
+		double total = 0;
+		double atLeast = 0;
+		for (size_t k = 0; k <= maxU; k++)
+		{
+			total += counts[n1][n2][k];
+			if (static_cast<double>(k) >= u)
+				atLeast += counts[n1][n2][k];
+		}
+		return atLeast / total;
+	}
+
+	//
+	// The normal approximation, with the variance reduced for ties and a
+	// continuity correction.
+	//
+	std::vector<double> all(x);
+	all.insert(all.end(), y.begin(), y.end());
+	std::sort(all.begin(), all.end());
+	double tieTerm = 0;
+	for (size_t i = 0; i < all.size();)
+	{
+		size_t j = i;
+		while (j < all.size() && all[j] == all[i])
+			j++;
+		double t = static_cast<double>(j - i);
+		tieTerm += t * t * t - t;
+		i = j;
+	}
+	double n = static_cast<double>(n1 + n2);
+	double mean = static_cast<double>(n1 * n2) / 2;
+	double variance = static_cast<double>(n1 * n2) / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+	if (variance <= 0)
+		return 1;
+	double z = (u - mean - 0.5) / std::sqrt(variance);
+	return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+std::vector<BenchComparer::Comparison> BenchComparer::compare(const BenchRun& baseline,
+	const BenchRun& candidate, const std::string& filter) const
+{
+	std::vector<Comparison> comparisons;
+	for (const BenchMetric& m : candidate.metrics)
+	{
+		if (!filter.empty() && m.name.find(filter) == std::string::npos)
+			continue;
+		Comparison c = Comparison();
+		c.name = m.name;
+		c.kind = m.kind;
+		c.candidate = m.samples.empty() ? m.value : median(m.samples);
+		c.pValue = -1;
+		const BenchMetric* base = baseline.find(m.name);
+		if (base == nullptr)
+		{
+			c.verdict = Added;
+			comparisons.push_back(c);
+			continue;
+		}
+		c.baseline = base->samples.empty() ? base->value : median(base->samples);
+		c.verdict = Unchanged;
+		if (m.kind == BenchMetric::Allocations)
+		{
+			c.change = c.candidate - c.baseline;
+			if (c.change > myThresholds.allocations)
+				c.verdict = Regressed;
+			else if (c.change < -myThresholds.allocations)
+				c.verdict = Improved;
+		}
+		else
+		{
+			double threshold = (m.kind == BenchMetric::Time ? myThresholds.timePercent : myThresholds.latencyPercent) / 100;
+			c.change = c.baseline > 0 ? c.candidate / c.baseline - 1 : 0;
+			bool testable = m.kind == BenchMetric::Time &&
+				smallestPValue(m.samples.size(), base->samples.size()) < myThresholds.alpha;
+			if (c.change > threshold)
+			{
+				if (testable)
+					c.pValue = mannWhitneyGreater(m.samples, base->samples);
+				if (!testable || c.pValue < myThresholds.alpha)
+					c.verdict = Regressed;
+			}
+			else if (c.change < -threshold)
+			{
+				if (testable)
+					c.pValue = mannWhitneyGreater(base->samples, m.samples);
+				if (!testable || c.pValue < myThresholds.alpha)
+					c.verdict = Improved;
+			}
+		}
+		comparisons.push_back(c);
+	}
+	for (const BenchMetric& m : baseline.metrics)
+	{
+		if ((filter.empty() || m.name.find(filter) != std::string::npos) && candidate.find(m.name) == nullptr)
+		{
+			Comparison c = Comparison();
+			c.name = m.name;
+			c.kind = m.kind;
+			c.baseline = m.value;
+			c.pValue = -1;
+			c.verdict = Removed;
+			comparisons.push_back(c);
+		}
+	}
+	return comparisons;
+}
+
+const char* BenchComparer::verdictName(Verdict verdict)
+{
+	static const char* names[] = { "", "REGRESSED", "improved", "new", "missing" };
+	return names[verdict];
+}
+
+size_t BenchComparer::report(std::ostream& out, const BenchRun& baseline, const BenchRun& candidate,
+	const std::vector<Comparison>& comparisons, bool verbose) const
+{
+	out << "Baseline:  " << (baseline.label.empty() ? "(unlabelled)" : baseline.label) << " " << baseline.date
+		<< (baseline.version.empty() ? "" : " MTE " + baseline.version) << std::endl;
+	out << "Candidate: " << (candidate.label.empty() ? candidate.source : candidate.label) << " " << candidate.date
+		<< (candidate.version.empty() ? "" : " MTE " + candidate.version) << std::endl;
+	out << "Thresholds: time +" << myThresholds.timePercent << "% (p < " << myThresholds.alpha
+		<< "), latency +" << myThresholds.latencyPercent << "%, allocations +" << myThresholds.allocations
+		<< "/op" << std::endl << std::endl;
+
+	size_t counts[5] = { 0, 0, 0, 0, 0 };
+	size_t width = 6;
+	for (const Comparison& c : comparisons)
+		width = std::max(width, c.name.size());
+	out << std::left << std::setw(static_cast<int>(width)) << "metric" << std::right
+		<< std::setw(14) << "baseline" << std::setw(14) << "candidate" << std::setw(10) << "change"
+		<< std::setw(9) << "p" << "  verdict" << std::endl;
+	for (const Comparison& c : comparisons)
+	{
+		counts[c.verdict]++;
+		if (!verbose && (c.verdict == Unchanged || c.verdict == Added))
+			continue;
+		out << std::left << std::setw(static_cast<int>(width)) << c.name << std::right << std::fixed;
+		out << std::setprecision(c.kind == BenchMetric::Allocations ? 2 : 0);
+		if (c.verdict == Added)
+			out << std::setw(14) << "-";
+		else
+			out << std::setw(14) << c.baseline;
+		if (c.verdict == Removed)
+			out << std::setw(14) << "-" << std::setw(10) << "";
+		else
+		{
+			out << std::setw(14) << c.candidate;
+			if (c.verdict == Added)
+				out << std::setw(10) << "";
+			else if (c.kind == BenchMetric::Allocations)
+				out << std::setw(10) << std::showpos << std::setprecision(2) << c.change << std::noshowpos;
+			else
+				out << std::setw(9) << std::showpos << std::setprecision(1) << c.change * 100 << std::noshowpos << "%";
+		}
+		if (c.pValue >= 0)
+			out << std::setw(9) << std::setprecision(4) << c.pValue;
+		else
+			out << std::setw(9) << "";
+		out << "  " << verdictName(c.verdict) << std::endl;
+	}
+	out << std::endl << counts[Regressed] << " regressed, " << counts[Improved] << " improved, "
+		<< counts[Unchanged] << " unchanged, " << counts[Added] << " new, " << counts[Removed] << " missing" << std::endl;
+	return counts[Regressed];
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef BENCHCOMPARE_H
+#define BENCHCOMPARE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BenchHistory.h"
+
+//******************************************************************************
+// Class BenchComparer
+//
+// Compares the metrics of a run with those of a baseline run.
+//
+// A time is a regression when its median is more than the time threshold
+// slower and, if both runs have enough repetitions for the test to go below
+// alpha, a one-sided Mann-Whitney U test of the repetitions says the new
+// ones are slower with p below alpha. Noise on a quiet machine then does not
+// fail the check, and neither does a real but small slowdown. Allocations,
+// which do not vary from run to run, and LoadGen latency percentiles, which
+// have one value per run, are compared against their thresholds alone.
+//******************************************************************************
+class BenchComparer
+{
+public:
+	struct Thresholds
+	{
+		// Percent slower.
+		double timePercent = 5;
+		// Percent higher.
+		double latencyPercent = 10;
+		// More allocations per operation.
+		double allocations = 0.1;
+		// The significance level of the Mann-Whitney test.
+		double alpha = 0.05;
+	};
+
+	enum Verdict { Unchanged, Regressed, Improved, Added, Removed };
+
+	struct Comparison
+	{
+		std::string name;
+		BenchMetric::Kind kind;
+		double baseline;
+		double candidate;
+		// Relative for times and latencies, absolute for allocations.
+		double change;
+		// The p-value of the test, or -1 if it was not run.
+		double pValue;
+		Verdict verdict;
+	};
+
+	explicit BenchComparer(const Thresholds& thresholds) : myThresholds(thresholds) {}
+
+	// Compares the metrics whose names contain the filter ("" for all).
+	std::vector<Comparison> compare(const BenchRun& baseline, const BenchRun& candidate,
+		const std::string& filter) const;
+
+	//------------------------------------------------------------
+	// Writes the regressions and improvements and a summary; every
+	// metric if verbose. Returns the number of regressions.
+	//------------------------------------------------------------
+	size_t report(std::ostream& out, const BenchRun& baseline, const BenchRun& candidate,
+		const std::vector<Comparison>& comparisons, bool verbose) const;
+
+	//------------------------------------------------------------
+	// The one-sided p-value of the Mann-Whitney U test that the
+	// values of x tend to be greater than those of y. Exact for
+	// small samples without ties, otherwise from the normal
+	// approximation with the tie correction.
+	//------------------------------------------------------------
+	static double mannWhitneyGreater(const std::vector<double>& x, const std::vector<double>& y);
+
+	// The smallest p-value the test can give for samples of these sizes.
+	static double smallestPValue(size_t n1, size_t n2);
+
+	static double median(std::vector<double> values);
+
+	static const char* verdictName(Verdict verdict);
+
+private:
+	Thresholds myThresholds;
+};
+
+#endif // !BENCHCOMPARE_H
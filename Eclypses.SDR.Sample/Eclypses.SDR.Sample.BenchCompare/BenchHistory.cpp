@@ -0,0 +1,210 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "BenchHistory.h"
+
+const char* BenchMetric::kindName(Kind kind)
+{
+	static const char* names[] = { "time", "allocations", "latency" };
+	return names[kind];
+}
+
+const BenchMetric* BenchRun::find(const std::string& name) const
+{
+	for (const BenchMetric& m : metrics)
+	{
+		if (m.name == name)
+			return &m;
+	}
+	return nullptr;
+}
+
+static std::string readText(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		throw std::runtime_error("Unable to open " + path);
+	std::ostringstream text;
+	text << in.rdbuf();
+	return text.str();
+}
+
+static std::string formatNumber(double value)
+{
+	std::ostringstream out;
+	out.precision(10);
+	out << value;
+	return out.str();
+}
+
+BenchRun BenchRun::fromResults(const std::string& path, const std::string& label)
+{
+	JsonValue json = JsonValue::parse(readText(path));
+	BenchRun run;
+	run.label = label;
+	run.source = path;
+	if (json["benchmarks"].isArray())
+	{
+		//
+		// The Benchmark: the time of every suite, size and thread count,
+		// with its repetitions, and its allocations.
+		//
+		run.date = json["context"]["date"].string();
+		run.version = json["context"]["mte_version"].string();
+		for (const JsonValue& b : json["benchmarks"].items())
+		{
+			BenchMetric time;
+			time.name = b["name"].string() + " ns/op";
+			time.kind = BenchMetric::Time;
+			time.value = b["ns_per_op"].number();
+			for (const JsonValue& s : b["samples_ns_per_op"].items())
+				time.samples.push_back(s.number());
+			run.metrics.push_back(time);
+
+			BenchMetric allocs;
+			allocs.name = b["name"].string() + " allocs/op";
+			allocs.kind = BenchMetric::Allocations;
+			allocs.value = b["allocs_per_op"].number();
+			run.metrics.push_back(allocs);
+		}
+	}
+	else if (json["runs"].isArray())
+	{
+		//
+		// The LoadGen: the latency percentiles at each target rate.
+		//
+		std::string prefix = "loadgen/" + json["backend"].string() + "/threads:" +
+			formatNumber(json["threads"].number()) + "/rate:";
+		for (const JsonValue& r : json["runs"].items())
+		{
+			static const char* percentiles[] = { "p50", "p99", "p99.9" };
+			for (const char* p : percentiles)
+			{
+				BenchMetric latency;
+				latency.name = prefix + formatNumber(r["target_rate"].number()) + " " + p;
+				latency.kind = BenchMetric::Latency;
+				latency.value = r["latency_ns"][p].number();
+				run.metrics.push_back(latency);
+			}
+		}
+	}
+	else
+	{
+		throw std::runtime_error(path + " is not Benchmark or LoadGen JSON");
+	}
+	if (run.date.empty())
+	{
+		char date[32];
+		std::time_t now = std::time(nullptr);
+		std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+		run.date = date;
+	}
+	return run;
+}
+
+BenchHistory::BenchHistory(const std::string& path) : myPath(path)
+{
+	std::ifstream in(path);
+	std::string line;
+	size_t number = 0;
+	while (std::getline(in, line))
+	{
+		number++;
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		JsonValue json;
+		try
+		{
+			json = JsonValue::parse(line);
+		}
+		catch (const std::exception& e)
+		{
+			throw std::runtime_error(path + " line " + std::to_string(number) + ": " + e.what());
+		}
+		BenchRun run;
+		run.label = json["label"].string();
+		run.date = json["date"].string();
+		run.version = json["mte_version"].string();
+		run.source = json["source"].string();
+		for (const JsonValue& m : json["metrics"].items())
+		{
+			BenchMetric metric;
+			metric.name = m["name"].string();
+			metric.kind = BenchMetric::Time;
+			for (int k = 0; k < BenchMetric::KindCount; k++)
+			{
+				if (m["kind"].string() == BenchMetric::kindName(static_cast<BenchMetric::Kind>(k)))
+					metric.kind = static_cast<BenchMetric::Kind>(k);
+			}
+			metric.value = m["value"].number();
+			for (const JsonValue& s : m["samples"].items())
+				metric.samples.push_back(s.number());
+			run.metrics.push_back(metric);
+		}
+		myRuns.push_back(run);
+	}
+}
+
+const BenchRun* BenchHistory::find(const std::string& label) const
+{
+	for (auto run = myRuns.rbegin(); run != myRuns.rend(); ++run)
+	{
+		if (label == "latest" || run->label == label)
+			return &*run;
+	}
+	return nullptr;
+}
+
+void BenchHistory::append(const BenchRun& run)
+{
+	std::ostringstream line;
+	line << "{\"label\": " << JsonValue::quote(run.label)
+		<< ", \"date\": " << JsonValue::quote(run.date)
+		<< ", \"mte_version\": " << JsonValue::quote(run.version)
+		<< ", \"source\": " << JsonValue::quote(run.source)
+		<< ", \"metrics\": [";
+	for (size_t i = 0; i < run.metrics.size(); i++)
+	{
+		const BenchMetric& m = run.metrics[i];
+		line << (i == 0 ? "" : ", ") << "{\"name\": " << JsonValue::quote(m.name)
+			<< ", \"kind\": \"" << BenchMetric::kindName(m.kind) << "\""
+			<< ", \"value\": " << formatNumber(m.value) << ", \"samples\": [";
+		for (size_t s = 0; s < m.samples.size(); s++)
+			line << (s == 0 ? "" : ", ") << formatNumber(m.samples[s]);
+		line << "]}";
+	}
+	line << "]}";
+
+	std::ofstream out(myPath, std::ios::app);
+	if (!out || !(out << line.str() << std::endl))
+		throw std::runtime_error("Unable to write " + myPath);
+	myRuns.push_back(run);
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef BENCHHISTORY_H
+#define BENCHHISTORY_H
+
+#include <string>
+#include <vector>
+
+#include "BenchJson.h"
+
+//
+// One tracked measurement of a run. Every kind is better when lower.
+//
+struct BenchMetric
+{
+	enum Kind
+	{
+		// Nanoseconds per operation of a Benchmark result, with a sample
+		// per repetition.
+		Time,
+		// Heap allocations per operation.
+		Allocations,
+		// A latency percentile of a LoadGen run, in nanoseconds.
+		Latency,
+		KindCount
+	};
+
+	std::string name;
+	Kind kind;
+	double value;
+	std::vector<double> samples;
+
+	static const char* kindName(Kind kind);
+};
+
+//
+// The metrics of one benchmark run.
+//
+struct BenchRun
+{
+	std::string label;
+	std::string date;
+	std::string version;
+	std::string source;
+	std::vector<BenchMetric> metrics;
+
+	// Returns the metric with the name, or nullptr.
+	const BenchMetric* find(const std::string& name) const;
+
+	//------------------------------------------------------------
+	// Reads the JSON written by the Benchmark (--json) or the
+	// LoadGen (--json). Throws std::runtime_error if the file
+	// cannot be read or is neither.
+	//------------------------------------------------------------
+	static BenchRun fromResults(const std::string& path, const std::string& label);
+};
+
+//******************************************************************************
+// Class BenchHistory
+//
+// The runs recorded so far, kept in a file with one JSON object per line so
+// a run is recorded by appending a line.
+//******************************************************************************
+class BenchHistory
+{
+public:
+	// Reads the history; a file that does not exist is an empty history.
+	// Throws std::runtime_error if a line is not valid.
+	explicit BenchHistory(const std::string& path);
+
+	const std::vector<BenchRun>& runs() const { return myRuns; }
+
+	//------------------------------------------------------------
+	// Returns the most recent run with the label, or the most
+	// recent run for "latest", or nullptr if there is none.
+	//------------------------------------------------------------
+	const BenchRun* find(const std::string& label) const;
+
+	// Appends a run to the file. Throws std::runtime_error on failure.
+	void append(const BenchRun& run);
+
+private:
+	std::string myPath;
+	std::vector<BenchRun> myRuns;
+};
+
+#endif // !BENCHHISTORY_H
@@ -0,0 +1,246 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "BenchJson.h"
+
+//******************************************************************************
+// Class JsonValue::Parser
+//
+// A recursive descent parser over the whole text.
+//******************************************************************************
+class JsonValue::Parser
+{
+public:
+	explicit Parser(const std::string& text) : myText(text), myPos(0) {}
+
+	JsonValue document()
+	{
+		JsonValue v = value();
+		skipSpace();
+		if (myPos != myText.size())
+			fail("unexpected text after the value");
+		return v;
+	}
+
+private:
+	const std::string& myText;
+	size_t myPos;
+
+	void fail(const std::string& what)
+	{
+		throw std::runtime_error("JSON error at offset " + std::to_string(myPos) + ": " + what);
+	}
+
+	void skipSpace()
+	{
+		while (myPos < myText.size() && (myText[myPos] == ' ' || myText[myPos] == '\t' ||
+			myText[myPos] == '\r' || myText[myPos] == '\n'))
+			myPos++;
+	}
+
+	bool consume(const char* word)
+	{
+		size_t n = std::char_traits<char>::length(word);
+		if (myText.compare(myPos, n, word) != 0)
+			return false;
+		myPos += n;
+		return true;
+	}
+
+	void expect(char c)
+	{
+		skipSpace();
+		if (myPos >= myText.size() || myText[myPos] != c)
+			fail(std::string("expected '") + c + "'");
+		myPos++;
+	}
+
+	JsonValue value()
+	{
+		skipSpace();
+		if (myPos >= myText.size())
+			fail("unexpected end");
+		JsonValue v;
+		char c = myText[myPos];
+		if (c == '{')
+		{
+			v.myType = Object;
+			myPos++;
+			skipSpace();
+			if (myPos < myText.size() && myText[myPos] == '}')
+			{
+				myPos++;
+				return v;
+			}
+			for (;;)
+			{
+				skipSpace();
+				if (myPos >= myText.size() || myText[myPos] != '"')
+					fail("expected a member name");
+				std::string name = string();
+				expect(':');
+				v.myMembers[name] = value();
+				skipSpace();
+				if (myPos < myText.size() && myText[myPos] == ',')
+				{
+					myPos++;
+					continue;
+				}
+				expect('}');
+				return v;
+			}
+		}
+		if (c == '[')
+		{
+			v.myType = Array;
+			myPos++;
+			skipSpace();
+			if (myPos < myText.size() && myText[myPos] == ']')
+			{
+				myPos++;
+				return v;
+			}
+			for (;;)
+			{
+				v.myItems.push_back(value());
+				skipSpace();
+				if (myPos < myText.size() && myText[myPos] == ',')
+				{
+					myPos++;
+					continue;
+				}
+				expect(']');
+				return v;
+			}
+		}
+		if (c == '"')
+		{
+			v.myType = String;
+			v.myString = string();
+			return v;
+		}
+		if (consume("true"))
+		{
+			v.myType = Boolean;
+			v.myNumber = 1;
+			return v;
+		}
+		if (consume("false"))
+		{
+			v.myType = Boolean;
+			return v;
+		}
+		if (consume("null"))
+			return v;
+		const char* start = myText.c_str() + myPos;
+		char* end = nullptr;
+		v.myNumber = std::strtod(start, &end);
+		if (end == start)
+			fail("expected a value");
+		v.myType = Number;
+		myPos += end - start;
+		return v;
+	}
+
+	std::string string()
+	{
+		std::string s;
+		myPos++;
+		while (myPos < myText.size() && myText[myPos] != '"')
+		{
+			char c = myText[myPos++];
+			if (c != '\\')
+			{
+				s.push_back(c);
+				continue;
+			}
+			if (myPos >= myText.size())
+				break;
+			c = myText[myPos++];
+			switch (c)
+			{
+			case 'n': s.push_back('\n'); break;
+			case 't': s.push_back('\t'); break;
+			case 'r': s.push_back('\r'); break;
+			case 'b': s.push_back('\b'); break;
+			case 'f': s.push_back('\f'); break;
+			case 'u':
+			{
+				// Only the characters the results can hold; others become '?'.
+				unsigned long code = std::strtoul(myText.substr(myPos, 4).c_str(), nullptr, 16);
+				s.push_back(code < 0x80 ? static_cast<char>(code) : '?');
+				myPos += 4;
+				break;
+			}
+			default: s.push_back(c); break;
+			}
+		}
+		if (myPos >= myText.size())
+			fail("unterminated string");
+		myPos++;
+		return s;
+	}
+};
+
+JsonValue JsonValue::parse(const std::string& text)
+{
+	return Parser(text).document();
+}
+
+const JsonValue& JsonValue::operator[](const std::string& name) const
+{
+	static const JsonValue none;
+	auto member = myMembers.find(name);
+	return member == myMembers.end() ? none : member->second;
+}
+
+std::string JsonValue::quote(const std::string& s)
+{
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out.push_back('\\');
+			out.push_back(c);
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escape[8];
+			std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+			out += escape;
+		}
+		else
+		{
+			out.push_back(c);
+		}
+	}
+	return out + "\"";
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef BENCHJSON_H
+#define BENCHJSON_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class JsonValue
+//
+// Just enough JSON to read the benchmark results and the history file: a
+// value is null, a boolean, a number, a string, an array or an object.
+//******************************************************************************
+class JsonValue
+{
+public:
+	enum Type { Null, Boolean, Number, String, Array, Object };
+
+	JsonValue() : myType(Null), myNumber(0) {}
+
+	// Parses a document. Throws std::runtime_error, with the offset, if it
+	// is not valid JSON.
+	static JsonValue parse(const std::string& text);
+
+	Type type() const { return myType; }
+	bool isObject() const { return myType == Object; }
+	bool isArray() const { return myType == Array; }
+
+	// The value as a number, or 0 if it is not one.
+	double number() const { return myType == Number ? myNumber : 0; }
+
+	// The value as a string, or "" if it is not one.
+	const std::string& string() const { return myString; }
+
+	const std::vector<JsonValue>& items() const { return myItems; }
+
+	bool has(const std::string& name) const { return myMembers.find(name) != myMembers.end(); }
+
+	// The member of an object, or a null value if there is none.
+	const JsonValue& operator[](const std::string& name) const;
+
+	// Writes a string with the characters JSON requires escaped.
+	static std::string quote(const std::string& s);
+
+private:
+	class Parser;
+
+	Type myType;
+	double myNumber;
+	std::string myString;
+	std::vector<JsonValue> myItems;
+	std::map<std::string, JsonValue> myMembers;
+};
+
+#endif // !BENCHJSON_H
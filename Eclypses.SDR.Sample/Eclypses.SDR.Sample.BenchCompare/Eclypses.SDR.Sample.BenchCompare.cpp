@@ -0,0 +1,173 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "BenchCompare.h"
+#include "BenchHistory.h"
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.BenchCompare ingest <results.json> [--label name] [--history <file>]" << std::endl;
+	std::cout << "      Records a Benchmark or LoadGen JSON result in the history." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.BenchCompare compare <results.json> [--baseline label|latest|<file.json>]" << std::endl;
+	std::cout << "                                   [--threshold percent] [--latency-threshold percent]" << std::endl;
+	std::cout << "                                   [--alloc-threshold allocs] [--alpha p] [--filter text]" << std::endl;
+	std::cout << "                                   [--verbose] [--ingest] [--label name] [--history <file>]" << std::endl;
+	std::cout << "      Compares a result with the baseline and exits with 1 if any metric regressed." << std::endl;
+	std::cout << "      --ingest records the result if nothing regressed, or if the history is empty." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.BenchCompare list [--history <file>]" << std::endl;
+	std::cout << "      The history defaults to bench-history.jsonl." << std::endl;
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix)
+{
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		usage();
+		return 2;
+	}
+	std::string command = argv[1];
+	std::string results;
+	std::string historyPath = "bench-history.jsonl";
+	std::string label;
+	std::string baselineName = "latest";
+	std::string filter;
+	bool verbose = false;
+	bool ingest = false;
+	BenchComparer::Thresholds thresholds;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--history" && hasValue)
+			historyPath = argv[++i];
+		else if (arg == "--label" && hasValue)
+			label = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			baselineName = argv[++i];
+		else if (arg == "--threshold" && hasValue)
+			thresholds.timePercent = std::atof(argv[++i]);
+		else if (arg == "--latency-threshold" && hasValue)
+			thresholds.latencyPercent = std::atof(argv[++i]);
+		else if (arg == "--alloc-threshold" && hasValue)
+			thresholds.allocations = std::atof(argv[++i]);
+		else if (arg == "--alpha" && hasValue)
+			thresholds.alpha = std::atof(argv[++i]);
+		else if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--verbose")
+			verbose = true;
+		else if (arg == "--ingest")
+			ingest = true;
+		else if (results.empty() && arg[0] != '-')
+			results = arg;
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	try
+	{
+		BenchHistory history(historyPath);
+		if (command == "list")
+		{
+			for (const BenchRun& run : history.runs())
+			{
+				std::cout << run.date << "  " << (run.label.empty() ? "-" : run.label) << "  MTE " << run.version
+					<< "  " << run.metrics.size() << " metrics  " << run.source << std::endl;
+			}
+			return 0;
+		}
+		if (results.empty() || (command != "ingest" && command != "compare"))
+		{
+			usage();
+			return 2;
+		}
+		BenchRun candidate = BenchRun::fromResults(results, label);
+		if (command == "ingest")
+		{
+			history.append(candidate);
+			std::cout << "Recorded " << candidate.metrics.size() << " metrics in " << historyPath << std::endl;
+			return 0;
+		}
+
+		//
+		// The baseline is a run in the history or another result file.
+		//
+		BenchRun fileBaseline;
+		const BenchRun* baseline;
+		if (endsWith(baselineName, ".json"))
+		{
+			fileBaseline = BenchRun::fromResults(baselineName, baselineName);
+			baseline = &fileBaseline;
+		}
+		else
+		{
+			baseline = history.find(baselineName);
+		}
+		if (baseline == nullptr)
+		{
+			std::cout << "No baseline '" << baselineName << "' in " << historyPath << "; nothing to compare." << std::endl;
+			if (ingest)
+			{
+				history.append(candidate);
+				std::cout << "Recorded " << candidate.metrics.size() << " metrics as the first run." << std::endl;
+			}
+			return 0;
+		}
+
+		BenchComparer comparer(thresholds);
+		std::vector<BenchComparer::Comparison> comparisons = comparer.compare(*baseline, candidate, filter);
+		size_t regressions = comparer.report(std::cout, *baseline, candidate, comparisons, verbose);
+		if (regressions != 0)
+		{
+			std::cout << "FAILED: " << regressions << " metric(s) regressed." << std::endl;
+			return 1;
+		}
+		if (ingest)
+		{
+			history.append(candidate);
+			std::cout << "Recorded in " << historyPath << std::endl;
+		}
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+}
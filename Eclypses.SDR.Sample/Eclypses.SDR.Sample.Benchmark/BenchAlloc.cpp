@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "BenchAlloc.h"
+
+//
+// Relaxed atomics: the counters are only read between timed runs.
+//
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocationBytes(0);
+static std::atomic<uint64_t> freeCount(0);
+
+BenchAllocCounts benchAllocCounts()
+{
+	BenchAllocCounts counts;
+	counts.allocations = allocationCount.load(std::memory_order_relaxed);
+	counts.bytes = allocationBytes.load(std::memory_order_relaxed);
+	counts.frees = freeCount.load(std::memory_order_relaxed);
+	return counts;
+}
+
+static void* countedAllocate(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocationBytes.fetch_add(size, std::memory_order_relaxed);
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+static void countedFree(void* p)
+{
+	if (p == nullptr)
+		return;
+	freeCount.fetch_add(1, std::memory_order_relaxed);
+	std::free(p);
+}
+
+void* operator new(size_t size)
+{
+	return countedAllocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedAllocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return countedAllocate(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return countedAllocate(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void* p) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	countedFree(p);
+}
@@ -0,0 +1,192 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include "BenchAlloc.h"
+#include "BenchRunner.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+BenchResult BenchRunner::run(const std::string& suite, size_t size, size_t threads, const Setup& setup)
+{
+	BenchResult result = BenchResult();
+	result.suite = suite;
+	result.size = size;
+	result.threads = threads == 0 ? 1 : threads;
+
+	std::vector<Op> ops;
+	for (size_t t = 0; t < result.threads; t++)
+		ops.push_back(setup(t));
+
+	//
+	// Calibrate on the first thread's operation, doubling the count until
+	// the run is long enough to time.
+	//
+	uint64_t count = 1;
+	double elapsed = 0.0;
+	for (;;)
+	{
+		Clock::time_point start = Clock::now();
+		for (uint64_t i = 0; i < count; i++)
+			ops[0]();
+		elapsed = secondsSince(start);
+		if (elapsed >= myOptions.minSeconds / 10 || count >= (1u << 24))
+			break;
+		count *= 2;
+	}
+	double perOp = elapsed / static_cast<double>(count);
+	result.iterations = std::max<uint64_t>(1, static_cast<uint64_t>(myOptions.minSeconds / perOp));
+
+	//
+	// Reserve the samples so recording them does not count as the
+	// operation's allocations.
+	//
+	result.samples.reserve(std::max<size_t>(1, myOptions.repetitions));
+	BenchAllocCounts before = benchAllocCounts();
+	for (size_t rep = 0; rep < std::max<size_t>(1, myOptions.repetitions); rep++)
+	{
+		double seconds;
+		if (result.threads == 1)
+		{
+			Clock::time_point start = Clock::now();
+			for (uint64_t i = 0; i < result.iterations; i++)
+				ops[0]();
+			seconds = secondsSince(start);
+		}
+		else
+		{
+			//
+			// Start the threads together and time until the last finishes.
+			//
+			std::atomic<bool> go(false);
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < result.threads; t++)
+			{
+				workers.emplace_back([&, t]
+					{
+						while (!go.load(std::memory_order_acquire))
+							std::this_thread::yield();
+						for (uint64_t i = 0; i < result.iterations; i++)
+							ops[t]();
+					});
+			}
+			Clock::time_point start = Clock::now();
+			go.store(true, std::memory_order_release);
+			for (auto& w : workers)
+				w.join();
+			seconds = secondsSince(start);
+		}
+		result.samples.push_back(seconds * 1e9 /
+			static_cast<double>(result.iterations * result.threads));
+	}
+	BenchAllocCounts after = benchAllocCounts();
+
+	std::vector<double> sorted = result.samples;
+	std::sort(sorted.begin(), sorted.end());
+	result.nsPerOp = sorted[sorted.size() / 2];
+	result.opsPerSec = 1e9 / result.nsPerOp;
+	result.mbPerSec = result.opsPerSec * static_cast<double>(size) / (1024.0 * 1024.0);
+
+	//
+	// The thread objects themselves allocate; their share is negligible.
+	//
+	double totalOps = static_cast<double>(result.iterations * result.threads * result.samples.size());
+	result.allocsPerOp = static_cast<double>(after.allocations - before.allocations) / totalOps;
+	result.allocBytesPerOp = static_cast<double>(after.bytes - before.bytes) / totalOps;
+	result.freesPerOp = static_cast<double>(after.frees - before.frees) / totalOps;
+	return result;
+}
+
+static std::string jsonString(const std::string& s)
+{
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+			out.push_back('\\');
+		if (static_cast<unsigned char>(c) >= 0x20)
+			out.push_back(c);
+	}
+	return out + "\"";
+}
+
+void BenchRunner::writeJson(std::ostream& out, const std::string& version,
+	const std::vector<BenchResult>& results)
+{
+	char date[32];
+	std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+	out << "{" << std::endl;
+	out << "  \"context\": {" << std::endl;
+	out << "    \"date\": " << jsonString(date) << "," << std::endl;
+	out << "    \"mte_version\": " << jsonString(version) << "," << std::endl;
+	out << "    \"hardware_concurrency\": " << std::thread::hardware_concurrency() << "," << std::endl;
+	//
+	// Label by optimization: the Makefile builds with -O2 but not NDEBUG.
+	// GCC and Clang define __OPTIMIZE__; Visual Studio defines _DEBUG in
+	// its unoptimized configuration.
+	//
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+	out << "    \"build\": \"release\"" << std::endl;
+#else
+	out << "    \"build\": \"debug\"" << std::endl;
+#endif
+	out << "  }," << std::endl;
+	out << "  \"benchmarks\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& r = results[i];
+		out << "    {" << std::endl;
+		out << "      \"name\": " << jsonString(r.suite + "/" + std::to_string(r.size) + "/threads:" + std::to_string(r.threads)) << "," << std::endl;
+		out << "      \"suite\": " << jsonString(r.suite) << "," << std::endl;
+		out << "      \"size\": " << r.size << "," << std::endl;
+		out << "      \"threads\": " << r.threads << "," << std::endl;
+		out << "      \"iterations\": " << r.iterations << "," << std::endl;
+		out << "      \"ns_per_op\": " << r.nsPerOp << "," << std::endl;
+		out << "      \"ops_per_sec\": " << r.opsPerSec << "," << std::endl;
+		out << "      \"mb_per_sec\": " << r.mbPerSec << "," << std::endl;
+		out << "      \"allocs_per_op\": " << r.allocsPerOp << "," << std::endl;
+		out << "      \"alloc_bytes_per_op\": " << r.allocBytesPerOp << "," << std::endl;
+		out << "      \"frees_per_op\": " << r.freesPerOp << "," << std::endl;
+		out << "      \"samples_ns_per_op\": [";
+		for (size_t s = 0; s < r.samples.size(); s++)
+			out << (s == 0 ? "" : ", ") << r.samples[s];
+		out << "]" << std::endl;
+		out << "    }" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The measurements of one benchmark case.
+struct BenchResult
+{
+	std::string suite;
+	size_t size;
+	size_t threads;
+	// Operations per thread in each repetition.
+	uint64_t iterations;
+	// Nanoseconds per operation, one sample per repetition.
+	std::vector<double> samples;
+	// The median of the samples and the rates derived from it.
+	double nsPerOp;
+	double opsPerSec;
+	double mbPerSec;
+	// Averaged over every timed operation.
+	double allocsPerOp;
+	double allocBytesPerOp;
+	double freesPerOp;
+};
+
+//******************************************************************************
+// Class BenchRunner
+//
+// Runs a benchmark case: an operation on a payload size, on one or more
+// threads. Each thread gets its own operation from the setup function (so it
+// can own its SDR instance and buffers), which is run before timing starts.
+//
+// The number of iterations is calibrated so a repetition takes about
+// minSeconds; each repetition gives one sample. Allocations are counted by
+// the global operator new hooks in BenchAlloc.cpp.
+//******************************************************************************
+class BenchRunner
+{
+public:
+	struct Options
+	{
+		double minSeconds = 0.2;
+		size_t repetitions = 3;
+	};
+
+	typedef std::function<void()> Op;
+	typedef std::function<Op(size_t thread)> Setup;
+
+	explicit BenchRunner(const Options& options) : myOptions(options) {}
+
+	BenchResult run(const std::string& suite, size_t size, size_t threads, const Setup& setup);
+
+	//---------------------------------------------------------
+	// Writes the results as a JSON document with the context
+	// (library version, machine, date) they were measured in.
+	//---------------------------------------------------------
+	static void writeJson(std::ostream& out, const std::string& version,
+		const std::vector<BenchResult>& results);
+
+private:
+	Options myOptions;
+};
+
+#endif // !BENCHRUNNER_H
@@ -0,0 +1,448 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "MteBase.h"
+#include "MteBase64.h"
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "Producer.h"
+#include "BenchRunner.h"
+#include "mte_base64.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+std::string getItemFromSettings(std::string key) {
+	std::ifstream file("./settings.txt");
+	std::string s;
+	while (std::getline(file, s)) {
+		std::size_t found = s.find(key);
+		if (found != std::string::npos) {
+			std::size_t eq = s.find('=');
+			if (eq != std::string::npos) {
+				return s.substr(eq + 1);
+			}
+		}
+	}
+	return "";
+}
+
+static const char* SecurityString = "SecurityString";
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Benchmark [--filter <suite>] [--max-size bytes] [--threads 1,N]" << std::endl;
+	std::cout << "                                [--min-time seconds] [--repetitions N] [--json <file>] [--dir <dir>]" << std::endl;
+	std::cout << "                                [--stats]" << std::endl;
+	std::cout << "      Payload sizes run from 16 bytes up to --max-size (default 16M; up to 1G) in steps of 4x." << std::endl;
+	std::cout << "      Suites: sdr-mem-write sdr-mem-read sdr-file-write sdr-file-read conceal reveal" << std::endl;
+	std::cout << "              conceal-lease reveal-lease random read-file write-file" << std::endl;
+	std::cout << "              b64-enc-mte b64-enc-scalar b64-enc-ssse3 b64-enc-avx2" << std::endl;
+	std::cout << "              b64-dec-mte b64-dec-scalar b64-dec-ssse3 b64-dec-avx2" << std::endl;
+	std::cout << "      The b64 suites are skipped on CPUs without their instruction set." << std::endl;
+	std::cout << "      Fails if a lease suite allocates on one thread, below 16M." << std::endl;
+	std::cout << "      --stats records the MteSdr phase statistics while the benchmarks run and prints them." << std::endl;
+}
+
+//
+// Parses a size such as 4096, 64K, 16M or 1G.
+//
+static size_t parseSize(const std::string& text)
+{
+	char* end = nullptr;
+	size_t value = std::strtoull(text.c_str(), &end, 10);
+	switch (end != nullptr ? *end : '\0')
+	{
+	case 'k': case 'K': return value << 10;
+	case 'm': case 'M': return value << 20;
+	case 'g': case 'G': return value << 30;
+	default: return value;
+	}
+}
+
+static std::vector<size_t> parseList(const std::string& list)
+{
+	std::vector<size_t> values;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		if (comma > start)
+			values.push_back(std::strtoul(list.substr(start, comma - start).c_str(), nullptr, 10));
+		start = comma + 1;
+	}
+	return values;
+}
+
+//
+// The state a benchmark thread owns. Held by shared_ptr so the operation
+// (a std::function, which must be copyable) can keep it alive.
+//
+struct ThreadState
+{
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> concealed;
+	std::vector<char> text;
+	std::unique_ptr<MteSdr> sdr;
+	std::unique_ptr<MteSdrDisconnected> disconnected;
+	std::string location;
+	std::string path;
+
+	~ThreadState()
+	{
+		//
+		// Leave nothing behind on disk.
+		//
+		if (sdr)
+			sdr->removeSdr();
+		if (!path.empty())
+			std::remove(path.c_str());
+	}
+};
+
+static std::shared_ptr<ThreadState> newState(size_t size)
+{
+	std::shared_ptr<ThreadState> state = std::make_shared<ThreadState>();
+	state->payload.resize(size);
+	MteRandom::getBytes(state->payload.data(), size);
+	return state;
+}
+
+static void initMteSdr(ThreadState& state, const std::string& location)
+{
+	state.location = location;
+	state.sdr.reset(new MteSdr((mte_sdr_random)MteRandom::getBytes));
+	state.sdr->initSdr(location, SecurityString);
+}
+
+//
+// The MteBase64 instruction set a b64 suite names.
+//
+static MteBase64::Isa suiteIsa(const std::string& suite)
+{
+	if (suite.find("avx2") != std::string::npos)
+		return MteBase64::Avx2;
+	if (suite.find("ssse3") != std::string::npos)
+		return MteBase64::Ssse3;
+	return MteBase64::Scalar;
+}
+
+//
+// The setup of each suite for a payload size and a working directory. The
+// operation it returns is what is timed.
+//
+static BenchRunner::Setup suiteSetup(const std::string& suite, size_t size, const std::string& dir)
+{
+	if (suite == "sdr-mem-write")
+		return [=](size_t t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			initMteSdr(*s, dir + "/bench-sdr-" + std::to_string(t));
+			return [s] { s->sdr->write("bench", s->payload.data(), s->payload.size(), true); s->sdr->remove("bench"); };
+		};
+	if (suite == "sdr-mem-read")
+		return [=](size_t t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			initMteSdr(*s, dir + "/bench-sdr-" + std::to_string(t));
+			s->sdr->write("bench", s->payload.data(), s->payload.size(), true);
+			return [s] { size_t n; s->sdr->readData("bench", n); };
+		};
+	if (suite == "sdr-file-write")
+		return [=](size_t t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			initMteSdr(*s, dir + "/bench-sdr-" + std::to_string(t));
+			return [s] { s->sdr->write("bench", s->payload.data(), s->payload.size()); };
+		};
+	if (suite == "sdr-file-read")
+		return [=](size_t t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			initMteSdr(*s, dir + "/bench-sdr-" + std::to_string(t));
+			s->sdr->write("bench", s->payload.data(), s->payload.size());
+			return [s] { size_t n; s->sdr->readData("bench", n); };
+		};
+	if (suite == "conceal")
+		return [=](size_t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			s->disconnected.reset(new MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes));
+			s->disconnected->initSdr(SecurityString);
+			return [s]
+			{
+				size_t n;
+				uint8_t* concealed = s->disconnected->Conceal(s->payload.data(), s->payload.size(), n);
+				delete[] concealed;
+			};
+		};
+	if (suite == "reveal")
+		return [=](size_t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			s->disconnected.reset(new MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes));
+			s->disconnected->initSdr(SecurityString);
+			size_t n;
+			uint8_t* concealed = s->disconnected->Conceal(s->payload.data(), s->payload.size(), n);
+			s->concealed.assign(concealed, concealed + n);
+			delete[] concealed;
+			return [s] { size_t n; s->disconnected->Reveal(s->concealed.data(), s->concealed.size(), n); };
+		};
+	//
+	// The leasing Conceal and Reveal; once the thread's pool holds the
+	// size, these make no heap allocation.
+	//
+	if (suite == "conceal-lease")
+		return [=](size_t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			s->disconnected.reset(new MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes));
+			s->disconnected->initSdr(SecurityString);
+			return [s] { s->disconnected->Conceal(s->payload.data(), s->payload.size()); };
+		};
+	if (suite == "reveal-lease")
+		return [=](size_t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			s->disconnected.reset(new MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes));
+			s->disconnected->initSdr(SecurityString);
+			MteBufferPool::Lease concealed = s->disconnected->Conceal(s->payload.data(), s->payload.size());
+			s->concealed.assign(concealed.data(), concealed.data() + concealed.size());
+			return [s] { s->disconnected->Reveal(s->concealed.data(), s->concealed.size()); };
+		};
+	if (suite == "random")
+		return [=](size_t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			return [s] { MteRandom::getBytes(s->payload.data(), s->payload.size()); };
+		};
+	if (suite == "read-file")
+		return [=](size_t t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			s->path = dir + "/bench-read-" + std::to_string(t) + ".tmp";
+			writeFile(s->path, s->payload.data(), s->payload.size());
+			return [s] { size_t n; delete[] readFile(s->path, n); };
+		};
+	if (suite == "write-file")
+		return [=](size_t t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			s->path = dir + "/bench-write-" + std::to_string(t) + ".tmp";
+			return [s] { writeFile(s->path, s->payload.data(), s->payload.size()); };
+		};
+	//
+	// Base64 of the payload by the library and by MteBase64 on each
+	// instruction set; the size is of the binary data both ways.
+	//
+	if (suite.compare(0, 4, "b64-") == 0)
+		return [=](size_t) -> BenchRunner::Op
+		{
+			std::shared_ptr<ThreadState> s = newState(size);
+			bool library = suite.compare(suite.size() - 4, 4, "-mte") == 0;
+			if (!library)
+				MteBase64::setIsa(suiteIsa(suite));
+			s->text.resize(MteBase64::encodeBytes(size));
+			size_t textBytes = MteBase64::encode(s->payload.data(), size, s->text.data());
+			s->concealed.resize(MteBase64::decodeBytes(textBytes));
+			if (suite.compare(0, 8, "b64-enc-") == 0)
+			{
+				if (library)
+					return [s] { mte_base64_encode(s->payload.data(), s->payload.size(), s->text.data()); };
+				return [s] { MteBase64::encode(s->payload.data(), s->payload.size(), s->text.data()); };
+			}
+			if (library)
+				return [s, textBytes] { mte_base64_decode(s->text.data(), textBytes, s->concealed.data()); };
+			return [s, textBytes] { MteBase64::decode(s->text.data(), textBytes, s->concealed.data()); };
+		};
+	return BenchRunner::Setup();
+}
+
+static std::string formatSize(size_t size)
+{
+	if (size >= (1u << 30) && size % (1u << 30) == 0)
+		return std::to_string(size >> 30) + "G";
+	if (size >= (1u << 20) && size % (1u << 20) == 0)
+		return std::to_string(size >> 20) + "M";
+	if (size >= (1u << 10) && size % (1u << 10) == 0)
+		return std::to_string(size >> 10) + "K";
+	return std::to_string(size);
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MteSdr Benchmarks" << std::endl;
+
+	BenchRunner::Options runOptions;
+	std::string filter;
+	std::string jsonPath;
+	std::string dir = ".";
+	bool stats = false;
+	size_t maxSize = 16 << 20;
+	std::vector<size_t> threadCounts;
+	threadCounts.push_back(1);
+	threadCounts.push_back(std::max(1u, std::thread::hardware_concurrency()));
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--max-size" && hasValue)
+			maxSize = parseSize(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+			threadCounts = parseList(argv[++i]);
+		else if (arg == "--min-time" && hasValue)
+			runOptions.minSeconds = std::atof(argv[++i]);
+		else if (arg == "--repetitions" && hasValue)
+			runOptions.repetitions = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (arg == "--dir" && hasValue)
+			dir = argv[++i];
+		else if (arg == "--stats")
+			stats = true;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	//
+	// Initialize MTE license.
+	//
+	std::string company = getItemFromSettings("LicensedCompany");
+	std::string license = getItemFromSettings("LicenseKey");
+	if (!MteBase::initLicense(company.c_str(), license.c_str()))
+	{
+		std::cerr << "License init error ("
+			<< MteBase::getStatusName(mte_status_license_error)
+			<< "): "
+			<< MteBase::getStatusDescription(mte_status_license_error)
+			<< std::endl;
+		return mte_status_license_error;
+	}
+	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	static const char* suites[] = {
+		"sdr-mem-write", "sdr-mem-read", "sdr-file-write", "sdr-file-read",
+		"conceal", "reveal", "conceal-lease", "reveal-lease", "random", "read-file", "write-file",
+		"b64-enc-mte", "b64-enc-scalar", "b64-enc-ssse3", "b64-enc-avx2",
+		"b64-dec-mte", "b64-dec-scalar", "b64-dec-ssse3", "b64-dec-avx2"
+	};
+
+	MteSdr::setStatsEnabled(stats);
+
+	BenchRunner runner(runOptions);
+	std::vector<BenchResult> results;
+	std::cout << std::left << std::setw(16) << "suite" << std::right
+		<< std::setw(7) << "size" << std::setw(9) << "threads"
+		<< std::setw(14) << "ops/s" << std::setw(12) << "MB/s"
+		<< std::setw(14) << "ns/op" << std::setw(12) << "allocs/op" << std::endl;
+	try
+	{
+		for (const char* suite : suites)
+		{
+			if (!filter.empty() && std::string(suite).find(filter) == std::string::npos)
+				continue;
+			if (suiteIsa(suite) > MteBase64::detected())
+				continue;
+			for (size_t size = 16; size <= maxSize && size <= (size_t(1) << 30); size *= 4)
+			{
+				for (size_t threads : threadCounts)
+				{
+					BenchResult r = runner.run(suite, size, threads, suiteSetup(suite, size, dir));
+					results.push_back(r);
+					std::cout << std::left << std::setw(16) << r.suite << std::right
+						<< std::setw(7) << formatSize(r.size) << std::setw(9) << r.threads
+						<< std::setw(14) << std::fixed << std::setprecision(0) << r.opsPerSec
+						<< std::setw(12) << std::setprecision(1) << r.mbPerSec
+						<< std::setw(14) << std::setprecision(0) << r.nsPerOp
+						<< std::setw(12) << std::setprecision(2) << r.allocsPerOp << std::endl;
+					std::cout.unsetf(std::ios::floatfield);
+					std::cout << std::setprecision(6);
+				}
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	//
+	// The lease suites must not allocate once warm. Only the one thread
+	// runs are checked, as the runner starts new threads, with empty
+	// pools, for every repetition of the others; and only the sizes the
+	// pool's classes hold, as it allocates larger buffers to size.
+	//
+	int exitCode = 0;
+	for (const BenchResult& r : results)
+	{
+		if (r.threads == 1 && r.suite.find("-lease") != std::string::npos &&
+			r.size < MteBufferPool::MaxClassBytes && r.allocsPerOp > 0)
+		{
+			std::cerr << "FAILED: " << r.suite << " " << formatSize(r.size) << " made "
+				<< r.allocsPerOp << " allocations per operation" << std::endl;
+			exitCode = 1;
+		}
+	}
+
+	if (stats)
+	{
+		std::cout << std::endl << "MteSdr phases:" << std::endl;
+		MteSdrStats::print(std::cout, MteSdr::getStats());
+	}
+
+	if (!jsonPath.empty())
+	{
+		std::ofstream json(jsonPath.c_str(), std::ios::out | std::ios::trunc);
+		BenchRunner::writeJson(json, MteBase::getVersion(), results);
+		std::cout << "Results written to " << jsonPath << std::endl;
+	}
+	return exitCode;
+}
@@ -0,0 +1,599 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "BusLog.h"
+
+#if defined(_WIN32)
+#  include <direct.h>
+#  include <io.h>
+#  include <windows.h>
+#else
+#  include <dirent.h>
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#  include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+static const size_t RecordHeaderBytes = 16;
+static const size_t IndexEntryBytes = 8;
+
+// Anything longer is taken to be corruption rather than a record.
+static const uint32_t MaxRecordBytes = 256 * 1024 * 1024;
+
+//
+// The platform specific file helpers.
+//
+static void makeDirectory(const std::string& path)
+{
+#if defined(_WIN32)
+	int rc = _mkdir(path.c_str());
+#else
+	int rc = mkdir(path.c_str(), 0755);
+#endif
+	if (rc != 0 && errno != EEXIST)
+		throw std::runtime_error("Unable to create " + path + ": " + strerror(errno));
+}
+
+static bool fileExists(const std::string& path)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == nullptr)
+		return false;
+	fclose(f);
+	return true;
+}
+
+static void seekTo(FILE* f, uint64_t position)
+{
+#if defined(_WIN32)
+	int rc = _fseeki64(f, static_cast<__int64>(position), SEEK_SET);
+#else
+	int rc = fseeko(f, static_cast<off_t>(position), SEEK_SET);
+#endif
+	if (rc != 0)
+		throw std::runtime_error(std::string("Unable to seek: ") + strerror(errno));
+}
+
+static void truncateFile(FILE* f, uint64_t size)
+{
+	fflush(f);
+#if defined(_WIN32)
+	int rc = _chsize_s(_fileno(f), static_cast<__int64>(size));
+#else
+	int rc = ftruncate(fileno(f), static_cast<off_t>(size));
+#endif
+	if (rc != 0)
+		throw std::runtime_error(std::string("Unable to truncate: ") + strerror(errno));
+}
+
+static void syncFile(FILE* f)
+{
+#if defined(_WIN32)
+	_commit(_fileno(f));
+#else
+	fsync(fileno(f));
+#endif
+}
+
+static void replaceFile(const std::string& from, const std::string& to)
+{
+#if defined(_WIN32)
+	bool ok = MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool ok = rename(from.c_str(), to.c_str()) == 0;
+#endif
+	if (!ok)
+		throw std::runtime_error("Unable to replace " + to);
+}
+
+//
+// Returns the base offsets of the segments in a partition, in order.
+//
+static std::vector<uint64_t> listSegments(const std::string& directory)
+{
+	std::vector<std::string> names;
+#if defined(_WIN32)
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "\\*.log").c_str(), &data);
+	if (find != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			names.push_back(data.cFileName);
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+	}
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir != nullptr)
+	{
+		while (struct dirent* entry = readdir(dir))
+			names.push_back(entry->d_name);
+		closedir(dir);
+	}
+#endif
+	std::vector<uint64_t> segments;
+	for (const std::string& name : names)
+	{
+		if (name.size() == 24 && name.compare(20, 4, ".log") == 0 &&
+			std::all_of(name.begin(), name.begin() + 20, [](char c) { return c >= '0' && c <= '9'; }))
+			segments.push_back(std::stoull(name.substr(0, 20)));
+	}
+	std::sort(segments.begin(), segments.end());
+	return segments;
+}
+
+static std::string segmentPath(const std::string& directory, uint64_t baseOffset, const char* extension)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%020llu", static_cast<unsigned long long>(baseOffset));
+	return directory + "/" + name + extension;
+}
+
+//
+// Little-endian packing, as in the record layout.
+//
+static void put32(uint8_t* out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+static void put64(uint8_t* out, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+static uint32_t get32(const uint8_t* in)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= static_cast<uint32_t>(in[i]) << (8 * i);
+	return value;
+}
+
+static uint64_t get64(const uint8_t* in)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++)
+		value |= static_cast<uint64_t>(in[i]) << (8 * i);
+	return value;
+}
+
+//
+// The CRC-32 (IEEE) of the record's offset and value.
+//
+struct Crc32Table
+{
+	uint32_t entries[256];
+
+	Crc32Table()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) != 0 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			entries[i] = c;
+		}
+	}
+};
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length)
+{
+	static const Crc32Table table;
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static uint32_t recordCrc(uint64_t offset, const uint8_t* value, size_t length)
+{
+	uint8_t packed[8];
+	put64(packed, offset);
+	return crc32Update(crc32Update(0, packed, sizeof(packed)), value, length);
+}
+
+//*****************************************************************************
+// Class BusPartitionWriter
+//*****************************************************************************
+BusPartitionWriter::BusPartitionWriter(const std::string& directory, const Options& options) :
+	myDirectory(directory), myOptions(options),
+	myLog(nullptr), myIndex(nullptr),
+	myBaseOffset(0), myNextOffset(0), myPosition(0), myLastIndexed(0)
+{
+	//
+	// Index entries hold 32 bit positions.
+	//
+	myOptions.segmentBytes = std::min<uint64_t>(myOptions.segmentBytes, 1ull << 31);
+	makeDirectory(myDirectory);
+	std::vector<uint64_t> segments = listSegments(myDirectory);
+	openSegment(segments.empty() ? 0 : segments.back(), !segments.empty());
+}
+
+BusPartitionWriter::~BusPartitionWriter()
+{
+	closeSegment();
+}
+
+void BusPartitionWriter::closeSegment()
+{
+	if (myLog != nullptr)
+	{
+		fflush(myLog);
+		if (myOptions.sync)
+			syncFile(myLog);
+		fclose(myLog);
+		myLog = nullptr;
+	}
+	if (myIndex != nullptr)
+	{
+		fflush(myIndex);
+		if (myOptions.sync)
+			syncFile(myIndex);
+		fclose(myIndex);
+		myIndex = nullptr;
+	}
+}
+
+void BusPartitionWriter::openSegment(uint64_t baseOffset, bool recover)
+{
+	std::string logPath = segmentPath(myDirectory, baseOffset, ".log");
+	std::string indexPath = segmentPath(myDirectory, baseOffset, ".index");
+	myLog = fopen(logPath.c_str(), recover ? "r+b" : "w+b");
+	myIndex = fopen(indexPath.c_str(), "w+b");
+	if (myLog == nullptr || myIndex == nullptr)
+		throw std::runtime_error("Unable to open segment " + logPath + ": " + strerror(errno));
+	myBaseOffset = baseOffset;
+	myNextOffset = baseOffset;
+	myPosition = 0;
+	myLastIndexed = 0;
+
+	if (recover)
+	{
+		//
+		// Scan the records, rebuilding the index, and cut the segment
+		// after the last whole record.
+		//
+		std::vector<uint8_t> value;
+		uint8_t header[RecordHeaderBytes];
+		for (;;)
+		{
+			if (fread(header, 1, sizeof(header), myLog) != sizeof(header))
+				break;
+			uint32_t length = get32(header);
+			uint32_t crc = get32(header + 4);
+			uint64_t offset = get64(header + 8);
+			if (length > MaxRecordBytes || offset != myNextOffset)
+				break;
+			value.resize(length);
+			if (length != 0 && fread(value.data(), 1, length, myLog) != length)
+				break;
+			if (recordCrc(offset, value.data(), length) != crc)
+				break;
+			if (myPosition == 0 || myPosition - myLastIndexed >= myOptions.indexInterval)
+			{
+				uint8_t entry[IndexEntryBytes];
+				put32(entry, static_cast<uint32_t>(offset - myBaseOffset));
+				put32(entry + 4, static_cast<uint32_t>(myPosition));
+				fwrite(entry, 1, sizeof(entry), myIndex);
+				myLastIndexed = myPosition;
+			}
+			myPosition += RecordHeaderBytes + length;
+			myNextOffset++;
+		}
+		truncateFile(myLog, myPosition);
+		seekTo(myLog, myPosition);
+		fflush(myIndex);
+	}
+}
+
+uint64_t BusPartitionWriter::endOffset()
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	return myNextOffset;
+}
+
+uint64_t BusPartitionWriter::append(const std::vector<std::pair<const uint8_t*, size_t> >& values)
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	uint64_t first = myNextOffset;
+	std::vector<uint8_t> index;
+	myBuffer.clear();
+
+	//
+	// Writes the buffered records, then the index entries that point at
+	// them. Readers only use the index to find where to start, and check
+	// each record themselves.
+	//
+	auto flushBuffers = [&]()
+	{
+		if (!myBuffer.empty() && fwrite(myBuffer.data(), 1, myBuffer.size(), myLog) != myBuffer.size())
+			throw std::runtime_error("Unable to append to " + myDirectory + ": " + strerror(errno));
+		if (!index.empty() && fwrite(index.data(), 1, index.size(), myIndex) != index.size())
+			throw std::runtime_error("Unable to append to the index in " + myDirectory);
+		fflush(myLog);
+		fflush(myIndex);
+		if (myOptions.sync)
+		{
+			syncFile(myLog);
+			syncFile(myIndex);
+		}
+		myBuffer.clear();
+		index.clear();
+	};
+
+	for (const auto& value : values)
+	{
+		if (value.second > MaxRecordBytes)
+			throw std::runtime_error("The message is too large for the log.");
+		if (myPosition >= myOptions.segmentBytes)
+		{
+			flushBuffers();
+			closeSegment();
+			openSegment(myNextOffset, false);
+		}
+		if (myPosition == 0 || myPosition - myLastIndexed >= myOptions.indexInterval)
+		{
+			uint8_t entry[IndexEntryBytes];
+			put32(entry, static_cast<uint32_t>(myNextOffset - myBaseOffset));
+			put32(entry + 4, static_cast<uint32_t>(myPosition));
+			index.insert(index.end(), entry, entry + sizeof(entry));
+			myLastIndexed = myPosition;
+		}
+		size_t at = myBuffer.size();
+		myBuffer.resize(at + RecordHeaderBytes + value.second);
+		put32(&myBuffer[at], static_cast<uint32_t>(value.second));
+		put32(&myBuffer[at + 4], recordCrc(myNextOffset, value.first, value.second));
+		put64(&myBuffer[at + 8], myNextOffset);
+		if (value.second != 0)
+			memcpy(&myBuffer[at + RecordHeaderBytes], value.first, value.second);
+		myPosition += RecordHeaderBytes + value.second;
+		myNextOffset++;
+	}
+	flushBuffers();
+	return first;
+}
+
+//*****************************************************************************
+// Class BusPartitionReader
+//*****************************************************************************
+BusPartitionReader::BusPartitionReader(const std::string& directory, uint64_t offset) :
+	myDirectory(directory), myLog(nullptr), myBaseOffset(0), myNextOffset(offset), myFilePosition(0)
+{
+	openSegmentFor(offset);
+}
+
+BusPartitionReader::~BusPartitionReader()
+{
+	if (myLog != nullptr)
+		fclose(myLog);
+}
+
+bool BusPartitionReader::openSegmentFor(uint64_t offset)
+{
+	std::vector<uint64_t> segments = listSegments(myDirectory);
+	auto it = std::upper_bound(segments.begin(), segments.end(), offset);
+	if (it == segments.begin())
+		return false;
+	uint64_t base = *(it - 1);
+	FILE* log = fopen(segmentPath(myDirectory, base, ".log").c_str(), "rb");
+	if (log == nullptr)
+		return false;
+	if (myLog != nullptr)
+		fclose(myLog);
+	myLog = log;
+	myBaseOffset = base;
+	myFilePosition = 0;
+
+	//
+	// Start from the last index entry at or before the offset; records
+	// before the offset are skipped by read().
+	//
+	FILE* index = fopen(segmentPath(myDirectory, base, ".index").c_str(), "rb");
+	if (index != nullptr)
+	{
+		uint8_t entry[IndexEntryBytes];
+		while (fread(entry, 1, sizeof(entry), index) == sizeof(entry))
+		{
+			if (base + get32(entry) > offset)
+				break;
+			myFilePosition = get32(entry + 4);
+		}
+		fclose(index);
+	}
+	seekTo(myLog, myFilePosition);
+	return true;
+}
+
+bool BusPartitionReader::readRecord(BusRecord& record)
+{
+	uint8_t header[RecordHeaderBytes];
+	if (fread(header, 1, sizeof(header), myLog) != sizeof(header))
+	{
+		clearerr(myLog);
+		seekTo(myLog, myFilePosition);
+		return false;
+	}
+	uint32_t length = get32(header);
+	uint32_t crc = get32(header + 4);
+	uint64_t offset = get64(header + 8);
+	if (length > MaxRecordBytes)
+		throw std::runtime_error("Corrupt record in " + myDirectory);
+	record.value.resize(length);
+	if (length != 0 && fread(record.value.data(), 1, length, myLog) != length)
+	{
+		//
+		// The writer is part way through this record; try again later.
+		//
+		clearerr(myLog);
+		seekTo(myLog, myFilePosition);
+		return false;
+	}
+	//
+	// The writer only appends, so a whole record that fails its check will
+	// never pass it.
+	//
+	if (recordCrc(offset, record.value.data(), length) != crc)
+		throw std::runtime_error("Corrupt record in " + myDirectory);
+	record.offset = offset;
+	myFilePosition += RecordHeaderBytes + length;
+	return true;
+}
+
+size_t BusPartitionReader::read(std::vector<BusRecord>& records, size_t maxRecords)
+{
+	if (myLog == nullptr && !openSegmentFor(myNextOffset))
+		return 0;
+	if (records.size() < maxRecords)
+		records.resize(maxRecords);
+
+	size_t count = 0;
+	while (count < maxRecords)
+	{
+		if (readRecord(records[count]))
+		{
+			//
+			// Skip the records between the index entry and the offset asked for.
+			//
+			if (records[count].offset < myNextOffset)
+				continue;
+			myNextOffset = records[count].offset + 1;
+			count++;
+			continue;
+		}
+		if (count != 0)
+			break;
+
+		//
+		// Nothing more in this segment. If the writer has rolled, the next
+		// segment starts at our position; drain this one once more first
+		// since it was complete before the next was created.
+		//
+		std::string next = segmentPath(myDirectory, myNextOffset, ".log");
+		if (myBaseOffset == myNextOffset || !fileExists(next))
+			break;
+		if (readRecord(records[count]))
+			continue;
+		if (!openSegmentFor(myNextOffset) || myBaseOffset != myNextOffset)
+			throw std::runtime_error("Corrupt segment in " + myDirectory);
+	}
+	return count;
+}
+
+//*****************************************************************************
+// Class BusTopic
+//*****************************************************************************
+BusTopic::BusTopic(const std::string& root, const std::string& name, size_t partitions) :
+	myDirectory(root + "/" + name), myPartitions(0)
+{
+	std::string metaPath = myDirectory + "/partitions";
+	std::ifstream meta(metaPath);
+	if (meta >> myPartitions && myPartitions != 0)
+	{
+		if (partitions != 0 && partitions != myPartitions)
+			throw std::runtime_error("Topic " + name + " already has " + std::to_string(myPartitions) + " partitions.");
+	}
+	else
+	{
+		if (partitions == 0)
+			throw std::runtime_error("Topic " + name + " does not exist.");
+		myPartitions = partitions;
+		makeDirectory(root);
+		makeDirectory(myDirectory);
+		for (size_t i = 0; i < myPartitions; i++)
+			makeDirectory(partitionDirectory(i));
+		std::ofstream out(metaPath + ".tmp");
+		out << myPartitions << std::endl;
+		out.close();
+		replaceFile(metaPath + ".tmp", metaPath);
+	}
+	myWriters.resize(myPartitions);
+}
+
+std::string BusTopic::partitionDirectory(size_t partition) const
+{
+	return myDirectory + "/" + std::to_string(partition);
+}
+
+BusPartitionWriter& BusTopic::writer(size_t partition, const BusPartitionWriter::Options& options)
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	if (!myWriters.at(partition))
+		myWriters[partition].reset(new BusPartitionWriter(partitionDirectory(partition), options));
+	return *myWriters[partition];
+}
+
+size_t BusTopic::partitionFor(const std::string& key) const
+{
+	//
+	// FNV-1a, so a key maps to the same partition in every process. Its low
+	// bits depend only on the low bits of each byte, so they are mixed with
+	// the high bits (the splitmix64 finalizer) before taking the remainder.
+	//
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : key)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+	hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+	hash ^= hash >> 31;
+	return static_cast<size_t>(hash % myPartitions);
+}
+
+uint64_t BusTopic::committed(const std::string& group, size_t partition) const
+{
+	std::ifstream in(partitionDirectory(partition) + "/" + group + ".offset");
+	uint64_t offset = 0;
+	if (!(in >> offset))
+		return 0;
+	return offset;
+}
+
+void BusTopic::commit(const std::string& group, size_t partition, uint64_t offset)
+{
+	std::string path = partitionDirectory(partition) + "/" + group + ".offset";
+	{
+		std::ofstream out(path + ".tmp", std::ios::trunc);
+		out << offset << std::endl;
+		if (!out)
+			throw std::runtime_error("Unable to write " + path);
+	}
+	replaceFile(path + ".tmp", path);
+}
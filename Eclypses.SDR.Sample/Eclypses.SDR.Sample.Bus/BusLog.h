@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef BUSLOG_H
+#define BUSLOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// A partitioned append-only log, used as a local stand-in for a message bus
+// such as Kafka.
+//
+// A topic is a directory holding a "partitions" file and one directory per
+// partition. A partition is a sequence of segments, each a ".log" file of
+// records and a sparse ".index" file, named after the offset of their first
+// record:
+//
+//   <root>/<topic>/partitions
+//   <root>/<topic>/<partition>/00000000000000000000.log
+//   <root>/<topic>/<partition>/00000000000000000000.index
+//   <root>/<topic>/<partition>/<group>.offset
+//
+// A record is a 16 byte header followed by the value; integers are
+// little-endian:
+//
+//   offset  size  field
+//   0       4     length   value length in bytes
+//   4       4     crc      CRC-32 of the offset and value
+//   8       8     offset   the record's offset in the partition
+//
+// An index entry (8 bytes) maps an offset relative to the segment to the
+// byte position of its record, and is written about every indexInterval
+// bytes. Readers look up the closest entry and scan forward.
+//
+// One process appends to a partition; any number of processes may read it
+// while it is written. A consumer group's progress is the offset of the
+// next record to read, stored per partition in "<group>.offset".
+//******************************************************************************
+
+// One record read from a partition.
+struct BusRecord
+{
+	uint64_t offset;
+	std::vector<uint8_t> value;
+};
+
+//******************************************************************************
+// Class BusPartitionWriter
+//
+// Appends records to one partition, rolling to a new segment when the
+// current one is full. On open the last segment is checked and any torn
+// record at its end (from a crash) is cut off.
+//
+// Appends are thread safe. Throws an exception on any I/O error.
+//******************************************************************************
+class BusPartitionWriter
+{
+public:
+	struct Options
+	{
+		// Roll to a new segment once the current one reaches this size.
+		uint64_t segmentBytes = 64 * 1024 * 1024;
+		// Bytes of records between index entries.
+		uint32_t indexInterval = 4096;
+		// Force each batch to disk before append returns.
+		bool sync = false;
+	};
+
+	BusPartitionWriter(const std::string& directory, const Options& options);
+	~BusPartitionWriter();
+
+	//---------------------------------------------------------
+	// Appends a batch of values and makes it visible to readers.
+	// Returns the offset of the first record in the batch.
+	//---------------------------------------------------------
+	uint64_t append(const std::vector<std::pair<const uint8_t*, size_t> >& values);
+
+	// The offset the next record will get.
+	uint64_t endOffset();
+
+private:
+	void openSegment(uint64_t baseOffset, bool recover);
+	void closeSegment();
+
+	std::string myDirectory;
+	Options myOptions;
+	std::mutex myMutex;
+
+	FILE* myLog;
+	FILE* myIndex;
+	uint64_t myBaseOffset;
+	uint64_t myNextOffset;
+	uint64_t myPosition;
+	uint64_t myLastIndexed;
+	std::vector<uint8_t> myBuffer;
+
+	BusPartitionWriter(const BusPartitionWriter&);
+	BusPartitionWriter& operator=(const BusPartitionWriter&);
+};
+
+//******************************************************************************
+// Class BusPartitionReader
+//
+// Reads one partition from a given offset, following the writer (which may
+// be in another process) as it appends and rolls segments.
+//
+// Throws an exception on any I/O error or a corrupt record.
+//******************************************************************************
+class BusPartitionReader
+{
+public:
+	BusPartitionReader(const std::string& directory, uint64_t offset);
+	~BusPartitionReader();
+
+	//---------------------------------------------------------
+	// Reads up to maxRecords records into "records", reusing its
+	// elements. Returns the number read, 0 if no new records have
+	// been written yet.
+	//---------------------------------------------------------
+	size_t read(std::vector<BusRecord>& records, size_t maxRecords);
+
+	// The offset of the next record to read.
+	uint64_t position() const { return myNextOffset; }
+
+private:
+	bool openSegmentFor(uint64_t offset);
+	bool readRecord(BusRecord& record);
+
+	std::string myDirectory;
+	FILE* myLog;
+	uint64_t myBaseOffset;
+	uint64_t myNextOffset;
+	uint64_t myFilePosition;
+
+	BusPartitionReader(const BusPartitionReader&);
+	BusPartitionReader& operator=(const BusPartitionReader&);
+};
+
+//******************************************************************************
+// Class BusTopic
+//
+// Opens or creates a topic and gives access to its partition writers and to
+// the committed offsets of consumer groups.
+//******************************************************************************
+class BusTopic
+{
+public:
+	//---------------------------------------------------------
+	// Opens the topic under root, creating it with "partitions"
+	// partitions if it does not exist (0 to require that it
+	// exists). Throws an exception on failure.
+	//---------------------------------------------------------
+	BusTopic(const std::string& root, const std::string& name, size_t partitions);
+
+	size_t partitions() const { return myPartitions; }
+
+	// The directory of a partition.
+	std::string partitionDirectory(size_t partition) const;
+
+	// The writer for a partition, opened on first use.
+	BusPartitionWriter& writer(size_t partition, const BusPartitionWriter::Options& options);
+
+	// The partition for a message key.
+	size_t partitionFor(const std::string& key) const;
+
+	// The committed offset of a group in a partition; 0 if none.
+	uint64_t committed(const std::string& group, size_t partition) const;
+
+	// Replaces the committed offset of a group in a partition atomically.
+	void commit(const std::string& group, size_t partition, uint64_t offset);
+
+private:
+	std::string myDirectory;
+	size_t myPartitions;
+	std::mutex myMutex;
+	std::vector<std::unique_ptr<BusPartitionWriter> > myWriters;
+};
+
+#endif // !BUSLOG_H
@@ -0,0 +1,433 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <csignal>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "BusLog.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+std::string getItemFromSettings(std::string key) {
+	std::ifstream file("./settings.txt");
+	std::string s;
+	while (std::getline(file, s)) {
+		std::size_t found = s.find(key);
+		if (found != std::string::npos) {
+			std::size_t eq = s.find('=');
+			if (eq != std::string::npos) {
+				return s.substr(eq + 1);
+			}
+		}
+	}
+	return "";
+}
+
+typedef std::chrono::steady_clock Clock;
+
+struct BusOptions
+{
+	std::string log = "bus";
+	std::string topic = "sdr";
+	std::string group = "reveal";
+	std::string security = "SecurityString";
+	size_t partitions = 4;
+	size_t producers = 1;
+	size_t count = 100000;
+	size_t size = 256;
+	size_t batch = 100;
+	bool follow = false;
+	BusPartitionWriter::Options writer;
+};
+
+//
+// Set by SIGINT/SIGTERM to stop a following consumer.
+//
+static std::atomic<bool> stopping(false);
+
+static void busSignalHandler(int)
+{
+	stopping = true;
+}
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Bus produce [options]" << std::endl;
+	std::cout << "      Conceals --count random messages of --size bytes and appends them to the topic." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Bus consume [options] [--follow]" << std::endl;
+	std::cout << "      Reveals the topic from the group's committed offsets, one worker per partition." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Bus bench [options]" << std::endl;
+	std::cout << "      Produces and consumes a new topic at the same time and reports end-to-end throughput" << std::endl;
+	std::cout << "      and latency." << std::endl;
+	std::cout << "Options: --log <dir> --topic <name> --partitions N --group <name> --producers N --count N" << std::endl;
+	std::cout << "         --size bytes --batch N --segment-mb N --sync" << std::endl;
+}
+
+static double percentile(const std::vector<uint64_t>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+	return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+//
+// Conceals messages and appends them to the topic, routing each by its key
+// and appending a partition's batch once it is full. When "stamp" is set the
+// first 8 bytes of each clear message hold the time it was produced.
+//
+static void produceMessages(BusTopic& topic, const BusOptions& options, size_t producer, size_t count,
+	bool stamp, std::atomic<uint64_t>& bytes)
+{
+	MteSdrDisconnected sdr = MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes);
+	sdr.initSdr(options.security);
+
+	std::vector<uint8_t> clear(std::max<size_t>(options.size, stamp ? 8 : 0));
+	MteRandom::getBytes(clear.data(), clear.size());
+
+	// The concealed messages waiting to be appended, per partition.
+	std::vector<std::vector<std::pair<const uint8_t*, size_t> > > pending(topic.partitions());
+	auto appendBatch = [&](size_t partition)
+	{
+		std::vector<std::pair<const uint8_t*, size_t> >& batch = pending[partition];
+		if (batch.empty())
+			return;
+		topic.writer(partition, options.writer).append(batch);
+		for (auto& message : batch)
+		{
+			bytes += message.second;
+			delete[] message.first;
+		}
+		batch.clear();
+	};
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (stamp)
+		{
+			uint64_t now = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+			memcpy(clear.data(), &now, sizeof(now));
+		}
+		size_t partition = topic.partitionFor("message-" + std::to_string(producer) + "-" + std::to_string(i));
+		size_t concealedLen = 0;
+		uint8_t* concealed = sdr.Conceal(clear.data(), clear.size(), concealedLen);
+		pending[partition].push_back(std::make_pair(concealed, concealedLen));
+		if (pending[partition].size() >= options.batch)
+			appendBatch(partition);
+	}
+	for (size_t p = 0; p < pending.size(); p++)
+		appendBatch(p);
+}
+
+struct ConsumerResult
+{
+	uint64_t messages = 0;
+	uint64_t bytes = 0;
+	uint64_t failed = 0;
+	std::vector<uint64_t> latencies;
+};
+
+//
+// Reveals one partition from the group's committed offset, committing after
+// each batch. Stops once the partition is drained unless "done" is given, in
+// which case it follows the partition until done() returns true.
+//
+template <typename Done>
+static void consumePartition(BusTopic& topic, const BusOptions& options, size_t partition,
+	bool stamped, std::atomic<uint64_t>& consumed, Done done, ConsumerResult& result)
+{
+	MteSdrDisconnected sdr = MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes);
+	sdr.initSdr(options.security);
+
+	BusPartitionReader reader(topic.partitionDirectory(partition), topic.committed(options.group, partition));
+	std::vector<BusRecord> records;
+	for (;;)
+	{
+		size_t count = reader.read(records, options.batch);
+		if (count == 0)
+		{
+			if (done())
+				return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			try
+			{
+				size_t clearLen = 0;
+				const uint8_t* clear = sdr.Reveal(records[i].value.data(), records[i].value.size(), clearLen);
+				result.bytes += clearLen;
+				if (stamped && clearLen >= 8)
+				{
+					uint64_t then = 0;
+					memcpy(&then, clear, sizeof(then));
+					uint64_t now = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+					result.latencies.push_back(static_cast<uint64_t>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::duration(static_cast<Clock::rep>(now - then))).count()));
+				}
+			}
+			catch (const std::exception&)
+			{
+				result.failed++;
+			}
+		}
+		result.messages += count;
+		consumed += count;
+		topic.commit(options.group, partition, reader.position());
+	}
+}
+
+static int produce(const BusOptions& options)
+{
+	BusTopic topic(options.log, options.topic, options.partitions);
+	std::atomic<uint64_t> bytes(0);
+	Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < options.producers; p++)
+	{
+		size_t count = options.count / options.producers + (p < options.count % options.producers ? 1 : 0);
+		threads.emplace_back([&, p, count] { produceMessages(topic, options, p, count, false, bytes); });
+	}
+	for (auto& t : threads)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	double rate = static_cast<double>(options.count) / elapsed;
+	std::cout << "Produced " << options.count << " messages to " << options.log << "/" << options.topic
+		<< " in " << elapsed << " seconds: " << rate << " msgs/s ("
+		<< static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed << " MB/s concealed)" << std::endl;
+	return 0;
+}
+
+static int consume(const BusOptions& options)
+{
+	BusTopic topic(options.log, options.topic, 0);
+	std::vector<ConsumerResult> results(topic.partitions());
+	std::atomic<uint64_t> consumed(0);
+	std::signal(SIGINT, busSignalHandler);
+	std::signal(SIGTERM, busSignalHandler);
+	bool follow = options.follow;
+	Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < topic.partitions(); p++)
+	{
+		threads.emplace_back([&, p]
+			{
+				try
+				{
+					consumePartition(topic, options, p, false, consumed,
+						[follow] { return !follow || stopping; }, results[p]);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "Partition " << p << ": " << e.what() << std::endl;
+				}
+			});
+	}
+	for (auto& t : threads)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	uint64_t bytes = 0;
+	uint64_t failed = 0;
+	for (size_t p = 0; p < results.size(); p++)
+	{
+		std::cout << "Partition " << p << ": " << results[p].messages << " messages, committed offset "
+			<< topic.committed(options.group, p) << std::endl;
+		bytes += results[p].bytes;
+		failed += results[p].failed;
+	}
+	std::cout << "Revealed " << consumed << " messages (" << failed << " failed) for group " << options.group
+		<< " in " << elapsed << " seconds: " << static_cast<double>(consumed) / elapsed << " msgs/s ("
+		<< static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed << " MB/s clear)" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
+
+static int bench(BusOptions options)
+{
+	//
+	// Always start from an empty topic so runs are comparable.
+	//
+	options.topic = "bench-" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+	BusTopic topic(options.log, options.topic, options.partitions);
+
+	std::atomic<uint64_t> produced(0);
+	std::atomic<uint64_t> consumed(0);
+	std::vector<ConsumerResult> results(topic.partitions());
+	uint64_t expected = options.count;
+	Clock::time_point start = Clock::now();
+
+	std::vector<std::thread> consumers;
+	for (size_t p = 0; p < topic.partitions(); p++)
+	{
+		consumers.emplace_back([&, p]
+			{
+				try
+				{
+					consumePartition(topic, options, p, true, consumed,
+						[&] { return consumed >= expected || stopping; }, results[p]);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "Partition " << p << ": " << e.what() << std::endl;
+					stopping = true;
+				}
+			});
+	}
+	std::vector<std::thread> producers;
+	for (size_t p = 0; p < options.producers; p++)
+	{
+		size_t count = options.count / options.producers + (p < options.count % options.producers ? 1 : 0);
+		producers.emplace_back([&, p, count] { produceMessages(topic, options, p, count, true, produced); });
+	}
+	for (auto& t : producers)
+		t.join();
+	double produceElapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	for (auto& t : consumers)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<uint64_t> all;
+	uint64_t failed = 0;
+	for (auto& r : results)
+	{
+		all.insert(all.end(), r.latencies.begin(), r.latencies.end());
+		failed += r.failed;
+	}
+	std::sort(all.begin(), all.end());
+
+	std::cout << "topic=" << options.log << "/" << options.topic
+		<< " partitions=" << options.partitions
+		<< " producers=" << options.producers
+		<< " size=" << options.size
+		<< " batch=" << options.batch << std::endl;
+	std::cout << "produce: " << static_cast<double>(options.count) / produceElapsed << " msgs/s ("
+		<< static_cast<double>(produced) / (1024.0 * 1024.0) / produceElapsed << " MB/s concealed)" << std::endl;
+	std::cout << "end-to-end: messages=" << consumed << " failed=" << failed
+		<< " seconds=" << elapsed
+		<< " throughput=" << static_cast<double>(consumed) / elapsed << " msgs/s" << std::endl;
+	std::cout << "latency us: p50=" << percentile(all, 0.50)
+		<< " p99=" << percentile(all, 0.99)
+		<< " p999=" << percentile(all, 0.999)
+		<< " max=" << (all.empty() ? 0.0 : static_cast<double>(all.back()) / 1000.0) << std::endl;
+	return failed == 0 && consumed == expected ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MteSdr Message Bus" << std::endl;
+
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+	std::string mode = argv[1];
+
+	BusOptions options;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--log" && hasValue)
+			options.log = argv[++i];
+		else if (arg == "--topic" && hasValue)
+			options.topic = argv[++i];
+		else if (arg == "--group" && hasValue)
+			options.group = argv[++i];
+		else if (arg == "--partitions" && hasValue)
+			options.partitions = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--producers" && hasValue)
+			options.producers = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--count" && hasValue)
+			options.count = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--size" && hasValue)
+			options.size = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--batch" && hasValue)
+			options.batch = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--segment-mb" && hasValue)
+			options.writer.segmentBytes = std::max<uint64_t>(1, std::strtoull(argv[++i], nullptr, 10)) * 1024 * 1024;
+		else if (arg == "--sync")
+			options.writer.sync = true;
+		else if (arg == "--follow")
+			options.follow = true;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	//
+	// Initialize MTE license.
+	//
+	std::string company = getItemFromSettings("LicensedCompany");
+	std::string license = getItemFromSettings("LicenseKey");
+	if (!MteBase::initLicense(company.c_str(), license.c_str()))
+	{
+		std::cerr << "License init error ("
+			<< MteBase::getStatusName(mte_status_license_error)
+			<< "): "
+			<< MteBase::getStatusDescription(mte_status_license_error)
+			<< std::endl;
+		return mte_status_license_error;
+	}
+	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	try
+	{
+		if (mode == "produce")
+			return produce(options);
+		if (mode == "consume")
+			return consume(options);
+		if (mode == "bench")
+			return bench(options);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	usage();
+	return 1;
+}
@@ -28,11 +28,15 @@
 #include <string>
 #include <cstring>
 #include <algorithm>
+#include <vector>
 
 #include "MteBase.h"
+#include "MteBase64.h"
 #include "MteSdr.h"
 #include "Consumer.h"
 #include "MteSdrDisconnected.h"
+#include "SpoolWatcher.h"
+#include "ChromeTrace.h"
 
 #if defined(_MSC_VER)
 #  pragma warning(disable:4996)
@@ -53,7 +57,21 @@ std::string getItemFromSettings(std::string key) {
 	return "";
 }
 
-int main()
+//
+// Prints the command line usage.
+//
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Consumer" << std::endl;
+	std::cout << "      Prompts for a protected file and reveals it. A '.b64' file is Base64 decoded first." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Consumer --watch <spool dir> [--out <dir>] [--workers N] [--queue N] [--stats S]" << std::endl;
+	std::cout << "      Reveals every '.sdr' file dropped into the spool directory until interrupted." << std::endl;
+	std::cout << "  Add --trace <file.json> to either to record a timeline for chrome://tracing or Perfetto." << std::endl;
+	std::cout << "  Add --capture <file> to either to record the SDR operations for replay by the LoadGen." << std::endl;
+}
+
+int main(int argc, char* argv[])
 {
 	std::cout << "---------------------------" << std::endl;
 	std::cout << "Eclypses MteSdr Demo Consumer" << std::endl;
@@ -74,6 +92,73 @@ int main()
 	}
 	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
 	std::cout << "---------------------------" << std::endl;
+
+	//
+	// --trace and --capture may be given in any mode; the other arguments
+	// choose the mode.
+	//
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+		{
+			ChromeTrace::start(argv[++i]);
+			ChromeTrace::setThreadName("main");
+			std::cout << "Tracing to " << argv[i] << std::endl;
+		}
+		else if (std::string(argv[i]) == "--capture" && i + 1 < argc)
+		{
+			try
+			{
+				MteSdr::startCapture(argv[++i]);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return 1;
+			}
+			std::cout << "Capturing SDR operations to " << argv[i] << std::endl;
+		}
+		else
+		{
+			args.push_back(argv[i]);
+		}
+	}
+	//
+	// In watch mode, stay resident and reveal files as they arrive.
+	//
+	if (!args.empty())
+	{
+		SpoolWatcher::Options options;
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			const std::string& arg = args[i];
+			bool hasValue = i + 1 < args.size();
+			if (arg == "--watch" && hasValue)
+				options.directory = args[++i];
+			else if (arg == "--out" && hasValue)
+				options.outputDirectory = args[++i];
+			else if (arg == "--workers" && hasValue)
+				options.workers = std::strtoul(args[++i].c_str(), nullptr, 10);
+			else if (arg == "--queue" && hasValue)
+				options.queueDepth = std::strtoul(args[++i].c_str(), nullptr, 10);
+			else if (arg == "--stats" && hasValue)
+				options.statsInterval = static_cast<unsigned>(std::strtoul(args[++i].c_str(), nullptr, 10));
+			else
+			{
+				usage();
+				return 1;
+			}
+		}
+		if (options.directory.empty())
+		{
+			usage();
+			return 1;
+		}
+		std::cout << "Watching " << options.directory << " with " << options.workers << " workers" << std::endl;
+		SpoolWatcher watcher(options);
+		return watcher.run();
+	}
 	//
 	// Get a file name to reveal.
 	//
@@ -84,9 +169,27 @@ int main()
 	// Read a protected file into memory
 	//
 	size_t fileSize;
-	const uint8_t* protectedData = readFile(filename, fileSize);
+	std::cout << "Reading original protected file - " << filename << std::endl;
+	const uint8_t* protectedData;
+	{
+		ChromeTrace::Span span("readFile", "io");
+		protectedData = readFile(filename, fileSize);
+		span.setBytes(static_cast<int64_t>(fileSize));
+	}
 	std::cout << "Protected file succesfully read - " << fileSize << " bytes" << std::endl;
 	//
+	// The Producer's text-safe output is Base64.
+	//
+	std::vector<uint8_t> decoded;
+	const std::string b64 = ".b64";
+	if (protectedData != nullptr && filename.size() > b64.size() &&
+		filename.compare(filename.size() - b64.size(), b64.size(), b64) == 0)
+	{
+		ChromeTrace::Span span("base64", "sdr", static_cast<int64_t>(fileSize));
+		decoded.resize(MteBase64::decodeBytes(fileSize));
+		decoded.resize(MteBase64::decode(protectedData, fileSize, decoded.data()));
+	}
+	//
 	// Initialize the Eclypses SDR with a security string that matches both the Concealer and the Revealer;
 	//
 	MteSdrDisconnected sdr = MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes);
@@ -95,16 +198,26 @@ int main()
 	// Reveal the data using Eclypses MTE
 	//
 	size_t clearLen;
-	const uint8_t* revealed = sdr.Reveal(protectedData, fileSize, clearLen);
+	const uint8_t* revealed;
+	{
+		ChromeTrace::Span span("Reveal", "sdr", static_cast<int64_t>(fileSize));
+		if (!decoded.empty())
+			revealed = sdr.Reveal(decoded.data(), decoded.size(), clearLen);
+		else
+			revealed = sdr.Reveal(protectedData, fileSize, clearLen);
+	}
 	//
 	// Write the revealed file
 	//
 	std::string revealedFileName = filename + ".clear";
-	writeFile(revealedFileName, revealed, clearLen);
+	{
+		ChromeTrace::Span span("writeFile", "io", static_cast<int64_t>(clearLen));
+		writeFile(revealedFileName, revealed, clearLen);
+	}
 	std::cout << "Original file (" << revealedFileName << ") successfully written - " << clearLen << " bytes" << std::endl;
+	delete[] protectedData;
 }
 const uint8_t* readFile(const std::string& filePath, size_t& valueBytes) {
-	std::cout << "Reading original protected file - " << filePath << std::endl;
 	const uint8_t* value = nullptr;
 	std::ifstream fs(filePath.c_str(),
 		std::ios::in | std::ios::binary);
@@ -116,7 +229,8 @@ const uint8_t* readFile(const std::string& filePath, size_t& valueBytes) {
 	}
 	fs.seekg(0, std::ios::end);
 	valueBytes = fs.tellg();
-	value = new uint8_t[valueBytes];
+	uint8_t* buffer = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::FileRead, valueBytes);
+	value = buffer;
 	if (value == nullptr)
 	{
 		valueBytes = 0;
@@ -124,15 +238,18 @@ const uint8_t* readFile(const std::string& filePath, size_t& valueBytes) {
 		return nullptr;
 	}
 	fs.seekg(0, std::ios::beg);
-	fs.read((char*)(value), valueBytes);
+	fs.read((char*)(buffer), valueBytes);
 	if (fs.bad() || (size_t)fs.gcount() != valueBytes)
 	{
+		MteSdrAlloc::release(MteSdrAlloc::FileRead, buffer, valueBytes);
 		value = nullptr;
 		valueBytes = 0;
 		fs.close();
 		return nullptr;
 	}
 	fs.close();
+	// The caller deletes it.
+	MteSdrAlloc::handOut(MteSdrAlloc::FileRead, valueBytes);
 	return value;
 }
 
@@ -24,6 +24,12 @@
  * SOFTWARE.
  *******************************************************************************/
 #include "MteSdrDisconnected.h"
+#include "ChromeTrace.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 
 void MteSdrDisconnected::initSdr(const std::string security) {
 	const std::string location = "";
@@ -31,6 +37,10 @@ void MteSdrDisconnected::initSdr(const std::string security) {
 }
 
 uint8_t* MteSdrDisconnected::Conceal(const uint8_t* clearData, size_t clearDataLen, size_t& protectedDataLen) {
+	//
+	// Captured as one operation; the write, read and remove below are not.
+	//
+	MteSdrCapture::Scope capture(MteSdrCapture::Conceal, std::string(), nullptr);
 	//
 	// The key is the lookup key for this item in the data store (std::map)
 	// it's value is inconsequential since this item is removed one it is used.
@@ -49,13 +59,13 @@ uint8_t* MteSdrDisconnected::Conceal(const uint8_t* clearData, size_t clearDataL
 	MteSdr::write(key, clearData, clearDataLen);
 	//
 	// This reads the protected data from the std::map and then removes it
-	// leaving no trace.
-	//
-	uint8_t* protectedData = readRecord(location, key, protectedDataLen);
-	//
-	// Since we are finished with the data stored in the std::map, remove it.
+	// leaving no trace. The caller deletes the protected data, so take it
+	// out of the std::map before removing the entry.
 	//
-	removeRecord(location, key);
+	tracedReadRecord(location, key, protectedDataLen);
+	uint8_t* protectedData = detachRecord(key);
+	tracedRemoveRecord(location, key);
+	capture.succeeded(clearDataLen);
 	//
 	// Return the protected data.
 	//
@@ -63,6 +73,7 @@ uint8_t* MteSdrDisconnected::Conceal(const uint8_t* clearData, size_t clearDataL
 }
 
 const uint8_t* MteSdrDisconnected::Reveal(const uint8_t* protectedData, size_t protectedDataLen, size_t& clearDataLen) {
+	MteSdrCapture::Scope capture(MteSdrCapture::Reveal, std::string(), nullptr);
 	//
     // The key is the lookup key for this item in the data store (std::map)
     // it's value is inconsequential since this item is removed one it is used.
@@ -76,7 +87,7 @@ const uint8_t* MteSdrDisconnected::Reveal(const uint8_t* protectedData, size_t p
 	// This places the protected data into the std::map so that we
 	// can get it using the SDR - this actually reveals the original value.
 	//
-	writeRecord(location, key, protectedData, protectedDataLen);
+	tracedWriteRecord(location, key, protectedData, protectedDataLen);
 	//
 	// This reads the data from the MTE / SDR which converts it back
 	// to the original value.
@@ -85,9 +96,167 @@ const uint8_t* MteSdrDisconnected::Reveal(const uint8_t* protectedData, size_t p
 	//
 	// Since we are finished with the data stored in the std::map, remove it.
 	//
-	removeRecord(location, key);
+	tracedRemoveRecord(location, key);
+	capture.succeeded(clearDataLen);
 	//
 	// Return the clear data.
 	//
 	return clearData;
-}
\ No newline at end of file
+}
+
+MteBufferPool::Lease MteSdrDisconnected::Conceal(const uint8_t* clearData, size_t clearDataLen) {
+	MteSdrCapture::Scope capture(MteSdrCapture::Conceal, std::string(), nullptr);
+	mte_status status;
+	MteBufferPool::Lease protectedData = encryptLease(clearData, clearDataLen, status);
+	if (status != mte_status_success)
+	{
+		throw std::runtime_error(std::string("Error encrypting data (") + MteBase::getStatusName(status) +
+			"): " + MteBase::getStatusDescription(status));
+	}
+	capture.succeeded(clearDataLen);
+	return protectedData;
+}
+
+MteBufferPool::Lease MteSdrDisconnected::Reveal(const uint8_t* protectedData, size_t protectedDataLen) {
+	MteSdrCapture::Scope capture(MteSdrCapture::Reveal, std::string(), nullptr);
+	mte_status status;
+	MteBufferPool::Lease clearData = decryptLease(protectedData, protectedDataLen, status);
+	if (status != mte_status_success)
+	{
+		throw std::runtime_error(std::string("Error decrypting data (") + MteBase::getStatusName(status) +
+			"): " + MteBase::getStatusDescription(status));
+	}
+	capture.succeeded(clearData.size());
+	return clearData;
+}
+
+void MteSdrDisconnected::ConcealRows(const MteSdrColumn& clearColumn, size_t first, size_t last, MteSdrColumn& protectedColumn) {
+	for (size_t row = first; row < last; row++)
+	{
+		//
+		// Encrypt straight from the column; the result is only valid until
+		// the next call, so copy it into the output column now.
+		//
+		size_t clearLen;
+		const uint8_t* clear = clearColumn.value(row, clearLen);
+		mte_status status;
+		size_t protectedLen;
+		const uint8_t* protectedData = encrypt(clear, clearLen, protectedLen, status);
+		if (status != mte_status_success)
+		{
+			throw std::runtime_error(std::string("Error encrypting data (") + MteBase::getStatusName(status) +
+				"): " + MteBase::getStatusDescription(status));
+		}
+		protectedColumn.append(protectedData, protectedLen);
+	}
+}
+
+void MteSdrDisconnected::RevealRows(const MteSdrColumn& protectedColumn, size_t first, size_t last, MteSdrColumn& clearColumn) {
+	for (size_t row = first; row < last; row++)
+	{
+		size_t protectedLen;
+		const uint8_t* protectedData = protectedColumn.value(row, protectedLen);
+		mte_status status;
+		size_t clearLen;
+		const uint8_t* clear = decrypt(protectedData, protectedLen, clearLen, status);
+		if (status != mte_status_success)
+		{
+			throw std::runtime_error(std::string("Error decrypting data (") + MteBase::getStatusName(status) +
+				"): " + MteBase::getStatusDescription(status));
+		}
+		clearColumn.append(clear, clearLen);
+	}
+}
+
+void MteSdrDisconnected::ConcealColumn(const MteSdrColumn& clearColumn, MteSdrColumn& protectedColumn) {
+	ConcealRows(clearColumn, 0, clearColumn.rows(), protectedColumn);
+}
+
+void MteSdrDisconnected::RevealColumn(const MteSdrColumn& protectedColumn, MteSdrColumn& clearColumn) {
+	RevealRows(protectedColumn, 0, protectedColumn.rows(), clearColumn);
+}
+
+MteSdrParallel::MteSdrParallel(mte_sdr_random rnd_cb, const std::string& security, size_t threads, size_t rowGroupRows) :
+	myRowGroupRows(rowGroupRows == 0 ? 1 : rowGroupRows)
+{
+	if (threads == 0)
+		threads = 1;
+	for (size_t i = 0; i < threads; i++)
+	{
+		mySdrs.emplace_back(new MteSdrDisconnected(rnd_cb));
+		mySdrs.back()->initSdr(security);
+	}
+}
+
+void MteSdrParallel::ConcealColumn(const MteSdrColumn& clearColumn, MteSdrColumn& protectedColumn) {
+	run(clearColumn, protectedColumn, true);
+}
+
+void MteSdrParallel::RevealColumn(const MteSdrColumn& protectedColumn, MteSdrColumn& clearColumn) {
+	run(protectedColumn, clearColumn, false);
+}
+
+void MteSdrParallel::run(const MteSdrColumn& input, MteSdrColumn& output, bool conceal) {
+	size_t rows = input.rows();
+	size_t groups = (rows + myRowGroupRows - 1) / myRowGroupRows;
+	if (myGroups.size() < groups)
+		myGroups.resize(groups);
+
+	//
+	// Each thread takes the next row group until there are none left.
+	//
+	std::atomic<size_t> nextGroup(0);
+	std::exception_ptr failure;
+	std::mutex failureMutex;
+	auto work = [&](MteSdrDisconnected* sdr)
+	{
+		try
+		{
+			for (size_t group = nextGroup++; group < groups; group = nextGroup++)
+			{
+				size_t first = group * myRowGroupRows;
+				size_t last = (std::min)(rows, first + myRowGroupRows);
+				myGroups[group].clear();
+				ChromeTrace::Span span(conceal ? "ConcealRows" : "RevealRows", "sdr",
+					static_cast<int64_t>(last - first));
+				if (conceal)
+					sdr->ConcealRows(input, first, last, myGroups[group]);
+				else
+					sdr->RevealRows(input, first, last, myGroups[group]);
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(failureMutex);
+			failure = std::current_exception();
+			nextGroup = groups;
+		}
+	};
+	size_t threads = (std::min)(mySdrs.size(), groups);
+	std::vector<std::thread> helpers;
+	for (size_t i = 1; i < threads; i++)
+		helpers.emplace_back(work, mySdrs[i].get());
+	if (threads != 0)
+		work(mySdrs[0].get());
+	for (auto& t : helpers)
+		t.join();
+	if (failure)
+		std::rethrow_exception(failure);
+
+	//
+	// Join the row groups in order.
+	//
+	size_t dataBytes = output.data.size();
+	for (size_t group = 0; group < groups; group++)
+		dataBytes += myGroups[group].data.size();
+	output.data.reserve(dataBytes);
+	output.offsets.reserve(output.offsets.size() + rows);
+	for (size_t group = 0; group < groups; group++)
+	{
+		const MteSdrColumn& part = myGroups[group];
+		size_t base = output.data.size();
+		output.data.insert(output.data.end(), part.data.begin(), part.data.end());
+		for (size_t row = 1; row < part.offsets.size(); row++)
+			output.offsets.push_back(base + part.offsets[row]);
+	}
+}
@@ -0,0 +1,454 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+#include "ChromeTrace.h"
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "Consumer.h"
+#include "MteSdrDisconnected.h"
+#include "SpoolWatcher.h"
+
+#if defined(__linux__)
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#endif
+
+//
+// Set by the signal handler; checked by the watcher loop.
+//
+static volatile std::sig_atomic_t spoolSignalled = 0;
+
+static void spoolSignalHandler(int)
+{
+	spoolSignalled = 1;
+}
+
+SpoolWatcher::SpoolWatcher(const Options& options) :
+	myOptions(options), myStopping(false),
+	myQueued(0), myRevealed(0), myFailed(0), myBytesIn(0), myBytesOut(0),
+	myLatencyTotalUs(0), myLatencyMaxUs(0), myIntervalMaxUs(0),
+	myLastRevealed(0), myLastLatencyTotalUs(0)
+{
+	if (myOptions.outputDirectory.empty())
+		myOptions.outputDirectory = myOptions.directory;
+	if (myOptions.workers == 0)
+		myOptions.workers = 1;
+	if (myOptions.queueDepth == 0)
+		myOptions.queueDepth = 1;
+}
+
+SpoolWatcher::~SpoolWatcher()
+{
+	stop();
+	for (auto& t : myWorkers)
+	{
+		if (t.joinable())
+			t.join();
+	}
+}
+
+void SpoolWatcher::stop()
+{
+	myStopping = true;
+	std::lock_guard<std::mutex> lock(myMutex);
+	myNotEmpty.notify_all();
+	myNotFull.notify_all();
+}
+
+bool SpoolWatcher::wanted(const std::string& name) const
+{
+	const std::string& suffix = myOptions.suffix;
+	if (name.empty() || name[0] == '.' || name.size() <= suffix.size())
+		return false;
+	return name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool SpoolWatcher::enqueue(const std::string& name)
+{
+	if (!wanted(name))
+		return true;
+
+	std::unique_lock<std::mutex> lock(myMutex);
+	//
+	// A file can be reported by the startup scan and by an event, or
+	// more than once after an event queue overflow - only queue it once.
+	//
+	if (myInFlight.count(name) != 0)
+		return true;
+	//
+	// Apply back pressure to the watcher when the workers fall behind.
+	// Events keep accumulating in the kernel meanwhile. The signal handler
+	// cannot notify, so look at its flag every half second as run() does.
+	//
+	while (!myStopping && !spoolSignalled && myQueue.size() >= myOptions.queueDepth)
+		myNotFull.wait_for(lock, std::chrono::milliseconds(500));
+	if (myStopping || spoolSignalled)
+		return false;
+
+	Job job;
+	job.name = name;
+	job.arrived = Clock::now();
+	myQueue.push_back(job);
+	myInFlight.insert(name);
+	++myQueued;
+	myNotEmpty.notify_one();
+	return true;
+}
+
+void SpoolWatcher::worker()
+{
+	//
+	// Each worker owns its SDR; initialization is paid once here rather
+	// than once per file.
+	//
+	ChromeTrace::setThreadName("reveal worker");
+	MteSdrDisconnected sdr = MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes);
+	sdr.initSdr(myOptions.security);
+
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(myMutex);
+			myNotEmpty.wait(lock, [this] { return myStopping || !myQueue.empty(); });
+			if (myQueue.empty())
+				return;
+			job = myQueue.front();
+			myQueue.pop_front();
+			myNotFull.notify_one();
+		}
+
+		//
+		// An event can still be queued for a file revealed and renamed
+		// since; that is not a failure.
+		//
+		if (exists(job.name))
+		{
+			if (reveal(sdr, job))
+				++myRevealed;
+			else
+				++myFailed;
+		}
+
+		std::lock_guard<std::mutex> lock(myMutex);
+		myInFlight.erase(job.name);
+	}
+}
+
+SpoolWatcher::Stats SpoolWatcher::getStats() const
+{
+	Stats stats;
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		stats.queueDepth = myQueue.size();
+	}
+	stats.queued = myQueued;
+	stats.revealed = myRevealed;
+	stats.failed = myFailed;
+	stats.bytesIn = myBytesIn;
+	stats.bytesOut = myBytesOut;
+	stats.latencyAvgMs = stats.revealed == 0 ? 0.0 :
+		static_cast<double>(myLatencyTotalUs) / stats.revealed / 1000.0;
+	stats.latencyMaxMs = static_cast<double>(myLatencyMaxUs) / 1000.0;
+	return stats;
+}
+
+SpoolWatcher::Stats SpoolWatcher::getIntervalStats()
+{
+	Stats stats = getStats();
+	uint64_t totalUs = myLatencyTotalUs;
+	uint64_t revealed = stats.revealed - myLastRevealed;
+	stats.latencyAvgMs = revealed == 0 ? 0.0 :
+		static_cast<double>(totalUs - myLastLatencyTotalUs) / revealed / 1000.0;
+	stats.latencyMaxMs = static_cast<double>(myIntervalMaxUs.exchange(0)) / 1000.0;
+	myLastRevealed = stats.revealed;
+	myLastLatencyTotalUs = totalUs;
+	return stats;
+}
+
+void SpoolWatcher::printStats(const Stats& stats) const
+{
+	std::cout << "queue=" << stats.queueDepth
+		<< " queued=" << stats.queued
+		<< " revealed=" << stats.revealed
+		<< " failed=" << stats.failed
+		<< " in=" << stats.bytesIn << "B"
+		<< " out=" << stats.bytesOut << "B"
+		<< " latency avg=" << stats.latencyAvgMs << "ms"
+		<< " max=" << stats.latencyMaxMs << "ms" << std::endl;
+}
+
+#if defined(__linux__)
+
+//
+// Writes the data to a temporary file in the target directory, flushes it
+// and renames it over the final name so it appears atomically.
+//
+static bool writeFileAtomic(const std::string& directory, const std::string& name,
+	const uint8_t* data, size_t dataLen)
+{
+	std::string finalPath = MteSdr::mkFilePath(directory, name);
+	std::string tempPath = MteSdr::mkFilePath(directory, "." + name + ".tmp");
+	int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+	size_t written = 0;
+	while (written < dataLen)
+	{
+		ssize_t rc = write(fd, data + written, dataLen - written);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			close(fd);
+			unlink(tempPath.c_str());
+			return false;
+		}
+		written += static_cast<size_t>(rc);
+	}
+	if (fsync(fd) != 0 || close(fd) != 0)
+	{
+		unlink(tempPath.c_str());
+		return false;
+	}
+	if (rename(tempPath.c_str(), finalPath.c_str()) != 0)
+	{
+		unlink(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool SpoolWatcher::exists(const std::string& name) const
+{
+	std::string path = MteSdr::mkFilePath(myOptions.directory, name);
+	return access(path.c_str(), F_OK) == 0 || errno != ENOENT;
+}
+
+bool SpoolWatcher::reveal(MteSdrDisconnected& sdr, const Job& job)
+{
+	std::string inputPath = MteSdr::mkFilePath(myOptions.directory, job.name);
+
+	size_t fileSize;
+	const uint8_t* protectedData;
+	{
+		ChromeTrace::Span span("readFile", "io");
+		protectedData = readFile(inputPath, fileSize);
+		span.setBytes(protectedData != nullptr ? static_cast<int64_t>(fileSize) : 0);
+	}
+	if (protectedData == nullptr)
+	{
+		std::cerr << "Unable to read " << inputPath << std::endl;
+		return false;
+	}
+
+	bool ok = false;
+	try
+	{
+		size_t clearLen;
+		const uint8_t* revealed;
+		{
+			ChromeTrace::Span span("Reveal", "sdr", static_cast<int64_t>(fileSize));
+			revealed = sdr.Reveal(protectedData, fileSize, clearLen);
+		}
+		{
+			ChromeTrace::Span span("writeFile", "io", static_cast<int64_t>(clearLen));
+			ok = writeFileAtomic(myOptions.outputDirectory, job.name + ".clear", revealed, clearLen);
+		}
+		if (ok)
+		{
+			myBytesIn += fileSize;
+			myBytesOut += clearLen;
+		}
+		else
+		{
+			std::cerr << "Unable to write the revealed version of " << inputPath << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Unable to reveal " << inputPath << ": " << e.what() << std::endl;
+	}
+	delete[] protectedData;
+
+	if (!ok)
+		return false;
+	//
+	// Mark the input as done so a restart does not reveal it again.
+	//
+	rename(inputPath.c_str(), (inputPath + ".done").c_str());
+
+	uint64_t us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		Clock::now() - job.arrived).count());
+	myLatencyTotalUs += us;
+	uint64_t max = myLatencyMaxUs;
+	while (us > max && !myLatencyMaxUs.compare_exchange_weak(max, us))
+	{
+	}
+	max = myIntervalMaxUs;
+	while (us > max && !myIntervalMaxUs.compare_exchange_weak(max, us))
+	{
+	}
+	return true;
+}
+
+void SpoolWatcher::scanDirectory()
+{
+	std::list<std::string> names;
+	struct dirent** entries = nullptr;
+	int c = scandir(myOptions.directory.c_str(), &entries, nullptr, alphasort);
+	for (int i = 0; i < c; i++)
+	{
+		if (entries[i]->d_type == DT_REG || entries[i]->d_type == DT_UNKNOWN)
+			names.push_back(entries[i]->d_name);
+		free(entries[i]);
+	}
+	if (entries != nullptr)
+		free(entries);
+
+	for (const auto& name : names)
+	{
+		if (!enqueue(name))
+			return;
+	}
+}
+
+int SpoolWatcher::run()
+{
+	//
+	// Watch for files that were closed after writing or moved into the
+	// spool. A file still being written is never picked up.
+	//
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return errno;
+	if (inotify_add_watch(fd, myOptions.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		int rc = errno;
+		close(fd);
+		return rc;
+	}
+
+	std::signal(SIGINT, spoolSignalHandler);
+	std::signal(SIGTERM, spoolSignalHandler);
+
+	for (size_t i = 0; i < myOptions.workers; i++)
+		myWorkers.emplace_back(&SpoolWatcher::worker, this);
+
+	//
+	// Pick up anything dropped while we were not running.
+	//
+	scanDirectory();
+
+	auto nextStats = Clock::now() + std::chrono::seconds(myOptions.statsInterval);
+	alignas(struct inotify_event) char buffer[64 * 1024];
+	while (!myStopping && !spoolSignalled)
+	{
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		int rc = poll(&pfd, 1, 500);
+		if (rc > 0)
+		{
+			for (;;)
+			{
+				ssize_t len = read(fd, buffer, sizeof(buffer));
+				if (len <= 0)
+					break;
+				for (char* p = buffer; p < buffer + len;)
+				{
+					const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+					if (ev->mask & IN_Q_OVERFLOW)
+					{
+						//
+						// Events were lost; the directory is the source of truth.
+						//
+						scanDirectory();
+					}
+					else if (ev->len > 0 && !(ev->mask & IN_ISDIR))
+					{
+						enqueue(ev->name);
+					}
+					p += sizeof(struct inotify_event) + ev->len;
+				}
+			}
+		}
+
+		if (myOptions.statsInterval != 0 && Clock::now() >= nextStats)
+		{
+			printStats(getIntervalStats());
+			nextStats = Clock::now() + std::chrono::seconds(myOptions.statsInterval);
+		}
+	}
+
+	//
+	// Let the workers drain what is already queued, then shut them down.
+	//
+	{
+		std::unique_lock<std::mutex> lock(myMutex);
+		myNotFull.wait_for(lock, std::chrono::seconds(30), [this] { return myQueue.empty(); });
+	}
+	stop();
+	for (auto& t : myWorkers)
+	{
+		if (t.joinable())
+			t.join();
+	}
+	myWorkers.clear();
+	close(fd);
+	printStats(getStats());
+	return 0;
+}
+
+#else
+
+bool SpoolWatcher::exists(const std::string&) const
+{
+	return true;
+}
+
+bool SpoolWatcher::reveal(MteSdrDisconnected&, const Job&)
+{
+	return false;
+}
+
+void SpoolWatcher::scanDirectory()
+{
+}
+
+int SpoolWatcher::run()
+{
+	std::cerr << "The spool watcher requires inotify and is only available on Linux." << std::endl;
+	return ENOSYS;
+}
+
+#endif
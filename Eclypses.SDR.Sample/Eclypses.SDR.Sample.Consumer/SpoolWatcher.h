@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SPOOLWATCHER_H
+#define SPOOLWATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MteSdrDisconnected;
+
+//******************************************************************************
+// Class SpoolWatcher
+//
+// Long-running reveal mode for the Consumer. A directory is watched (inotify on
+// Linux) for complete ".sdr" files - files that were closed after writing or
+// renamed into the directory. Each new file is queued to a bounded pool of
+// workers, each of which owns an MteSdrDisconnected that was initialized once
+// at startup, so the license and SDR setup costs are not paid per file.
+//
+// The revealed output is written to a temporary file and renamed into place so
+// that downstream readers never see a partial file. The input is then renamed
+// with a ".done" suffix so it is not revealed again after a restart.
+//
+// To use, fill in the Options, construct and call run(). run() blocks until
+// stop() is called or SIGINT/SIGTERM is received.
+//******************************************************************************
+class SpoolWatcher
+{
+public:
+	struct Options
+	{
+		// The spool directory to watch.
+		std::string directory;
+		// The directory to write revealed files to; blank for the spool directory.
+		std::string outputDirectory;
+		// The SDR security string; must match the one used by the Producer.
+		std::string security = "SecurityString";
+		// Only files ending with this suffix are revealed.
+		std::string suffix = ".sdr";
+		// The number of reveal workers (each owns an SDR instance).
+		size_t workers = 4;
+		// The maximum number of files waiting for a worker.
+		size_t queueDepth = 256;
+		// How often to print the statistics, in seconds (0 for never).
+		unsigned statsInterval = 10;
+	};
+
+	// A snapshot of the watcher statistics. Latency is measured from the time
+	// the file was seen as complete to the time its output was in place.
+	struct Stats
+	{
+		size_t queueDepth;
+		uint64_t queued;
+		uint64_t revealed;
+		uint64_t failed;
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		double latencyAvgMs;
+		double latencyMaxMs;
+	};
+
+	explicit SpoolWatcher(const Options& options);
+	~SpoolWatcher();
+
+	//------------------------------------------------------------
+	// Runs the watcher until stopped. Returns 0 on a clean stop or
+	// an errno style value if the directory could not be watched.
+	//------------------------------------------------------------
+	int run();
+
+	// Requests the watcher to stop; safe to call from any thread.
+	void stop();
+
+	// Returns a snapshot of the statistics.
+	Stats getStats() const;
+
+	// Returns the statistics since the previous call to this method; the
+	// latency figures cover only that interval.
+	Stats getIntervalStats();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		std::string name;
+		Clock::time_point arrived;
+	};
+
+	// Queues a file by name (relative to the spool directory). Blocks while
+	// the queue is full. Returns false if stopping.
+	bool enqueue(const std::string& name);
+
+	// Queues every complete file already in the spool directory.
+	void scanDirectory();
+
+	// The worker loop; one SDR instance per worker.
+	void worker();
+
+	// Returns true if the file is still in the spool directory.
+	bool exists(const std::string& name) const;
+
+	// Reveals one file. Returns true on success.
+	bool reveal(MteSdrDisconnected& sdr, const Job& job);
+
+	// Returns true if the name is one this watcher reveals.
+	bool wanted(const std::string& name) const;
+
+	void printStats(const Stats& stats) const;
+
+private:
+	Options myOptions;
+	std::atomic<bool> myStopping;
+
+	mutable std::mutex myMutex;
+	std::condition_variable myNotEmpty;
+	std::condition_variable myNotFull;
+	std::deque<Job> myQueue;
+	// Files queued or being revealed; used to drop duplicate events.
+	std::set<std::string> myInFlight;
+	std::vector<std::thread> myWorkers;
+
+	std::atomic<uint64_t> myQueued;
+	std::atomic<uint64_t> myRevealed;
+	std::atomic<uint64_t> myFailed;
+	std::atomic<uint64_t> myBytesIn;
+	std::atomic<uint64_t> myBytesOut;
+	std::atomic<uint64_t> myLatencyTotalUs;
+	std::atomic<uint64_t> myLatencyMaxUs;
+	std::atomic<uint64_t> myIntervalMaxUs;
+
+	// The totals at the last interval report.
+	uint64_t myLastRevealed;
+	uint64_t myLastLatencyTotalUs;
+};
+
+#endif // !SPOOLWATCHER_H
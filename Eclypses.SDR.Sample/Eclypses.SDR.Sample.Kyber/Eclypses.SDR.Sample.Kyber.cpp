@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "MteKyber.h"
+#include "MteKyberGate.h"
+#include "HandshakeBench.h"
+#include "MixedBench.h"
+#include "ExchangeBench.h"
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Kyber handshake-bench [--strength 512|768|1024] [--bursts N] [--burst N] [--gap ms]" << std::endl;
+	std::cout << "                                            [--min-depth N] [--max-depth N] [--refill seconds] [--threads N]" << std::endl;
+	std::cout << "      Times Kyber handshakes in bursts of new peers generating each key pair on the request" << std::endl;
+	std::cout << "      thread, and taking it from an MteKyberPool that generates them on --threads threads." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Kyber strength-mix [--strengths n,n,...] [--threads N] [--handshakes N]" << std::endl;
+	std::cout << "      Serves handshakes of each strength in turn on --threads threads at once in one process." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Kyber exchange-bench [--strengths n,n,...] [--requests N] [--threads N] [--batch N]" << std::endl;
+	std::cout << "                                           [--entropy bytes]" << std::endl;
+	std::cout << "      Times each strength's exchanges served on the request thread, and by an MteKyberEngine" << std::endl;
+	std::cout << "      of --threads workers taking --batch requests at a time." << std::endl;
+}
+
+//
+// Returns the strength for 512, 768 or 1024.
+//
+static KyberStrength parseStrength(const std::string& text)
+{
+	if (text == "512")
+		return K512;
+	if (text == "768")
+		return K768;
+	if (text == "1024")
+		return K1024;
+	throw std::runtime_error("Unknown Kyber strength: " + text);
+}
+
+//
+// Returns the strengths in a comma separated list.
+//
+static std::vector<KyberStrength> parseStrengths(const std::string& list)
+{
+	std::vector<KyberStrength> strengths;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		if (comma > start)
+			strengths.push_back(parseStrength(list.substr(start, comma - start)));
+		start = comma + 1;
+	}
+	return strengths;
+}
+
+static int handshakeBench(const std::vector<std::string>& args)
+{
+	HandshakeBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--strength" && hasValue)
+			options.pool.strength = parseStrength(args[++i]);
+		else if (arg == "--bursts" && hasValue)
+			options.bursts = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--burst" && hasValue)
+			options.burstSize = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--gap" && hasValue)
+			options.gapMs = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--min-depth" && hasValue)
+			options.pool.minDepth = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--max-depth" && hasValue)
+			options.pool.maxDepth = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--refill" && hasValue)
+			options.pool.refillSeconds = std::atof(args[++i].c_str());
+		else if (arg == "--threads" && hasValue)
+			options.pool.threads = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "Kyber handshakes, " << MteKyberGate::get().sizes(options.pool.strength).algorithm << ", " << options.bursts << " bursts of "
+		<< options.burstSize << std::endl;
+	HandshakeBench bench(options);
+	HandshakeBench::print(std::cout, bench.run());
+	return 0;
+}
+
+static int strengthMix(const std::vector<std::string>& args)
+{
+	MixedBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--strengths" && hasValue)
+			options.strengths = parseStrengths(args[++i]);
+		else if (arg == "--threads" && hasValue)
+			options.threads = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--handshakes" && hasValue)
+			options.handshakes = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "Kyber handshakes of mixed strengths, " << options.handshakes << " on " << options.threads
+		<< " threads" << std::endl;
+	MixedBench bench(options);
+	MixedBench::print(std::cout, bench.run());
+	return 0;
+}
+
+static int exchangeBench(const std::vector<std::string>& args)
+{
+	ExchangeBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--strengths" && hasValue)
+			options.strengths = parseStrengths(args[++i]);
+		else if (arg == "--requests" && hasValue)
+			options.requests = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--threads" && hasValue)
+			options.engine.threads = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--batch" && hasValue)
+			options.engine.batchSize = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--entropy" && hasValue)
+			options.engine.entropyBytes = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "Kyber exchanges, " << options.requests << " requests per strength" << std::endl;
+	ExchangeBench bench(options);
+	ExchangeBench::print(std::cout, bench.run());
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MTE Kyber Samples" << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+	std::string command = argv[1];
+	std::vector<std::string> args(argv + 2, argv + argc);
+	try
+	{
+		if (command == "handshake-bench")
+			return handshakeBench(args);
+		if (command == "strength-mix")
+			return strengthMix(args);
+		if (command == "exchange-bench")
+			return exchangeBench(args);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	usage();
+	return 1;
+}
@@ -0,0 +1,185 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "ExchangeBench.h"
+#include "MteKyberPool.h"
+#include "MteHistogram.h"
+#include "MteBase.h"
+#include "MteRandom.h"
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <stdexcept>
+
+typedef std::chrono::steady_clock Clock;
+
+//
+// Makes a secret for the peer's public key as a request thread would without
+// the engine.
+//
+static MteKyberEngine::Response respondDirect(KyberStrength strength, const std::vector<uint8_t>& peerPublicKey)
+{
+	MteKyberInstance responder(strength);
+	std::vector<uint8_t> entropy(responder.getMinEntropySize());
+	if (MteRandom::getBytes(entropy.data(), entropy.size()) != 0)
+		throw std::runtime_error("Unable to get random bytes for the Kyber entropy");
+	int result = responder.setEntropy(entropy.data(), entropy.size());
+	MteKyberEngine::Response response;
+	response.secret.resize(responder.getSecretSize());
+	response.encrypted.resize(responder.getEncryptedSize());
+	size_t secretBytes = response.secret.size();
+	size_t encryptedBytes = response.encrypted.size();
+	if (result == MteKyber::Success)
+		result = responder.createSecret(peerPublicKey.data(), peerPublicKey.size(),
+			response.secret.data(), secretBytes, response.encrypted.data(), encryptedBytes);
+	MteKyber::zeroize(entropy.data(), entropy.size());
+	if (result != MteKyber::Success)
+		throw std::runtime_error("Error creating the Kyber secret: " + std::to_string(result));
+	response.secret.resize(secretBytes);
+	response.encrypted.resize(encryptedBytes);
+	response.latencyNs = 0;
+	return response;
+}
+
+//
+// Throws if the secrets differ.
+//
+static void checkSecret(const std::vector<uint8_t>& decrypted, const std::vector<uint8_t>& secret)
+{
+	if (decrypted.size() != secret.size() || memcmp(decrypted.data(), secret.data(), secret.size()) != 0)
+		throw std::runtime_error("The two sides of a Kyber exchange have different secrets");
+}
+
+ExchangeBench::ExchangeBench(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.strengths.empty())
+		throw std::runtime_error("No Kyber strengths to exchange");
+	if (myOptions.requests == 0)
+		myOptions.requests = 1;
+}
+
+std::vector<ExchangeBench::Result> ExchangeBench::run()
+{
+	std::vector<Result> results;
+	MteKyberEngine engine(myOptions.engine);
+	size_t requests = myOptions.requests;
+	for (KyberStrength strength : myOptions.strengths)
+	{
+		std::string algorithm = MteKyberGate::get().sizes(strength).algorithm;
+		auto addResult = [&](const char* operation, const char* method, const MteHistogram& latency, double seconds)
+		{
+			Result r;
+			r.algorithm = algorithm;
+			r.operation = operation;
+			r.method = method;
+			r.requests = latency.count();
+			r.requestsPerSec = seconds > 0 ? static_cast<double>(r.requests) / seconds : 0.0;
+			r.p50Us = static_cast<double>(latency.percentile(50)) / 1000.0;
+			r.p99Us = static_cast<double>(latency.percentile(99)) / 1000.0;
+			results.push_back(r);
+		};
+		auto sinceNs = [](Clock::time_point start)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+		};
+
+		std::vector<MteKyberPool::KeyPair> pairs;
+		for (size_t i = 0; i < requests; i++)
+			pairs.push_back(MteKyberPool::generate(strength));
+
+		std::vector<MteKyberEngine::Response> responses(requests);
+		MteHistogram latency;
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < requests; i++)
+		{
+			responses[i] = respondDirect(strength, pairs[i].publicKey);
+			latency.record(sinceNs(start));
+		}
+		addResult("createSecret", "direct", latency, std::chrono::duration<double>(Clock::now() - start).count());
+
+		latency.reset();
+		start = Clock::now();
+		for (size_t i = 0; i < requests; i++)
+		{
+			std::vector<uint8_t> secret(pairs[i].kyber->getSecretSize());
+			size_t secretBytes = secret.size();
+			int result = pairs[i].kyber->decryptSecret(responses[i].encrypted.data(), responses[i].encrypted.size(),
+				secret.data(), secretBytes);
+			if (result != MteKyber::Success)
+				throw std::runtime_error("Error decrypting the Kyber secret: " + std::to_string(result));
+			secret.resize(secretBytes);
+			latency.record(sinceNs(start));
+			checkSecret(secret, responses[i].secret);
+		}
+		addResult("decryptSecret", "direct", latency, std::chrono::duration<double>(Clock::now() - start).count());
+
+		latency.reset();
+		start = Clock::now();
+		std::vector<std::future<MteKyberEngine::Response> > responding;
+		for (size_t i = 0; i < requests; i++)
+			responding.push_back(engine.respond(strength, pairs[i].publicKey));
+		for (size_t i = 0; i < requests; i++)
+		{
+			responses[i] = responding[i].get();
+			latency.record(responses[i].latencyNs);
+		}
+		addResult("createSecret", "engine", latency, std::chrono::duration<double>(Clock::now() - start).count());
+
+		latency.reset();
+		start = Clock::now();
+		std::vector<std::future<MteKyberEngine::Secret> > decrypting;
+		for (size_t i = 0; i < requests; i++)
+			decrypting.push_back(engine.decrypt(*pairs[i].kyber, responses[i].encrypted));
+		for (size_t i = 0; i < requests; i++)
+		{
+			MteKyberEngine::Secret secret = decrypting[i].get();
+			latency.record(secret.latencyNs);
+			checkSecret(secret.secret, responses[i].secret);
+		}
+		addResult("decryptSecret", "engine", latency, std::chrono::duration<double>(Clock::now() - start).count());
+	}
+	return results;
+}
+
+void ExchangeBench::print(std::ostream& out, const std::vector<Result>& results)
+{
+	out << std::left << std::setw(16) << "algorithm" << std::setw(15) << "operation" << std::setw(8) << "method" << std::right
+		<< std::setw(10) << "requests" << std::setw(12) << "requests/s"
+		<< std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::endl;
+	for (const Result& r : results)
+	{
+		out << std::left << std::setw(16) << r.algorithm << std::setw(15) << r.operation << std::setw(8) << r.method
+			<< std::right << std::fixed
+			<< std::setw(10) << r.requests
+			<< std::setw(12) << std::setprecision(0) << r.requestsPerSec
+			<< std::setw(12) << std::setprecision(1) << r.p50Us
+			<< std::setw(12) << r.p99Us << std::endl;
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+	}
+}
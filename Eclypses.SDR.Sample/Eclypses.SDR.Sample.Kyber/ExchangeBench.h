@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef EXCHANGEBENCH_H
+#define EXCHANGEBENCH_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MteKyberEngine.h"
+
+//******************************************************************************
+// Class ExchangeBench
+//
+// Measures Kyber key exchange throughput and latency for each strength, as a
+// gateway's responder sees them. Each strength's requests arrive at once,
+// one per initiator key pair made beforehand, and both halves of the
+// exchange are timed in two ways:
+//   direct  -- each request is served in turn on the request thread, the
+//              responder making an MteKyberInstance and getting its entropy
+//              from the OS per request. The latency is from the arrival of
+//              the requests to its end.
+//   engine  -- the requests are queued to an MteKyberEngine. The latency is
+//              from queueing to completion.
+// Every decrypted secret is checked against the responder's.
+//******************************************************************************
+class ExchangeBench
+{
+public:
+	struct Options
+	{
+		std::vector<KyberStrength> strengths = { K512, K768, K1024 };
+		size_t requests = 2000;
+		MteKyberEngine::Options engine;
+	};
+
+	struct Result
+	{
+		std::string algorithm;
+		// createSecret or decryptSecret.
+		std::string operation;
+		std::string method;
+		uint64_t requests;
+		double requestsPerSec;
+		double p50Us;
+		double p99Us;
+	};
+
+	explicit ExchangeBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on Kyber error or if the two
+	// sides of an exchange do not agree on the secret.
+	std::vector<Result> run();
+
+	static void print(std::ostream& out, const std::vector<Result>& results);
+
+private:
+	Options myOptions;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "HandshakeBench.h"
+#include "MteHistogram.h"
+#include "MteBase.h"
+#include "MteRandom.h"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+void HandshakeBench::handshake(MteKyberPool::KeyPair& initiator)
+{
+	MteKyberInstance responder(initiator.kyber->getStrength());
+	std::vector<uint8_t> entropy(responder.getMinEntropySize());
+	if (MteRandom::getBytes(entropy.data(), entropy.size()) != 0)
+		throw std::runtime_error("Unable to get random bytes for the Kyber entropy");
+	int result = responder.setEntropy(entropy.data(), entropy.size());
+	std::vector<uint8_t> secret(responder.getSecretSize());
+	std::vector<uint8_t> encrypted(responder.getEncryptedSize());
+	size_t secretBytes = secret.size();
+	size_t encryptedBytes = encrypted.size();
+	if (result == MteKyber::Success)
+		result = responder.createSecret(initiator.publicKey.data(), initiator.publicKey.size(),
+			secret.data(), secretBytes, encrypted.data(), encryptedBytes);
+	MteKyber::zeroize(entropy.data(), entropy.size());
+	if (result != MteKyber::Success)
+		throw std::runtime_error("Error creating the Kyber secret: " + std::to_string(result));
+
+	std::vector<uint8_t> initiatorSecret(initiator.kyber->getSecretSize());
+	size_t initiatorSecretBytes = initiatorSecret.size();
+	result = initiator.kyber->decryptSecret(encrypted.data(), encryptedBytes, initiatorSecret.data(), initiatorSecretBytes);
+	if (result != MteKyber::Success)
+		throw std::runtime_error("Error decrypting the Kyber secret: " + std::to_string(result));
+	if (initiatorSecretBytes != secretBytes || memcmp(initiatorSecret.data(), secret.data(), secretBytes) != 0)
+		throw std::runtime_error("The two sides of a Kyber handshake have different secrets");
+	MteKyber::zeroize(secret.data(), secret.size());
+	MteKyber::zeroize(initiatorSecret.data(), initiatorSecret.size());
+}
+
+HandshakeBench::HandshakeBench(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.bursts == 0)
+		myOptions.bursts = 1;
+	if (myOptions.burstSize == 0)
+		myOptions.burstSize = 1;
+}
+
+std::vector<HandshakeBench::Result> HandshakeBench::run()
+{
+	std::vector<Result> results;
+	auto runBursts = [this, &results](const char* method, const std::function<MteKyberPool::KeyPair()>& keyPair,
+		const std::function<uint64_t()>& generated)
+	{
+		MteHistogram latency;
+		double busySeconds = 0;
+		for (size_t b = 0; b < myOptions.bursts; b++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(myOptions.gapMs));
+			Clock::time_point start = Clock::now();
+			for (size_t i = 0; i < myOptions.burstSize; i++)
+			{
+				MteKyberPool::KeyPair pair = keyPair();
+				handshake(pair);
+				latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+			}
+			busySeconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Result r;
+		r.method = method;
+		r.handshakes = latency.count();
+		r.handshakesPerSec = busySeconds > 0 ? static_cast<double>(r.handshakes) / busySeconds : 0.0;
+		r.p50Us = static_cast<double>(latency.percentile(50)) / 1000.0;
+		r.p99Us = static_cast<double>(latency.percentile(99)) / 1000.0;
+		r.maxUs = static_cast<double>(latency.max()) / 1000.0;
+		r.generated = generated();
+		results.push_back(r);
+	};
+
+	KyberStrength strength = myOptions.pool.strength;
+	runBursts("direct", [strength] { return MteKyberPool::generate(strength); },
+		[this] { return static_cast<uint64_t>(myOptions.bursts * myOptions.burstSize); });
+
+	MteKyberPool pool(myOptions.pool);
+	runBursts("pool", [&pool] { return pool.take(); }, [&pool] { return pool.stats().misses; });
+	return results;
+}
+
+void HandshakeBench::print(std::ostream& out, const std::vector<Result>& results)
+{
+	out << std::left << std::setw(10) << "method" << std::right
+		<< std::setw(12) << "handshakes" << std::setw(14) << "handshakes/s"
+		<< std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us"
+		<< std::setw(12) << "generated" << std::endl;
+	for (const Result& r : results)
+	{
+		out << std::left << std::setw(10) << r.method << std::right << std::fixed
+			<< std::setw(12) << r.handshakes
+			<< std::setw(14) << std::setprecision(0) << r.handshakesPerSec
+			<< std::setw(12) << std::setprecision(1) << r.p50Us
+			<< std::setw(12) << r.p99Us
+			<< std::setw(12) << r.maxUs
+			<< std::setw(12) << r.generated << std::endl;
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+	}
+}
@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef HANDSHAKEBENCH_H
+#define HANDSHAKEBENCH_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MteKyberPool.h"
+
+//******************************************************************************
+// Class HandshakeBench
+//
+// Measures Kyber handshake latency under bursts of new peers. Each burst of
+// burstSize handshakes arrives at once and is served in turn on one thread,
+// so a handshake's latency is from the start of the burst to its end, as
+// for a queue of waiting peers. A handshake takes the initiator's key pair,
+// makes the responder's secret from its public key and decrypts it on the
+// initiator's side, checking that the secrets match. Two ways are timed:
+//   direct  -- the key pair is generated on the request thread.
+//   pool    -- the key pair is taken from an MteKyberPool that refills in
+//              the background during the gaps between bursts.
+//******************************************************************************
+class HandshakeBench
+{
+public:
+	struct Options
+	{
+		// The strength is pool.strength.
+		size_t bursts = 5;
+		size_t burstSize = 1000;
+		size_t gapMs = 1000;
+		MteKyberPool::Options pool;
+	};
+
+	struct Result
+	{
+		std::string method;
+		uint64_t handshakes;
+		double handshakesPerSec;
+		double p50Us;
+		double p99Us;
+		double maxUs;
+		// Handshakes that generated their key pair on the request thread.
+		uint64_t generated;
+	};
+
+	explicit HandshakeBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on Kyber error or if the two
+	// sides of a handshake do not agree on the secret.
+	std::vector<Result> run();
+
+	static void print(std::ostream& out, const std::vector<Result>& results);
+
+	// Completes a handshake with the initiator's key pair. Throws an
+	// exception on Kyber error or if the secrets differ.
+	static void handshake(MteKyberPool::KeyPair& initiator);
+
+private:
+	Options myOptions;
+};
+
+#endif
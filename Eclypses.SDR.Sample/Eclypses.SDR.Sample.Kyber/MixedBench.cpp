@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MixedBench.h"
+#include "MteKyberGate.h"
+#include "HandshakeBench.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+MixedBench::MixedBench(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.strengths.empty())
+		throw std::runtime_error("No Kyber strengths to serve");
+	if (myOptions.threads == 0)
+		myOptions.threads = 1;
+}
+
+MixedBench::Result MixedBench::run()
+{
+	size_t kinds = myOptions.strengths.size();
+	std::vector<uint64_t> counts(kinds, 0);
+	std::vector<double> busy(kinds, 0.0);
+	std::atomic<size_t> next(0);
+	std::mutex mutex;
+	std::exception_ptr error;
+
+	MteKyberGate::Stats before = MteKyberGate::get().stats();
+	Clock::time_point start = Clock::now();
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < myOptions.threads; t++)
+	{
+		workers.push_back(std::thread([&]
+			{
+				std::vector<uint64_t> myCounts(kinds, 0);
+				std::vector<double> myBusy(kinds, 0.0);
+				try
+				{
+					for (size_t i = next++; i < myOptions.handshakes; i = next++)
+					{
+						size_t kind = i % kinds;
+						Clock::time_point begin = Clock::now();
+						MteKyberPool::KeyPair pair = MteKyberPool::generate(myOptions.strengths[kind]);
+						HandshakeBench::handshake(pair);
+						myBusy[kind] += std::chrono::duration<double>(Clock::now() - begin).count();
+						myCounts[kind]++;
+					}
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error)
+						error = std::current_exception();
+					next = myOptions.handshakes;
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				for (size_t k = 0; k < kinds; k++)
+				{
+					counts[k] += myCounts[k];
+					busy[k] += myBusy[k];
+				}
+			}));
+	}
+	for (std::thread& w : workers)
+		w.join();
+	if (error)
+		std::rethrow_exception(error);
+
+	Result result;
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.switches = MteKyberGate::get().stats().switches - before.switches;
+	for (size_t k = 0; k < kinds; k++)
+	{
+		Row row;
+		row.algorithm = MteKyberGate::get().sizes(myOptions.strengths[k]).algorithm;
+		row.handshakes = counts[k];
+		row.handshakesPerSec = result.seconds > 0 ? static_cast<double>(counts[k]) / result.seconds : 0.0;
+		row.meanUs = counts[k] > 0 ? busy[k] * 1e6 / static_cast<double>(counts[k]) : 0.0;
+		result.rows.push_back(row);
+	}
+	return result;
+}
+
+void MixedBench::print(std::ostream& out, const Result& result)
+{
+	out << std::left << std::setw(16) << "algorithm" << std::right
+		<< std::setw(12) << "handshakes" << std::setw(14) << "handshakes/s" << std::setw(12) << "mean us" << std::endl;
+	uint64_t total = 0;
+	for (const Row& r : result.rows)
+	{
+		out << std::left << std::setw(16) << r.algorithm << std::right << std::fixed
+			<< std::setw(12) << r.handshakes
+			<< std::setw(14) << std::setprecision(0) << r.handshakesPerSec
+			<< std::setw(12) << std::setprecision(1) << r.meanUs << std::endl;
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+		total += r.handshakes;
+	}
+	out << total << " handshakes in " << result.seconds << " seconds; the strength switched "
+		<< result.switches << " times" << std::endl;
+}
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MIXEDBENCH_H
+#define MIXEDBENCH_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MteKyber.h"
+
+//******************************************************************************
+// Class MixedBench
+//
+// Serves Kyber handshakes of mixed strengths from one process. Worker
+// threads take the next handshake from a shared counter, the strengths in
+// turn, so every strength is in use at once; each handshake uses
+// MteKyberInstance objects of its strength and is checked. The result has
+// the handshakes of each strength and how many times the MteKyberGate
+// switched the process's strength.
+//******************************************************************************
+class MixedBench
+{
+public:
+	struct Options
+	{
+		std::vector<KyberStrength> strengths = { K512, K768, K1024 };
+		size_t threads = 4;
+		size_t handshakes = 3000;
+	};
+
+	struct Row
+	{
+		std::string algorithm;
+		uint64_t handshakes;
+		double handshakesPerSec;
+		// The mean time of a handshake on its thread.
+		double meanUs;
+	};
+
+	struct Result
+	{
+		std::vector<Row> rows;
+		double seconds;
+		uint64_t switches;
+	};
+
+	explicit MixedBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on Kyber error or if the two
+	// sides of a handshake do not agree on the secret.
+	Result run();
+
+	static void print(std::ostream& out, const Result& result);
+
+private:
+	Options myOptions;
+};
+
+#endif
@@ -0,0 +1,245 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteKyberEngine.h"
+#include "MteBase.h"
+#include "MteRandom.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+//******************************************************************************
+// Class MteKyberEngine::Worker
+//
+// The state of one worker thread: its responders and its entropy pool, which
+// the responders draw on through the entropy callback. Each slice handed out
+// is used once; MteKyber wipes the entropy it takes.
+//******************************************************************************
+class MteKyberEngine::Worker : public MteKyber::EntropyCallback
+{
+public:
+	explicit Worker(size_t entropyBytes) :
+		myPool(entropyBytes), myUsed(entropyBytes)
+	{
+	}
+
+	~Worker()
+	{
+		myResponders.clear();
+		MteKyber::zeroize(myPool.data(), myPool.size());
+	}
+
+	//
+	// Returns this thread's responder of the strength, made on first use.
+	//
+	MteKyberInstance& responder(KyberStrength strength)
+	{
+		std::unique_ptr<MteKyberInstance>& kyber = myResponders[strength];
+		if (!kyber)
+		{
+			kyber.reset(new MteKyberInstance(strength));
+			kyber->setEntropyCallback(this);
+		}
+		return *kyber;
+	}
+
+	virtual int entropyCallback(void** entropy, size_t* entropyBytes, size_t minEntropyBytes, size_t maxEntropyBytes)
+	{
+		(void)maxEntropyBytes;
+		if (myPool.size() < minEntropyBytes)
+		{
+			MteKyber::zeroize(myPool.data(), myPool.size());
+			myPool.assign(minEntropyBytes, 0);
+			myUsed = myPool.size();
+		}
+		if (myPool.size() - myUsed < minEntropyBytes)
+		{
+			if (MteRandom::getBytes(myPool.data(), myPool.size()) != 0)
+				return MteKyber::EntropyFail;
+			myUsed = 0;
+		}
+		*entropy = &myPool[myUsed];
+		*entropyBytes = minEntropyBytes;
+		myUsed += minEntropyBytes;
+		return MteKyber::Success;
+	}
+
+private:
+	std::map<KyberStrength, std::unique_ptr<MteKyberInstance> > myResponders;
+	std::vector<uint8_t> myPool;
+	size_t myUsed;
+};
+
+MteKyberEngine::MteKyberEngine(const Options& options) :
+	myOptions(options), myStop(false), myCompleted(0), myBatches(0)
+{
+	if (myOptions.threads == 0)
+		myOptions.threads = std::max(1u, std::thread::hardware_concurrency());
+	if (myOptions.batchSize == 0)
+		myOptions.batchSize = 1;
+	for (size_t t = 0; t < myOptions.threads; t++)
+		myThreads.push_back(std::thread(&MteKyberEngine::work, this));
+}
+
+MteKyberEngine::~MteKyberEngine()
+{
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		myStop = true;
+	}
+	myQueued.notify_all();
+	for (std::thread& t : myThreads)
+		t.join();
+}
+
+std::future<MteKyberEngine::Response> MteKyberEngine::respond(KyberStrength strength, std::vector<uint8_t> peerPublicKey)
+{
+	// Throws now if the strength is not supported.
+	MteKyberGate::get().sizes(strength);
+	Job job;
+	job.strength = strength;
+	job.initiator = nullptr;
+	job.input = std::move(peerPublicKey);
+	std::future<Response> future = job.response.get_future();
+	push(std::move(job));
+	return future;
+}
+
+std::future<MteKyberEngine::Secret> MteKyberEngine::decrypt(MteKyberInstance& initiator, std::vector<uint8_t> encrypted)
+{
+	Job job;
+	job.strength = initiator.getStrength();
+	job.initiator = &initiator;
+	job.input = std::move(encrypted);
+	std::future<Secret> future = job.secret.get_future();
+	push(std::move(job));
+	return future;
+}
+
+MteKyberEngine::Stats MteKyberEngine::stats() const
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	Stats s;
+	s.completed = myCompleted;
+	s.batches = myBatches;
+	return s;
+}
+
+void MteKyberEngine::push(Job&& job)
+{
+	job.queued = Clock::now();
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		if (myStop)
+			throw std::runtime_error("The Kyber engine is stopping");
+		myJobs.push_back(std::move(job));
+	}
+	myQueued.notify_one();
+}
+
+//
+// Runs batches of queued requests until the engine stops and the queue is
+// empty.
+//
+void MteKyberEngine::work()
+{
+	Worker worker(myOptions.entropyBytes);
+	std::vector<Job> batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(myMutex);
+			myQueued.wait(lock, [this] { return myStop || !myJobs.empty(); });
+			if (myJobs.empty())
+				return;
+			batch.clear();
+			size_t take = std::min(myOptions.batchSize, myJobs.size());
+			for (size_t i = 0; i < take; i++)
+			{
+				batch.push_back(std::move(myJobs.front()));
+				myJobs.pop_front();
+			}
+			myBatches++;
+			// Leave the rest to another worker.
+			if (!myJobs.empty())
+				myQueued.notify_one();
+		}
+		std::stable_sort(batch.begin(), batch.end(), [](const Job& a, const Job& b)
+			{
+				return a.strength < b.strength;
+			});
+
+		for (Job& job : batch)
+		{
+			try
+			{
+				if (job.initiator == nullptr)
+				{
+					MteKyberInstance& responder = worker.responder(job.strength);
+					Response response;
+					response.secret.resize(responder.getSecretSize());
+					response.encrypted.resize(responder.getEncryptedSize());
+					size_t secretBytes = response.secret.size();
+					size_t encryptedBytes = response.encrypted.size();
+					int result = responder.createSecret(job.input.data(), job.input.size(),
+						response.secret.data(), secretBytes, response.encrypted.data(), encryptedBytes);
+					if (result != MteKyber::Success)
+						throw std::runtime_error("Error creating the Kyber secret: " + std::to_string(result));
+					response.secret.resize(secretBytes);
+					response.encrypted.resize(encryptedBytes);
+					response.latencyNs = static_cast<uint64_t>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - job.queued).count());
+					job.response.set_value(std::move(response));
+				}
+				else
+				{
+					Secret secret;
+					secret.secret.resize(job.initiator->getSecretSize());
+					size_t secretBytes = secret.secret.size();
+					int result = job.initiator->decryptSecret(job.input.data(), job.input.size(),
+						secret.secret.data(), secretBytes);
+					if (result != MteKyber::Success)
+						throw std::runtime_error("Error decrypting the Kyber secret: " + std::to_string(result));
+					secret.secret.resize(secretBytes);
+					secret.latencyNs = static_cast<uint64_t>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - job.queued).count());
+					job.secret.set_value(std::move(secret));
+				}
+			}
+			catch (...)
+			{
+				if (job.initiator == nullptr)
+					job.response.set_exception(std::current_exception());
+				else
+					job.secret.set_exception(std::current_exception());
+			}
+		}
+		std::lock_guard<std::mutex> lock(myMutex);
+		myCompleted += batch.size();
+	}
+}
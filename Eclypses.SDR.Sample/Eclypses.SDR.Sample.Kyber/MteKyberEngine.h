@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTEKYBERENGINE_H
+#define MTEKYBERENGINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MteKyberInstance.h"
+
+//******************************************************************************
+// Class MteKyberEngine
+//
+// Runs Kyber exchanges for a gateway on a pool of worker threads instead of
+// the request threads. respond() queues making a secret for a peer's public
+// key (createSecret), decrypt() queues decrypting the secret a peer
+// encrypted for one of our key pairs (decryptSecret), and each returns a
+// future of the result.
+//
+// A worker takes up to batchSize queued requests at once and runs them
+// ordered by strength, so the MteKyberGate switches strengths as little as
+// possible. Each worker has its own MteKyberInstance of each strength for
+// respond(), whose entropy comes from a per-thread pool refilled entropyBytes
+// at a time from the OS random source through setEntropyCallback(), rather
+// than a system call per exchange.
+//
+// Each result has the time from queueing to completion. A Kyber error is
+// given to the future as an exception. Thread safe; the destructor finishes
+// the queued requests.
+//******************************************************************************
+class MteKyberEngine
+{
+public:
+	struct Options
+	{
+		// The worker threads; 0 is one per core.
+		size_t threads = 0;
+		size_t batchSize = 32;
+		size_t entropyBytes = 4096;
+	};
+
+	// The result of respond(): the secret, and the encrypted secret to send
+	// to the peer.
+	struct Response
+	{
+		std::vector<uint8_t> secret;
+		std::vector<uint8_t> encrypted;
+		uint64_t latencyNs;
+	};
+
+	// The result of decrypt().
+	struct Secret
+	{
+		std::vector<uint8_t> secret;
+		uint64_t latencyNs;
+	};
+
+	struct Stats
+	{
+		uint64_t completed;
+		uint64_t batches;
+	};
+
+	explicit MteKyberEngine(const Options& options);
+	~MteKyberEngine();
+
+	// Queues making a secret of the strength for the peer's public key.
+	std::future<Response> respond(KyberStrength strength, std::vector<uint8_t> peerPublicKey);
+
+	// Queues decrypting the encrypted secret with the key pair in initiator,
+	// which must not be used or destroyed until the future is ready.
+	std::future<Secret> decrypt(MteKyberInstance& initiator, std::vector<uint8_t> encrypted);
+
+	Stats stats() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		KyberStrength strength;
+		// Null for respond().
+		MteKyberInstance* initiator;
+		std::vector<uint8_t> input;
+		Clock::time_point queued;
+		std::promise<Response> response;
+		std::promise<Secret> secret;
+	};
+
+	class Worker;
+
+	MteKyberEngine(const MteKyberEngine&);
+	MteKyberEngine& operator=(const MteKyberEngine&);
+
+	void push(Job&& job);
+	void work();
+
+	Options myOptions;
+
+	mutable std::mutex myMutex;
+	std::condition_variable myQueued;
+	std::deque<Job> myJobs;
+	bool myStop;
+
+	uint64_t myCompleted;
+	uint64_t myBatches;
+
+	std::vector<std::thread> myThreads;
+};
+
+#endif
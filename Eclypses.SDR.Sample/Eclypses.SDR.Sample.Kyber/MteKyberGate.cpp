@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteKyberGate.h"
+
+#include <stdexcept>
+
+static const KyberStrength StrengthOf[] = { K512, K768, K1024 };
+
+MteKyberGate& MteKyberGate::get()
+{
+	static MteKyberGate gate;
+	return gate;
+}
+
+//
+// Reads the sizes of every strength the library supports, leaving none in
+// force.
+//
+MteKyberGate::MteKyberGate() :
+	myCurrent(-1), myActive(0), myAdmit(0), myEntries(0), mySwitches(0)
+{
+	for (int i = 0; i < Strengths; i++)
+	{
+		myWaiting[i] = 0;
+		mySupported[i] = MteKyber::init(StrengthOf[i]) == MteKyber::Success;
+		Sizes& s = mySizes[i];
+		s.publicKey = mySupported[i] ? MteKyber::getPublicKeySize() : 0;
+		s.secret = mySupported[i] ? MteKyber::getSecretSize() : 0;
+		s.encrypted = mySupported[i] ? MteKyber::getEncryptedSize() : 0;
+		s.minEntropy = mySupported[i] ? MteKyber::getMinEntropySize() : 0;
+		s.maxEntropy = mySupported[i] ? MteKyber::getMaxEntropySize() : 0;
+		s.algorithm = mySupported[i] ? MteKyber::getAlgorithm() : "";
+	}
+}
+
+const MteKyberGate::Sizes& MteKyberGate::sizes(KyberStrength strength) const
+{
+	return mySizes[indexOf(strength)];
+}
+
+MteKyberGate::Pass MteKyberGate::enter(KyberStrength strength)
+{
+	int index = indexOf(strength);
+	std::unique_lock<std::mutex> lock(myMutex);
+	myWaiting[index]++;
+	for (;;)
+	{
+		if (myCurrent == index && (myAdmit > 0 || !othersWaiting(index)))
+		{
+			if (myAdmit > 0)
+				myAdmit--;
+			break;
+		}
+		if (myActive == 0 && myAdmit == 0 && next() == index)
+		{
+			if (myCurrent != index)
+			{
+				int result = MteKyber::init(strength);
+				if (result != MteKyber::Success)
+				{
+					myWaiting[index]--;
+					myChanged.notify_all();
+					throw std::runtime_error("Error initializing Kyber: " + std::to_string(result));
+				}
+				myCurrent = index;
+				mySwitches++;
+			}
+			myAdmit = myWaiting[index] - 1;
+			myChanged.notify_all();
+			break;
+		}
+		myChanged.wait(lock);
+	}
+	myWaiting[index]--;
+	myActive++;
+	myEntries++;
+	return Pass(this);
+}
+
+MteKyberGate::Stats MteKyberGate::stats() const
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	Stats s;
+	s.entries = myEntries;
+	s.switches = mySwitches;
+	return s;
+}
+
+int MteKyberGate::indexOf(KyberStrength strength) const
+{
+	for (int i = 0; i < Strengths; i++)
+	{
+		if (StrengthOf[i] == strength)
+		{
+			if (!mySupported[i])
+				break;
+			return i;
+		}
+	}
+	throw std::runtime_error("Unsupported Kyber strength: " + std::to_string(static_cast<int>(strength)));
+}
+
+// Called with the lock held.
+bool MteKyberGate::othersWaiting(int index) const
+{
+	for (int i = 0; i < Strengths; i++)
+	{
+		if (i != index && myWaiting[i] > 0)
+			return true;
+	}
+	return false;
+}
+
+//
+// Called with the lock held. Returns the strength to switch to: the first
+// one waited for after the one in force, in turn.
+//
+int MteKyberGate::next() const
+{
+	for (int n = 1; n <= Strengths; n++)
+	{
+		int i = (myCurrent + n + Strengths) % Strengths;
+		if (myWaiting[i] > 0)
+			return i;
+	}
+	return -1;
+}
+
+void MteKyberGate::leave()
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	if (--myActive == 0)
+		myChanged.notify_all();
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTEKYBERGATE_H
+#define MTEKYBERGATE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "MteKyber.h"
+
+//******************************************************************************
+// Class MteKyberGate
+//
+// Shares the process-wide Kyber strength between threads that need different
+// strengths. MteKyber::init() sets the strength and the sizes for the whole
+// process, so every Kyber call is made through a pass from enter(), which
+// admits any number of threads of the strength in force and switches the
+// strength only when none is inside. Calls of one strength run concurrently;
+// the strengths take turns when more than one is wanted. Once a thread waits
+// for another strength, new arrivals for the one in force wait too, so the
+// gate drains and no strength is starved; at each switch every thread then
+// waiting for the next strength is let in.
+//
+// The sizes of each strength are read once, when the gate is made, so they
+// can be asked for from any thread at any time.
+//
+// There is one gate per process, from get(). Once it is in use, nothing else
+// may call MteKyber::init(). Throws an exception for a strength the library
+// does not support.
+//******************************************************************************
+class MteKyberGate
+{
+public:
+	// The sizes in bytes of a strength.
+	struct Sizes
+	{
+		size_t publicKey;
+		size_t secret;
+		size_t encrypted;
+		size_t minEntropy;
+		size_t maxEntropy;
+		std::string algorithm;
+	};
+
+	struct Stats
+	{
+		uint64_t entries;
+		uint64_t switches;
+	};
+
+	//---------------------------------------------------------
+	// Leave to make Kyber calls of the strength it was entered
+	// with. The gate is left when the pass is destroyed.
+	//---------------------------------------------------------
+	class Pass
+	{
+	public:
+		Pass(Pass&& other) : myGate(other.myGate) { other.myGate = nullptr; }
+		~Pass() { if (myGate != nullptr) myGate->leave(); }
+
+	private:
+		friend class MteKyberGate;
+
+		explicit Pass(MteKyberGate* gate) : myGate(gate) {}
+
+		Pass(const Pass&);
+		Pass& operator=(const Pass&);
+		Pass& operator=(Pass&&);
+
+		MteKyberGate* myGate;
+	};
+
+	// Returns the process's gate.
+	static MteKyberGate& get();
+
+	// Returns the sizes of the strength. Thread safe.
+	const Sizes& sizes(KyberStrength strength) const;
+
+	// Waits until Kyber calls of the strength may be made.
+	Pass enter(KyberStrength strength);
+
+	Stats stats() const;
+
+private:
+	static const int Strengths = 3;
+
+	MteKyberGate();
+	MteKyberGate(const MteKyberGate&);
+	MteKyberGate& operator=(const MteKyberGate&);
+
+	int indexOf(KyberStrength strength) const;
+	bool othersWaiting(int index) const;
+	int next() const;
+	void leave();
+
+	Sizes mySizes[Strengths];
+	bool mySupported[Strengths];
+
+	mutable std::mutex myMutex;
+	std::condition_variable myChanged;
+	// The strength in force, or -1 before the first enter().
+	int myCurrent;
+	size_t myActive;
+	size_t myWaiting[Strengths];
+	// Threads still to be let in for the strength just switched to.
+	size_t myAdmit;
+
+	uint64_t myEntries;
+	uint64_t mySwitches;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteKyberInstance.h"
+
+MteKyberInstance::MteKyberInstance(KyberStrength strength) :
+	myStrength(strength), mySizes(MteKyberGate::get().sizes(strength))
+{
+	MteKyberGate::Pass pass = MteKyberGate::get().enter(myStrength);
+	myKyber.reset(new MteKyber());
+}
+
+//
+// The private key is wiped and freed with the sizes of the instance's
+// strength, so the MteKyber is destroyed through the gate too.
+//
+MteKyberInstance::~MteKyberInstance()
+{
+	try
+	{
+		MteKyberGate::Pass pass = MteKyberGate::get().enter(myStrength);
+		myKyber.reset();
+	}
+	catch (...)
+	{
+	}
+}
+
+int MteKyberInstance::setEntropy(void* entropy, size_t entropyBytes)
+{
+	MteKyberGate::Pass pass = MteKyberGate::get().enter(myStrength);
+	return myKyber->setEntropy(entropy, entropyBytes);
+}
+
+void MteKyberInstance::setEntropyCallback(MteKyber::EntropyCallback* cb)
+{
+	myKyber->setEntropyCallback(cb);
+}
+
+int MteKyberInstance::createKeyPair(void* publicKey, size_t& publicKeyBytes)
+{
+	MteKyberGate::Pass pass = MteKyberGate::get().enter(myStrength);
+	return myKyber->createKeyPair(publicKey, publicKeyBytes);
+}
+
+int MteKyberInstance::createSecret(const void* peerPublicKey, size_t peerPublicKeyBytes,
+	void* secret, size_t& secretBytes,
+	void* encrypted, size_t& encryptedBytes)
+{
+	MteKyberGate::Pass pass = MteKyberGate::get().enter(myStrength);
+	return myKyber->createSecret(peerPublicKey, peerPublicKeyBytes, secret, secretBytes, encrypted, encryptedBytes);
+}
+
+int MteKyberInstance::decryptSecret(const void* encrypted, size_t encryptedBytes,
+	void* secret, size_t& secretBytes)
+{
+	MteKyberGate::Pass pass = MteKyberGate::get().enter(myStrength);
+	return myKyber->decryptSecret(encrypted, encryptedBytes, secret, secretBytes);
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTEKYBERINSTANCE_H
+#define MTEKYBERINSTANCE_H
+
+#include <cstddef>
+#include <memory>
+
+#include "MteKyber.h"
+#include "MteKyberGate.h"
+
+//******************************************************************************
+// Class MteKyberInstance
+//
+// An MteKyber with a strength of its own, so one process can serve K512,
+// K768 and K1024 peers at once. Every call that depends on the strength,
+// including making and destroying the MteKyber, goes through the
+// MteKyberGate, so instances of different strengths can be used from any
+// threads without calling MteKyber::init(). The size queries are of the
+// instance's strength and are thread safe.
+//
+// The calls return the MteKyber result codes. An instance is used from one
+// thread at a time.
+//******************************************************************************
+class MteKyberInstance
+{
+public:
+	explicit MteKyberInstance(KyberStrength strength);
+	~MteKyberInstance();
+
+	KyberStrength getStrength() const { return myStrength; }
+
+	size_t getPublicKeySize() const { return mySizes.publicKey; }
+	size_t getSecretSize() const { return mySizes.secret; }
+	size_t getEncryptedSize() const { return mySizes.encrypted; }
+	size_t getMinEntropySize() const { return mySizes.minEntropy; }
+	size_t getMaxEntropySize() const { return mySizes.maxEntropy; }
+	const char* getAlgorithm() const { return mySizes.algorithm.c_str(); }
+
+	// As for MteKyber.
+	int setEntropy(void* entropy, size_t entropyBytes);
+	void setEntropyCallback(MteKyber::EntropyCallback* cb);
+	int createKeyPair(void* publicKey, size_t& publicKeyBytes);
+	int createSecret(const void* peerPublicKey, size_t peerPublicKeyBytes,
+		void* secret, size_t& secretBytes,
+		void* encrypted, size_t& encryptedBytes);
+	int decryptSecret(const void* encrypted, size_t encryptedBytes,
+		void* secret, size_t& secretBytes);
+
+private:
+	MteKyberInstance(const MteKyberInstance&);
+	MteKyberInstance& operator=(const MteKyberInstance&);
+
+	KyberStrength myStrength;
+	const MteKyberGate::Sizes& mySizes;
+	std::unique_ptr<MteKyber> myKyber;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteKyberPool.h"
+#include "MteBase.h"
+#include "MteRandom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+// The window the take rate is measured over.
+static const double RateWindow = 0.25;
+
+// How much of the rate is kept each window when the takes slow down.
+static const double RateDecay = 0.9;
+
+// How long a waiting generator sleeps before it measures the rate again.
+static const std::chrono::milliseconds IdleCheck(100);
+
+MteKyberPool::MteKyberPool(const Options& options) :
+	myOptions(options), myGenerating(0), myTarget(0), myStop(false), myRate(0.0),
+	myWindowStart(Clock::now()), myWindowTakes(0), myGenerated(0), myTaken(0), myMisses(0)
+{
+	// Throws for a strength the library does not support.
+	MteKyberGate::get().sizes(myOptions.strength);
+	myOptions.maxDepth = std::max(myOptions.maxDepth, myOptions.minDepth);
+	myTarget = myOptions.minDepth;
+	for (size_t i = 0; i < std::max<size_t>(1, myOptions.threads); i++)
+		myThreads.push_back(std::thread(&MteKyberPool::generator, this));
+}
+
+MteKyberPool::~MteKyberPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		myStop = true;
+	}
+	myWanted.notify_all();
+	myFilled.notify_all();
+	for (std::thread& t : myThreads)
+		t.join();
+}
+
+MteKyberPool::KeyPair MteKyberPool::take()
+{
+	{
+		std::unique_lock<std::mutex> lock(myMutex);
+		myTaken++;
+		myWindowTakes++;
+		updateRate(Clock::now());
+		if (!myReady.empty())
+		{
+			KeyPair pair = std::move(myReady.front());
+			myReady.pop_front();
+			lock.unlock();
+			myWanted.notify_one();
+			return pair;
+		}
+		myMisses++;
+	}
+	myWanted.notify_all();
+	return generate(myOptions.strength);
+}
+
+void MteKyberPool::fill()
+{
+	std::unique_lock<std::mutex> lock(myMutex);
+	myFilled.wait(lock, [this] { return myStop || myError || myReady.size() >= myTarget; });
+	if (myError)
+		std::rethrow_exception(myError);
+}
+
+MteKyberPool::Stats MteKyberPool::stats() const
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	Stats s;
+	s.generated = myGenerated;
+	s.taken = myTaken;
+	s.misses = myMisses;
+	s.depth = myReady.size();
+	s.target = myTarget;
+	s.takeRate = myRate;
+	return s;
+}
+
+MteKyberPool::KeyPair MteKyberPool::generate(KyberStrength strength)
+{
+	KeyPair pair;
+	pair.kyber.reset(new MteKyberInstance(strength));
+	std::vector<uint8_t> entropy(pair.kyber->getMinEntropySize());
+	if (MteRandom::getBytes(entropy.data(), entropy.size()) != 0)
+		throw std::runtime_error("Unable to get random bytes for the Kyber entropy");
+	int result = pair.kyber->setEntropy(entropy.data(), entropy.size());
+	pair.publicKey.resize(pair.kyber->getPublicKeySize());
+	size_t publicKeyBytes = pair.publicKey.size();
+	if (result == MteKyber::Success)
+		result = pair.kyber->createKeyPair(pair.publicKey.data(), publicKeyBytes);
+	MteKyber::zeroize(entropy.data(), entropy.size());
+	if (result != MteKyber::Success)
+		throw std::runtime_error("Error creating a Kyber key pair: " + std::to_string(result));
+	pair.publicKey.resize(publicKeyBytes);
+	return pair;
+}
+
+//
+// Generates pairs while the pool is below its target. A waiting generator
+// wakes on a take or every IdleCheck to measure the rate again, so the
+// target falls when the takes stop.
+//
+void MteKyberPool::generator()
+{
+	std::unique_lock<std::mutex> lock(myMutex);
+	while (!myStop)
+	{
+		updateRate(Clock::now());
+		if (myReady.size() + myGenerating >= myTarget)
+		{
+			myWanted.wait_for(lock, IdleCheck);
+			continue;
+		}
+		myGenerating++;
+		lock.unlock();
+		KeyPair pair;
+		try
+		{
+			pair = generate(myOptions.strength);
+		}
+		catch (...)
+		{
+			lock.lock();
+			myGenerating--;
+			if (!myError)
+				myError = std::current_exception();
+			myFilled.notify_all();
+			return;
+		}
+		lock.lock();
+		myGenerating--;
+		myGenerated++;
+		myReady.push_back(std::move(pair));
+		if (myReady.size() >= myTarget)
+			myFilled.notify_all();
+	}
+}
+
+//
+// Called with the lock held. At the end of each window the rate becomes the
+// window's rate if that is higher, else it decays by RateDecay towards it,
+// and the target is the rate times refillSeconds.
+//
+void MteKyberPool::updateRate(Clock::time_point now)
+{
+	double elapsed = std::chrono::duration<double>(now - myWindowStart).count();
+	if (elapsed < RateWindow)
+		return;
+	double rate = static_cast<double>(myWindowTakes) / elapsed;
+	myRate = std::max(rate, myRate * RateDecay);
+	myWindowStart = now;
+	myWindowTakes = 0;
+	double target = std::ceil(myRate * myOptions.refillSeconds);
+	myTarget = std::max(myOptions.minDepth, std::min(myOptions.maxDepth, static_cast<size_t>(target)));
+}
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTEKYBERPOOL_H
+#define MTEKYBERPOOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MteKyberInstance.h"
+
+//******************************************************************************
+// Class MteKyberPool
+//
+// Key pairs generated ahead of the handshakes that need them. Generating a
+// Kyber key pair is the costly part of starting an exchange, so background
+// threads keep a queue of ready pairs and take() hands one out in constant
+// time, generating one on the calling thread only when the queue is empty.
+//
+// The depth kept ready adapts to demand: the pool measures how fast pairs
+// are taken and aims to hold refillSeconds of them, between minDepth and
+// maxDepth. The rate rises at once with a burst and falls back slowly, so
+// the pool is deep again for the next burst.
+//
+// The pairs are of the strength in the options; pools of different strengths
+// can be used at once. Each pair is used for one exchange. Thread safe.
+// Throws an exception on Kyber error.
+//******************************************************************************
+class MteKyberPool
+{
+public:
+	struct Options
+	{
+		KyberStrength strength = K512;
+		size_t minDepth = 16;
+		size_t maxDepth = 4096;
+		// The seconds of demand to keep ready.
+		double refillSeconds = 1.0;
+		// The generator threads.
+		size_t threads = 1;
+	};
+
+	// A key pair: the Kyber instance holding the private key, and the public
+	// key to send to the peer.
+	struct KeyPair
+	{
+		std::unique_ptr<MteKyberInstance> kyber;
+		std::vector<uint8_t> publicKey;
+	};
+
+	struct Stats
+	{
+		uint64_t generated;
+		uint64_t taken;
+		// Takes that found the pool empty and generated on the calling thread.
+		uint64_t misses;
+		size_t depth;
+		size_t target;
+		// The measured take rate per second.
+		double takeRate;
+	};
+
+	explicit MteKyberPool(const Options& options);
+	~MteKyberPool();
+
+	// Takes a ready key pair, or generates one if none is ready.
+	KeyPair take();
+
+	// Waits until the pool holds its target depth. Throws the error that
+	// stopped a generator thread, if any.
+	void fill();
+
+	Stats stats() const;
+
+	// Generates a key pair of the strength with entropy from the OS random
+	// source.
+	static KeyPair generate(KyberStrength strength);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	MteKyberPool(const MteKyberPool&);
+	MteKyberPool& operator=(const MteKyberPool&);
+
+	void generator();
+	void updateRate(Clock::time_point now);
+
+	Options myOptions;
+
+	mutable std::mutex myMutex;
+	std::condition_variable myWanted;
+	std::condition_variable myFilled;
+	std::deque<KeyPair> myReady;
+	size_t myGenerating;
+	size_t myTarget;
+	bool myStop;
+	// The first error of a generator thread, which then stops.
+	std::exception_ptr myError;
+
+	// The take rate, measured over windows of RateWindow.
+	double myRate;
+	Clock::time_point myWindowStart;
+	uint64_t myWindowTakes;
+
+	uint64_t myGenerated;
+	uint64_t myTaken;
+	uint64_t myMisses;
+
+	std::vector<std::thread> myThreads;
+};
+
+#endif
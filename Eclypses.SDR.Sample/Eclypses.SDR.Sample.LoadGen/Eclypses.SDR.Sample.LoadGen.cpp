@@ -0,0 +1,403 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "LoadGen.h"
+#include "Replay.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+std::string getItemFromSettings(std::string key) {
+	std::ifstream file("./settings.txt");
+	std::string s;
+	while (std::getline(file, s)) {
+		std::size_t found = s.find(key);
+		if (found != std::string::npos) {
+			std::size_t eq = s.find('=');
+			if (eq != std::string::npos) {
+				return s.substr(eq + 1);
+			}
+		}
+	}
+	return "";
+}
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.LoadGen [--backend memory|file|disconnected] [--rate ops/s | --rates r1,r2,...]" << std::endl;
+	std::cout << "                              [--threads N] [--seconds S] [--warmup S] [--keys N] [--zipf s]" << std::endl;
+	std::cout << "                              [--size spec] [--max-size bytes] [--mix spec] [--seed N]" << std::endl;
+	std::cout << "                              [--dir <dir>] [--json <file>] [--capture <file>]" << std::endl;
+	std::cout << "      Runs SDR operations open loop at each target rate and reports the latency from the" << std::endl;
+	std::cout << "      scheduled start of each operation (corrected for coordinated omission)." << std::endl;
+	std::cout << "      --size is a byte count (default 1024), lognormal:<median>:<sigma> or file:<path>" << std::endl;
+	std::cout << "             (lines of \"size [weight]\")." << std::endl;
+	std::cout << "      --mix defaults to read=80,write=15,remove=5." << std::endl;
+	std::cout << "      --capture records the generated operations, as MteSdr::startCapture() does." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.LoadGen --replay <capture> [--backend recorded|memory|file] [--threads N]" << std::endl;
+	std::cout << "                              [--speed x] [--dir <dir>] [--json <file>]" << std::endl;
+	std::cout << "      Replays a capture with values of the captured sizes, at its captured times scaled by" << std::endl;
+	std::cout << "      --speed (default 1; 0 runs the operations back to back)." << std::endl;
+}
+
+//
+// Parses a size such as 4096, 64K, 16M or 1G.
+//
+static size_t parseSize(const std::string& text)
+{
+	char* end = nullptr;
+	size_t value = std::strtoull(text.c_str(), &end, 10);
+	switch (end != nullptr ? *end : '\0')
+	{
+	case 'k': case 'K': return value << 10;
+	case 'm': case 'M': return value << 20;
+	case 'g': case 'G': return value << 30;
+	default: return value;
+	}
+}
+
+static std::vector<double> parseRates(const std::string& list)
+{
+	std::vector<double> values;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		if (comma > start)
+			values.push_back(std::atof(list.substr(start, comma - start).c_str()));
+		start = comma + 1;
+	}
+	return values;
+}
+
+static double micros(uint64_t ns)
+{
+	return static_cast<double>(ns) / 1000.0;
+}
+
+static void writeJson(std::ostream& out, const LoadGenerator::Options& options, const SizeDistribution& sizes,
+	const OperationMix& mix, const std::vector<LoadGenerator::Result>& results)
+{
+	out << "{" << std::endl;
+	out << "  \"backend\": \"" << LoadGenerator::backendName(options.backend) << "\"," << std::endl;
+	out << "  \"threads\": " << options.threads << "," << std::endl;
+	out << "  \"keys\": " << options.keys << "," << std::endl;
+	out << "  \"zipf\": " << options.zipfExponent << "," << std::endl;
+	out << "  \"size\": \"" << sizes.spec() << "\"," << std::endl;
+	out << "  \"mix\": \"" << mix.spec() << "\"," << std::endl;
+	out << "  \"runs\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const LoadGenerator::Result& r = results[i];
+		out << "    {" << std::endl;
+		out << "      \"target_rate\": " << r.targetRate << "," << std::endl;
+		out << "      \"achieved_rate\": " << r.achievedRate << "," << std::endl;
+		out << "      \"seconds\": " << r.seconds << "," << std::endl;
+		out << "      \"operations\": " << r.operations << "," << std::endl;
+		for (int op = 0; op < OperationMix::OperationCount; op++)
+			out << "      \"" << OperationMix::name(static_cast<OperationMix::Operation>(op)) << "s\": " << r.counts[op] << "," << std::endl;
+		out << "      \"misses\": " << r.misses << "," << std::endl;
+		out << "      \"errors\": " << r.errors << "," << std::endl;
+		out << "      \"bytes\": " << r.bytes << "," << std::endl;
+		static const double percentiles[] = { 50, 90, 99, 99.9 };
+		const MteHistogram* histograms[] = { &r.latency, &r.service };
+		const char* names[] = { "latency_ns", "service_ns" };
+		for (int h = 0; h < 2; h++)
+		{
+			out << "      \"" << names[h] << "\": { \"mean\": " << histograms[h]->mean();
+			for (double p : percentiles)
+				out << ", \"p" << p << "\": " << histograms[h]->percentile(p);
+			out << ", \"max\": " << histograms[h]->max() << " }" << (h == 0 ? "," : "") << std::endl;
+		}
+		out << "    }" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
+static void writeReplayJson(std::ostream& out, const CaptureReplay::Options& options, const CaptureReplay::Result& r)
+{
+	out << "{" << std::endl;
+	out << "  \"backend\": \"" << CaptureReplay::storageName(options.storage) << "\"," << std::endl;
+	out << "  \"threads\": " << options.threads << "," << std::endl;
+	out << "  \"speed\": " << options.speed << "," << std::endl;
+	out << "  \"captured_seconds\": " << r.capturedSeconds << "," << std::endl;
+	out << "  \"seconds\": " << r.seconds << "," << std::endl;
+	out << "  \"operations\": " << r.operations << "," << std::endl;
+	out << "  \"errors\": " << r.errors << "," << std::endl;
+	out << "  \"bytes\": " << r.bytes << "," << std::endl;
+	out << "  \"latency_ns\": {" << std::endl;
+	bool first = true;
+	for (int op = 0; op < MteSdrCapture::OperationCount; op++)
+	{
+		if (r.counts[op] == 0)
+			continue;
+		const MteHistogram& h = r.latency[op];
+		out << (first ? "" : ",\n") << "    \"" << MteSdrCapture::operationName(static_cast<MteSdrCapture::Operation>(op))
+			<< "\": { \"count\": " << r.counts[op] << ", \"mean\": " << h.mean() << ", \"p50\": " << h.percentile(50)
+			<< ", \"p99\": " << h.percentile(99) << ", \"p99.9\": " << h.percentile(99.9) << ", \"max\": " << h.max()
+			<< ", \"service_p50\": " << r.service[op].percentile(50) << ", \"service_p99\": " << r.service[op].percentile(99) << " }";
+		first = false;
+	}
+	out << std::endl << "  }" << std::endl;
+	out << "}" << std::endl;
+}
+
+//
+// Replays a capture and prints the latency of each operation.
+//
+static int replay(const std::string& path, const CaptureReplay::Options& options, const std::string& jsonPath)
+{
+	try
+	{
+		CaptureReplay replay(path, options);
+		std::cout << "Replaying " << replay.records().size() << " operations from " << path << " on "
+			<< options.threads << " thread(s), backend " << CaptureReplay::storageName(options.storage)
+			<< ", speed " << options.speed << std::endl;
+		CaptureReplay::Result r = replay.run();
+		std::cout << "Captured over " << r.capturedSeconds << " seconds, replayed in " << r.seconds << " seconds ("
+			<< (r.seconds > 0 ? static_cast<double>(r.operations) / r.seconds : 0) << " ops/s)";
+		if (r.errors != 0)
+			std::cout << ", " << r.errors << " errors";
+		std::cout << std::endl;
+		std::cout << std::left << std::setw(10) << "operation" << std::right << std::setw(10) << "count"
+			<< std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(11) << "max"
+			<< std::setw(12) << "svc p50" << std::setw(10) << "svc p99" << std::endl;
+		for (int op = 0; op < MteSdrCapture::OperationCount; op++)
+		{
+			if (r.counts[op] == 0)
+				continue;
+			const MteHistogram& h = r.latency[op];
+			std::cout << std::left << std::setw(10) << MteSdrCapture::operationName(static_cast<MteSdrCapture::Operation>(op))
+				<< std::right << std::setw(10) << r.counts[op] << std::fixed << std::setprecision(1)
+				<< std::setw(10) << micros(h.percentile(50)) << std::setw(10) << micros(h.percentile(99))
+				<< std::setw(10) << micros(h.percentile(99.9)) << std::setw(11) << micros(h.max())
+				<< std::setw(12) << micros(r.service[op].percentile(50))
+				<< std::setw(10) << micros(r.service[op].percentile(99)) << std::endl;
+		}
+		if (!jsonPath.empty())
+		{
+			std::ofstream out(jsonPath);
+			if (!out)
+				throw std::runtime_error("Unable to open " + jsonPath);
+			writeReplayJson(out, options, r);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MteSdr Load Generator" << std::endl;
+
+	LoadGenerator::Options options;
+	std::string backend;
+	std::string replayPath;
+	std::string capturePath;
+	double speed = 1;
+	std::vector<double> rates;
+	std::string sizeSpec = "1024";
+	std::string mixSpec = "read=80,write=15,remove=5";
+	std::string jsonPath;
+	size_t maxSize = 1 << 20;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--backend" && hasValue)
+			backend = argv[++i];
+		else if (arg == "--replay" && hasValue)
+			replayPath = argv[++i];
+		else if (arg == "--speed" && hasValue)
+			speed = std::atof(argv[++i]);
+		else if (arg == "--capture" && hasValue)
+			capturePath = argv[++i];
+		else if (arg == "--rate" && hasValue)
+			rates = parseRates(argv[++i]);
+		else if (arg == "--rates" && hasValue)
+			rates = parseRates(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+			options.threads = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--seconds" && hasValue)
+			options.seconds = std::atof(argv[++i]);
+		else if (arg == "--warmup" && hasValue)
+			options.warmupSeconds = std::atof(argv[++i]);
+		else if (arg == "--keys" && hasValue)
+			options.keys = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--zipf" && hasValue)
+			options.zipfExponent = std::atof(argv[++i]);
+		else if (arg == "--size" && hasValue)
+			sizeSpec = argv[++i];
+		else if (arg == "--max-size" && hasValue)
+			maxSize = parseSize(argv[++i]);
+		else if (arg == "--mix" && hasValue)
+			mixSpec = argv[++i];
+		else if (arg == "--seed" && hasValue)
+			options.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--dir" && hasValue)
+			options.directory = argv[++i];
+		else if (arg == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (rates.empty())
+		rates.push_back(1000);
+	if (options.keys == 0 || options.seconds <= 0)
+	{
+		usage();
+		return 1;
+	}
+	CaptureReplay::Options replayOptions;
+	replayOptions.directory = options.directory;
+	replayOptions.threads = options.threads;
+	replayOptions.speed = speed;
+	if (!replayPath.empty())
+	{
+		if (backend.empty() || backend == "recorded")
+			replayOptions.storage = CaptureReplay::Recorded;
+		else if (backend == "memory")
+			replayOptions.storage = CaptureReplay::Memory;
+		else if (backend == "file")
+			replayOptions.storage = CaptureReplay::File;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	else if (backend.empty() || backend == "memory")
+		options.backend = LoadGenerator::Memory;
+	else if (backend == "file")
+		options.backend = LoadGenerator::File;
+	else if (backend == "disconnected")
+		options.backend = LoadGenerator::Disconnected;
+	else
+	{
+		usage();
+		return 1;
+	}
+
+	//
+	// Initialize MTE license.
+	//
+	std::string company = getItemFromSettings("LicensedCompany");
+	std::string license = getItemFromSettings("LicenseKey");
+	if (!MteBase::initLicense(company.c_str(), license.c_str()))
+	{
+		std::cerr << "License init error ("
+			<< MteBase::getStatusName(mte_status_license_error)
+			<< "): "
+			<< MteBase::getStatusDescription(mte_status_license_error)
+			<< std::endl;
+		return mte_status_license_error;
+	}
+	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	if (!replayPath.empty())
+		return replay(replayPath, replayOptions, jsonPath);
+
+	std::vector<LoadGenerator::Result> results;
+	try
+	{
+		SizeDistribution sizes(sizeSpec, maxSize);
+		OperationMix mix(mixSpec);
+		std::cout << "Backend " << LoadGenerator::backendName(options.backend) << ", " << options.threads
+			<< " thread(s), " << options.keys << " keys (zipf " << options.zipfExponent << "), size "
+			<< sizes.spec() << ", mix " << mix.spec() << std::endl;
+		LoadGenerator generator(options, sizes, mix);
+		if (!capturePath.empty())
+			MteSdr::startCapture(capturePath);
+
+		//
+		// Latencies are in microseconds. A run that does not reach 95% of
+		// its target rate is saturated: the SDR cannot keep up, and the
+		// latency is mostly time spent waiting behind earlier operations.
+		//
+		std::cout << std::right << std::setw(12) << "target/s" << std::setw(12) << "achieved/s"
+			<< std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+			<< std::setw(10) << "p99.9" << std::setw(11) << "max"
+			<< std::setw(12) << "svc p50" << std::setw(10) << "svc p99" << std::endl;
+		for (double rate : rates)
+		{
+			LoadGenerator::Result r = generator.run(rate);
+			results.push_back(r);
+			std::cout << std::fixed << std::setprecision(0)
+				<< std::setw(12) << r.targetRate << std::setw(12) << r.achievedRate
+				<< std::setprecision(1)
+				<< std::setw(10) << micros(r.latency.percentile(50))
+				<< std::setw(10) << micros(r.latency.percentile(90))
+				<< std::setw(10) << micros(r.latency.percentile(99))
+				<< std::setw(10) << micros(r.latency.percentile(99.9))
+				<< std::setw(11) << micros(r.latency.max())
+				<< std::setw(12) << micros(r.service.percentile(50))
+				<< std::setw(10) << micros(r.service.percentile(99));
+			if (r.achievedRate < 0.95 * r.targetRate)
+				std::cout << "  saturated";
+			if (r.errors != 0)
+				std::cout << "  " << r.errors << " errors";
+			std::cout << std::endl;
+		}
+		MteSdr::stopCapture();
+		if (!jsonPath.empty())
+		{
+			std::ofstream out(jsonPath);
+			if (!out)
+				throw std::runtime_error("Unable to open " + jsonPath);
+			writeJson(out, options, sizes, mix, results);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,266 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "LoadGen.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//******************************************************************************
+// Class LoadWorker
+//
+// The SDR and the records of one thread of a load generator.
+//******************************************************************************
+class LoadWorker
+{
+public:
+	LoadWorker(const LoadGenerator::Options& options, size_t index, const uint8_t* payload) :
+		myBackend(options.backend), myPayload(payload), myPresent(options.keys, false)
+	{
+		if (myBackend == LoadGenerator::Disconnected)
+		{
+			myDisconnected.reset(new MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes));
+			myDisconnected->initSdr(options.security);
+			myConcealed.resize(options.keys);
+		}
+		else
+		{
+			mySdr.reset(new MteSdr((mte_sdr_random)MteRandom::getBytes));
+			mySdr->initSdr(MteSdr::mkFilePath(options.directory, "loadgen-" + std::to_string(index)),
+				options.security);
+		}
+		myNames.reserve(options.keys);
+		for (size_t key = 0; key < options.keys; key++)
+			myNames.push_back("key-" + std::to_string(key));
+	}
+
+	~LoadWorker()
+	{
+		if (mySdr)
+		{
+			try
+			{
+				mySdr->removeSdr();
+			}
+			catch (const std::exception&)
+			{
+			}
+		}
+	}
+
+	//------------------------------------------------------------
+	// Runs one operation on a key. Returns false, without running
+	// it, if the key is needed but not present.
+	//------------------------------------------------------------
+	bool execute(OperationMix::Operation operation, size_t key, size_t bytes)
+	{
+		if (operation != OperationMix::Write && !myPresent[key])
+			return false;
+		switch (operation)
+		{
+		case OperationMix::Read:
+			if (myDisconnected)
+			{
+				size_t clearBytes;
+				myDisconnected->Reveal(myConcealed[key].data(), myConcealed[key].size(), clearBytes);
+			}
+			else
+			{
+				size_t clearBytes;
+				mySdr->readData(myNames[key], clearBytes);
+			}
+			break;
+		case OperationMix::Write:
+			if (myDisconnected)
+			{
+				size_t concealedBytes;
+				uint8_t* concealed = myDisconnected->Conceal(myPayload, bytes, concealedBytes);
+				myConcealed[key].assign(concealed, concealed + concealedBytes);
+				delete[] concealed;
+			}
+			else
+			{
+				mySdr->write(myNames[key], myPayload, bytes, myBackend == LoadGenerator::Memory);
+			}
+			myPresent[key] = true;
+			break;
+		default:
+			if (myDisconnected)
+				std::vector<uint8_t>().swap(myConcealed[key]);
+			else
+				mySdr->remove(myNames[key]);
+			myPresent[key] = false;
+			break;
+		}
+		return true;
+	}
+
+private:
+	LoadGenerator::Backend myBackend;
+	const uint8_t* myPayload;
+	std::unique_ptr<MteSdr> mySdr;
+	std::unique_ptr<MteSdrDisconnected> myDisconnected;
+	std::vector<std::vector<uint8_t> > myConcealed;
+	std::vector<bool> myPresent;
+	std::vector<std::string> myNames;
+};
+
+LoadGenerator::LoadGenerator(const Options& options, const SizeDistribution& sizes, const OperationMix& mix) :
+	myOptions(options), mySizes(sizes), myMix(mix), myKeys(options.keys, options.zipfExponent), myRuns(0)
+{
+	if (myOptions.threads == 0)
+		myOptions.threads = 1;
+	myPayload.resize(std::max<size_t>(1, sizes.maxBytes()));
+	MteRandom::getBytes(myPayload.data(), myPayload.size());
+
+	LoadRandom random(myOptions.seed);
+	for (size_t t = 0; t < myOptions.threads; t++)
+	{
+		myWorkers.emplace_back(new LoadWorker(myOptions, t, myPayload.data()));
+		for (size_t key = 0; key < myOptions.keys; key++)
+			myWorkers.back()->execute(OperationMix::Write, key, mySizes.next(random));
+	}
+}
+
+LoadGenerator::~LoadGenerator()
+{
+}
+
+LoadGenerator::Result LoadGenerator::run(double rate)
+{
+	if (rate <= 0)
+		throw std::runtime_error("The target rate must be positive.");
+	const size_t threads = myWorkers.size();
+	std::vector<Result> results(threads);
+
+	//
+	// Thread t starts operations t, t + threads, t + 2 * threads... of a
+	// schedule with one operation every 1 / rate seconds.
+	//
+	const std::chrono::nanoseconds interval(static_cast<int64_t>(1e9 * static_cast<double>(threads) / rate));
+	const std::chrono::nanoseconds warmup(static_cast<int64_t>(1e9 * myOptions.warmupSeconds));
+	const std::chrono::nanoseconds measured(static_cast<int64_t>(1e9 * myOptions.seconds));
+	const Clock::time_point start = Clock::now() + std::chrono::milliseconds(10);
+	const Clock::time_point measureFrom = start + warmup;
+	const Clock::time_point end = measureFrom + measured;
+	uint64_t run = ++myRuns;
+
+	auto work = [&](size_t t)
+	{
+		Result& result = results[t];
+		result = Result();
+		LoadRandom random(myOptions.seed + run * 1000003 + t);
+		LoadWorker& worker = *myWorkers[t];
+		Clock::time_point scheduled = start + std::chrono::nanoseconds(
+			static_cast<int64_t>(1e9 * static_cast<double>(t) / rate));
+		for (; scheduled < end; scheduled += interval)
+		{
+			OperationMix::Operation operation = myMix.next(random);
+			size_t key = myKeys.next(random);
+			size_t bytes = operation == OperationMix::Write ? mySizes.next(random) : 0;
+
+			//
+			// Sleep until close to the scheduled time and spin the rest.
+			// When behind schedule, start at once.
+			//
+			Clock::time_point now = Clock::now();
+			if (scheduled - now > std::chrono::microseconds(200))
+				std::this_thread::sleep_until(scheduled - std::chrono::microseconds(100));
+			while ((now = Clock::now()) < scheduled)
+			{
+			}
+
+			bool done;
+			bool failed = false;
+			try
+			{
+				done = worker.execute(operation, key, bytes);
+			}
+			catch (const std::exception&)
+			{
+				done = true;
+				failed = true;
+			}
+			Clock::time_point finished = Clock::now();
+			if (scheduled < measureFrom)
+				continue;
+			if (!done)
+			{
+				result.misses++;
+				continue;
+			}
+			if (failed)
+				result.errors++;
+			result.operations++;
+			result.counts[operation]++;
+			result.bytes += bytes;
+			result.latency.record(static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(finished - scheduled).count()));
+			result.service.record(static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(finished - now).count()));
+		}
+	};
+	std::vector<std::thread> helpers;
+	for (size_t t = 1; t < threads; t++)
+		helpers.emplace_back(work, t);
+	work(0);
+	for (auto& h : helpers)
+		h.join();
+
+	//
+	// The run lasts until the last operation finishes, which is later than
+	// the end of the schedule if the SDR could not keep up.
+	//
+	double seconds = std::chrono::duration<double>(Clock::now() - measureFrom).count();
+	Result total = Result();
+	total.targetRate = rate;
+	total.seconds = seconds;
+	for (const Result& r : results)
+	{
+		total.operations += r.operations;
+		for (int i = 0; i < OperationMix::OperationCount; i++)
+			total.counts[i] += r.counts[i];
+		total.misses += r.misses;
+		total.errors += r.errors;
+		total.bytes += r.bytes;
+		total.latency.merge(r.latency);
+		total.service.merge(r.service);
+	}
+	total.achievedRate = seconds > 0 ? static_cast<double>(total.operations + total.misses) / seconds : 0;
+	return total;
+}
+
+const char* LoadGenerator::backendName(Backend backend)
+{
+	static const char* names[] = { "memory", "file", "disconnected" };
+	return names[backend];
+}
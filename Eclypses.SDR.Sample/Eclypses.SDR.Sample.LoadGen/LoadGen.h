@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MteHistogram.h"
+#include "LoadModel.h"
+
+class LoadWorker;
+
+//******************************************************************************
+// Class LoadGenerator
+//
+// Drives SDR operations open loop: operations are started on a fixed schedule
+// at the target rate whether or not earlier ones have finished, as the
+// requests of independent users would be. Each thread has its own SDR and
+// its own share of the schedule.
+//
+// The latency of an operation is measured from the time it was scheduled to
+// start, not from the time it actually started, so time an operation spends
+// waiting behind a slow one is counted (the correction for coordinated
+// omission). The service time, from the actual start, is reported as well;
+// the two diverge once the target rate is more than the SDR can sustain.
+//
+// Each thread keeps --keys keys, drawn with a Zipf distribution, and all are
+// written before the first run. A read or remove of a key that is not there
+// (after a remove) is counted as a miss and not timed.
+//******************************************************************************
+class LoadGenerator
+{
+public:
+	enum Backend
+	{
+		// MteSdr with the records in memory.
+		Memory,
+		// MteSdr with the records in files.
+		File,
+		// MteSdrDisconnected Conceal / Reveal; the caller keeps the records.
+		Disconnected
+	};
+
+	struct Options
+	{
+		Backend backend = Memory;
+		// Each thread's SDR is the folder loadgen-<thread> in this one.
+		std::string directory = ".";
+		std::string security = "SecurityString";
+		size_t threads = 1;
+		double seconds = 5;
+		// Operations in the first warmupSeconds of a run are not counted.
+		double warmupSeconds = 1;
+		size_t keys = 1000;
+		double zipfExponent = 0.99;
+		uint64_t seed = 1;
+	};
+
+	struct Result
+	{
+		double targetRate;
+		double achievedRate;
+		double seconds;
+		uint64_t operations;
+		uint64_t counts[OperationMix::OperationCount];
+		uint64_t misses;
+		uint64_t errors;
+		uint64_t bytes;
+		// Nanoseconds from the scheduled start to the end.
+		MteHistogram latency;
+		// Nanoseconds from the actual start to the end.
+		MteHistogram service;
+	};
+
+	// Creates the SDRs and writes every key. Throws on failure.
+	LoadGenerator(const Options& options, const SizeDistribution& sizes, const OperationMix& mix);
+	~LoadGenerator();
+
+	//----------------------------------------------------------------
+	// Runs at the target rate, in operations per second across all
+	// threads, for the configured time.
+	//----------------------------------------------------------------
+	Result run(double rate);
+
+	static const char* backendName(Backend backend);
+
+private:
+	Options myOptions;
+	const SizeDistribution& mySizes;
+	const OperationMix& myMix;
+	ZipfKeys myKeys;
+	// Every payload is a prefix of this.
+	std::vector<uint8_t> myPayload;
+	std::vector<std::unique_ptr<LoadWorker> > myWorkers;
+	uint64_t myRuns;
+};
+
+#endif // !LOADGEN_H
@@ -0,0 +1,185 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "LoadModel.h"
+
+SizeDistribution::SizeDistribution(const std::string& spec, size_t maxBytes) :
+	mySpec(spec), myKind(Fixed), myMaxBytes(maxBytes), myFixed(0), myMu(0), mySigma(0)
+{
+	if (spec.compare(0, 10, "lognormal:") == 0)
+	{
+		//
+		// The median of a log-normal distribution is exp(mu).
+		//
+		char* end = nullptr;
+		double median = std::strtod(spec.c_str() + 10, &end);
+		if (end == nullptr || *end != ':' || median <= 0)
+			throw std::runtime_error("Expected lognormal:<median>:<sigma> but found " + spec);
+		mySigma = std::strtod(end + 1, nullptr);
+		myMu = std::log(median);
+		myKind = LogNormal;
+	}
+	else if (spec.compare(0, 5, "file:") == 0)
+	{
+		std::string path = spec.substr(5);
+		std::ifstream in(path.c_str());
+		if (!in.is_open())
+			throw std::runtime_error("Unable to open " + path);
+		std::string line;
+		double total = 0;
+		size_t largest = 0;
+		while (std::getline(in, line))
+		{
+			std::istringstream fields(line);
+			double size;
+			double weight = 1;
+			if (!(fields >> size))
+				continue;
+			fields >> weight;
+			if (size < 0 || weight <= 0)
+				continue;
+			total += weight;
+			mySizes.push_back(static_cast<size_t>(size));
+			myCumulative.push_back(total);
+			largest = std::max(largest, mySizes.back());
+		}
+		if (mySizes.empty())
+			throw std::runtime_error("No sizes were found in " + path);
+		myMaxBytes = std::min(myMaxBytes, largest);
+		myKind = Empirical;
+	}
+	else
+	{
+		char* end = nullptr;
+		myFixed = std::strtoull(spec.c_str(), &end, 10);
+		if (end == spec.c_str() || *end != '\0')
+			throw std::runtime_error("Unknown size distribution " + spec);
+		myMaxBytes = std::min(myMaxBytes, myFixed);
+		myFixed = myMaxBytes;
+	}
+}
+
+size_t SizeDistribution::next(LoadRandom& random) const
+{
+	switch (myKind)
+	{
+	case LogNormal:
+	{
+		std::lognormal_distribution<double> distribution(myMu, mySigma);
+		double size = distribution(random);
+		return size >= static_cast<double>(myMaxBytes) ? myMaxBytes : static_cast<size_t>(size);
+	}
+	case Empirical:
+	{
+		std::uniform_real_distribution<double> distribution(0, myCumulative.back());
+		size_t index = std::upper_bound(myCumulative.begin(), myCumulative.end(), distribution(random)) -
+			myCumulative.begin();
+		return std::min(mySizes[std::min(index, mySizes.size() - 1)], myMaxBytes);
+	}
+	default:
+		return myFixed;
+	}
+}
+
+ZipfKeys::ZipfKeys(size_t count, double exponent)
+{
+	if (count == 0)
+		throw std::runtime_error("At least one key is needed.");
+	myCumulative.resize(count);
+	double total = 0;
+	for (size_t rank = 0; rank < count; rank++)
+	{
+		total += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+		myCumulative[rank] = total;
+	}
+}
+
+size_t ZipfKeys::next(LoadRandom& random) const
+{
+	std::uniform_real_distribution<double> distribution(0, myCumulative.back());
+	size_t rank = std::upper_bound(myCumulative.begin(), myCumulative.end(), distribution(random)) -
+		myCumulative.begin();
+	return std::min(rank, myCumulative.size() - 1);
+}
+
+OperationMix::OperationMix(const std::string& spec) : mySpec(spec)
+{
+	double weights[OperationCount] = { 0, 0, 0 };
+	size_t start = 0;
+	while (start < spec.size())
+	{
+		size_t comma = spec.find(',', start);
+		if (comma == std::string::npos)
+			comma = spec.size();
+		std::string item = spec.substr(start, comma - start);
+		size_t eq = item.find('=');
+		std::string name = item.substr(0, eq);
+		double weight = eq == std::string::npos ? 0 : std::strtod(item.c_str() + eq + 1, nullptr);
+		int operation = -1;
+		for (int i = 0; i < OperationCount; i++)
+		{
+			if (name == OperationMix::name(static_cast<Operation>(i)))
+				operation = i;
+		}
+		if (operation < 0 || weight < 0)
+			throw std::runtime_error("Expected read=N,write=N,remove=N but found " + spec);
+		weights[operation] = weight;
+		start = comma + 1;
+	}
+	double total = 0;
+	for (int i = 0; i < OperationCount; i++)
+	{
+		total += weights[i];
+		myCumulative[i] = total;
+	}
+	if (total <= 0)
+		throw std::runtime_error("The operation mix " + spec + " has no operations.");
+}
+
+OperationMix::Operation OperationMix::next(LoadRandom& random) const
+{
+	std::uniform_real_distribution<double> distribution(0, myCumulative[OperationCount - 1]);
+	double value = distribution(random);
+	for (int i = 0; i < OperationCount; i++)
+	{
+		if (value < myCumulative[i])
+			return static_cast<Operation>(i);
+	}
+	return Write;
+}
+
+const char* OperationMix::name(Operation operation)
+{
+	static const char* names[OperationCount] = { "read", "write", "remove" };
+	return names[operation];
+}
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef LOADMODEL_H
+#define LOADMODEL_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::mt19937_64 LoadRandom;
+
+//******************************************************************************
+// Class SizeDistribution
+//
+// The payload sizes of a load test, parsed from a specification:
+//   256                  every payload is 256 bytes
+//   lognormal:1024:0.8   log-normal with a median of 1024 bytes and a sigma
+//                        (of the natural logarithm) of 0.8
+//   file:sizes.txt       empirical; each line of the file is "size" or
+//                        "size weight", and sizes are drawn in proportion to
+//                        their weights
+// Sizes are clamped to maxBytes. Throws std::runtime_error if the
+// specification or the file is not valid.
+//******************************************************************************
+class SizeDistribution
+{
+public:
+	SizeDistribution(const std::string& spec, size_t maxBytes);
+
+	size_t next(LoadRandom& random) const;
+
+	// Returns the largest size next() can return.
+	size_t maxBytes() const { return myMaxBytes; }
+
+	const std::string& spec() const { return mySpec; }
+
+private:
+	enum Kind { Fixed, LogNormal, Empirical };
+
+	std::string mySpec;
+	Kind myKind;
+	size_t myMaxBytes;
+	size_t myFixed;
+	double myMu;
+	double mySigma;
+	// The empirical sizes and their cumulative weights.
+	std::vector<size_t> mySizes;
+	std::vector<double> myCumulative;
+};
+
+//******************************************************************************
+// Class ZipfKeys
+//
+// Draws key ranks 0..count-1 with probability proportional to 1 / (rank+1)^s,
+// so rank 0 is the hottest key. An exponent of 0 is uniform. The cumulative
+// distribution is built once, and each draw is a binary search.
+//******************************************************************************
+class ZipfKeys
+{
+public:
+	ZipfKeys(size_t count, double exponent);
+
+	size_t next(LoadRandom& random) const;
+
+	size_t count() const { return myCumulative.size(); }
+
+private:
+	std::vector<double> myCumulative;
+};
+
+//******************************************************************************
+// Class OperationMix
+//
+// The proportions of reads, writes and removes, parsed from a specification
+// such as "read=70,write=25,remove=5". Throws std::runtime_error if it is not
+// valid.
+//******************************************************************************
+class OperationMix
+{
+public:
+	enum Operation { Read, Write, Remove, OperationCount };
+
+	explicit OperationMix(const std::string& spec);
+
+	Operation next(LoadRandom& random) const;
+
+	const std::string& spec() const { return mySpec; }
+
+	static const char* name(Operation operation);
+
+private:
+	std::string mySpec;
+	double myCumulative[OperationCount];
+};
+
+#endif // !LOADMODEL_H
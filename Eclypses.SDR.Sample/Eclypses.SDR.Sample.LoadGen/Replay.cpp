@@ -0,0 +1,252 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "Replay.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//******************************************************************************
+// Class ReplayWorker
+//
+// The SDRs and the share of the capture of one replay thread.
+//******************************************************************************
+class ReplayWorker
+{
+public:
+	ReplayWorker(const CaptureReplay::Options& options, size_t index, const uint8_t* payload) :
+		myStorage(options.storage), myPayload(payload),
+		mySdr((mte_sdr_random)MteRandom::getBytes),
+		myDisconnected((mte_sdr_random)MteRandom::getBytes)
+	{
+		mySdr.initSdr(MteSdr::mkFilePath(options.directory, "replay-" + std::to_string(index)), options.security);
+		myDisconnected.initSdr(options.security);
+	}
+
+	~ReplayWorker()
+	{
+		try
+		{
+			mySdr.removeSdr();
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	//------------------------------------------------------------
+	// Writes the keys that are read before the capture writes them,
+	// and conceals a value of each size that is revealed.
+	//------------------------------------------------------------
+	void prepare()
+	{
+		std::set<uint64_t> seen;
+		for (const MteSdrCapture::Record& r : myRecords)
+		{
+			if (r.operation == MteSdrCapture::Reveal && myConcealed.find(r.valueBytes) == myConcealed.end())
+			{
+				size_t concealedBytes;
+				uint8_t* concealed = myDisconnected.Conceal(myPayload, r.valueBytes, concealedBytes);
+				myConcealed[r.valueBytes].assign(concealed, concealed + concealedBytes);
+				delete[] concealed;
+			}
+			if (r.operation > MteSdrCapture::Remove || !seen.insert(r.keyHash).second)
+				continue;
+			if (r.operation == MteSdrCapture::Read && (r.flags & MteSdrCapture::Failed) == 0)
+				mySdr.write(keyName(r.keyHash), myPayload, r.valueBytes, toMemory(r));
+		}
+	}
+
+	// Runs one captured operation. Throws on failure.
+	void execute(const MteSdrCapture::Record& r)
+	{
+		size_t bytes;
+		switch (r.operation)
+		{
+		case MteSdrCapture::Read:
+			mySdr.readData(keyName(r.keyHash), bytes);
+			break;
+		case MteSdrCapture::Write:
+			mySdr.write(keyName(r.keyHash), myPayload, r.valueBytes, toMemory(r));
+			break;
+		case MteSdrCapture::Remove:
+			mySdr.remove(keyName(r.keyHash));
+			break;
+		case MteSdrCapture::Conceal:
+			delete[] myDisconnected.Conceal(myPayload, r.valueBytes, bytes);
+			break;
+		default:
+		{
+			const std::vector<uint8_t>& concealed = myConcealed[r.valueBytes];
+			myDisconnected.Reveal(concealed.data(), concealed.size(), bytes);
+			break;
+		}
+		}
+	}
+
+	std::vector<MteSdrCapture::Record> myRecords;
+
+private:
+	bool toMemory(const MteSdrCapture::Record& r) const
+	{
+		return myStorage == CaptureReplay::Recorded ? (r.flags & MteSdrCapture::ToMemory) != 0 :
+			myStorage == CaptureReplay::Memory;
+	}
+
+	// The stand-in for a captured key; a valid file name.
+	static std::string keyName(uint64_t hash)
+	{
+		char name[20];
+		std::snprintf(name, sizeof(name), "k%016llx", static_cast<unsigned long long>(hash));
+		return name;
+	}
+
+	CaptureReplay::Storage myStorage;
+	const uint8_t* myPayload;
+	MteSdr mySdr;
+	MteSdrDisconnected myDisconnected;
+	std::map<uint32_t, std::vector<uint8_t> > myConcealed;
+};
+
+CaptureReplay::CaptureReplay(const std::string& capturePath, const Options& options) :
+	myOptions(options), myRecords(MteSdrCapture::read(capturePath))
+{
+	if (myOptions.threads == 0)
+		myOptions.threads = 1;
+	if (myOptions.speed < 0)
+		throw std::runtime_error("The replay speed must not be negative.");
+	std::stable_sort(myRecords.begin(), myRecords.end(),
+		[](const MteSdrCapture::Record& a, const MteSdrCapture::Record& b) { return a.startNs < b.startNs; });
+}
+
+CaptureReplay::Result CaptureReplay::run()
+{
+	Result total = Result();
+	if (myRecords.empty())
+		return total;
+	total.capturedSeconds = static_cast<double>(myRecords.back().startNs - myRecords.front().startNs) / 1e9;
+
+	uint32_t maxBytes = 1;
+	for (const MteSdrCapture::Record& r : myRecords)
+		maxBytes = std::max(maxBytes, r.valueBytes);
+	std::vector<uint8_t> payload(maxBytes);
+	MteRandom::getBytes(payload.data(), payload.size());
+
+	//
+	// Keyed operations go to a thread by key, so each key lives in one SDR;
+	// conceals and reveals by the thread that captured them.
+	//
+	const size_t threads = myOptions.threads;
+	std::vector<std::unique_ptr<ReplayWorker> > workers;
+	for (size_t t = 0; t < threads; t++)
+		workers.emplace_back(new ReplayWorker(myOptions, t, payload.data()));
+	for (const MteSdrCapture::Record& r : myRecords)
+	{
+		size_t t = r.operation <= MteSdrCapture::Remove ? r.keyHash % threads : r.thread % threads;
+		workers[t]->myRecords.push_back(r);
+	}
+	for (auto& w : workers)
+		w->prepare();
+
+	std::vector<Result> results(threads);
+	const uint64_t firstNs = myRecords.front().startNs;
+	const Clock::time_point start = Clock::now() + std::chrono::milliseconds(10);
+	auto work = [&](size_t t)
+	{
+		Result& result = results[t];
+		result = Result();
+		ReplayWorker& worker = *workers[t];
+		for (const MteSdrCapture::Record& r : worker.myRecords)
+		{
+			Clock::time_point now = Clock::now();
+			Clock::time_point scheduled = now;
+			if (myOptions.speed > 0)
+			{
+				scheduled = start + std::chrono::nanoseconds(
+					static_cast<int64_t>(static_cast<double>(r.startNs - firstNs) / myOptions.speed));
+				if (scheduled - now > std::chrono::microseconds(200))
+					std::this_thread::sleep_until(scheduled - std::chrono::microseconds(100));
+				while ((now = Clock::now()) < scheduled)
+				{
+				}
+			}
+			try
+			{
+				worker.execute(r);
+			}
+			catch (const std::exception&)
+			{
+				result.errors++;
+			}
+			Clock::time_point finished = Clock::now();
+			result.operations++;
+			result.counts[r.operation]++;
+			result.bytes += r.valueBytes;
+			result.latency[r.operation].record(static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(finished - scheduled).count()));
+			result.service[r.operation].record(static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(finished - now).count()));
+		}
+	};
+	std::vector<std::thread> helpers;
+	for (size_t t = 1; t < threads; t++)
+		helpers.emplace_back(work, t);
+	work(0);
+	for (auto& h : helpers)
+		h.join();
+
+	total.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	for (const Result& r : results)
+	{
+		total.operations += r.operations;
+		total.errors += r.errors;
+		total.bytes += r.bytes;
+		for (int op = 0; op < MteSdrCapture::OperationCount; op++)
+		{
+			total.counts[op] += r.counts[op];
+			total.latency[op].merge(r.latency[op]);
+			total.service[op].merge(r.service[op]);
+			total.totalLatency.merge(r.latency[op]);
+		}
+	}
+	return total;
+}
+
+const char* CaptureReplay::storageName(Storage storage)
+{
+	static const char* names[] = { "recorded", "memory", "file" };
+	return names[storage];
+}
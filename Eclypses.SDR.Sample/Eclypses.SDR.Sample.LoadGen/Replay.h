@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MteHistogram.h"
+#include "MteSdrCapture.h"
+
+//******************************************************************************
+// Class CaptureReplay
+//
+// Replays a capture recorded with MteSdr::startCapture(): the same sequence
+// of reads, writes, removes, conceals and reveals, on keys standing in for
+// the captured key hashes, with random values of the captured sizes.
+//
+// Each replay thread has its own SDR, and every operation on a key runs on
+// the same thread, so a read finds what the capture wrote before it. Keys
+// read before they were written in the capture (written before it started)
+// are written first, with the size that was read.
+//
+// At speed 1 the operations are started at their captured times, open loop,
+// and latency is measured from that time as in the load generator; speed 2
+// runs twice as fast. At speed 0 they are run back to back.
+//******************************************************************************
+class CaptureReplay
+{
+public:
+	enum Storage
+	{
+		// Memory or file, as each operation was captured.
+		Recorded,
+		Memory,
+		File
+	};
+
+	struct Options
+	{
+		Storage storage = Recorded;
+		// Each thread's SDR is the folder replay-<thread> in this one.
+		std::string directory = ".";
+		std::string security = "SecurityString";
+		size_t threads = 1;
+		double speed = 1;
+	};
+
+	struct Result
+	{
+		double seconds;
+		// The time from the first captured operation to the last.
+		double capturedSeconds;
+		uint64_t operations;
+		uint64_t errors;
+		uint64_t bytes;
+		uint64_t counts[MteSdrCapture::OperationCount];
+		// Nanoseconds from the scheduled start to the end, per operation
+		// and in total.
+		MteHistogram latency[MteSdrCapture::OperationCount];
+		MteHistogram totalLatency;
+		// Nanoseconds from the actual start to the end.
+		MteHistogram service[MteSdrCapture::OperationCount];
+	};
+
+	// Reads the capture. Throws on failure.
+	CaptureReplay(const std::string& capturePath, const Options& options);
+
+	// Prepares the SDRs and replays the capture once. Throws on failure.
+	Result run();
+
+	const std::vector<MteSdrCapture::Record>& records() const { return myRecords; }
+
+	static const char* storageName(Storage storage);
+
+private:
+	Options myOptions;
+	// Sorted by start time.
+	std::vector<MteSdrCapture::Record> myRecords;
+};
+
+#endif // !REPLAY_H
@@ -0,0 +1,236 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "BatchBench.h"
+#include "MteSession.h"
+#include "MteBatch.h"
+#include "MteFixed.h"
+#include "MteEnc.h"
+#include "MteDec.h"
+#include "MteMkeEnc.h"
+#include "MteMkeDec.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* Personalization = "BatchBench";
+
+// The longest message the fixed option types keep in their own buffers.
+static const size_t FixedBytes = 1024;
+
+//
+// Throws if the status is an error.
+//
+static void check(mte_status status, const char* what)
+{
+	if (MteBase::statusIsError(status))
+	{
+		throw std::runtime_error(std::string(what) + " (" + MteBase::getStatusName(status) + "): " +
+			MteBase::getStatusDescription(status));
+	}
+}
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void putLength(size_t value, uint8_t* out)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+static size_t getLength(const uint8_t* in)
+{
+	return static_cast<size_t>(in[0]) | static_cast<size_t>(in[1]) << 8 |
+		static_cast<size_t>(in[2]) << 16 | static_cast<size_t>(in[3]) << 24;
+}
+
+//
+// Sends each batch one message at a time: each is copied out of the encoder
+// behind its length, then decoded and copied out of the decoder. Returns the
+// seconds taken.
+//
+template <class Enc, class Dec>
+static double timePerMessage(const std::vector<MteBatch::Message>& messages, const std::vector<uint8_t>& payload,
+	size_t batches, uint64_t nonce)
+{
+	MteSessionSeed seed = MteSessionSeed::random(nonce, Personalization);
+	Enc encoder;
+	check(instantiateSession(encoder, seed), "Error instantiating the encoder");
+	Dec decoder;
+	check(instantiateSession(decoder, seed), "Error instantiating the decoder");
+	std::vector<uint8_t> sent;
+	for (const MteBatch::Message& m : messages)
+		sent.resize(sent.size() + 4 + encoder.getBuffBytes(m.bytes));
+	std::vector<uint8_t> received(payload.size());
+	Clock::time_point start = Clock::now();
+	for (size_t b = 0; b < batches; b++)
+	{
+		mte_status status;
+		size_t sentBytes = 0;
+		for (const MteBatch::Message& m : messages)
+		{
+			size_t encodedBytes = 0;
+			const void* encoded = encoder.encode(m.data, m.bytes, encodedBytes, status);
+			check(status, "Error encoding");
+			putLength(encodedBytes, sent.data() + sentBytes);
+			memcpy(sent.data() + sentBytes + 4, encoded, encodedBytes);
+			sentBytes += 4 + encodedBytes;
+		}
+		size_t receivedBytes = 0;
+		for (size_t off = 0; off < sentBytes;)
+		{
+			size_t encodedBytes = getLength(sent.data() + off);
+			size_t decodedBytes = 0;
+			const void* decoded = decoder.decode(sent.data() + off + 4, encodedBytes, decodedBytes, status);
+			check(status, "Error decoding");
+			if (receivedBytes + decodedBytes > received.size())
+				throw std::runtime_error("A message decoded to more bytes than were sent");
+			memcpy(received.data() + receivedBytes, decoded, decodedBytes);
+			receivedBytes += decodedBytes;
+			off += 4 + encodedBytes;
+		}
+		if (receivedBytes != payload.size() || memcmp(received.data(), payload.data(), payload.size()) != 0)
+			throw std::runtime_error("A batch sent one message at a time did not decode to the messages sent");
+	}
+	return secondsSince(start);
+}
+
+BatchBench::BatchBench(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.batchMessages == 0)
+		myOptions.batchMessages = 1;
+	if (myOptions.batches == 0)
+		myOptions.batches = 1;
+}
+
+std::vector<BatchBench::Result> BatchBench::run()
+{
+	if (myOptions.type == "core")
+		return runPair<MteEnc, MteDec, MteEncT<FixedBytes>, MteDecT<FixedBytes> >();
+	if (myOptions.type == "mke")
+		return runPair<MteMkeEnc, MteMkeDec, MteMkeEncT<FixedBytes>, MteMkeDecT<FixedBytes> >();
+	throw std::runtime_error("Unknown session type: " + myOptions.type);
+}
+
+template <class Enc, class Dec, class FixedEnc, class FixedDec>
+std::vector<BatchBench::Result> BatchBench::runPair()
+{
+	//
+	// The same messages are sent in every batch.
+	//
+	size_t count = myOptions.batchMessages;
+	std::vector<uint8_t> payload(count * myOptions.messageBytes);
+	for (size_t i = 0; i < payload.size(); i++)
+		payload[i] = static_cast<uint8_t>(i * 131 + i / 7);
+	std::vector<MteBatch::Message> messages;
+	for (size_t i = 0; i < count; i++)
+		messages.push_back(MteBatch::Message(payload.data() + i * myOptions.messageBytes, myOptions.messageBytes));
+
+	std::vector<Result> results;
+	auto addResult = [&](const char* method, double seconds, size_t sends)
+	{
+		Result r;
+		r.method = method;
+		r.nsPerMessage = seconds * 1e9 / static_cast<double>(myOptions.batches * count);
+		r.messagesPerSec = seconds > 0 ? static_cast<double>(myOptions.batches * count) / seconds : 0.0;
+		r.sendsPerBatch = sends;
+		results.push_back(r);
+	};
+
+	//
+	// One message at a time, then the same with the fixed option types and
+	// their inline buffers.
+	//
+	addResult("per-message", timePerMessage<Enc, Dec>(messages, payload, myOptions.batches, 1), count);
+	addResult("per-message-t", timePerMessage<FixedEnc, FixedDec>(messages, payload, myOptions.batches, 2), count);
+
+	//
+	// The whole batch in one buffer behind its table.
+	//
+	{
+		MteSessionSeed seed = MteSessionSeed::random(3, Personalization);
+		Enc encoder;
+		check(instantiateSession(encoder, seed), "Error instantiating the encoder");
+		Dec decoder;
+		check(instantiateSession(decoder, seed), "Error instantiating the decoder");
+		//
+		// The batch is encoded after room for its header, so the header and
+		// the batch arrive together as one message.
+		//
+		size_t headerBytes = MteBatch::tableBytes(messages.size());
+		std::vector<uint8_t> header;
+		std::vector<uint8_t> wire(headerBytes + MteBatch::encodeBuffBytes(encoder, messages));
+		std::vector<uint8_t> received;
+		std::vector<MteBatch::Entry> table;
+		std::vector<MteBatch::Entry> receivedTable;
+		std::vector<MteBatch::Entry> decTable;
+		Clock::time_point start = Clock::now();
+		for (size_t b = 0; b < myOptions.batches; b++)
+		{
+			check(MteBatch::encode(encoder, messages, wire.data() + headerBytes, wire.size() - headerBytes, table),
+				"Error encoding the batch");
+			header.clear();
+			MteBatch::writeTable(table, header);
+			memcpy(wire.data(), header.data(), headerBytes);
+			size_t wireBytes = headerBytes + MteBatch::batchBytes(table);
+			if (MteBatch::readTable(wire.data(), wireBytes, receivedTable) != headerBytes)
+				throw std::runtime_error("The batch table did not read back");
+			received.resize(MteBatch::decodeBuffBytes(decoder, receivedTable));
+			check(MteBatch::decode(decoder, wire.data() + headerBytes, wireBytes - headerBytes, receivedTable,
+				received.data(), received.size(), decTable), "Error decoding the batch");
+			if (MteBatch::batchBytes(decTable) != payload.size() || decTable.size() != count ||
+				memcmp(received.data(), payload.data(), payload.size()) != 0)
+				throw std::runtime_error("A batch did not decode to the messages sent");
+		}
+		addResult("batch", secondsSince(start), 1);
+	}
+	return results;
+}
+
+void BatchBench::print(std::ostream& out, const std::vector<Result>& results)
+{
+	double baseline = results.empty() ? 0.0 : results.front().nsPerMessage;
+	out << std::left << std::setw(14) << "method" << std::right
+		<< std::setw(14) << "messages/s" << std::setw(14) << "ns/message" << std::setw(14) << "sends/batch"
+		<< std::setw(10) << "speedup" << std::endl;
+	for (const Result& r : results)
+	{
+		out << std::left << std::setw(14) << r.method << std::right << std::fixed
+			<< std::setw(14) << std::setprecision(0) << r.messagesPerSec
+			<< std::setw(14) << std::setprecision(1) << r.nsPerMessage
+			<< std::setw(14) << r.sendsPerBatch
+			<< std::setw(9) << std::setprecision(1) << (r.nsPerMessage > 0 ? baseline / r.nsPerMessage : 0.0) << "x" << std::endl;
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+	}
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef BATCHBENCH_H
+#define BATCHBENCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class BatchBench
+//
+// Measures sending a batch of small messages, of the core MTE or of MKE,
+// from an encoder to a decoder in two ways:
+//   per-message  -- encode() each message, copy it out of the encoder's
+//                   buffer behind a length prefix, as for one framed send
+//                   per message, and on the other side decode() each one
+//                   and copy it out of the decoder's buffer.
+//   per-message-t -- the same with MteEncT and MteDecT, or MteMkeEncT and
+//                   MteMkeDecT, which use buffers inside the objects for
+//                   messages of up to 1K.
+//   batch        -- MteBatch encodes the whole batch back to back into one
+//                   buffer behind its table, as for one send or writev(),
+//                   and decodes it into one buffer on the other side.
+// The send itself is left out; every batch is checked to decode to the
+// messages sent.
+//******************************************************************************
+class BatchBench
+{
+public:
+	struct Options
+	{
+		// "core" or "mke".
+		std::string type = "core";
+		size_t batchMessages = 64;
+		size_t messageBytes = 64;
+		size_t batches = 2000;
+	};
+
+	struct Result
+	{
+		std::string method;
+		double nsPerMessage;
+		double messagesPerSec;
+		// Sends needed for each batch.
+		size_t sendsPerBatch;
+	};
+
+	explicit BatchBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on MTE error or if a batch
+	// does not decode to the messages sent.
+	std::vector<Result> run();
+
+	static void print(std::ostream& out, const std::vector<Result>& results);
+
+private:
+	template <class Enc, class Dec, class FixedEnc, class FixedDec>
+	std::vector<Result> runPair();
+
+	Options myOptions;
+};
+
+#endif
@@ -0,0 +1,355 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "MteBase.h"
+#include "SessionBench.h"
+#include "PagingBench.h"
+#include "MteFileCrypt.h"
+#include "MteSegmentCrypt.h"
+#include "SegmentBench.h"
+#include "BatchBench.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+std::string getItemFromSettings(std::string key) {
+	std::ifstream file("./settings.txt");
+	std::string s;
+	while (std::getline(file, s)) {
+		std::size_t found = s.find(key);
+		if (found != std::string::npos) {
+			std::size_t eq = s.find('=');
+			if (eq != std::string::npos) {
+				return s.substr(eq + 1);
+			}
+		}
+	}
+	return "";
+}
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Mte session-bench [--type core|mke] [--sessions N] [--repetitions N] [--pool N]" << std::endl;
+	std::cout << "      Times setting up an encoder and decoder per session by instantiating them, and by leasing" << std::endl;
+	std::cout << "      them from an MteInstancePool restoring saved or prepared states." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Mte session-paging [--type core|mke] [--sessions N] [--resident N] [--active N]" << std::endl;
+	std::cout << "                                         [--hot fraction] [--operations N] [--size bytes]" << std::endl;
+	std::cout << "                                         [--file <state file>] [--seed N]" << std::endl;
+	std::cout << "      Opens many sessions in an MteSessionManager that keeps --resident in memory and pages" << std::endl;
+	std::cout << "      the rest out to the state file, then uses them, mostly the first --active." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Mte file-encrypt --in <file> --key <key file> [--out <file>] [--chunk bytes] [--buffers N]" << std::endl;
+	std::cout << "                                       [--threads N] [--segment bytes]" << std::endl;
+	std::cout << "      Encrypts a file of any size with MKE in chunks, to '<file>.mke' by default. A missing key" << std::endl;
+	std::cout << "      file is created with a new random key. With --threads or --segment the file is split into" << std::endl;
+	std::cout << "      segments encrypted in parallel, on every core with --threads 0." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Mte file-decrypt --in <file> --key <key file> [--out <file>] [--chunk bytes] [--buffers N]" << std::endl;
+	std::cout << "                                       [--threads N]" << std::endl;
+	std::cout << "      Decrypts a file from file-encrypt, to the name without '.mke' or to '<file>.clear'." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Mte file-scaling [--size bytes] [--segment bytes] [--threads n,n,...] [--file <name>]" << std::endl;
+	std::cout << "      Times encrypting and decrypting a file of random data in one session and in segments on" << std::endl;
+	std::cout << "      each number of threads." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Mte batch-bench [--type core|mke] [--messages N] [--size bytes] [--batches N]" << std::endl;
+	std::cout << "      Times encoding and decoding batches of small messages one message at a time, and with" << std::endl;
+	std::cout << "      MteBatch into one buffer for a single send." << std::endl;
+}
+
+static size_t parseSize(const std::string& text)
+{
+	char* end = nullptr;
+	size_t value = std::strtoull(text.c_str(), &end, 10);
+	switch (end != nullptr ? *end : '\0')
+	{
+	case 'k': case 'K': return value << 10;
+	case 'm': case 'M': return value << 20;
+	case 'g': case 'G': return value << 30;
+	default: return value;
+	}
+}
+
+static std::vector<size_t> parseList(const std::string& list)
+{
+	std::vector<size_t> values;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		if (comma > start)
+			values.push_back(std::strtoul(list.substr(start, comma - start).c_str(), nullptr, 10));
+		start = comma + 1;
+	}
+	return values;
+}
+
+static int sessionBench(const std::vector<std::string>& args)
+{
+	SessionBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--type" && hasValue)
+			options.type = args[++i];
+		else if (arg == "--sessions" && hasValue)
+			options.sessions = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--repetitions" && hasValue)
+			options.repetitions = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--pool" && hasValue)
+			options.poolSize = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "Session setup, " << options.type << ", " << options.sessions << " sessions" << std::endl;
+	SessionBench bench(options);
+	SessionBench::print(std::cout, bench.run());
+	return 0;
+}
+
+static int sessionPaging(const std::vector<std::string>& args)
+{
+	PagingBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--type" && hasValue)
+			options.type = args[++i];
+		else if (arg == "--sessions" && hasValue)
+			options.sessions = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--resident" && hasValue)
+			options.maxResident = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--active" && hasValue)
+			options.active = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--hot" && hasValue)
+			options.hot = std::atof(args[++i].c_str());
+		else if (arg == "--operations" && hasValue)
+			options.operations = std::strtoull(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--size" && hasValue)
+			options.messageBytes = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--file" && hasValue)
+			options.stateFile = args[++i];
+		else if (arg == "--seed" && hasValue)
+			options.seed = std::strtoull(args[++i].c_str(), nullptr, 10);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "Session paging, " << options.type << ", " << options.sessions << " sessions, "
+		<< options.maxResident << " resident" << std::endl;
+	PagingBench bench(options);
+	PagingBench::print(std::cout, bench.run());
+	return 0;
+}
+
+static int fileCrypt(const std::vector<std::string>& args, bool encrypt)
+{
+	MteFileCrypt::Options options;
+	MteSegmentCrypt::Options segmentOptions;
+	bool segmented = false;
+	std::string input;
+	std::string output;
+	std::string keyFile;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--in" && hasValue)
+			input = args[++i];
+		else if (arg == "--out" && hasValue)
+			output = args[++i];
+		else if (arg == "--key" && hasValue)
+			keyFile = args[++i];
+		else if (arg == "--chunk" && hasValue)
+			options.chunkBytes = parseSize(args[++i]);
+		else if (arg == "--buffers" && hasValue)
+			options.buffers = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--threads" && hasValue)
+		{
+			segmentOptions.threads = std::strtoul(args[++i].c_str(), nullptr, 10);
+			segmented = true;
+		}
+		else if (arg == "--segment" && hasValue && encrypt)
+		{
+			segmentOptions.segmentBytes = parseSize(args[++i]);
+			segmented = true;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (input.empty() || keyFile.empty())
+	{
+		usage();
+		return 1;
+	}
+	const std::string extension = ".mke";
+	if (output.empty() && encrypt)
+		output = input + extension;
+	else if (output.empty() && input.size() > extension.size() &&
+		input.compare(input.size() - extension.size(), extension.size(), extension) == 0)
+		output = input.substr(0, input.size() - extension.size());
+	else if (output.empty())
+		output = input + ".clear";
+
+	std::vector<uint8_t> key = MteFileCrypt::readKey(keyFile, encrypt);
+	std::cout << (encrypt ? "Encrypting " : "Decrypting ") << input << " to " << output << std::endl;
+	// A segmented file is decrypted in segments whatever the options.
+	if (encrypt ? segmented : MteSegmentCrypt::isSegmented(input))
+	{
+		MteSegmentCrypt crypt(segmentOptions);
+		MteSegmentCrypt::print(std::cout, encrypt ? crypt.encrypt(input, output, key) : crypt.decrypt(input, output, key));
+		return 0;
+	}
+	MteFileCrypt crypt(options);
+	MteFileCrypt::print(std::cout, encrypt ? crypt.encrypt(input, output, key) : crypt.decrypt(input, output, key));
+	return 0;
+}
+
+static int fileScaling(const std::vector<std::string>& args)
+{
+	SegmentBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--size" && hasValue)
+			options.fileBytes = parseSize(args[++i]);
+		else if (arg == "--segment" && hasValue)
+			options.segmentBytes = parseSize(args[++i]);
+		else if (arg == "--threads" && hasValue)
+			options.threads = parseList(args[++i]);
+		else if (arg == "--file" && hasValue)
+			options.file = args[++i];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "File encryption scaling, " << options.fileBytes << " bytes in segments of " << options.segmentBytes
+		<< " bytes" << std::endl;
+	SegmentBench bench(options);
+	SegmentBench::print(std::cout, bench.run());
+	return 0;
+}
+
+static int batchBench(const std::vector<std::string>& args)
+{
+	BatchBench::Options options;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		bool hasValue = i + 1 < args.size();
+		if (arg == "--type" && hasValue)
+			options.type = args[++i];
+		else if (arg == "--messages" && hasValue)
+			options.batchMessages = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else if (arg == "--size" && hasValue)
+			options.messageBytes = parseSize(args[++i]);
+		else if (arg == "--batches" && hasValue)
+			options.batches = std::strtoul(args[++i].c_str(), nullptr, 10);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	std::cout << "Batch encoding, " << options.type << ", " << options.batchMessages << " messages of "
+		<< options.messageBytes << " bytes per batch" << std::endl;
+	BatchBench bench(options);
+	BatchBench::print(std::cout, bench.run());
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MTE Core Samples" << std::endl;
+
+	//
+	// Initialize MTE license.
+	//
+	std::string company = getItemFromSettings("LicensedCompany");
+	std::string license = getItemFromSettings("LicenseKey");
+	if (!MteBase::initLicense(company.c_str(), license.c_str()))
+	{
+		std::cerr << "License init error ("
+			<< MteBase::getStatusName(mte_status_license_error)
+			<< "): "
+			<< MteBase::getStatusDescription(mte_status_license_error)
+			<< std::endl;
+		return mte_status_license_error;
+	}
+	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+	std::string command = argv[1];
+	std::vector<std::string> args(argv + 2, argv + argc);
+	try
+	{
+		if (command == "session-bench")
+			return sessionBench(args);
+		if (command == "session-paging")
+			return sessionPaging(args);
+		if (command == "file-encrypt")
+			return fileCrypt(args, true);
+		if (command == "file-decrypt")
+			return fileCrypt(args, false);
+		if (command == "file-scaling")
+			return fileScaling(args);
+		if (command == "batch-bench")
+			return batchBench(args);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	usage();
+	return 1;
+}
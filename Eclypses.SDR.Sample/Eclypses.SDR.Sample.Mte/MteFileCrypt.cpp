@@ -0,0 +1,513 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteFileCrypt.h"
+#include "MteSession.h"
+#include "MteMkeEnc.h"
+#include "MteMkeDec.h"
+#include "MteRandom.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+static const char Magic[8] = { 'M', 'T', 'E', 'F', 'I', 'L', 'E', '1' };
+static const size_t HeaderBytes = 16;
+static const char* Personalization = "MteFileCrypt";
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//
+// Throws if the status is an error.
+//
+static void check(mte_status status, const char* what)
+{
+	if (status != mte_status_success)
+	{
+		throw std::runtime_error(std::string(what) + " (" + MteBase::getStatusName(status) + "): " +
+			MteBase::getStatusDescription(status));
+	}
+}
+
+//
+// The cipher block size, at least 1. The padding length must fit in a byte.
+//
+static size_t blockBytes(const MteBase& mte)
+{
+	size_t block = MteBase::getCiphersBlockBytes(mte.getCipher());
+	if (block > 255)
+		throw std::runtime_error("The cipher block size is too large to pad");
+	return block == 0 ? 1 : block;
+}
+
+//
+// One buffer of the ring. The chunk that reaches the end of the input is
+// flagged last; it may be short or empty.
+//
+struct Chunk
+{
+	std::vector<uint8_t> data;
+	size_t bytes = 0;
+	bool last = false;
+};
+
+//
+// Hands chunks from one stage to the next. abort() wakes every waiter and
+// makes pop() return null from then on, so a failing stage stops the others.
+//
+class ChunkQueue
+{
+public:
+	void push(Chunk* chunk)
+	{
+		{
+			std::lock_guard<std::mutex> lock(myMutex);
+			myChunks.push_back(chunk);
+		}
+		myCv.notify_one();
+	}
+
+	Chunk* pop()
+	{
+		std::unique_lock<std::mutex> lock(myMutex);
+		myCv.wait(lock, [this] { return myAborted || !myChunks.empty(); });
+		if (myAborted)
+			return nullptr;
+		Chunk* chunk = myChunks.front();
+		myChunks.pop_front();
+		return chunk;
+	}
+
+	void abort()
+	{
+		{
+			std::lock_guard<std::mutex> lock(myMutex);
+			myAborted = true;
+		}
+		myCv.notify_all();
+	}
+
+private:
+	std::mutex myMutex;
+	std::condition_variable myCv;
+	std::deque<Chunk*> myChunks;
+	bool myAborted = false;
+};
+
+//
+// The stages of one run. The first error of any stage aborts the queues and
+// is rethrown by finish().
+//
+class Pipeline
+{
+public:
+	explicit Pipeline(std::vector<ChunkQueue*> queues) :
+		myQueues(queues)
+	{
+	}
+
+	~Pipeline()
+	{
+		abort();
+		join();
+	}
+
+	// Runs the stage on a thread of its own.
+	void start(std::function<void()> stage)
+	{
+		myThreads.emplace_back([this, stage] { run(stage); });
+	}
+
+	// Runs the stage on this thread.
+	void run(const std::function<void()>& stage)
+	{
+		try
+		{
+			stage();
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<std::mutex> lock(myMutex);
+				if (!myError)
+					myError = std::current_exception();
+			}
+			abort();
+		}
+	}
+
+	// Waits for the stages and rethrows the first error.
+	void finish()
+	{
+		join();
+		if (myError)
+			std::rethrow_exception(myError);
+	}
+
+private:
+	void abort()
+	{
+		for (ChunkQueue* queue : myQueues)
+			queue->abort();
+	}
+
+	void join()
+	{
+		for (std::thread& t : myThreads)
+		{
+			if (t.joinable())
+				t.join();
+		}
+	}
+
+	std::vector<ChunkQueue*> myQueues;
+	std::vector<std::thread> myThreads;
+	std::mutex myMutex;
+	std::exception_ptr myError;
+};
+
+//
+// Reads the input a chunk at a time until the end.
+//
+static void readChunks(std::ifstream& in, size_t chunkBytes, ChunkQueue& free, ChunkQueue& filled, uint64_t& bytesIn)
+{
+	for (;;)
+	{
+		Chunk* chunk = free.pop();
+		if (chunk == nullptr)
+			return;
+		in.read(reinterpret_cast<char*>(chunk->data.data()), static_cast<std::streamsize>(chunkBytes));
+		if (in.bad())
+			throw std::runtime_error("Error reading the input");
+		chunk->bytes = static_cast<size_t>(in.gcount());
+		chunk->last = chunk->bytes < chunkBytes;
+		bytesIn += chunk->bytes;
+		filled.push(chunk);
+		if (chunk->last)
+			return;
+	}
+}
+
+//
+// Writes the chunks out until the last one.
+//
+static void writeChunks(std::ofstream& out, ChunkQueue& done, ChunkQueue& free, uint64_t& bytesOut)
+{
+	for (;;)
+	{
+		Chunk* chunk = done.pop();
+		if (chunk == nullptr)
+			return;
+		out.write(reinterpret_cast<const char*>(chunk->data.data()), static_cast<std::streamsize>(chunk->bytes));
+		bool last = chunk->last;
+		if (last)
+			out.flush();
+		if (!out)
+			throw std::runtime_error("Error writing the output");
+		bytesOut += chunk->bytes;
+		free.push(chunk);
+		if (last)
+			return;
+	}
+}
+
+//
+// Appends bytes to a chunk, growing it if need be.
+//
+static void append(Chunk& chunk, const void* data, size_t bytes)
+{
+	if (chunk.bytes + bytes > chunk.data.size())
+		chunk.data.resize(chunk.bytes + bytes);
+	if (bytes > 0)
+		std::memcpy(chunk.data.data() + chunk.bytes, data, bytes);
+	chunk.bytes += bytes;
+}
+
+MteFileCrypt::MteFileCrypt(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.buffers < 2)
+		myOptions.buffers = 2;
+}
+
+MteFileCrypt::Result MteFileCrypt::encrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key)
+{
+	Clock::time_point start = Clock::now();
+	std::ifstream in(input.c_str(), std::ios::in | std::ios::binary);
+	if (!in.is_open())
+		throw std::runtime_error("Unable to open " + input);
+
+	MteSessionSeed seed;
+	seed.entropy = key;
+	if (MteRandom::getBytes(&seed.nonce, sizeof(seed.nonce)) != 0)
+		throw std::runtime_error("Unable to get random bytes for the nonce");
+	seed.personalization = Personalization;
+	MteMkeEnc encoder;
+	check(instantiateSession(encoder, seed), "Error instantiating the encryptor");
+	size_t block = blockBytes(encoder);
+	size_t chunkBytes = std::max(block, myOptions.chunkBytes / block * block);
+
+	std::ofstream out(output.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		throw std::runtime_error("Unable to create " + output);
+	uint64_t bytesIn = 0;
+	uint64_t bytesOut = 0;
+	double cipherSeconds = 0.0;
+	try
+	{
+		uint8_t header[HeaderBytes];
+		std::memcpy(header, Magic, sizeof(Magic));
+		for (size_t i = 0; i < 8; i++)
+			header[8 + i] = static_cast<uint8_t>(seed.nonce >> (8 * i));
+		out.write(reinterpret_cast<const char*>(header), HeaderBytes);
+		bytesOut += HeaderBytes;
+
+		// Room for the padding and the final part in the last chunk.
+		std::vector<Chunk> chunks(myOptions.buffers);
+		ChunkQueue free, filled, done;
+		for (Chunk& chunk : chunks)
+		{
+			chunk.data.resize(chunkBytes + block + encoder.encryptFinishBytes());
+			free.push(&chunk);
+		}
+		Pipeline pipeline({ &free, &filled, &done });
+		pipeline.start([&] { readChunks(in, chunkBytes, free, filled, bytesIn); });
+		pipeline.start([&] { writeChunks(out, done, free, bytesOut); });
+		pipeline.run([&]
+			{
+				check(encoder.startEncrypt(), "Error starting the encryption");
+				for (;;)
+				{
+					Chunk* chunk = filled.pop();
+					if (chunk == nullptr)
+						return;
+					Clock::time_point cipherStart = Clock::now();
+					bool last = chunk->last;
+					if (last)
+					{
+						// PKCS#7: pad to a whole block with 1 to block bytes.
+						size_t pad = block - chunk->bytes % block;
+						std::memset(chunk->data.data() + chunk->bytes, static_cast<int>(pad), pad);
+						chunk->bytes += pad;
+					}
+					check(encoder.encryptChunk(chunk->data.data(), chunk->bytes), "Error encrypting");
+					if (last)
+					{
+						size_t finalBytes = 0;
+						mte_status status = mte_status_success;
+						const void* final = encoder.finishEncrypt(finalBytes, status);
+						check(status, "Error finishing the encryption");
+						append(*chunk, final, finalBytes);
+					}
+					cipherSeconds += secondsSince(cipherStart);
+					done.push(chunk);
+					if (last)
+						return;
+				}
+			});
+		pipeline.finish();
+		out.close();
+	}
+	catch (...)
+	{
+		out.close();
+		std::remove(output.c_str());
+		throw;
+	}
+	Result result;
+	result.bytesIn = bytesIn;
+	result.bytesOut = bytesOut;
+	result.seconds = secondsSince(start);
+	result.cipherSeconds = cipherSeconds;
+	return result;
+}
+
+MteFileCrypt::Result MteFileCrypt::decrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key)
+{
+	Clock::time_point start = Clock::now();
+	std::ifstream in(input.c_str(), std::ios::in | std::ios::binary);
+	if (!in.is_open())
+		throw std::runtime_error("Unable to open " + input);
+	uint8_t header[HeaderBytes];
+	in.read(reinterpret_cast<char*>(header), HeaderBytes);
+	if (static_cast<size_t>(in.gcount()) != HeaderBytes || std::memcmp(header, Magic, sizeof(Magic)) != 0)
+		throw std::runtime_error(input + " is not an encrypted file");
+
+	MteSessionSeed seed;
+	seed.entropy = key;
+	for (size_t i = 0; i < 8; i++)
+		seed.nonce |= static_cast<uint64_t>(header[8 + i]) << (8 * i);
+	seed.personalization = Personalization;
+	MteMkeDec decoder;
+	check(instantiateSession(decoder, seed), "Error instantiating the decryptor");
+	size_t block = blockBytes(decoder);
+	size_t chunkBytes = std::max(block, myOptions.chunkBytes / block * block);
+
+	std::ofstream out(output.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		throw std::runtime_error("Unable to create " + output);
+	uint64_t bytesIn = HeaderBytes;
+	uint64_t bytesOut = 0;
+	double cipherSeconds = 0.0;
+	try
+	{
+		// Decryption cannot be in place, so the plain chunks are a ring of
+		// their own. Each has room for the held back block, the chunk and the
+		// block decryptChunk() may add.
+		std::vector<Chunk> chunks(myOptions.buffers);
+		std::vector<Chunk> plains(myOptions.buffers);
+		ChunkQueue free, filled, plainFree, done;
+		for (Chunk& chunk : chunks)
+		{
+			chunk.data.resize(chunkBytes);
+			free.push(&chunk);
+		}
+		for (Chunk& plain : plains)
+		{
+			plain.data.resize(block + chunkBytes + block);
+			plainFree.push(&plain);
+		}
+		std::vector<uint8_t> held;
+		held.reserve(block);
+		Pipeline pipeline({ &free, &filled, &plainFree, &done });
+		pipeline.start([&] { readChunks(in, chunkBytes, free, filled, bytesIn); });
+		pipeline.start([&] { writeChunks(out, done, plainFree, bytesOut); });
+		pipeline.run([&]
+			{
+				check(decoder.startDecrypt(), "Error starting the decryption");
+				for (;;)
+				{
+					Chunk* chunk = filled.pop();
+					Chunk* plain = chunk != nullptr ? plainFree.pop() : nullptr;
+					if (plain == nullptr)
+						return;
+					Clock::time_point cipherStart = Clock::now();
+					bool last = chunk->last;
+					plain->bytes = 0;
+					append(*plain, held.data(), held.size());
+					if (chunk->bytes > 0)
+					{
+						size_t decrypted = decoder.decryptChunk(chunk->data.data(), 0, chunk->bytes,
+							plain->data.data(), plain->bytes);
+						if (decrypted == ULONG_MAX)
+							throw std::runtime_error("Error decrypting");
+						plain->bytes += decrypted;
+					}
+					free.push(chunk);
+					if (last)
+					{
+						size_t finalBytes = 0;
+						mte_status status = mte_status_success;
+						const void* final = decoder.finishDecrypt(finalBytes, status);
+						check(status, "Error finishing the decryption");
+						append(*plain, final, finalBytes);
+						const uint8_t* data = plain->data.data();
+						size_t pad = plain->bytes > 0 ? data[plain->bytes - 1] : 0;
+						if (pad == 0 || pad > block || pad > plain->bytes ||
+							std::count(data + plain->bytes - pad, data + plain->bytes, static_cast<uint8_t>(pad)) != static_cast<std::ptrdiff_t>(pad))
+						{
+							throw std::runtime_error(input + " is incomplete or was not encrypted with this key");
+						}
+						plain->bytes -= pad;
+					}
+					else
+					{
+						// Hold back the last block, as it may be the padding.
+						size_t keep = std::min(plain->bytes, block);
+						plain->bytes -= keep;
+						held.assign(plain->data.begin() + plain->bytes, plain->data.begin() + plain->bytes + keep);
+					}
+					plain->last = last;
+					cipherSeconds += secondsSince(cipherStart);
+					done.push(plain);
+					if (last)
+						return;
+				}
+			});
+		pipeline.finish();
+		out.close();
+	}
+	catch (...)
+	{
+		out.close();
+		std::remove(output.c_str());
+		throw;
+	}
+	Result result;
+	result.bytesIn = bytesIn;
+	result.bytesOut = bytesOut;
+	result.seconds = secondsSince(start);
+	result.cipherSeconds = cipherSeconds;
+	return result;
+}
+
+std::vector<uint8_t> MteFileCrypt::readKey(const std::string& path, bool create)
+{
+	std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		if (!create)
+			throw std::runtime_error("Unable to read the key file " + path);
+		std::vector<uint8_t> key = MteSessionSeed::random(0, Personalization).entropy;
+		std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(key.data()), static_cast<std::streamsize>(key.size()));
+		out.close();
+		if (!out)
+			throw std::runtime_error("Unable to write the key file " + path);
+		return key;
+	}
+	std::vector<uint8_t> key((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (key.size() < MteBase::getDrbgsEntropyMinBytes(MteBase::getDefaultDrbg()))
+		throw std::runtime_error("The key file " + path + " is too short");
+	return key;
+}
+
+void MteFileCrypt::print(std::ostream& out, const Result& result)
+{
+	double mb = 1024.0 * 1024.0;
+	double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+	out << std::fixed << std::setprecision(1)
+		<< "Read " << result.bytesIn / mb << " MB and wrote " << result.bytesOut / mb << " MB in "
+		<< std::setprecision(3) << result.seconds << " seconds: " << std::setprecision(1)
+		<< result.bytesIn / mb / seconds << " MB/s, cipher busy " << 100.0 * result.cipherSeconds / seconds << "%"
+		<< std::endl;
+}
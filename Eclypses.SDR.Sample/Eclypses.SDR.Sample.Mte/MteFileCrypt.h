@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTEFILECRYPT_H
+#define MTEFILECRYPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class MteFileCrypt
+//
+// Encrypts and decrypts files of any size with the chunk API of MteMkeEnc
+// and MteMkeDec, in constant memory. A reader thread reads the input into a
+// ring of chunk buffers, the calling thread encrypts or decrypts each one and
+// a writer thread writes it out, so the reads, the cipher and the writes all
+// overlap. With the default four buffers, two can be in flight on each side
+// of the cipher.
+//
+// The chunks are a multiple of the cipher block size, as encryptChunk()
+// requires, and are encrypted in place. The last one is padded to a block
+// with PKCS#7 padding, which decryption strips.
+//
+// An encrypted file starts with a 16 byte header: the magic "MTEFILE1" and
+// the nonce, little endian. The nonce is drawn for each file, so a key can
+// be used for many files. The key is the entropy to instantiate with.
+//
+// Throws an exception on I/O or MTE error, removing the partial output.
+//******************************************************************************
+class MteFileCrypt
+{
+public:
+	struct Options
+	{
+		// The bytes read per chunk, rounded down to the cipher block size.
+		size_t chunkBytes = 1024 * 1024;
+		// The chunk buffers on each side of the cipher.
+		size_t buffers = 4;
+	};
+
+	struct Result
+	{
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		double seconds;
+		// The time spent in the cipher; the rest of the run it waited on I/O.
+		double cipherSeconds;
+	};
+
+	explicit MteFileCrypt(const Options& options);
+
+	Result encrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key);
+	Result decrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key);
+
+	// Reads a key file. With create, a missing key file is created with a new
+	// random key first.
+	static std::vector<uint8_t> readKey(const std::string& path, bool create);
+
+	static void print(std::ostream& out, const Result& result);
+
+private:
+	Options myOptions;
+};
+
+#endif
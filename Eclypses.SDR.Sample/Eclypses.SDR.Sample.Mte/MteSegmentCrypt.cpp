@@ -0,0 +1,460 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteSegmentCrypt.h"
+#include "MteSession.h"
+#include "MteMkeEnc.h"
+#include "MteMkeDec.h"
+#include "MteRandom.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+static const char Magic[8] = { 'M', 'T', 'E', 'S', 'E', 'G', 'S', '1' };
+static const size_t HeaderBytes = 40;
+static const size_t IndexEntryBytes = 16;
+static const char* Personalization = "MteSegmentCrypt";
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//
+// Throws if the status is an error.
+//
+static void check(mte_status status, const char* what)
+{
+	if (status != mte_status_success)
+	{
+		throw std::runtime_error(std::string(what) + " (" + MteBase::getStatusName(status) + "): " +
+			MteBase::getStatusDescription(status));
+	}
+}
+
+//
+// The cipher block size, at least 1. The padding length must fit in a byte.
+//
+static size_t blockBytes(const MteBase& mte)
+{
+	size_t block = MteBase::getCiphersBlockBytes(mte.getCipher());
+	if (block > 255)
+		throw std::runtime_error("The cipher block size is too large to pad");
+	return block == 0 ? 1 : block;
+}
+
+static void putU64(uint8_t* p, uint64_t value)
+{
+	for (size_t i = 0; i < 8; i++)
+		p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+static uint64_t getU64(const uint8_t* p)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < 8; i++)
+		value |= static_cast<uint64_t>(p[i]) << (8 * i);
+	return value;
+}
+
+//
+// The seed of one segment: the file nonce plus the segment index.
+//
+static MteSessionSeed segmentSeed(const std::vector<uint8_t>& key, uint64_t nonce, uint64_t segment)
+{
+	MteSessionSeed seed;
+	seed.entropy = key;
+	seed.nonce = nonce + segment;
+	seed.personalization = Personalization;
+	return seed;
+}
+
+//
+// Hands the segments out to the workers, each taking the next one, and
+// keeps the first error. After an error no more segments are handed out.
+//
+class SegmentQueue
+{
+public:
+	explicit SegmentQueue(uint64_t segments) :
+		myNext(0), mySegments(segments), myFailed(false)
+	{
+	}
+
+	// Takes the next segment; false when there are none left.
+	bool next(uint64_t& segment)
+	{
+		if (myFailed.load(std::memory_order_relaxed))
+			return false;
+		segment = myNext.fetch_add(1);
+		return segment < mySegments;
+	}
+
+	// Runs the worker on each thread and rethrows the first error.
+	void run(size_t threads, const std::function<void()>& worker)
+	{
+		std::vector<std::thread> pool;
+		for (size_t t = 0; t < threads; t++)
+		{
+			pool.emplace_back([this, &worker]
+				{
+					try
+					{
+						worker();
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(myMutex);
+						if (!myError)
+							myError = std::current_exception();
+						myFailed = true;
+					}
+				});
+		}
+		for (std::thread& t : pool)
+			t.join();
+		if (myError)
+			std::rethrow_exception(myError);
+	}
+
+private:
+	std::atomic<uint64_t> myNext;
+	uint64_t mySegments;
+	std::atomic<bool> myFailed;
+	std::mutex myMutex;
+	std::exception_ptr myError;
+};
+
+//
+// Encrypts a segment in place as a session of its own: pads it to a block
+// and appends the final part. Returns the encrypted length.
+//
+static size_t encryptSegment(MteMkeEnc& encoder, const MteSessionSeed& seed, std::vector<uint8_t>& data,
+	size_t bytes, size_t block)
+{
+	check(instantiateSession(encoder, seed), "Error instantiating the encryptor");
+	size_t pad = block - bytes % block;
+	std::memset(data.data() + bytes, static_cast<int>(pad), pad);
+	bytes += pad;
+	check(encoder.startEncrypt(), "Error starting the encryption");
+	check(encoder.encryptChunk(data.data(), bytes), "Error encrypting");
+	size_t finalBytes = 0;
+	mte_status status = mte_status_success;
+	const void* final = encoder.finishEncrypt(finalBytes, status);
+	check(status, "Error finishing the encryption");
+	if (bytes + finalBytes > data.size())
+		data.resize(bytes + finalBytes);
+	std::memcpy(data.data() + bytes, final, finalBytes);
+	encoder.uninstantiate();
+	return bytes + finalBytes;
+}
+
+//
+// Decrypts a segment into plain and strips the padding. Returns the plain
+// length.
+//
+static size_t decryptSegment(MteMkeDec& decoder, const MteSessionSeed& seed, const uint8_t* encrypted,
+	size_t encryptedBytes, std::vector<uint8_t>& plain, size_t block, uint64_t segment)
+{
+	check(instantiateSession(decoder, seed), "Error instantiating the decryptor");
+	check(decoder.startDecrypt(), "Error starting the decryption");
+	size_t bytes = decoder.decryptChunk(encrypted, 0, encryptedBytes, plain.data(), 0);
+	if (bytes == ULONG_MAX)
+		throw std::runtime_error("Error decrypting segment " + std::to_string(segment));
+	size_t finalBytes = 0;
+	mte_status status = mte_status_success;
+	const void* final = decoder.finishDecrypt(finalBytes, status);
+	check(status, "Error finishing the decryption");
+	if (bytes + finalBytes > plain.size())
+		plain.resize(bytes + finalBytes);
+	if (finalBytes > 0)
+		std::memcpy(plain.data() + bytes, final, finalBytes);
+	bytes += finalBytes;
+	decoder.uninstantiate();
+	const uint8_t* data = plain.data();
+	size_t pad = bytes > 0 ? data[bytes - 1] : 0;
+	if (pad == 0 || pad > block || pad > bytes ||
+		std::count(data + bytes - pad, data + bytes, static_cast<uint8_t>(pad)) != static_cast<std::ptrdiff_t>(pad))
+	{
+		throw std::runtime_error("Segment " + std::to_string(segment) + " is damaged or was not encrypted with this key");
+	}
+	return bytes - pad;
+}
+
+MteSegmentCrypt::MteSegmentCrypt(const Options& options) :
+	myOptions(options)
+{
+}
+
+size_t MteSegmentCrypt::threadsFor(uint64_t segments) const
+{
+	size_t threads = myOptions.threads;
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads > segments)
+		threads = static_cast<size_t>(segments);
+	return threads == 0 ? 1 : threads;
+}
+
+MteSegmentCrypt::Result MteSegmentCrypt::encrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key)
+{
+	Clock::time_point start = Clock::now();
+	std::ifstream probe(input.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!probe.is_open())
+		throw std::runtime_error("Unable to open " + input);
+	uint64_t plainBytes = static_cast<uint64_t>(probe.tellg());
+	probe.close();
+
+	uint64_t nonce = 0;
+	if (MteRandom::getBytes(&nonce, sizeof(nonce)) != 0)
+		throw std::runtime_error("Unable to get random bytes for the nonce");
+	// Every segment has the same block size and final part length.
+	size_t block;
+	size_t finishBytes;
+	{
+		MteMkeEnc encoder;
+		check(instantiateSession(encoder, segmentSeed(key, nonce, 0)), "Error instantiating the encryptor");
+		block = blockBytes(encoder);
+		finishBytes = encoder.encryptFinishBytes();
+	}
+	size_t segmentBytes = std::max(block, myOptions.segmentBytes / block * block);
+	uint64_t segments = plainBytes == 0 ? 1 : (plainBytes + segmentBytes - 1) / segmentBytes;
+
+	// Lay out the segments.
+	std::vector<uint8_t> header(HeaderBytes + segments * IndexEntryBytes);
+	std::memcpy(header.data(), Magic, sizeof(Magic));
+	putU64(&header[8], nonce);
+	putU64(&header[16], segmentBytes);
+	putU64(&header[24], segments);
+	putU64(&header[32], plainBytes);
+	std::vector<uint64_t> offsets(segments);
+	std::vector<uint64_t> lengths(segments);
+	uint64_t offset = header.size();
+	for (uint64_t s = 0; s < segments; s++)
+	{
+		uint64_t plain = std::min<uint64_t>(segmentBytes, plainBytes - s * segmentBytes);
+		offsets[s] = offset;
+		lengths[s] = plain + (block - plain % block) + finishBytes;
+		putU64(&header[HeaderBytes + s * IndexEntryBytes], offsets[s]);
+		putU64(&header[HeaderBytes + s * IndexEntryBytes + 8], lengths[s]);
+		offset += lengths[s];
+	}
+
+	Result result;
+	result.bytesIn = plainBytes;
+	result.bytesOut = offset;
+	result.segments = segments;
+	result.threads = threadsFor(segments);
+	result.cipherSeconds = 0.0;
+	try
+	{
+		{
+			std::ofstream out(output.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+			out.close();
+			if (!out)
+				throw std::runtime_error("Unable to create " + output);
+		}
+		SegmentQueue queue(segments);
+		std::mutex mutex;
+		queue.run(result.threads, [&]
+			{
+				std::ifstream in(input.c_str(), std::ios::in | std::ios::binary);
+				std::fstream out(output.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+				if (!in.is_open() || !out.is_open())
+					throw std::runtime_error("Unable to open " + input + " and " + output);
+				MteMkeEnc encoder;
+				std::vector<uint8_t> data(segmentBytes + block + finishBytes);
+				double cipherSeconds = 0.0;
+				uint64_t s;
+				while (queue.next(s))
+				{
+					size_t plain = static_cast<size_t>(std::min<uint64_t>(segmentBytes, plainBytes - s * segmentBytes));
+					in.seekg(static_cast<std::streamoff>(s * segmentBytes));
+					in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(plain));
+					if (static_cast<size_t>(in.gcount()) != plain)
+						throw std::runtime_error("Error reading " + input);
+					Clock::time_point cipherStart = Clock::now();
+					size_t bytes = encryptSegment(encoder, segmentSeed(key, nonce, s), data, plain, block);
+					cipherSeconds += secondsSince(cipherStart);
+					if (bytes != lengths[s])
+						throw std::runtime_error("Segment " + std::to_string(s) + " encrypted to an unexpected length");
+					out.seekp(static_cast<std::streamoff>(offsets[s]));
+					out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(bytes));
+					if (!out)
+						throw std::runtime_error("Error writing " + output);
+				}
+				out.flush();
+				if (!out)
+					throw std::runtime_error("Error writing " + output);
+				std::lock_guard<std::mutex> lock(mutex);
+				result.cipherSeconds += cipherSeconds;
+			});
+	}
+	catch (...)
+	{
+		std::remove(output.c_str());
+		throw;
+	}
+	result.seconds = secondsSince(start);
+	return result;
+}
+
+MteSegmentCrypt::Result MteSegmentCrypt::decrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key)
+{
+	Clock::time_point start = Clock::now();
+	std::ifstream probe(input.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!probe.is_open())
+		throw std::runtime_error("Unable to open " + input);
+	uint64_t fileBytes = static_cast<uint64_t>(probe.tellg());
+	probe.seekg(0);
+
+	// Read and check the header and the index.
+	const std::string invalid = input + " is not a segmented encrypted file";
+	uint8_t header[HeaderBytes];
+	probe.read(reinterpret_cast<char*>(header), HeaderBytes);
+	if (static_cast<size_t>(probe.gcount()) != HeaderBytes || std::memcmp(header, Magic, sizeof(Magic)) != 0)
+		throw std::runtime_error(invalid);
+	uint64_t nonce = getU64(header + 8);
+	uint64_t segmentBytes = getU64(header + 16);
+	uint64_t segments = getU64(header + 24);
+	uint64_t plainBytes = getU64(header + 32);
+	if (segmentBytes == 0 || segments == 0 || segments > (fileBytes - HeaderBytes) / IndexEntryBytes ||
+		segments != (plainBytes == 0 ? 1 : (plainBytes + segmentBytes - 1) / segmentBytes))
+	{
+		throw std::runtime_error(invalid);
+	}
+	std::vector<uint8_t> index(static_cast<size_t>(segments * IndexEntryBytes));
+	probe.read(reinterpret_cast<char*>(index.data()), static_cast<std::streamsize>(index.size()));
+	if (static_cast<size_t>(probe.gcount()) != index.size())
+		throw std::runtime_error(invalid);
+	probe.close();
+	std::vector<uint64_t> offsets(segments);
+	std::vector<uint64_t> lengths(segments);
+	uint64_t maxLength = 0;
+	for (uint64_t s = 0; s < segments; s++)
+	{
+		offsets[s] = getU64(&index[s * IndexEntryBytes]);
+		lengths[s] = getU64(&index[s * IndexEntryBytes + 8]);
+		if (offsets[s] > fileBytes || lengths[s] > fileBytes - offsets[s])
+			throw std::runtime_error(invalid);
+		maxLength = std::max(maxLength, lengths[s]);
+	}
+
+	size_t block;
+	{
+		MteMkeDec decoder;
+		block = blockBytes(decoder);
+	}
+	Result result;
+	result.bytesIn = fileBytes;
+	result.bytesOut = plainBytes;
+	result.segments = segments;
+	result.threads = threadsFor(segments);
+	result.cipherSeconds = 0.0;
+	try
+	{
+		{
+			std::ofstream out(output.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!out.is_open())
+				throw std::runtime_error("Unable to create " + output);
+		}
+		SegmentQueue queue(segments);
+		std::mutex mutex;
+		queue.run(result.threads, [&]
+			{
+				std::ifstream in(input.c_str(), std::ios::in | std::ios::binary);
+				std::fstream out(output.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+				if (!in.is_open() || !out.is_open())
+					throw std::runtime_error("Unable to open " + input + " and " + output);
+				MteMkeDec decoder;
+				std::vector<uint8_t> encrypted(static_cast<size_t>(maxLength));
+				std::vector<uint8_t> plain(static_cast<size_t>(maxLength) + block);
+				double cipherSeconds = 0.0;
+				uint64_t s;
+				while (queue.next(s))
+				{
+					size_t length = static_cast<size_t>(lengths[s]);
+					in.seekg(static_cast<std::streamoff>(offsets[s]));
+					in.read(reinterpret_cast<char*>(encrypted.data()), static_cast<std::streamsize>(length));
+					if (static_cast<size_t>(in.gcount()) != length)
+						throw std::runtime_error("Error reading " + input);
+					Clock::time_point cipherStart = Clock::now();
+					size_t bytes = decryptSegment(decoder, segmentSeed(key, nonce, s), encrypted.data(), length, plain, block, s);
+					cipherSeconds += secondsSince(cipherStart);
+					if (bytes != std::min<uint64_t>(segmentBytes, plainBytes - s * segmentBytes))
+						throw std::runtime_error("Segment " + std::to_string(s) + " decrypted to an unexpected length");
+					out.seekp(static_cast<std::streamoff>(s * segmentBytes));
+					out.write(reinterpret_cast<const char*>(plain.data()), static_cast<std::streamsize>(bytes));
+					if (!out)
+						throw std::runtime_error("Error writing " + output);
+				}
+				out.flush();
+				if (!out)
+					throw std::runtime_error("Error writing " + output);
+				std::lock_guard<std::mutex> lock(mutex);
+				result.cipherSeconds += cipherSeconds;
+			});
+	}
+	catch (...)
+	{
+		std::remove(output.c_str());
+		throw;
+	}
+	result.seconds = secondsSince(start);
+	return result;
+}
+
+bool MteSegmentCrypt::isSegmented(const std::string& path)
+{
+	std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+	char magic[sizeof(Magic)];
+	in.read(magic, sizeof(magic));
+	return static_cast<size_t>(in.gcount()) == sizeof(magic) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+void MteSegmentCrypt::print(std::ostream& out, const Result& result)
+{
+	double mb = 1024.0 * 1024.0;
+	double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+	out << std::fixed << std::setprecision(1)
+		<< "Read " << result.bytesIn / mb << " MB and wrote " << result.bytesOut / mb << " MB in "
+		<< std::setprecision(3) << result.seconds << " seconds: " << std::setprecision(1)
+		<< result.bytesIn / mb / seconds << " MB/s, " << result.segments << " segments on " << result.threads
+		<< " threads, cipher busy " << 100.0 * result.cipherSeconds / (seconds * result.threads) << "%" << std::endl;
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTESEGMENTCRYPT_H
+#define MTESEGMENTCRYPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class MteSegmentCrypt
+//
+// Encrypts and decrypts files on many cores with MKE. A chunk session of
+// MteMkeEnc is sequential, so the file is split into segments and each is
+// encrypted as a session of its own, with a worker thread per core taking the
+// next segment. Every segment instantiates with the key and the file nonce
+// plus its index, so no two segments share a keystream; restoring one saved
+// state for all of them would.
+//
+// The output is an indexed container: a 40 byte header (the magic
+// "MTESEGS1", the nonce, the segment size, the segment count and the plain
+// size, all little endian), then the offset and length of each encrypted
+// segment, then the segments. Each segment is padded like MteFileCrypt
+// chunks. As the offsets are known up front, the workers read and write
+// their segments in place and a segment can be decrypted on its own.
+//
+// Memory is one segment per worker. Throws an exception on I/O or MTE error,
+// removing the partial output.
+//******************************************************************************
+class MteSegmentCrypt
+{
+public:
+	struct Options
+	{
+		// The plain bytes per segment, rounded down to the cipher block size.
+		size_t segmentBytes = 4 * 1024 * 1024;
+		// The worker threads; 0 is one per core.
+		size_t threads = 0;
+	};
+
+	struct Result
+	{
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		uint64_t segments;
+		size_t threads;
+		double seconds;
+		// The time the workers spent in the cipher, added up.
+		double cipherSeconds;
+	};
+
+	explicit MteSegmentCrypt(const Options& options);
+
+	Result encrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key);
+	Result decrypt(const std::string& input, const std::string& output, const std::vector<uint8_t>& key);
+
+	// Returns true if the file is a segmented container.
+	static bool isSegmented(const std::string& path);
+
+	static void print(std::ostream& out, const Result& result);
+
+private:
+	size_t threadsFor(uint64_t segments) const;
+
+	Options myOptions;
+};
+
+#endif
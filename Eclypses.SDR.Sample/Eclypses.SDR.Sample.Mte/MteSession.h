@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTESESSION_H
+#define MTESESSION_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MteBase.h"
+#include "MteRandom.h"
+
+//
+// The seeding material of one session. Both ends of a channel instantiate
+// with the same material; in a deployment the entropy comes from a key
+// exchange such as MteKyber rather than being drawn here.
+//
+struct MteSessionSeed
+{
+	std::vector<uint8_t> entropy;
+	uint64_t nonce = 0;
+	std::string personalization;
+
+	// Draws the entropy for a new session from the OS random source.
+	static MteSessionSeed random(uint64_t nonce, const std::string& personalization)
+	{
+		MteSessionSeed seed;
+		seed.entropy.resize(MteBase::getDrbgsEntropyMinBytes(MteBase::getDefaultDrbg()));
+		if (!seed.entropy.empty() && MteRandom::getBytes(seed.entropy.data(), seed.entropy.size()) != 0)
+			throw std::runtime_error("Unable to get random bytes for the entropy");
+		seed.nonce = nonce;
+		seed.personalization = personalization;
+		return seed;
+	}
+};
+
+//
+// Instantiates an MTE object with the seed. The entropy is copied, as
+// instantiate() zeroizes it. Returns the status.
+//
+template <class T>
+mte_status instantiateSession(T& instance, const MteSessionSeed& seed)
+{
+	std::vector<uint8_t> entropy(seed.entropy);
+	instance.setEntropy(entropy.data(), entropy.size());
+	instance.setNonce(seed.nonce);
+	return instance.instantiate(seed.personalization);
+}
+
+#endif
@@ -0,0 +1,294 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTESESSIONMANAGER_H
+#define MTESESSIONMANAGER_H
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "MteInstancePool.h"
+#include "MteSession.h"
+#include "MteStateFile.h"
+
+//******************************************************************************
+// Class MteSessionManager
+//
+// Holds the encoder and decoder of many sessions, keyed by connection ID,
+// with only the recently used ones in memory. Enc and Dec are MteEnc and
+// MteDec or MteMkeEnc and MteMkeDec.
+//
+// Up to maxResident sessions keep live objects. Past that, the least
+// recently used session that is not in use is paged out: both states are
+// saved into a slot of an MteStateFile and its objects go back to an
+// MteInstancePool, buffers and all. acquire() pages a session back in with
+// restoreState(). Memory therefore follows the number of active sessions;
+// an idle session costs a slot in the file and a map entry.
+//
+// The manager is thread safe, but a session must be used by one thread at a
+// time. Errors throw an exception.
+//******************************************************************************
+template <class Enc, class Dec>
+class MteSessionManager
+{
+public:
+	struct Options
+	{
+		// The sessions kept in memory when not in use.
+		size_t maxResident = 1024;
+		// The state file, removed when the manager is destroyed.
+		std::string stateFile = "mte-sessions.state";
+		// The idle objects kept for reuse.
+		size_t spareObjects = 64;
+	};
+
+	struct Stats
+	{
+		size_t resident;
+		size_t paged;
+		uint64_t pageIns;
+		uint64_t pageOuts;
+		size_t fileBytes;
+	};
+
+private:
+	struct Session
+	{
+		typename MteInstancePool<Enc>::Lease encoder;
+		typename MteInstancePool<Dec>::Lease decoder;
+		std::list<uint64_t>::iterator lru;
+		int pins = 0;
+	};
+
+public:
+	//---------------------------------------------------
+	// A session in use. It stays in memory until this is
+	// destroyed.
+	//---------------------------------------------------
+	class Channel
+	{
+	public:
+		Channel(Channel&& other) : myManager(other.myManager), mySession(other.mySession)
+		{
+			other.myManager = nullptr;
+			other.mySession = nullptr;
+		}
+
+		~Channel()
+		{
+			if (myManager != nullptr)
+				myManager->unpin(*mySession);
+		}
+
+		Enc& encoder() { return *mySession->encoder; }
+		Dec& decoder() { return *mySession->decoder; }
+
+	private:
+		friend class MteSessionManager;
+
+		Channel(MteSessionManager* manager, Session* session) : myManager(manager), mySession(session) {}
+
+		Channel(const Channel&);
+		Channel& operator=(const Channel&);
+		Channel& operator=(Channel&&);
+
+		MteSessionManager* myManager;
+		Session* mySession;
+	};
+
+	explicit MteSessionManager(const Options& options) :
+		myOptions(options),
+		myEncPool(options.spareObjects),
+		myDecPool(options.spareObjects),
+		myFile(options.stateFile, myEncPool.stateBytes() + myDecPool.stateBytes()),
+		myPageIns(0),
+		myPageOuts(0)
+	{
+	}
+
+	// Opens a session instantiated with the seed. Throws if it is open.
+	void open(uint64_t id, const MteSessionSeed& seed)
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		if (myResident.count(id) != 0 || myPaged.count(id) != 0)
+			throw std::runtime_error("Session " + std::to_string(id) + " is already open");
+		Session session;
+		session.encoder = myEncPool.acquireNew([&seed](Enc& e) { return instantiateSession(e, seed); });
+		session.decoder = myDecPool.acquireNew([&seed](Dec& d) { return instantiateSession(d, seed); });
+		insert(id, std::move(session));
+		makeRoom();
+	}
+
+	// Returns the session, paging it in if needed. Throws if it is not open.
+	Channel acquire(uint64_t id)
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		auto it = myResident.find(id);
+		if (it == myResident.end())
+		{
+			auto paged = myPaged.find(id);
+			if (paged == myPaged.end())
+				throw std::runtime_error("Session " + std::to_string(id) + " is not open");
+			const uint8_t* slot = myFile.slot(paged->second);
+			Session session;
+			session.encoder = myEncPool.acquire(slot);
+			session.decoder = myDecPool.acquire(slot + myEncPool.stateBytes());
+			myFile.release(paged->second);
+			myPaged.erase(paged);
+			myPageIns++;
+			it = insert(id, std::move(session));
+		}
+		else
+		{
+			myLru.splice(myLru.begin(), myLru, it->second.lru);
+		}
+		Session& session = it->second;
+		session.pins++;
+		makeRoom();
+		return Channel(this, &session);
+	}
+
+	// Closes a session. It is not an error if it is not open; it is if it
+	// is in use.
+	void close(uint64_t id)
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		auto it = myResident.find(id);
+		if (it != myResident.end())
+		{
+			if (it->second.pins != 0)
+				throw std::runtime_error("Session " + std::to_string(id) + " is in use");
+			myLru.erase(it->second.lru);
+			myResident.erase(it);
+			return;
+		}
+		auto paged = myPaged.find(id);
+		if (paged != myPaged.end())
+		{
+			myFile.release(paged->second);
+			myPaged.erase(paged);
+		}
+	}
+
+	Stats stats() const
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		Stats s;
+		s.resident = myResident.size();
+		s.paged = myPaged.size();
+		s.pageIns = myPageIns;
+		s.pageOuts = myPageOuts;
+		s.fileBytes = myFile.fileBytes();
+		return s;
+	}
+
+private:
+	MteSessionManager(const MteSessionManager&);
+	MteSessionManager& operator=(const MteSessionManager&);
+
+	typedef std::unordered_map<uint64_t, Session> SessionMap;
+
+	typename SessionMap::iterator insert(uint64_t id, Session&& session)
+	{
+		auto it = myResident.emplace(id, std::move(session)).first;
+		myLru.push_front(id);
+		it->second.lru = myLru.begin();
+		return it;
+	}
+
+	//
+	// Pages out the least recently used sessions that are not in use until
+	// no more than maxResident are left.
+	//
+	void makeRoom()
+	{
+		auto lru = myLru.end();
+		while (myResident.size() > myOptions.maxResident && lru != myLru.begin())
+		{
+			--lru;
+			auto it = myResident.find(*lru);
+			if (it->second.pins != 0)
+				continue;
+			auto next = lru;
+			++next;
+			pageOut(it);
+			lru = next;
+		}
+	}
+
+	void pageOut(typename SessionMap::iterator it)
+	{
+		uint32_t slot = myFile.allocate();
+		uint8_t* bytes = myFile.slot(slot);
+		size_t encBytes = 0;
+		size_t decBytes = 0;
+		const void* encState = it->second.encoder->saveState(encBytes);
+		if (encState == nullptr || encBytes != myEncPool.stateBytes())
+		{
+			myFile.release(slot);
+			throw std::runtime_error("Error saving the encoder state");
+		}
+		memcpy(bytes, encState, encBytes);
+		const void* decState = it->second.decoder->saveState(decBytes);
+		if (decState == nullptr || decBytes != myDecPool.stateBytes())
+		{
+			myFile.release(slot);
+			throw std::runtime_error("Error saving the decoder state");
+		}
+		memcpy(bytes + encBytes, decState, decBytes);
+		myPaged.emplace(it->first, slot);
+		myLru.erase(it->second.lru);
+		myResident.erase(it);
+		myPageOuts++;
+	}
+
+	void unpin(Session& session)
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		session.pins--;
+		makeRoom();
+	}
+
+	Options myOptions;
+	MteInstancePool<Enc> myEncPool;
+	MteInstancePool<Dec> myDecPool;
+	MteStateFile myFile;
+
+	mutable std::mutex myMutex;
+	SessionMap myResident;
+	std::unordered_map<uint64_t, uint32_t> myPaged;
+	// The resident sessions, most recently used first.
+	std::list<uint64_t> myLru;
+	uint64_t myPageIns;
+	uint64_t myPageOuts;
+};
+
+#endif
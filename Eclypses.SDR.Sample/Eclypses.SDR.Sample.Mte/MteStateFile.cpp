@@ -0,0 +1,171 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MteStateFile.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+static const char Magic[8] = { 'M', 'T', 'E', 'S', 'T', 'A', 'T', '1' };
+static const size_t HeaderBytes = 64;
+
+// Each slot is rounded up to whole cache lines.
+static size_t roundUp64(size_t bytes)
+{
+	return (bytes + 63) & ~static_cast<size_t>(63);
+}
+
+MteStateFile::MteStateFile(const std::string& path, size_t slotBytes, size_t initialSlots) :
+	myPath(path), mySlotBytes(roundUp64(slotBytes == 0 ? 1 : slotBytes)), mySlotCount(0), myBytes(0), myMemory(nullptr)
+{
+#if defined(_WIN32)
+	myMapping = nullptr;
+	myFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (myFile == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Unable to create " + path);
+#else
+	myFd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (myFd < 0)
+		throw std::runtime_error("Unable to create " + path + ": " + strerror(errno));
+#endif
+	try
+	{
+		map(initialSlots == 0 ? 1 : initialSlots);
+	}
+	catch (...)
+	{
+		unmap();
+#if defined(_WIN32)
+		CloseHandle(myFile);
+#else
+		close(myFd);
+		unlink(myPath.c_str());
+#endif
+		throw;
+	}
+	memcpy(myMemory, Magic, sizeof(Magic));
+}
+
+MteStateFile::~MteStateFile()
+{
+	unmap();
+#if defined(_WIN32)
+	CloseHandle(myFile);
+#else
+	close(myFd);
+	unlink(myPath.c_str());
+#endif
+}
+
+uint32_t MteStateFile::allocate()
+{
+	if (myFree.empty())
+		map(mySlotCount * 2);
+	uint32_t slot = myFree.back();
+	myFree.pop_back();
+	return slot;
+}
+
+void MteStateFile::release(uint32_t slot)
+{
+	memset(this->slot(slot), 0, mySlotBytes);
+	myFree.push_back(slot);
+}
+
+uint8_t* MteStateFile::slot(uint32_t slot)
+{
+	return myMemory + HeaderBytes + static_cast<size_t>(slot) * mySlotBytes;
+}
+
+void MteStateFile::map(size_t slots)
+{
+	size_t bytes = HeaderBytes + slots * mySlotBytes;
+	//
+	// Map the new size before letting go of the old view, so the slots stay
+	// usable if growing fails.
+	//
+#if defined(_WIN32)
+	HANDLE mapping = CreateFileMappingA(myFile, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32), static_cast<DWORD>(bytes), nullptr);
+	if (mapping == nullptr)
+		throw std::runtime_error("Unable to map " + myPath);
+	void* memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+	if (memory == nullptr)
+	{
+		CloseHandle(mapping);
+		throw std::runtime_error("Unable to map " + myPath);
+	}
+	unmap();
+	myMapping = mapping;
+#else
+	if (ftruncate(myFd, static_cast<off_t>(bytes)) != 0)
+		throw std::runtime_error("Unable to size " + myPath + ": " + strerror(errno));
+	void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, myFd, 0);
+	if (memory == MAP_FAILED)
+		throw std::runtime_error("Unable to map " + myPath + ": " + strerror(errno));
+	unmap();
+#endif
+	myMemory = static_cast<uint8_t*>(memory);
+	myBytes = bytes;
+
+	//
+	// The new slots are free; push them highest first so the lowest is
+	// taken first.
+	//
+	for (size_t s = slots; s > mySlotCount; s--)
+		myFree.push_back(static_cast<uint32_t>(s - 1));
+	mySlotCount = slots;
+
+	uint64_t header[2] = { mySlotBytes, mySlotCount };
+	memcpy(myMemory + sizeof(Magic), header, sizeof(header));
+}
+
+void MteStateFile::unmap()
+{
+	if (myMemory == nullptr)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(myMemory);
+	CloseHandle(myMapping);
+	myMapping = nullptr;
+#else
+	munmap(myMemory, myBytes);
+#endif
+	myMemory = nullptr;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef MTESTATEFILE_H
+#define MTESTATEFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#endif
+
+//******************************************************************************
+// Class MteStateFile
+//
+// A memory mapped file of fixed size slots that saved MTE states are paged
+// out to. The file starts with a 64 byte header (magic, slot size, slot
+// count) and the slots follow it. It doubles when the slots run out.
+//
+// A paged out state costs only its slot on disk; the operating system writes
+// the mapped pages back and drops them from memory as it needs to. The file
+// is scratch space: it is created empty and removed when closed.
+//
+// Not thread safe. Throws an exception on I/O error.
+//******************************************************************************
+class MteStateFile
+{
+public:
+	MteStateFile(const std::string& path, size_t slotBytes, size_t initialSlots = 1024);
+	~MteStateFile();
+
+	// Takes a free slot, growing the file if there is none.
+	uint32_t allocate();
+
+	// Frees a slot, zeroing it.
+	void release(uint32_t slot);
+
+	// The bytes of a slot, valid until the next allocate().
+	uint8_t* slot(uint32_t slot);
+
+	size_t slotBytes() const { return mySlotBytes; }
+	size_t slotCount() const { return mySlotCount; }
+	size_t slotsInUse() const { return mySlotCount - myFree.size(); }
+	size_t fileBytes() const { return myBytes; }
+
+private:
+	MteStateFile(const MteStateFile&);
+	MteStateFile& operator=(const MteStateFile&);
+
+	// Sizes the file for the slot count and maps it.
+	void map(size_t slots);
+	void unmap();
+
+	std::string myPath;
+	size_t mySlotBytes;
+	size_t mySlotCount;
+	size_t myBytes;
+	uint8_t* myMemory;
+	// The free slots, lowest last so the file is filled from the front.
+	std::vector<uint32_t> myFree;
+#if defined(_WIN32)
+	HANDLE myFile;
+	HANDLE myMapping;
+#else
+	int myFd;
+#endif
+};
+
+#endif
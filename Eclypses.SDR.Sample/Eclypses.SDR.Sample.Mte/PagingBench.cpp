@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "PagingBench.h"
+#include "MteSessionManager.h"
+#include "MteEnc.h"
+#include "MteDec.h"
+#include "MteMkeEnc.h"
+#include "MteMkeDec.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__linux__)
+#  include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//
+// The resident set size of the process in bytes, or 0 if unknown.
+//
+static size_t residentBytes()
+{
+#if defined(__linux__)
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == nullptr)
+		return 0;
+	unsigned long pages = 0;
+	unsigned long resident = 0;
+	int n = fscanf(f, "%lu %lu", &pages, &resident);
+	fclose(f);
+	return n == 2 ? static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+	return 0;
+#endif
+}
+
+PagingBench::PagingBench(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.sessions == 0)
+		myOptions.sessions = 1;
+	if (myOptions.active == 0 || myOptions.active > myOptions.sessions)
+		myOptions.active = myOptions.sessions;
+}
+
+PagingBench::Result PagingBench::run()
+{
+	if (myOptions.type == "core")
+		return runPair<MteEnc, MteDec>();
+	if (myOptions.type == "mke")
+		return runPair<MteMkeEnc, MteMkeDec>();
+	throw std::runtime_error("Unknown session type: " + myOptions.type);
+}
+
+template <class Enc, class Dec>
+PagingBench::Result PagingBench::runPair()
+{
+	Result result = Result();
+	result.rssBefore = residentBytes();
+
+	typename MteSessionManager<Enc, Dec>::Options managerOptions;
+	managerOptions.maxResident = myOptions.maxResident;
+	managerOptions.stateFile = myOptions.stateFile;
+	MteSessionManager<Enc, Dec> manager(managerOptions);
+
+	Clock::time_point start = Clock::now();
+	for (size_t id = 0; id < myOptions.sessions; id++)
+		manager.open(id, MteSessionSeed::random(id, "PagingBench"));
+	result.openSeconds = secondsSince(start);
+	result.rssOpened = residentBytes();
+
+	std::mt19937_64 random(myOptions.seed);
+	std::uniform_real_distribution<double> coin(0.0, 1.0);
+	std::uniform_int_distribution<size_t> hotSession(0, myOptions.active - 1);
+	std::uniform_int_distribution<size_t> anySession(0, myOptions.sessions - 1);
+	std::vector<uint8_t> message(myOptions.messageBytes);
+	for (size_t i = 0; i < message.size(); i++)
+		message[i] = static_cast<uint8_t>(i);
+
+	start = Clock::now();
+	for (uint64_t op = 0; op < myOptions.operations; op++)
+	{
+		size_t id = coin(random) < myOptions.hot ? hotSession(random) : anySession(random);
+		typename MteSessionManager<Enc, Dec>::Channel channel = manager.acquire(id);
+		mte_status status;
+		size_t encodedBytes = 0;
+		const void* encoded = channel.encoder().encode(message.data(), message.size(), encodedBytes, status);
+		if (status != mte_status_success)
+			throw std::runtime_error(std::string("Error encoding (") + MteBase::getStatusName(status) + ")");
+		size_t decodedBytes = 0;
+		const void* decoded = channel.decoder().decode(encoded, encodedBytes, decodedBytes, status);
+		if (status != mte_status_success || decodedBytes != message.size() ||
+			memcmp(decoded, message.data(), decodedBytes) != 0)
+		{
+			throw std::runtime_error("Session " + std::to_string(id) + " did not decode its own message (" +
+				MteBase::getStatusName(status) + ")");
+		}
+	}
+	result.runSeconds = secondsSince(start);
+	result.operations = myOptions.operations;
+	result.rssAfter = residentBytes();
+
+	typename MteSessionManager<Enc, Dec>::Stats stats = manager.stats();
+	result.pageIns = stats.pageIns;
+	result.pageOuts = stats.pageOuts;
+	result.resident = stats.resident;
+	result.paged = stats.paged;
+	result.fileBytes = stats.fileBytes;
+	return result;
+}
+
+static std::string megabytes(size_t bytes)
+{
+	if (bytes == 0)
+		return "n/a";
+	char text[32];
+	snprintf(text, sizeof(text), "%.1f MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+	return text;
+}
+
+void PagingBench::print(std::ostream& out, const Result& r)
+{
+	out << "opened in " << r.openSeconds << " seconds" << std::endl;
+	out << r.operations << " operations in " << r.runSeconds << " seconds: "
+		<< (r.runSeconds > 0 ? static_cast<double>(r.operations) / r.runSeconds : 0.0) << " ops/s" << std::endl;
+	out << "page ins " << r.pageIns << ", page outs " << r.pageOuts << std::endl;
+	out << "sessions resident " << r.resident << ", paged " << r.paged
+		<< ", state file " << megabytes(r.fileBytes) << std::endl;
+	out << "process resident: before " << megabytes(r.rssBefore) << ", opened " << megabytes(r.rssOpened)
+		<< ", after " << megabytes(r.rssAfter) << std::endl;
+}
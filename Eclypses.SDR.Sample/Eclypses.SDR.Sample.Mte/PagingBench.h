@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef PAGINGBENCH_H
+#define PAGINGBENCH_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+//******************************************************************************
+// Class PagingBench
+//
+// Opens many sessions in an MteSessionManager and uses them with a hot set:
+// each operation takes a session, from the first --active sessions with
+// probability --hot and from all of them otherwise, and encodes a message
+// with its encoder and decodes it with its decoder. A message that does not
+// come back is an error, so paging must keep every state exact.
+//
+// Reports the rate, the page ins and outs, and the resident memory of the
+// process after opening the sessions and after the run (Linux only).
+//******************************************************************************
+class PagingBench
+{
+public:
+	struct Options
+	{
+		// "core" or "mke".
+		std::string type = "mke";
+		size_t sessions = 100000;
+		size_t maxResident = 1000;
+		size_t active = 500;
+		double hot = 0.9;
+		uint64_t operations = 200000;
+		size_t messageBytes = 256;
+		std::string stateFile = "mte-sessions.state";
+		uint64_t seed = 1;
+	};
+
+	struct Result
+	{
+		double openSeconds;
+		double runSeconds;
+		uint64_t operations;
+		uint64_t pageIns;
+		uint64_t pageOuts;
+		size_t resident;
+		size_t paged;
+		size_t fileBytes;
+		// Resident set sizes in bytes; 0 where unknown.
+		size_t rssBefore;
+		size_t rssOpened;
+		size_t rssAfter;
+	};
+
+	explicit PagingBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on MTE error.
+	Result run();
+
+	static void print(std::ostream& out, const Result& result);
+
+private:
+	template <class Enc, class Dec>
+	Result runPair();
+
+	Options myOptions;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "SegmentBench.h"
+#include "MteFileCrypt.h"
+#include "MteSegmentCrypt.h"
+#include "MteSession.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+
+//
+// Writes a file of random bytes.
+//
+static void writeRandomFile(const std::string& path, uint64_t bytes)
+{
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	std::mt19937_64 random(1);
+	std::vector<uint64_t> block(1 << 17);
+	while (bytes > 0 && out)
+	{
+		for (uint64_t& word : block)
+			word = random();
+		size_t n = static_cast<size_t>(std::min<uint64_t>(bytes, block.size() * sizeof(uint64_t)));
+		out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(n));
+		bytes -= n;
+	}
+	out.close();
+	if (!out)
+		throw std::runtime_error("Unable to write " + path);
+}
+
+//
+// Returns true if the files have the same contents.
+//
+static bool sameFile(const std::string& a, const std::string& b)
+{
+	std::ifstream fa(a.c_str(), std::ios::in | std::ios::binary);
+	std::ifstream fb(b.c_str(), std::ios::in | std::ios::binary);
+	if (!fa.is_open() || !fb.is_open())
+		return false;
+	std::vector<char> ba(1 << 20);
+	std::vector<char> bb(1 << 20);
+	for (;;)
+	{
+		fa.read(ba.data(), static_cast<std::streamsize>(ba.size()));
+		fb.read(bb.data(), static_cast<std::streamsize>(bb.size()));
+		if (fa.gcount() != fb.gcount() || std::memcmp(ba.data(), bb.data(), static_cast<size_t>(fa.gcount())) != 0)
+			return false;
+		if (fa.gcount() == 0)
+			return true;
+	}
+}
+
+SegmentBench::SegmentBench(const Options& options) :
+	myOptions(options)
+{
+}
+
+std::vector<SegmentBench::Row> SegmentBench::run()
+{
+	const std::string& plain = myOptions.file;
+	const std::string encrypted = plain + ".mke";
+	const std::string decrypted = plain + ".clear";
+	std::vector<uint8_t> key = MteSessionSeed::random(0, "SegmentBench").entropy;
+	std::vector<Row> rows;
+	try
+	{
+		writeRandomFile(plain, myOptions.fileBytes);
+
+		MteFileCrypt::Options streamOptions;
+		MteFileCrypt stream(streamOptions);
+		Row row;
+		row.mode = "stream";
+		row.threads = 1;
+		row.bytes = myOptions.fileBytes;
+		row.encryptSeconds = stream.encrypt(plain, encrypted, key).seconds;
+		row.decryptSeconds = stream.decrypt(encrypted, decrypted, key).seconds;
+		if (!sameFile(plain, decrypted))
+			throw std::runtime_error("The stream did not decrypt to the original");
+		rows.push_back(row);
+
+		for (size_t threads : myOptions.threads)
+		{
+			MteSegmentCrypt::Options segmentOptions;
+			segmentOptions.segmentBytes = myOptions.segmentBytes;
+			segmentOptions.threads = threads;
+			MteSegmentCrypt segmented(segmentOptions);
+			row.mode = "segments";
+			row.threads = threads;
+			row.encryptSeconds = segmented.encrypt(plain, encrypted, key).seconds;
+			row.decryptSeconds = segmented.decrypt(encrypted, decrypted, key).seconds;
+			if (!sameFile(plain, decrypted))
+				throw std::runtime_error("The segments did not decrypt to the original with " + std::to_string(threads) + " threads");
+			rows.push_back(row);
+		}
+	}
+	catch (...)
+	{
+		std::remove(plain.c_str());
+		std::remove(encrypted.c_str());
+		std::remove(decrypted.c_str());
+		throw;
+	}
+	std::remove(plain.c_str());
+	std::remove(encrypted.c_str());
+	std::remove(decrypted.c_str());
+	return rows;
+}
+
+void SegmentBench::print(std::ostream& out, const std::vector<Row>& rows)
+{
+	double mb = 1024.0 * 1024.0;
+	out << std::left << std::setw(10) << "mode" << std::right << std::setw(8) << "threads"
+		<< std::setw(16) << "encrypt MB/s" << std::setw(16) << "decrypt MB/s"
+		<< std::setw(18) << "encrypt speedup" << std::setw(18) << "decrypt speedup" << std::endl;
+	if (rows.empty())
+		return;
+	// The speedups are against the single session.
+	const Row& base = rows.front();
+	for (const Row& row : rows)
+	{
+		out << std::left << std::setw(10) << row.mode << std::right << std::setw(8) << row.threads
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(16) << row.bytes / mb / row.encryptSeconds
+			<< std::setw(16) << row.bytes / mb / row.decryptSeconds
+			<< std::setprecision(2)
+			<< std::setw(17) << base.encryptSeconds / row.encryptSeconds << "x"
+			<< std::setw(17) << base.decryptSeconds / row.decryptSeconds << "x" << std::endl;
+	}
+}
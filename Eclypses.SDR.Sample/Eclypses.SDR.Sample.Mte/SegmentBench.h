@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SEGMENTBENCH_H
+#define SEGMENTBENCH_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class SegmentBench
+//
+// Measures how MteSegmentCrypt scales with threads. Writes a file of random
+// data, encrypts and decrypts it with MteFileCrypt as the single session
+// baseline and then with MteSegmentCrypt at each thread count, checking that
+// every decrypted file matches. The files are removed afterwards.
+//
+// The file is read back from the page cache on the later runs, so on a fast
+// disk the numbers show the cipher rather than the disk.
+//******************************************************************************
+class SegmentBench
+{
+public:
+	struct Options
+	{
+		uint64_t fileBytes = 256ULL * 1024 * 1024;
+		size_t segmentBytes = 4 * 1024 * 1024;
+		std::vector<size_t> threads = { 1, 2, 4, 8 };
+		// The name of the test file; the encrypted and decrypted files add
+		// ".mke" and ".clear".
+		std::string file = "mte-scaling.bin";
+	};
+
+	struct Row
+	{
+		// "stream" for MteFileCrypt, "segments" for MteSegmentCrypt.
+		std::string mode;
+		size_t threads;
+		uint64_t bytes;
+		double encryptSeconds;
+		double decryptSeconds;
+	};
+
+	explicit SegmentBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on MTE or I/O error or if a
+	// file does not decrypt to the original.
+	std::vector<Row> run();
+
+	static void print(std::ostream& out, const std::vector<Row>& rows);
+
+private:
+	Options myOptions;
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "SessionBench.h"
+#include "MteSession.h"
+#include "MteInstancePool.h"
+#include "MteEnc.h"
+#include "MteDec.h"
+#include "MteMkeEnc.h"
+#include "MteMkeDec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* Personalization = "SessionBench";
+
+//
+// Throws if the status is an error.
+//
+static void check(mte_status status, const char* what)
+{
+	if (status != mte_status_success)
+	{
+		throw std::runtime_error(std::string(what) + " (" + MteBase::getStatusName(status) + "): " +
+			MteBase::getStatusDescription(status));
+	}
+}
+
+//
+// Runs the setup of "sessions" sessions "repetitions" times and returns the
+// median nanoseconds per session. Prepare is run, untimed, before each
+// repetition.
+//
+template <typename Prepare, typename Setup>
+static double timeSessions(size_t sessions, size_t repetitions, Prepare prepare, Setup setup)
+{
+	std::vector<double> samples;
+	for (size_t rep = 0; rep < std::max<size_t>(1, repetitions); rep++)
+	{
+		prepare();
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < sessions; i++)
+			setup(i);
+		double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+		samples.push_back(ns / static_cast<double>(sessions));
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+SessionBench::SessionBench(const Options& options) :
+	myOptions(options)
+{
+	if (myOptions.sessions == 0)
+		myOptions.sessions = 1;
+}
+
+std::vector<SessionBench::Result> SessionBench::run()
+{
+	if (myOptions.type == "core")
+		return runPair<MteEnc, MteDec>();
+	if (myOptions.type == "mke")
+		return runPair<MteMkeEnc, MteMkeDec>();
+	throw std::runtime_error("Unknown session type: " + myOptions.type);
+}
+
+template <class Enc, class Dec>
+std::vector<SessionBench::Result> SessionBench::runPair()
+{
+	MteInstancePool<Enc> encPool(myOptions.poolSize);
+	MteInstancePool<Dec> decPool(myOptions.poolSize);
+	encPool.warm(myOptions.poolSize);
+	decPool.warm(myOptions.poolSize);
+
+	//
+	// A pooled decoder restored from a saved state must decode what an
+	// encoder instantiated with the same seed encodes.
+	//
+	{
+		MteSessionSeed seed = MteSessionSeed::random(1, Personalization);
+		Enc encoder;
+		check(instantiateSession(encoder, seed), "Error instantiating the encoder");
+		Dec decoder;
+		check(instantiateSession(decoder, seed), "Error instantiating the decoder");
+		typename MteInstancePool<Dec>::State state = decPool.save(decoder);
+		typename MteInstancePool<Dec>::Lease pooled = decPool.acquire(state);
+		decPool.recycle(std::move(state));
+
+		static const char message[] = "MteInstancePool check";
+		mte_status status;
+		size_t encodedBytes = 0;
+		const void* encoded = encoder.encode(message, sizeof(message), encodedBytes, status);
+		check(status, "Error encoding");
+		size_t decodedBytes = 0;
+		const void* decoded = pooled->decode(encoded, encodedBytes, decodedBytes, status);
+		check(status, "Error decoding with a pooled decoder");
+		if (decodedBytes != sizeof(message) || memcmp(decoded, message, sizeof(message)) != 0)
+			throw std::runtime_error("A pooled decoder did not decode the message");
+	}
+
+	size_t sessions = myOptions.sessions;
+	std::vector<Result> results;
+	auto addResult = [&results](const char* method, double ns)
+	{
+		Result r;
+		r.method = method;
+		r.nsPerSession = ns;
+		r.sessionsPerSec = ns > 0 ? 1e9 / ns : 0.0;
+		results.push_back(r);
+	};
+
+	addResult("instantiate", timeSessions(sessions, myOptions.repetitions, [] {}, [](size_t i)
+		{
+			MteSessionSeed seed = MteSessionSeed::random(i, Personalization);
+			std::unique_ptr<Enc> encoder(new Enc());
+			check(instantiateSession(*encoder, seed), "Error instantiating the encoder");
+			std::unique_ptr<Dec> decoder(new Dec());
+			check(instantiateSession(*decoder, seed), "Error instantiating the decoder");
+		}));
+
+	//
+	// The saved states of sessions to resume, made once.
+	//
+	std::vector<typename MteInstancePool<Enc>::State> encStates;
+	std::vector<typename MteInstancePool<Dec>::State> decStates;
+	for (size_t i = 0; i < sessions; i++)
+	{
+		MteSessionSeed seed = MteSessionSeed::random(i, Personalization);
+		Enc encoder;
+		check(instantiateSession(encoder, seed), "Error instantiating the encoder");
+		encStates.push_back(encPool.save(encoder));
+		Dec decoder;
+		check(instantiateSession(decoder, seed), "Error instantiating the decoder");
+		decStates.push_back(decPool.save(decoder));
+	}
+	addResult("restore", timeSessions(sessions, myOptions.repetitions, [] {}, [&](size_t i)
+		{
+			typename MteInstancePool<Enc>::Lease encoder = encPool.acquire(encStates[i]);
+			typename MteInstancePool<Dec>::Lease decoder = decPool.acquire(decStates[i]);
+		}));
+
+	//
+	// Both ends of each session are prepared from the same seed. The pools
+	// hand out their prepared states in the same order, so they pair up.
+	//
+	std::vector<MteSessionSeed> seeds;
+	size_t nextEnc = 0;
+	size_t nextDec = 0;
+	auto encInstantiator = [&](Enc& e) { return instantiateSession(e, seeds[nextEnc++ % seeds.size()]); };
+	auto decInstantiator = [&](Dec& d) { return instantiateSession(d, seeds[nextDec++ % seeds.size()]); };
+	addResult("prepared", timeSessions(sessions, myOptions.repetitions, [&]
+		{
+			seeds.clear();
+			for (size_t i = 0; i < sessions; i++)
+				seeds.push_back(MteSessionSeed::random(i, Personalization));
+			nextEnc = nextDec = 0;
+			encPool.prepare(sessions, encInstantiator);
+			decPool.prepare(sessions, decInstantiator);
+		}, [&](size_t)
+		{
+			typename MteInstancePool<Enc>::Lease encoder = encPool.acquirePrepared(encInstantiator);
+			typename MteInstancePool<Dec>::Lease decoder = decPool.acquirePrepared(decInstantiator);
+		}));
+	return results;
+}
+
+void SessionBench::print(std::ostream& out, const std::vector<Result>& results)
+{
+	double baseline = results.empty() ? 0.0 : results.front().nsPerSession;
+	out << std::left << std::setw(14) << "method" << std::right
+		<< std::setw(14) << "sessions/s" << std::setw(14) << "us/session" << std::setw(10) << "speedup" << std::endl;
+	for (const Result& r : results)
+	{
+		out << std::left << std::setw(14) << r.method << std::right << std::fixed
+			<< std::setw(14) << std::setprecision(0) << r.sessionsPerSec
+			<< std::setw(14) << std::setprecision(2) << r.nsPerSession / 1000.0
+			<< std::setw(9) << std::setprecision(1) << (r.nsPerSession > 0 ? baseline / r.nsPerSession : 0.0) << "x" << std::endl;
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+	}
+}
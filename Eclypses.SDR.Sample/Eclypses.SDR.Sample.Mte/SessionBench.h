@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SESSIONBENCH_H
+#define SESSIONBENCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class SessionBench
+//
+// Measures the cost of setting up a session: an encoder and a decoder, of
+// the core MTE or of MKE, ready to use. Three ways are timed:
+//   instantiate  -- construct both and instantiate them with fresh entropy,
+//                   as a session without a pool does.
+//   restore      -- lease both from an MteInstancePool, restoring saved
+//                   states, as a resumed session does.
+//   prepared     -- lease both from an MteInstancePool restoring states it
+//                   instantiated ahead of time, as a new session does when
+//                   the pool is kept topped up off the setup path.
+// Each session is torn down (or its objects returned) before the next.
+// Before timing, a message encoded by an instantiated encoder is decoded by
+// a pooled decoder to check that restoring gives a working object.
+//******************************************************************************
+class SessionBench
+{
+public:
+	struct Options
+	{
+		// "core" or "mke".
+		std::string type = "core";
+		size_t sessions = 2000;
+		size_t repetitions = 5;
+		size_t poolSize = 64;
+	};
+
+	struct Result
+	{
+		std::string method;
+		double nsPerSession;
+		double sessionsPerSec;
+	};
+
+	explicit SessionBench(const Options& options);
+
+	// Runs the benchmark. Throws an exception on MTE error.
+	std::vector<Result> run();
+
+	static void print(std::ostream& out, const std::vector<Result>& results);
+
+private:
+	template <class Enc, class Dec>
+	std::vector<Result> runPair();
+
+	Options myOptions;
+};
+
+#endif
@@ -0,0 +1,314 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include "ChromeTrace.h"
+#include "MteBase.h"
+#include "MteBase64.h"
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "CsvConceal.h"
+
+// The bytes read from the file at a time.
+static const size_t ReadChunkBytes = 4 * 1024 * 1024;
+
+//
+// A parsed row: its fields are fields[firstField] onwards, and the bytes
+// from lineEnd to next are its line break.
+//
+struct CsvRow
+{
+	size_t firstField;
+	size_t fieldCount;
+	size_t lineEnd;
+	size_t next;
+};
+
+//
+// Parses the row starting at "pos", appending its field spans. Returns false
+// if the row is not complete in the buffer yet (the spans are then removed).
+//
+static bool parseRow(const std::string& buffer, size_t pos, bool eof, char delimiter,
+	std::vector<std::pair<size_t, size_t> >& fields, CsvRow& row)
+{
+	size_t n = buffer.size();
+	size_t i = pos;
+	size_t fieldStart = pos;
+	bool inQuotes = false;
+	row.firstField = fields.size();
+	while (i < n)
+	{
+		char c = buffer[i];
+		if (inQuotes)
+		{
+			if (c == '"')
+			{
+				if (i + 1 >= n && !eof)
+					break;
+				if (i + 1 < n && buffer[i + 1] == '"')
+				{
+					i += 2;
+					continue;
+				}
+				inQuotes = false;
+			}
+			i++;
+			continue;
+		}
+		if (c == '"' && i == fieldStart)
+			inQuotes = true;
+		else if (c == delimiter)
+		{
+			fields.push_back(std::make_pair(fieldStart, i));
+			fieldStart = i + 1;
+		}
+		else if (c == '\n')
+		{
+			size_t fieldEnd = i > fieldStart && buffer[i - 1] == '\r' ? i - 1 : i;
+			fields.push_back(std::make_pair(fieldStart, fieldEnd));
+			row.fieldCount = fields.size() - row.firstField;
+			row.lineEnd = fieldEnd;
+			row.next = i + 1;
+			return true;
+		}
+		i++;
+	}
+	if (eof && i == n && n > pos)
+	{
+		//
+		// The last row of a file without a final line break.
+		//
+		size_t fieldEnd = n > fieldStart && buffer[n - 1] == '\r' ? n - 1 : n;
+		fields.push_back(std::make_pair(fieldStart, fieldEnd));
+		row.fieldCount = fields.size() - row.firstField;
+		row.lineEnd = fieldEnd;
+		row.next = n;
+		return true;
+	}
+	fields.resize(row.firstField);
+	return false;
+}
+
+//
+// Appends a field's value to a column, removing the quotes of a quoted field.
+//
+static void appendField(const std::string& buffer, std::pair<size_t, size_t> span, MteSdrColumn& column)
+{
+	const char* begin = buffer.data() + span.first;
+	const char* end = buffer.data() + span.second;
+	if (end - begin >= 2 && *begin == '"' && *(end - 1) == '"')
+	{
+		for (const char* p = begin + 1; p < end - 1; p++)
+		{
+			column.data.push_back(static_cast<uint8_t>(*p));
+			if (*p == '"' && p + 1 < end - 1 && *(p + 1) == '"')
+				p++;
+		}
+		column.offsets.push_back(column.data.size());
+	}
+	else
+		column.append(reinterpret_cast<const uint8_t*>(begin), static_cast<size_t>(end - begin));
+}
+
+CsvConcealer::CsvConcealer(const Options& options) : myOptions(options)
+{
+	if (myOptions.output.empty())
+		myOptions.output = myOptions.input + ".sdr.csv";
+	if (myOptions.threads == 0)
+		myOptions.threads = std::max(1u, std::thread::hardware_concurrency());
+	if (myOptions.batchRows == 0)
+		myOptions.batchRows = 1;
+	if (myOptions.columns.empty())
+		throw std::runtime_error("No columns were chosen to conceal.");
+}
+
+CsvConcealer::Stats CsvConcealer::run()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Stats stats = Stats();
+
+	std::ifstream in(myOptions.input.c_str(), std::ios::in | std::ios::binary);
+	if (!in.is_open())
+		throw std::runtime_error("Unable to open " + myOptions.input);
+	std::ofstream out(myOptions.output.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		throw std::runtime_error("Unable to create " + myOptions.output);
+
+	MteSdrParallel sdr((mte_sdr_random)MteRandom::getBytes, myOptions.security,
+		myOptions.threads, myOptions.rowGroupRows);
+
+	//
+	// The slot of each column in the clear and concealed columns, or -1.
+	//
+	size_t maxColumn = *std::max_element(myOptions.columns.begin(), myOptions.columns.end());
+	std::vector<int> slots(maxColumn + 1, -1);
+	for (size_t i = 0; i < myOptions.columns.size(); i++)
+		slots[myOptions.columns[i]] = static_cast<int>(i);
+	std::vector<MteSdrColumn> clear(myOptions.columns.size());
+	std::vector<MteSdrColumn> concealed(myOptions.columns.size());
+
+	std::string buffer;
+	std::string output;
+	std::vector<std::pair<size_t, size_t> > fields;
+	std::vector<CsvRow> rows;
+	size_t pos = 0;
+	bool eof = false;
+	bool header = myOptions.header;
+	while (!eof || pos < buffer.size())
+	{
+		//
+		// Parse as many whole rows as the buffer holds, up to a batch.
+		//
+		CsvRow row;
+		while (rows.size() < myOptions.batchRows &&
+			parseRow(buffer, pos, eof, myOptions.delimiter, fields, row))
+		{
+			pos = row.next;
+			if (header)
+			{
+				size_t rowStart = fields[row.firstField].first;
+				output.append(buffer, rowStart, row.next - rowStart);
+				fields.resize(row.firstField);
+				header = false;
+				continue;
+			}
+			rows.push_back(row);
+		}
+		if (rows.size() < myOptions.batchRows && !eof)
+		{
+			//
+			// Keep the unparsed tail and read more. Row spans refer to the
+			// buffer, so only drop what no pending row uses.
+			//
+			size_t keep = rows.empty() ? pos : fields[rows.front().firstField].first;
+			buffer.erase(0, keep);
+			for (auto& f : fields)
+			{
+				f.first -= keep;
+				f.second -= keep;
+			}
+			for (auto& r : rows)
+			{
+				r.lineEnd -= keep;
+				r.next -= keep;
+			}
+			pos -= keep;
+			ChromeTrace::Span span("read", "io");
+			size_t at = buffer.size();
+			buffer.resize(at + ReadChunkBytes);
+			in.read(&buffer[at], ReadChunkBytes);
+			size_t got = static_cast<size_t>(in.gcount());
+			span.setBytes(static_cast<int64_t>(got));
+			buffer.resize(at + got);
+			stats.bytesIn += got;
+			eof = got == 0 || in.eof();
+			continue;
+		}
+		if (rows.empty())
+			break;
+
+		//
+		// Gather the chosen fields of the batch into columns and conceal
+		// each column in one call.
+		//
+		for (auto& column : clear)
+			column.clear();
+		for (const CsvRow& r : rows)
+		{
+			for (size_t i = 0; i < myOptions.columns.size(); i++)
+			{
+				size_t column = myOptions.columns[i];
+				if (column < r.fieldCount)
+					appendField(buffer, fields[r.firstField + column], clear[i]);
+				else
+					clear[i].offsets.push_back(clear[i].data.size());
+			}
+		}
+		for (size_t i = 0; i < clear.size(); i++)
+		{
+			ChromeTrace::Span span("ConcealColumn", "sdr", static_cast<int64_t>(rows.size()));
+			concealed[i].clear();
+			sdr.ConcealColumn(clear[i], concealed[i]);
+		}
+
+		//
+		// Write the rows back with the chosen fields replaced.
+		//
+		for (size_t r = 0; r < rows.size(); r++)
+		{
+			const CsvRow& row = rows[r];
+			for (size_t f = 0; f < row.fieldCount; f++)
+			{
+				if (f != 0)
+					output.push_back(myOptions.delimiter);
+				int slot = f <= maxColumn ? slots[f] : -1;
+				if (slot >= 0)
+				{
+					size_t length;
+					const uint8_t* value = concealed[slot].value(r, length);
+					MteBase64::append(value, length, output);
+					stats.cells++;
+				}
+				else
+				{
+					const std::pair<size_t, size_t>& span = fields[row.firstField + f];
+					output.append(buffer, span.first, span.second - span.first);
+				}
+			}
+			output.append(buffer, row.lineEnd, row.next - row.lineEnd);
+		}
+		stats.rows += rows.size();
+		{
+			ChromeTrace::Span span("write", "io", static_cast<int64_t>(output.size()));
+			out.write(output.data(), static_cast<std::streamsize>(output.size()));
+			if (out.bad())
+				throw std::runtime_error("Unable to write " + myOptions.output);
+		}
+		stats.bytesOut += output.size();
+		output.clear();
+		rows.clear();
+		fields.clear();
+	}
+	if (!output.empty())
+	{
+		out.write(output.data(), static_cast<std::streamsize>(output.size()));
+		if (out.bad())
+			throw std::runtime_error("Unable to write " + myOptions.output);
+		stats.bytesOut += output.size();
+	}
+	//
+	// Closing flushes what the stream still buffers, so it can fail too.
+	//
+	out.close();
+	if (out.fail())
+		throw std::runtime_error("Unable to write " + myOptions.output);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef CSVCONCEAL_H
+#define CSVCONCEAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class CsvConcealer
+//
+// Streams a CSV file and conceals only the chosen columns, leaving every
+// other field exactly as it was. The rows are read in batches; the chosen
+// fields of a batch are gathered into one column each and concealed with a
+// single MteSdrParallel call, which splits the rows into row groups across
+// threads. Each concealed value is written base64 encoded.
+//
+// Fields may be quoted as in RFC 4180, including delimiters, doubled quotes
+// and line breaks inside quotes; a quoted field is unquoted before it is
+// concealed. Rows without a chosen column are written unchanged.
+//
+// To use, fill in the Options, construct and call run().
+//******************************************************************************
+class CsvConcealer
+{
+public:
+	struct Options
+	{
+		std::string input;
+		// The output file; blank for the input name with ".sdr.csv" appended.
+		std::string output;
+		// The zero-based indexes of the columns to conceal.
+		std::vector<size_t> columns;
+		// The SDR security string; must match the one used to reveal.
+		std::string security = "SecurityString";
+		char delimiter = ',';
+		// Pass the first row through unchanged.
+		bool header = false;
+		// Number of conceal threads; 0 for one per hardware thread.
+		size_t threads = 0;
+		// Rows read and concealed together.
+		size_t batchRows = 65536;
+		// Rows per row group within a batch.
+		size_t rowGroupRows = 4096;
+	};
+
+	struct Stats
+	{
+		uint64_t rows;
+		uint64_t cells;
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		double seconds;
+	};
+
+	explicit CsvConcealer(const Options& options);
+
+	//---------------------------------------------------------
+	// Conceals the file. Throws an exception on I/O or MTE error.
+	//---------------------------------------------------------
+	Stats run();
+
+private:
+	Options myOptions;
+};
+
+#endif // !CSVCONCEAL_H
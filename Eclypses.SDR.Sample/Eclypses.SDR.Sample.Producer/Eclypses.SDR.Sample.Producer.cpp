@@ -28,11 +28,15 @@
 #include <string>
 #include <cstring>
 #include <algorithm>
+#include <vector>
 
 #include "MteBase.h"
+#include "MteBase64.h"
 #include "MteSdr.h"
 #include "Producer.h"
 #include "MteSdrDisconnected.h"
+#include "CsvConceal.h"
+#include "ChromeTrace.h"
 
 #if defined(_MSC_VER)
 #  pragma warning(disable:4996)
@@ -53,7 +57,43 @@ std::string getItemFromSettings(std::string key) {
 	return "";
 }
 
-int main()
+//
+// Prints the command line usage.
+//
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Producer" << std::endl;
+	std::cout << "      Prompts for a file and conceals it to '<file>.sdr'." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Producer --base64" << std::endl;
+	std::cout << "      The same, writing the concealed file as Base64 text to '<file>.sdr.b64'." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Producer --csv <file> --columns <n,n,...> [--out <file>] [--header]" << std::endl;
+	std::cout << "                               [--delimiter c] [--threads N] [--batch rows] [--row-group rows]" << std::endl;
+	std::cout << "      Conceals the chosen (zero-based) columns of a CSV file, writing each concealed value base64 encoded." << std::endl;
+	std::cout << "  Add --trace <file.json> to either to record a timeline for chrome://tracing or Perfetto." << std::endl;
+	std::cout << "  Add --capture <file> to either to record the SDR operations for replay by the LoadGen." << std::endl;
+}
+
+//
+// Parses a comma separated list of column indexes.
+//
+static std::vector<size_t> parseColumns(const std::string& list)
+{
+	std::vector<size_t> columns;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		if (comma > start)
+			columns.push_back(std::strtoul(list.substr(start, comma - start).c_str(), nullptr, 10));
+		start = comma + 1;
+	}
+	return columns;
+}
+
+int main(int argc, char* argv[])
 {
 	std::cout << "---------------------------" << std::endl;
 	std::cout << "Eclypses MteSdr Demo Producer" << std::endl;
@@ -74,17 +114,114 @@ int main()
 	}
 	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
 	std::cout << "---------------------------" << std::endl;
+
+	//
+	// --trace and --capture may be given in any mode; the other arguments
+	// choose the mode.
+	//
+	std::vector<std::string> args;
+	bool base64 = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--base64")
+		{
+			base64 = true;
+		}
+		else if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+		{
+			ChromeTrace::start(argv[++i]);
+			ChromeTrace::setThreadName("main");
+			std::cout << "Tracing to " << argv[i] << std::endl;
+		}
+		else if (std::string(argv[i]) == "--capture" && i + 1 < argc)
+		{
+			try
+			{
+				MteSdr::startCapture(argv[++i]);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return 1;
+			}
+			std::cout << "Capturing SDR operations to " << argv[i] << std::endl;
+		}
+		else
+		{
+			args.push_back(argv[i]);
+		}
+	}
+
+	if (!args.empty())
+	{
+		CsvConcealer::Options options;
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			const std::string& arg = args[i];
+			bool hasValue = i + 1 < args.size();
+			if (arg == "--csv" && hasValue)
+				options.input = args[++i];
+			else if (arg == "--columns" && hasValue)
+				options.columns = parseColumns(args[++i]);
+			else if (arg == "--out" && hasValue)
+				options.output = args[++i];
+			else if (arg == "--header")
+				options.header = true;
+			else if (arg == "--delimiter" && hasValue)
+				options.delimiter = args[++i][0];
+			else if (arg == "--threads" && hasValue)
+				options.threads = std::strtoul(args[++i].c_str(), nullptr, 10);
+			else if (arg == "--batch" && hasValue)
+				options.batchRows = std::strtoul(args[++i].c_str(), nullptr, 10);
+			else if (arg == "--row-group" && hasValue)
+				options.rowGroupRows = std::strtoul(args[++i].c_str(), nullptr, 10);
+			else
+			{
+				usage();
+				return 1;
+			}
+		}
+		if (options.input.empty() || options.columns.empty())
+		{
+			usage();
+			return 1;
+		}
+		try
+		{
+			CsvConcealer concealer(options);
+			CsvConcealer::Stats stats = concealer.run();
+			double rate = stats.seconds > 0 ? static_cast<double>(stats.rows) / stats.seconds : 0.0;
+			double mbPerSec = stats.seconds > 0 ? static_cast<double>(stats.bytesIn) / (1024.0 * 1024.0) / stats.seconds : 0.0;
+			std::cout << "Concealed " << stats.cells << " cells in " << stats.rows << " rows in "
+				<< stats.seconds << " seconds: " << rate << " rows/sec ("
+				<< mbPerSec << " MB/s read)" << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	//
 	// Get a file name to protect.
 	//
-	std::cout << "Enter a file name that you wish to protect.  Once it is protected, it will be saved in the same folder with an '.sdr' extension." << std::endl;
+	const char* extension = base64 ? ".sdr.b64" : ".sdr";
+	std::cout << "Enter a file name that you wish to protect.  Once it is protected, it will be saved in the same folder with an '" << extension << "' extension." << std::endl;
 	std::string filename;
 	std::getline(std::cin, filename);
 	//
 	// Read the file into memory
 	//
 	size_t fileSize;
-	const uint8_t* clearData = readFile(filename, fileSize);
+	std::cout << "Reading original image file - " << filename << std::endl;
+	const uint8_t* clearData;
+	{
+		ChromeTrace::Span span("readFile", "io");
+		clearData = readFile(filename, fileSize);
+		span.setBytes(static_cast<int64_t>(fileSize));
+	}
 	std::cout << "Image file succesfully read - " << fileSize << " bytes" << std::endl;
 	//
 	// Initialize the Eclypses SDR with a security string that matches both the Concealer and the Revealer;
@@ -94,55 +231,30 @@ int main()
 	//
 	// Conceal the data using the Eclypses MTE
 	//
-	size_t concealedLen;
-	const uint8_t* concealed = sdr.Conceal(clearData, fileSize, concealedLen);
-	//
-	// Write the concealed file for retrieval later
-	//
-	std::string concealedFileName = filename + ".sdr";
-	writeFile(concealedFileName, concealed, concealedLen);
-	std::cout << "Protected file (" << concealedFileName << ") successfully written - " << concealedLen << " bytes" << std::endl;
-}
-
-const uint8_t* readFile(const std::string& filePath, size_t& valueBytes) {
-	std::cout << "Reading original image file - " << filePath << std::endl;
-	const uint8_t* value = nullptr;
-	std::ifstream fs(filePath.c_str(), std::ios::in | std::ios::binary);
-	if (!fs.is_open())
+	MteBufferPool::Lease concealed;
 	{
-		value = nullptr;
-		valueBytes = 0;
-		return nullptr;
+		ChromeTrace::Span span("Conceal", "sdr", static_cast<int64_t>(fileSize));
+		concealed = sdr.Conceal(clearData, fileSize);
 	}
-	fs.seekg(0, std::ios::end);
-	valueBytes = fs.tellg();
-	value = new uint8_t[valueBytes];
-	if (value == nullptr)
+	size_t concealedLen = concealed.size();
+	//
+	// Text-safe output is the concealed data Base64 encoded, for JSON or HTTP.
+	//
+	std::string text;
+	if (base64)
 	{
-		valueBytes = 0;
-		fs.close();
-		return nullptr;
+		ChromeTrace::Span span("base64", "sdr", static_cast<int64_t>(concealedLen));
+		MteBase64::append(concealed.data(), concealedLen, text);
+		concealedLen = text.size();
 	}
-	fs.seekg(0, std::ios::beg);
-	fs.read((char*)(value), valueBytes);
-	if (fs.bad() || (size_t)fs.gcount() != valueBytes)
+	//
+	// Write the concealed file for retrieval later
+	//
+	std::string concealedFileName = filename + extension;
 	{
-		value = nullptr;
-		valueBytes = 0;
-		fs.close();
-		return nullptr;
+		ChromeTrace::Span span("writeFile", "io", static_cast<int64_t>(concealedLen));
+		writeFile(concealedFileName, base64 ? reinterpret_cast<const uint8_t*>(text.data()) : concealed.data(), concealedLen);
 	}
-	fs.close();
-	return value;
+	std::cout << "Protected file (" << concealedFileName << ") successfully written - " << concealedLen << " bytes" << std::endl;
+	delete[] clearData;
 }
-
-void writeFile(const std::string fileName, const uint8_t* data, size_t dataLen) {
-	std::ofstream fs(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
-	if (!fs.is_open())
-		return;
-	fs.write((char*)data, dataLen);
-	if (fs.bad())
-		return;
-	fs.close();
-	return;
-}
\ No newline at end of file
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "MteSdrAlloc.h"
+#include "Producer.h"
+
+const uint8_t* readFile(const std::string& filePath, size_t& valueBytes) {
+	const uint8_t* value = nullptr;
+	std::ifstream fs(filePath.c_str(), std::ios::in | std::ios::binary);
+	if (!fs.is_open())
+	{
+		value = nullptr;
+		valueBytes = 0;
+		return nullptr;
+	}
+	fs.seekg(0, std::ios::end);
+	valueBytes = fs.tellg();
+	uint8_t* buffer = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::FileRead, valueBytes);
+	value = buffer;
+	if (value == nullptr)
+	{
+		valueBytes = 0;
+		fs.close();
+		return nullptr;
+	}
+	fs.seekg(0, std::ios::beg);
+	fs.read((char*)(buffer), valueBytes);
+	if (fs.bad() || (size_t)fs.gcount() != valueBytes)
+	{
+		MteSdrAlloc::release(MteSdrAlloc::FileRead, buffer, valueBytes);
+		value = nullptr;
+		valueBytes = 0;
+		fs.close();
+		return nullptr;
+	}
+	fs.close();
+	// The caller deletes it.
+	MteSdrAlloc::handOut(MteSdrAlloc::FileRead, valueBytes);
+	return value;
+}
+
+void writeFile(const std::string fileName, const uint8_t* data, size_t dataLen) {
+	std::ofstream fs(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fs.is_open())
+		return;
+	fs.write((char*)data, dataLen);
+	if (fs.bad())
+		return;
+	fs.close();
+	return;
+}
\ No newline at end of file
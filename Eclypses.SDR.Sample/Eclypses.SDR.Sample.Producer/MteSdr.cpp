@@ -24,9 +24,11 @@
  * SOFTWARE.
  *******************************************************************************/
 #include  "MteSdr.h"
+#include "ChromeTrace.h"
 
 MteSdr::MteSdr(mte_sdr_random rnd_cb) :
-	myEncoder(NULL), myDecoder(NULL),
+	myPassword(NULL), myPasswordBytes(0), myMemRecordBytes(0),
+	myEncoder(NULL), myEncoderBytes(0), myDecoder(NULL), myDecoderBytes(0),
 	myEncBuff(NULL), myEncBuffBytes(0),
 	myDecBuff(NULL), myDecBuffBytes(0)
 {
@@ -35,11 +37,13 @@ MteSdr::MteSdr(mte_sdr_random rnd_cb) :
 
 MteSdr::~MteSdr()
 {
-	// Delete the buffers.
-	delete[] myEncoder;
-	delete[] myDecoder;
-	delete[] myEncBuff;
-	delete[] myDecBuff;
+	// Delete the buffers and the memory records.
+	clearMemRecords();
+	MteSdrAlloc::release(MteSdrAlloc::Password, static_cast<uint8_t*>(myPassword), myPasswordBytes);
+	MteSdrAlloc::release(MteSdrAlloc::EncoderState, myEncoder, myEncoderBytes);
+	MteSdrAlloc::release(MteSdrAlloc::DecoderState, myDecoder, myDecoderBytes);
+	MteSdrAlloc::release(MteSdrAlloc::EncryptBuffer, myEncBuff, myEncBuffBytes);
+	MteSdrAlloc::release(MteSdrAlloc::DecryptBuffer, myDecBuff, myDecBuffBytes);
 }
 
 void MteSdr::initSdr(const std::string& location, const uint8_t* password, size_t passwordBytes)
@@ -47,6 +51,11 @@ void MteSdr::initSdr(const std::string& location, const uint8_t* password, size_
 	// Save the SDR path.
 	mySdrLocation = location;
 
+	// Free what an earlier initSdr() allocated.
+	MteSdrAlloc::release(MteSdrAlloc::Password, static_cast<uint8_t*>(myPassword), myPasswordBytes);
+	MteSdrAlloc::release(MteSdrAlloc::EncoderState, myEncoder, myEncoderBytes);
+	MteSdrAlloc::release(MteSdrAlloc::DecoderState, myDecoder, myDecoderBytes);
+
 	// Check if password has been set with initSdr.
 	if (password == nullptr || passwordBytes == 0)
 	{
@@ -57,7 +66,7 @@ void MteSdr::initSdr(const std::string& location, const uint8_t* password, size_
 	{
 		// Set the password.
 		myPasswordBytes = passwordBytes;
-		myPassword = new uint8_t[passwordBytes];
+		myPassword = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::Password, passwordBytes);
 		memcpy(myPassword, password, myPasswordBytes);
 	}
 
@@ -71,13 +80,15 @@ void MteSdr::initSdr(const std::string& location, const uint8_t* password, size_
 	size_t encBytes = mte_sdr_enc_state_bytes();
 
 	// Allocate the encoder.
-	myEncoder = new MTE_HANDLE[encBytes];
+	myEncoder = MteSdrAlloc::allocate<MTE_HANDLE>(MteSdrAlloc::EncoderState, encBytes);
+	myEncoderBytes = encBytes;
 
 	// Get the decoder size.
 	size_t decBytes = mte_sdr_dec_state_bytes();
 
 	// Allocate the decoder.
-	myDecoder = new MTE_HANDLE[decBytes];
+	myDecoder = MteSdrAlloc::allocate<MTE_HANDLE>(MteSdrAlloc::DecoderState, decBytes);
+	myDecoderBytes = decBytes;
 }
 
 void MteSdr::initSdr(const std::string& location, const std::string& password)
@@ -88,10 +99,12 @@ void MteSdr::initSdr(const std::string& location, const std::string& password)
 
 const uint8_t* MteSdr::readData(const std::string& key, size_t& decryptedBytes)
 {
+	MteSdrCapture::Scope capture(MteSdrCapture::Read, mySdrLocation, &key);
 	mte_status status;
 
 	uint8_t* encrypted = nullptr;
 	size_t encryptedBytes;
+	bool fromStorage = false;
 	// Get the encrypted data.
 	// First check if encrypted data is in memory.
 	auto encryptedMem = memRecords.find(key);
@@ -99,21 +112,26 @@ const uint8_t* MteSdr::readData(const std::string& key, size_t& decryptedBytes)
 	{
 		encrypted = encryptedMem->second.second;
 		encryptedBytes = encryptedMem->second.first;
+		capture.setToMemory();
 	}
 	else
 	{
 		// Attempt to get the record from the file system.
-		encrypted = readRecord(mySdrLocation, key, encryptedBytes);
+		encrypted = tracedReadRecord(mySdrLocation, key, encryptedBytes);
+		fromStorage = true;
 	}
 
-	// Decode the encrypted data.
+	// Decode the encrypted data, then free the record if it was read.
 	const uint8_t* decrypted = decrypt(encrypted, encryptedBytes, decryptedBytes, status);
+	if (fromStorage)
+		releaseRecord(encrypted, encryptedBytes);
 	if (status != mte_status_success)
 	{
 		throw std::runtime_error(std::string("Error decrypting data (") + MteBase::getStatusName(status) +
 			"): " + MteBase::getStatusDescription(status));
 	}
 
+	capture.succeeded(decryptedBytes);
 	return decrypted;
 }
 
@@ -127,6 +145,7 @@ const std::string MteSdr::readString(const std::string& key)
 
 void MteSdr::write(const std::string& key, const uint8_t* value, size_t valueBytes, bool toMemory)
 {
+	MteSdrCapture::Scope capture(MteSdrCapture::Write, mySdrLocation, &key, toMemory);
 	// Encrypt the data.
 	mte_status status;
 	size_t encryptedBytes;
@@ -143,19 +162,32 @@ void MteSdr::write(const std::string& key, const uint8_t* value, size_t valueByt
 		// If saving to memory, add it to the memory map.
 		std::pair<size_t, uint8_t*> byteArray;
 		byteArray.first = encryptedBytes;
-		byteArray.second = new uint8_t[encryptedBytes];
+		byteArray.second = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::MemoryRecord, encryptedBytes);
 		memcpy(byteArray.second, encrypted, encryptedBytes);
 
-		removeRecord(mySdrLocation, key);
-		memRecords.emplace(key, byteArray);
+		tracedRemoveRecord(mySdrLocation, key);
+		auto existing = memRecords.find(key);
+		if (existing != memRecords.end())
+		{
+			// Replace the earlier version.
+			myMemRecordBytes -= existing->second.first;
+			MteSdrAlloc::release(MteSdrAlloc::MemoryRecord, existing->second.second, existing->second.first);
+			existing->second = byteArray;
+		}
+		else
+		{
+			memRecords.emplace(key, byteArray);
+		}
+		myMemRecordBytes += encryptedBytes;
 
 	}
 	else
 	{
 		// Otherwise write it to the file.
-		writeRecord(mySdrLocation, key, encrypted, encryptedBytes);
+		tracedWriteRecord(mySdrLocation, key, encrypted, encryptedBytes);
 	}
 
+	capture.succeeded(valueBytes);
 }
 
 void MteSdr::write(const std::string& key, const std::string& value, bool toMemory)
@@ -177,23 +209,28 @@ void MteSdr::write(const std::string& key, const std::string& value)
 
 void MteSdr::remove(const std::string& key)
 {
+	MteSdrCapture::Scope capture(MteSdrCapture::Remove, mySdrLocation, &key);
 	// Remove from memory if it exists there.
 	auto item = memRecords.find(key);
 	if (item != memRecords.end())
 	{
+		myMemRecordBytes -= item->second.first;
+		MteSdrAlloc::release(MteSdrAlloc::MemoryRecord, item->second.second, item->second.first);
 		memRecords.erase(item);
+		capture.setToMemory();
 	}
 	else
 	{
 		// Remove from the SDR if it exists there.
-		removeRecord(mySdrLocation, key);
+		tracedRemoveRecord(mySdrLocation, key);
 	}
+	capture.succeeded(0);
 }
 
 void MteSdr::removeSdr()
 {
 	// Clear the memory storage.
-	memRecords.clear();
+	clearMemRecords();
 
 	// If the SDR directory exists, remove it.
 	if (locationExists(mySdrLocation))
@@ -203,7 +240,7 @@ void MteSdr::removeSdr()
 		for (std::list<std::string>::iterator record = records.begin();
 			record != records.end(); ++record)
 		{
-			removeRecord(mySdrLocation, record->data());
+			tracedRemoveRecord(mySdrLocation, record->data());
 		}
 
 		// Remove the SDR directory.
@@ -211,6 +248,56 @@ void MteSdr::removeSdr()
 	}
 }
 
+std::vector<MteSdrStats::PhaseStats> MteSdr::getStats()
+{
+	return MteSdrStats::snapshot();
+}
+
+void MteSdr::setStatsEnabled(bool enable)
+{
+	MteSdrStats::setEnabled(enable);
+}
+
+void MteSdr::resetStats()
+{
+	MteSdrStats::reset();
+}
+
+std::vector<MteSdrAlloc::SiteStats> MteSdr::getAllocStats()
+{
+	return MteSdrAlloc::snapshot();
+}
+
+void MteSdr::startAllocReport(std::ostream& out, double seconds)
+{
+	MteSdrAlloc::startReport(out, seconds);
+}
+
+void MteSdr::stopAllocReport()
+{
+	MteSdrAlloc::stopReport();
+}
+
+MteSdr::Footprint MteSdr::getFootprint() const
+{
+	Footprint footprint;
+	footprint.stateBytes = (myEncoderBytes + myDecoderBytes) * sizeof(MTE_HANDLE);
+	footprint.scratchBytes = myEncBuffBytes + myDecBuffBytes;
+	footprint.memoryRecords = memRecords.size();
+	footprint.memoryRecordBytes = myMemRecordBytes;
+	return footprint;
+}
+
+void MteSdr::startCapture(const std::string& path)
+{
+	MteSdrCapture::start(path);
+}
+
+void MteSdr::stopCapture()
+{
+	MteSdrCapture::stop();
+}
+
 std::string MteSdr::mkFilePath(const std::string& path, const std::string& file)
 {
 	std::string filepath = path;
@@ -333,7 +420,7 @@ uint8_t* MteSdr::readRecord(const std::string& location, const std::string& key,
 	}
 	fs.seekg(0, std::ios::end);
 	valueBytes = fs.tellg();
-	value = new uint8_t[valueBytes];
+	value = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::StorageRecord, valueBytes);
 	if (value == nullptr)
 	{
 		valueBytes = 0;
@@ -344,7 +431,7 @@ uint8_t* MteSdr::readRecord(const std::string& location, const std::string& key,
 	fs.read((char*)(value), valueBytes);
 	if (fs.bad() || (size_t)fs.gcount() != valueBytes)
 	{
-		delete value;
+		MteSdrAlloc::release(MteSdrAlloc::StorageRecord, value, valueBytes);
 		value = nullptr;
 		valueBytes = 0;
 		fs.close();
@@ -354,6 +441,19 @@ uint8_t* MteSdr::readRecord(const std::string& location, const std::string& key,
 	return value;
 }
 
+void MteSdr::releaseRecord(uint8_t* value, size_t valueBytes)
+{
+	MteSdrAlloc::release(MteSdrAlloc::StorageRecord, value, valueBytes);
+}
+
+void MteSdr::clearMemRecords()
+{
+	for (auto& record : memRecords)
+		MteSdrAlloc::release(MteSdrAlloc::MemoryRecord, record.second.second, record.second.first);
+	memRecords.clear();
+	myMemRecordBytes = 0;
+}
+
 void MteSdr::writeRecord(const std::string& location, const std::string& key,
 	const uint8_t* value, size_t valueBytes)
 {
@@ -384,7 +484,7 @@ void MteSdr::removeRecord(const std::string& location, const std::string& key)
 	struct stat info;
 	if (stat(filepath.c_str(), &info) != 0)
 	{
-		printf("%d\n", errno);
+		// Nothing to remove.
 		return;
 	}
 	else if (info.st_mode & S_IFREG)
@@ -393,14 +493,48 @@ void MteSdr::removeRecord(const std::string& location, const std::string& key)
 	}
 }
 
+uint8_t* MteSdr::tracedReadRecord(const std::string& location, const std::string& key,
+	size_t& valueBytes)
+{
+	MTE_SDR_PROBE1(read_record_entry, key.size());
+	uint8_t* value;
+	{
+		MteSdrStats::Timer timer(MteSdrStats::ReadRecord, 0);
+		value = readRecord(location, key, valueBytes);
+		timer.setBytes(valueBytes);
+	}
+	MTE_SDR_PROBE2(read_record_return, key.size(), valueBytes);
+	return value;
+}
+
+void MteSdr::tracedWriteRecord(const std::string& location, const std::string& key,
+	const uint8_t* value, size_t valueBytes)
+{
+	MTE_SDR_PROBE2(write_record_entry, key.size(), valueBytes);
+	{
+		MteSdrStats::Timer timer(MteSdrStats::WriteRecord, valueBytes);
+		writeRecord(location, key, value, valueBytes);
+	}
+	MTE_SDR_PROBE2(write_record_return, key.size(), valueBytes);
+}
+
+void MteSdr::tracedRemoveRecord(const std::string& location, const std::string& key)
+{
+	MTE_SDR_PROBE1(remove_record_entry, key.size());
+	removeRecord(location, key);
+	MTE_SDR_PROBE1(remove_record_return, key.size());
+}
+
 const uint8_t* MteSdr::encrypt(const uint8_t* data, size_t dataBytes, size_t& encryptedBytes, mte_status& status)
 {
 	// Get the encrypted buffer requirement and reallocate if necessary.
 	size_t buffBytes = mte_sdr_enc_buff_bytes(myEncoder, dataBytes);
 	if (buffBytes > myEncBuffBytes)
 	{
-		delete[] myEncBuff;
-		myEncBuff = new uint8_t[buffBytes];
+		MTE_SDR_PROBE3(buffer_realloc, 0, myEncBuffBytes, buffBytes);
+		MteSdrStats::Timer timer(MteSdrStats::EncryptRealloc, buffBytes);
+		MteSdrAlloc::release(MteSdrAlloc::EncryptBuffer, myEncBuff, myEncBuffBytes);
+		myEncBuff = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::EncryptBuffer, buffBytes);
 		myEncBuffBytes = buffBytes;
 	}
 
@@ -409,7 +543,12 @@ const uint8_t* MteSdr::encrypt(const uint8_t* data, size_t dataBytes, size_t& en
 	size_t bytes = dataBytes;
 
 	// Encrypt the data.
-	status = mte_sdr_encrypt(myEncoder, data, &bytes, myEncBuff, myPassword, myPasswordBytes, MteSdrRandomCallback, this);
+	MTE_SDR_PROBE1(encrypt_entry, dataBytes);
+	{
+		MteSdrStats::Timer timer(MteSdrStats::Encrypt, dataBytes);
+		status = mte_sdr_encrypt(myEncoder, data, &bytes, myEncBuff, myPassword, myPasswordBytes, MteSdrRandomCallback, this);
+	}
+	MTE_SDR_PROBE3(encrypt_return, dataBytes, bytes, static_cast<int>(status));
 
 	// After the call, bytes will be the size of the encrypted data.
 	encryptedBytes = bytes;
@@ -424,8 +563,10 @@ const uint8_t* MteSdr::decrypt(const uint8_t* encryptedData, size_t encryptedByt
 	size_t buffBytes = mte_sdr_dec_buff_bytes(myDecoder, encryptedBytes);
 	if (buffBytes > myDecBuffBytes)
 	{
-		delete[] myDecBuff;
-		myDecBuff = new uint8_t[buffBytes];
+		MTE_SDR_PROBE3(buffer_realloc, 1, myDecBuffBytes, buffBytes);
+		MteSdrStats::Timer timer(MteSdrStats::DecryptRealloc, buffBytes);
+		MteSdrAlloc::release(MteSdrAlloc::DecryptBuffer, myDecBuff, myDecBuffBytes);
+		myDecBuff = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::DecryptBuffer, buffBytes);
 		myDecBuffBytes = buffBytes;
 	}
 
@@ -435,7 +576,12 @@ const uint8_t* MteSdr::decrypt(const uint8_t* encryptedData, size_t encryptedByt
 
 	// Decrypt the encrypted data.
 	uint8_t dOff = 0;
-	status = mte_sdr_decrypt(myDecoder, encryptedData, &bytes, myDecBuff, &dOff, myPassword, myPasswordBytes);
+	MTE_SDR_PROBE1(decrypt_entry, encryptedBytes);
+	{
+		MteSdrStats::Timer timer(MteSdrStats::Decrypt, encryptedBytes);
+		status = mte_sdr_decrypt(myDecoder, encryptedData, &bytes, myDecBuff, &dOff, myPassword, myPasswordBytes);
+	}
+	MTE_SDR_PROBE3(decrypt_return, encryptedBytes, bytes, static_cast<int>(status));
 
 	// After the call, bytes will be the size of the decrypted data.
 	decryptedBytes = bytes;
@@ -444,6 +590,37 @@ const uint8_t* MteSdr::decrypt(const uint8_t* encryptedData, size_t encryptedByt
 	return myDecBuff + dOff;
 }
 
+MteBufferPool::Lease MteSdr::encryptLease(const uint8_t* data, size_t dataBytes, mte_status& status)
+{
+	// Encrypt straight into a leased buffer of the size required.
+	MteBufferPool::Lease lease = MteBufferPool::acquire(mte_sdr_enc_buff_bytes(myEncoder, dataBytes));
+	size_t bytes = dataBytes;
+	MTE_SDR_PROBE1(encrypt_entry, dataBytes);
+	{
+		MteSdrStats::Timer timer(MteSdrStats::Encrypt, dataBytes);
+		status = mte_sdr_encrypt(myEncoder, data, &bytes, lease.data(), myPassword, myPasswordBytes, MteSdrRandomCallback, this);
+	}
+	MTE_SDR_PROBE3(encrypt_return, dataBytes, bytes, static_cast<int>(status));
+	lease.setData(0, bytes);
+	return lease;
+}
+
+MteBufferPool::Lease MteSdr::decryptLease(const uint8_t* encryptedData, size_t encryptedBytes, mte_status& status)
+{
+	// Decrypt straight into a leased buffer; the data starts dOff bytes in.
+	MteBufferPool::Lease lease = MteBufferPool::acquire(mte_sdr_dec_buff_bytes(myDecoder, encryptedBytes));
+	size_t bytes = encryptedBytes;
+	uint8_t dOff = 0;
+	MTE_SDR_PROBE1(decrypt_entry, encryptedBytes);
+	{
+		MteSdrStats::Timer timer(MteSdrStats::Decrypt, encryptedBytes);
+		status = mte_sdr_decrypt(myDecoder, encryptedData, &bytes, lease.data(), &dOff, myPassword, myPasswordBytes);
+	}
+	MTE_SDR_PROBE3(decrypt_return, encryptedBytes, bytes, static_cast<int>(status));
+	lease.setData(dOff, bytes);
+	return lease;
+}
+
 int MteSdr::mkAllDir(const std::string& path) const
 {
 	// The startPath will start as the path coming in, then each sub directory
@@ -515,7 +692,13 @@ int MteSdr::mkAllDir(const std::string& path) const
 
 void MteSdr::randomCallback(void* buffer, size_t bufferSize)
 {
-	(*myRandomCallback)(buffer, bufferSize);
+	MTE_SDR_PROBE1(random_entry, bufferSize);
+	{
+		ChromeTrace::Span span("random", "mte", static_cast<int64_t>(bufferSize));
+		MteSdrStats::Timer timer(MteSdrStats::Random, bufferSize);
+		(*myRandomCallback)(buffer, bufferSize);
+	}
+	MTE_SDR_PROBE1(random_return, bufferSize);
 }
 
 void MteSdrRandomCallback(void* context, void* buffer, size_t bufferBytes)
@@ -25,13 +25,65 @@
  *******************************************************************************/
 #pragma once
 #include <MteSdr.h>
+#include <memory>
+#include <vector>
+
+//
+// An Arrow-style column of variable length values: value i is the bytes
+// data[offsets[i]] up to data[offsets[i + 1]], so there are rows + 1 offsets.
+//
+struct MteSdrColumn
+{
+	std::vector<size_t> offsets = std::vector<size_t>(1, 0);
+	std::vector<uint8_t> data;
+
+	size_t rows() const { return offsets.size() - 1; }
+
+	const uint8_t* value(size_t row, size_t& length) const
+	{
+		length = offsets[row + 1] - offsets[row];
+		return data.data() + offsets[row];
+	}
+
+	void append(const uint8_t* value, size_t length)
+	{
+		data.insert(data.end(), value, value + length);
+		offsets.push_back(data.size());
+	}
+
+	// Empties the column, keeping its memory for reuse.
+	void clear()
+	{
+		offsets.resize(1);
+		data.clear();
+	}
+};
+
 class MteSdrDisconnected : MteSdr
 {
 public:
 	MteSdrDisconnected(mte_sdr_random rnd_cb) : MteSdr(rnd_cb) {};
+	~MteSdrDisconnected() override { clearRecords(); }
     void initSdr(const std::string security);
     uint8_t* Conceal(const uint8_t* clearData, size_t clearDataLen, size_t& protectedDataLen);
     const uint8_t* Reveal(const uint8_t* protectedData, size_t protectedDataLen, size_t& clearDataLen);
+
+    // Conceal or Reveal into a buffer leased from MteBufferPool; the
+    // buffer goes back to the pool when the lease is destroyed. These do
+    // not go through the record store, so once the pool holds the sizes
+    // in use they make no heap allocation.
+    // Throws an exception on MTE error.
+    MteBufferPool::Lease Conceal(const uint8_t* clearData, size_t clearDataLen);
+    MteBufferPool::Lease Reveal(const uint8_t* protectedData, size_t protectedDataLen);
+
+    // Conceals or reveals every value of a column in one call, without the
+    // record store or an allocation per value. The results are appended to
+    // the output column; rows [first, last) only, in the Rows variants.
+    // Throws an exception on MTE error.
+    void ConcealColumn(const MteSdrColumn& clearColumn, MteSdrColumn& protectedColumn);
+    void RevealColumn(const MteSdrColumn& protectedColumn, MteSdrColumn& clearColumn);
+    void ConcealRows(const MteSdrColumn& clearColumn, size_t first, size_t last, MteSdrColumn& protectedColumn);
+    void RevealRows(const MteSdrColumn& protectedColumn, size_t first, size_t last, MteSdrColumn& clearColumn);
 protected:
     // Returns true if the location exists, false if not.
     // This simple demo implementation ignores the location.
@@ -66,7 +118,7 @@ protected:
     // This simple demo implementation ignores the location.
     void setupLocation(const std::string& location) override
     {
-        myRecords = std::map<std::string, std::pair<size_t, uint8_t*>>();
+        clearRecords();
     }
 
     // Reads a record. Returns the record's value.
@@ -86,13 +138,18 @@ protected:
         return value;
     }
 
+    // The records read are still in the store, which frees them.
+    void releaseRecord(uint8_t* value, size_t valueBytes) override
+    {
+    }
+
     // Writes a record.
     // This simple demo implementation ignores the location.
     void writeRecord(const std::string& location, const std::string& key, const uint8_t* value, size_t valueBytes) override
     {
         std::pair<size_t, uint8_t*> byteArray;
         byteArray.first = valueBytes;
-        byteArray.second = new uint8_t[valueBytes];
+        byteArray.second = MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::DisconnectedRecord, valueBytes);
         memcpy(byteArray.second, value, valueBytes);
 
         removeRecord(location, key);
@@ -108,6 +165,7 @@ protected:
         auto item = myRecords.find(key);
         if (item != myRecords.end())
         {
+            MteSdrAlloc::release(MteSdrAlloc::DisconnectedRecord, item->second.second, item->second.first);
             myRecords.erase(item);
         }
     }
@@ -116,11 +174,52 @@ protected:
     // This simple demo implementation ignores the location.
     void removeLocation(const std::string& location) override
     {
-        myRecords.clear();
+        clearRecords();
     }
 
 private:
+    // Takes a record out of the store for the caller to delete[]; the
+    // entry is left empty, to be removed.
+    uint8_t* detachRecord(const std::string& key)
+    {
+        auto item = myRecords.find(key);
+        if (item == myRecords.end())
+            return nullptr;
+        uint8_t* value = item->second.second;
+        MteSdrAlloc::handOut(MteSdrAlloc::DisconnectedRecord, item->second.first);
+        item->second.second = nullptr;
+        item->second.first = 0;
+        return value;
+    }
+
+    void clearRecords()
+    {
+        for (auto& item : myRecords)
+            MteSdrAlloc::release(MteSdrAlloc::DisconnectedRecord, item.second.second, item.second.first);
+        myRecords.clear();
+    }
+
 	std::map<std::string, std::pair<size_t, uint8_t*> > myRecords;
 };
 
+//
+// Conceals or reveals large columns on several threads. The rows are split
+// into row groups that the threads take in turn, each thread with its own
+// MteSdrDisconnected, and the results are joined in row order.
+//
+class MteSdrParallel
+{
+public:
+	MteSdrParallel(mte_sdr_random rnd_cb, const std::string& security, size_t threads, size_t rowGroupRows = 4096);
+
+	void ConcealColumn(const MteSdrColumn& clearColumn, MteSdrColumn& protectedColumn);
+	void RevealColumn(const MteSdrColumn& protectedColumn, MteSdrColumn& clearColumn);
 
+private:
+	void run(const MteSdrColumn& input, MteSdrColumn& output, bool conceal);
+
+	size_t myRowGroupRows;
+	std::vector<std::unique_ptr<MteSdrDisconnected> > mySdrs;
+	// The output of each row group, kept for reuse.
+	std::vector<MteSdrColumn> myGroups;
+};
@@ -0,0 +1,497 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <csignal>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "SdrService.h"
+#include "SdrClient.h"
+#include "ShmTransport.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+std::string getItemFromSettings(std::string key) {
+	std::ifstream file("./settings.txt");
+	std::string s;
+	while (std::getline(file, s)) {
+		std::size_t found = s.find(key);
+		if (found != std::string::npos) {
+			std::size_t eq = s.find('=');
+			if (eq != std::string::npos) {
+				return s.substr(eq + 1);
+			}
+		}
+	}
+	return "";
+}
+
+//
+// The running service, so the signal handler can stop it.
+//
+static SdrService* runningService = nullptr;
+static ShmService* runningShmService = nullptr;
+
+static void serviceSignalHandler(int)
+{
+	if (runningService != nullptr)
+		runningService->stop();
+	if (runningShmService != nullptr)
+		runningShmService->stop();
+}
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Service serve [--unix <path>] [--tcp <port>] [--workers N] [--batch N]" << std::endl;
+	std::cout << "      Serves Conceal/Reveal requests until interrupted." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Service loadtest [--unix <path> | --tcp <port>] [--connections N] [--depth N]" << std::endl;
+	std::cout << "                                       [--size bytes] [--seconds S] [--op conceal|reveal] [--workers N]" << std::endl;
+	std::cout << "      Drives a service over loopback and reports throughput and latency. Without --unix or --tcp" << std::endl;
+	std::cout << "      a service is started in this process on a temporary Unix socket." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Service shm-serve [--unix <path>] [--spin N]" << std::endl;
+	std::cout << "      Serves Conceal/Reveal requests over shared memory channels handed over on the socket." << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Service shm-loadtest [--unix <path>] [--connections N] [--depth N] [--size bytes]" << std::endl;
+	std::cout << "                                           [--seconds S] [--op conceal|reveal] [--slots N] [--spin N]" << std::endl;
+	std::cout << "      The load test over shared memory channels, one per connection." << std::endl;
+}
+
+struct LoadTestOptions
+{
+	size_t connections = 8;
+	size_t depth = 16;
+	size_t size = 256;
+	unsigned seconds = 10;
+	SdrOp op = SdrOpConceal;
+	// Shared memory only: slots per ring and polls before sleeping.
+	uint32_t slots = 256;
+	unsigned spin = ShmRing::defaultSpin();
+};
+
+//
+// Connects a client to whichever endpoint was chosen.
+//
+static void connectClient(SdrClient& client, const SdrService::Options& endpoint)
+{
+	if (!endpoint.unixPath.empty())
+		client.connectUnix(endpoint.unixPath);
+	else
+		client.connectTcp(endpoint.tcpAddress, endpoint.tcpPort);
+}
+
+//
+// Runs one load test connection: keeps "depth" requests outstanding until the
+// deadline and records the latency of each.
+//
+static void loadTestConnection(const SdrService::Options& endpoint, const LoadTestOptions& options,
+	const std::vector<uint8_t>& payload, std::chrono::steady_clock::time_point deadline,
+	std::vector<uint64_t>& latencies)
+{
+	typedef std::chrono::steady_clock Clock;
+	SdrClient client;
+	connectClient(client, endpoint);
+
+	std::deque<Clock::time_point> sent;
+	std::vector<uint8_t> response;
+	uint64_t id = 0;
+	bool sending = true;
+	while (sending || !sent.empty())
+	{
+		if (sending && Clock::now() >= deadline)
+			sending = false;
+		if (sending)
+		{
+			while (sent.size() < options.depth)
+			{
+				client.send(options.op, ++id, payload.data(), payload.size());
+				sent.push_back(Clock::now());
+			}
+			client.flush();
+		}
+		SdrFrameHeader header = client.receive(response);
+		if (header.status != SdrStatusOk)
+			throw std::runtime_error("The service returned an error: " + std::string(response.begin(), response.end()));
+		latencies.push_back(static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent.front()).count()));
+		sent.pop_front();
+	}
+}
+
+static double percentile(const std::vector<uint64_t>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+	return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+//
+// Prints the throughput and latency of a load test. Returns non-zero if no
+// request completed.
+//
+static int reportLoadTest(const LoadTestOptions& options,
+	const std::vector<std::vector<uint64_t> >& latencies, double elapsed)
+{
+	std::vector<uint64_t> all;
+	for (auto& l : latencies)
+		all.insert(all.end(), l.begin(), l.end());
+	std::sort(all.begin(), all.end());
+
+	double rate = static_cast<double>(all.size()) / elapsed;
+	std::cout << "op=" << (options.op == SdrOpConceal ? "conceal" : "reveal")
+		<< " size=" << options.size
+		<< " connections=" << options.connections
+		<< " depth=" << options.depth << std::endl;
+	std::cout << "requests=" << all.size()
+		<< " seconds=" << elapsed
+		<< " throughput=" << rate << " req/s"
+		<< " (" << rate * static_cast<double>(options.size) / (1024.0 * 1024.0) << " MB/s)" << std::endl;
+	std::cout << "latency us: p50=" << percentile(all, 0.50)
+		<< " p99=" << percentile(all, 0.99)
+		<< " p999=" << percentile(all, 0.999)
+		<< " max=" << (all.empty() ? 0.0 : static_cast<double>(all.back()) / 1000.0) << std::endl;
+	return all.empty() ? 1 : 0;
+}
+
+static int loadTest(const SdrService::Options& endpoint, const LoadTestOptions& options)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	//
+	// The payload for every request; for Reveal it is a concealed payload.
+	//
+	std::vector<uint8_t> payload(options.size);
+	MteRandom::getBytes(payload.data(), payload.size());
+	if (options.op == SdrOpReveal)
+	{
+		SdrClient client;
+		connectClient(client, endpoint);
+		std::vector<uint8_t> concealed;
+		client.call(SdrOpConceal, payload.data(), payload.size(), concealed);
+		payload.swap(concealed);
+	}
+
+	std::vector<std::vector<uint64_t> > latencies(options.connections);
+	std::vector<std::thread> threads;
+	Clock::time_point start = Clock::now();
+	Clock::time_point deadline = start + std::chrono::seconds(options.seconds);
+	for (size_t i = 0; i < options.connections; i++)
+	{
+		threads.emplace_back([&, i]
+			{
+				try
+				{
+					loadTestConnection(endpoint, options, payload, deadline, latencies[i]);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "Connection " << i << ": " << e.what() << std::endl;
+				}
+			});
+	}
+	for (auto& t : threads)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	return reportLoadTest(options, latencies, elapsed);
+}
+
+//
+// The slot size for a shared memory load test; leaves room for the bytes
+// Conceal adds.
+//
+static uint32_t shmSlotBytes(const LoadTestOptions& options)
+{
+	return static_cast<uint32_t>(options.size + 4096);
+}
+
+//
+// Runs one shared memory load test connection: keeps "depth" requests in the
+// ring until the deadline, writing each in place, and records the latency of
+// each response.
+//
+static void shmLoadTestConnection(const std::string& path, const LoadTestOptions& options,
+	const std::vector<uint8_t>& payload, std::chrono::steady_clock::time_point deadline,
+	std::vector<uint64_t>& latencies)
+{
+	typedef std::chrono::steady_clock Clock;
+	ShmClient client;
+	client.connect(path, options.slots, shmSlotBytes(options));
+	client.requests().setSpin(options.spin);
+	client.responses().setSpin(options.spin);
+
+	std::deque<Clock::time_point> sent;
+	uint64_t id = 0;
+	bool sending = true;
+	while (sending || !sent.empty())
+	{
+		if (sending && Clock::now() >= deadline)
+			sending = false;
+		while (sending && sent.size() < options.depth)
+		{
+			ShmSlot* request = client.requests().tryClaim();
+			if (request == nullptr)
+				break;
+			request->id = ++id;
+			request->op = static_cast<uint8_t>(options.op);
+			request->status = 0;
+			request->reserved = 0;
+			request->length = static_cast<uint32_t>(payload.size());
+			memcpy(request->data(), payload.data(), payload.size());
+			client.requests().publish(request);
+			sent.push_back(Clock::now());
+		}
+		if (sent.empty())
+			continue;
+		ShmSlot* response = client.responses().peek(1000);
+		if (response == nullptr)
+			throw std::runtime_error("The service stopped responding.");
+		if (response->status != SdrStatusOk)
+			throw std::runtime_error("The service returned an error: " +
+				std::string(response->data(), response->data() + response->length));
+		client.responses().release(response);
+		latencies.push_back(static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent.front()).count()));
+		sent.pop_front();
+	}
+}
+
+static int shmLoadTest(const std::string& path, const LoadTestOptions& options)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	//
+	// The payload for every request; for Reveal it is a concealed payload.
+	//
+	std::vector<uint8_t> payload(options.size);
+	MteRandom::getBytes(payload.data(), payload.size());
+	if (options.op == SdrOpReveal)
+	{
+		ShmClient client;
+		client.connect(path, 1, shmSlotBytes(options));
+		std::vector<uint8_t> concealed;
+		client.call(SdrOpConceal, payload.data(), payload.size(), concealed);
+		payload.swap(concealed);
+	}
+
+	std::vector<std::vector<uint64_t> > latencies(options.connections);
+	std::vector<std::thread> threads;
+	Clock::time_point start = Clock::now();
+	Clock::time_point deadline = start + std::chrono::seconds(options.seconds);
+	for (size_t i = 0; i < options.connections; i++)
+	{
+		threads.emplace_back([&, i]
+			{
+				try
+				{
+					shmLoadTestConnection(path, options, payload, deadline, latencies[i]);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "Connection " << i << ": " << e.what() << std::endl;
+				}
+			});
+	}
+	for (auto& t : threads)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	return reportLoadTest(options, latencies, elapsed);
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MteSdr Conceal Service" << std::endl;
+
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+	std::string mode = argv[1];
+
+	SdrService::Options options;
+	LoadTestOptions loadOptions;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--unix" && hasValue)
+			options.unixPath = argv[++i];
+		else if (arg == "--tcp" && hasValue)
+			options.tcpPort = std::atoi(argv[++i]);
+		else if (arg == "--workers" && hasValue)
+			options.workers = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--batch" && hasValue)
+			options.maxBatch = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--connections" && hasValue)
+			loadOptions.connections = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--depth" && hasValue)
+			loadOptions.depth = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--size" && hasValue)
+			loadOptions.size = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--seconds" && hasValue)
+			loadOptions.seconds = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--slots" && hasValue)
+			loadOptions.slots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--spin" && hasValue)
+			loadOptions.spin = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--op" && hasValue)
+		{
+			std::string op = argv[++i];
+			loadOptions.op = op == "reveal" ? SdrOpReveal : SdrOpConceal;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	//
+	// Initialize MTE license.
+	//
+	std::string company = getItemFromSettings("LicensedCompany");
+	std::string license = getItemFromSettings("LicenseKey");
+	if (!MteBase::initLicense(company.c_str(), license.c_str()))
+	{
+		std::cerr << "License init error ("
+			<< MteBase::getStatusName(mte_status_license_error)
+			<< "): "
+			<< MteBase::getStatusDescription(mte_status_license_error)
+			<< std::endl;
+		return mte_status_license_error;
+	}
+	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	try
+	{
+		if (mode == "serve")
+		{
+			if (options.unixPath.empty() && options.tcpPort == 0)
+				options.unixPath = "/tmp/mte-sdr.sock";
+			SdrService service(options);
+			service.start();
+			runningService = &service;
+			std::signal(SIGINT, serviceSignalHandler);
+			std::signal(SIGTERM, serviceSignalHandler);
+			std::cout << "Serving on"
+				<< (options.unixPath.empty() ? "" : " unix:" + options.unixPath)
+				<< (options.tcpPort == 0 ? "" : " tcp:" + std::to_string(options.tcpPort)) << std::endl;
+			service.run();
+			runningService = nullptr;
+			SdrService::Stats stats = service.getStats();
+			std::cout << "connections=" << stats.connections << " requests=" << stats.requests
+				<< " batches=" << stats.batches << " errors=" << stats.errors << std::endl;
+			return 0;
+		}
+		if (mode == "loadtest")
+		{
+			//
+			// Without an endpoint, test against a service in this process.
+			//
+			std::unique_ptr<SdrService> local;
+			std::thread loop;
+			if (options.unixPath.empty() && options.tcpPort == 0)
+			{
+				options.unixPath = "/tmp/mte-sdr-loadtest-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".sock";
+				local.reset(new SdrService(options));
+				local->start();
+				loop = std::thread([&local] { local->run(); });
+			}
+			int rc = loadTest(options, loadOptions);
+			if (local)
+			{
+				local->stop();
+				loop.join();
+			}
+			return rc;
+		}
+		if (mode == "shm-serve" || mode == "shm-loadtest")
+		{
+			ShmService::Options shmOptions;
+			shmOptions.security = options.security;
+			shmOptions.spin = loadOptions.spin;
+			if (!options.unixPath.empty())
+				shmOptions.unixPath = options.unixPath;
+			if (loadOptions.depth > loadOptions.slots)
+				loadOptions.depth = loadOptions.slots;
+
+			if (mode == "shm-serve")
+			{
+				ShmService service(shmOptions);
+				service.start();
+				runningShmService = &service;
+				std::signal(SIGINT, serviceSignalHandler);
+				std::signal(SIGTERM, serviceSignalHandler);
+				std::cout << "Serving shared memory channels on unix:" << shmOptions.unixPath << std::endl;
+				service.run();
+				runningShmService = nullptr;
+				ShmService::Stats stats = service.getStats();
+				std::cout << "channels=" << stats.channels << " requests=" << stats.requests
+					<< " errors=" << stats.errors << std::endl;
+				return 0;
+			}
+
+			//
+			// Without an endpoint, test against a service in this process.
+			//
+			std::unique_ptr<ShmService> local;
+			std::thread loop;
+			if (options.unixPath.empty())
+			{
+				shmOptions.unixPath = "/tmp/mte-sdr-shm-loadtest-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".sock";
+				local.reset(new ShmService(shmOptions));
+				local->start();
+				loop = std::thread([&local] { local->run(); });
+			}
+			int rc = shmLoadTest(shmOptions.unixPath, loadOptions);
+			if (local)
+			{
+				local->stop();
+				loop.join();
+			}
+			return rc;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	usage();
+	return 1;
+}
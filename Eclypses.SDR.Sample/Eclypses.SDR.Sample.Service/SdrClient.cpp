@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include "SdrClient.h"
+
+#if defined(__linux__)
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+SdrClient::SdrClient() : myFd(-1), myNextId(1)
+{
+}
+
+#if defined(__linux__)
+
+SdrClient::~SdrClient()
+{
+	if (myFd >= 0)
+		close(myFd);
+}
+
+void SdrClient::connectUnix(const std::string& path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("Unix socket path is too long");
+	strcpy(addr.sun_path, path.c_str());
+	myFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (myFd < 0 || connect(myFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+		throw std::runtime_error("Unable to connect to " + path + ": " + strerror(errno));
+}
+
+void SdrClient::connectTcp(const std::string& host, int port)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(static_cast<uint16_t>(port));
+	if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+		throw std::runtime_error("Invalid TCP address " + host);
+	myFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (myFd < 0 || connect(myFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+		throw std::runtime_error("Unable to connect to " + host + ": " + strerror(errno));
+	int on = 1;
+	setsockopt(myFd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+void SdrClient::flush()
+{
+	size_t sent = 0;
+	while (sent < myOut.size())
+	{
+		ssize_t rc = ::send(myFd, &myOut[sent], myOut.size() - sent, MSG_NOSIGNAL);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("send failed: ") + strerror(errno));
+		}
+		sent += static_cast<size_t>(rc);
+	}
+	myOut.clear();
+}
+
+void SdrClient::readFully(uint8_t* buffer, size_t bytes)
+{
+	size_t got = 0;
+	while (got < bytes)
+	{
+		ssize_t rc = recv(myFd, buffer + got, bytes - got, 0);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			throw std::runtime_error("The service closed the connection");
+		got += static_cast<size_t>(rc);
+	}
+}
+
+#else
+
+SdrClient::~SdrClient()
+{
+}
+
+void SdrClient::connectUnix(const std::string&)
+{
+	throw std::runtime_error("The SDR client is only available on Linux.");
+}
+
+void SdrClient::connectTcp(const std::string&, int)
+{
+	throw std::runtime_error("The SDR client is only available on Linux.");
+}
+
+void SdrClient::flush()
+{
+}
+
+void SdrClient::readFully(uint8_t*, size_t)
+{
+	throw std::runtime_error("The SDR client is only available on Linux.");
+}
+
+#endif
+
+void SdrClient::send(SdrOp op, uint64_t id, const uint8_t* data, size_t dataLen)
+{
+	SdrFrameHeader header;
+	header.length = static_cast<uint32_t>(dataLen);
+	header.op = static_cast<uint8_t>(op);
+	header.status = 0;
+	header.reserved = 0;
+	header.id = id;
+	size_t at = myOut.size();
+	myOut.resize(at + SdrHeaderBytes + dataLen);
+	sdrPackHeader(header, &myOut[at]);
+	if (dataLen != 0)
+		memcpy(&myOut[at + SdrHeaderBytes], data, dataLen);
+}
+
+SdrFrameHeader SdrClient::receive(std::vector<uint8_t>& payload)
+{
+	uint8_t raw[SdrHeaderBytes];
+	readFully(raw, sizeof(raw));
+	SdrFrameHeader header = sdrUnpackHeader(raw);
+	if (header.length > SdrMaxPayloadBytes)
+		throw std::runtime_error("The service sent an oversized response");
+	payload.resize(header.length);
+	if (header.length != 0)
+		readFully(payload.data(), header.length);
+	return header;
+}
+
+void SdrClient::call(SdrOp op, const uint8_t* data, size_t dataLen, std::vector<uint8_t>& result)
+{
+	send(op, myNextId++, data, dataLen);
+	flush();
+	SdrFrameHeader header = receive(result);
+	if (header.status != SdrStatusOk)
+		throw std::runtime_error("The service returned an error: " +
+			std::string(result.begin(), result.end()));
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SDRCLIENT_H
+#define SDRCLIENT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SdrProtocol.h"
+
+//******************************************************************************
+// Class SdrClient
+//
+// A minimal blocking client for the SdrService protocol. Requests are buffered
+// by send() and written by flush(), so a caller can pipeline several requests
+// in one write and then receive() the responses in order.
+//
+// Throws an exception on any socket error. Linux only.
+//******************************************************************************
+class SdrClient
+{
+public:
+	SdrClient();
+	~SdrClient();
+
+	// Connects to the service's Unix-domain socket.
+	void connectUnix(const std::string& path);
+
+	// Connects to the service over TCP.
+	void connectTcp(const std::string& host, int port);
+
+	// Buffers one request.
+	void send(SdrOp op, uint64_t id, const uint8_t* data, size_t dataLen);
+
+	// Writes all buffered requests.
+	void flush();
+
+	// Receives the next response into payload and returns its header.
+	SdrFrameHeader receive(std::vector<uint8_t>& payload);
+
+	// Sends one request and waits for its response. Throws an exception
+	// if the service reports an error.
+	void call(SdrOp op, const uint8_t* data, size_t dataLen, std::vector<uint8_t>& result);
+
+private:
+	void readFully(uint8_t* buffer, size_t bytes);
+
+	int myFd;
+	uint64_t myNextId;
+	std::vector<uint8_t> myOut;
+
+	SdrClient(const SdrClient&);
+	SdrClient& operator=(const SdrClient&);
+};
+
+#endif // !SDRCLIENT_H
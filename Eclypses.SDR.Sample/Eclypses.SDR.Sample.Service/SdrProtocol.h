@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SDRPROTOCOL_H
+#define SDRPROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+
+//******************************************************************************
+// The conceal service wire protocol.
+//
+// Every request and response is a frame: a fixed 16 byte header followed by
+// "length" bytes of payload. All integers are little-endian.
+//
+//   offset  size  field
+//   0       4     length   payload length in bytes
+//   4       1     op       SdrOp
+//   5       1     status   SdrStatus; 0 in requests
+//   6       2     reserved 0
+//   8       8     id       chosen by the client, echoed in the response
+//
+// A client may send any number of requests without waiting (pipelining).
+// Responses on a connection are returned in request order. For a Conceal
+// request the payload is the clear data and the response payload is the
+// protected data; Reveal is the reverse. A failed request returns a non-zero
+// status and the error text as the payload.
+//******************************************************************************
+enum SdrOp
+{
+	SdrOpPing = 0,
+	SdrOpConceal = 1,
+	SdrOpReveal = 2
+};
+
+enum SdrStatus
+{
+	SdrStatusOk = 0,
+	SdrStatusFailed = 1,
+	SdrStatusBadRequest = 2
+};
+
+struct SdrFrameHeader
+{
+	uint32_t length;
+	uint8_t op;
+	uint8_t status;
+	uint16_t reserved;
+	uint64_t id;
+};
+
+const size_t SdrHeaderBytes = 16;
+
+// The largest payload the service accepts; larger requests close the
+// connection.
+const size_t SdrMaxPayloadBytes = 64 * 1024 * 1024;
+
+// Writes the header to the 16 byte buffer.
+inline void sdrPackHeader(const SdrFrameHeader& header, uint8_t* out)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = static_cast<uint8_t>(header.length >> (8 * i));
+	out[4] = header.op;
+	out[5] = header.status;
+	out[6] = 0;
+	out[7] = 0;
+	for (int i = 0; i < 8; i++)
+		out[8 + i] = static_cast<uint8_t>(header.id >> (8 * i));
+}
+
+// Reads the header from the 16 byte buffer.
+inline SdrFrameHeader sdrUnpackHeader(const uint8_t* in)
+{
+	SdrFrameHeader header;
+	header.length = 0;
+	for (int i = 0; i < 4; i++)
+		header.length |= static_cast<uint32_t>(in[i]) << (8 * i);
+	header.op = in[4];
+	header.status = in[5];
+	header.reserved = 0;
+	header.id = 0;
+	for (int i = 0; i < 8; i++)
+		header.id |= static_cast<uint64_t>(in[8 + i]) << (8 * i);
+	return header;
+}
+
+#endif // !SDRPROTOCOL_H
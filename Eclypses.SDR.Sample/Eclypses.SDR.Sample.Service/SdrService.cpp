@@ -0,0 +1,589 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "SdrService.h"
+
+#if defined(__linux__)
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#endif
+
+//
+// The epoll tags below this value are not connections.
+//
+static const uint64_t TagWake = 0;
+static const uint64_t TagUnix = 1;
+static const uint64_t TagTcp = 2;
+static const uint64_t FirstConnection = 16;
+
+SdrService::SdrService(const Options& options) :
+	myOptions(options), myStopping(false),
+	myEpoll(-1), myWakeFd(-1), myUnixListener(-1), myTcpListener(-1),
+	myNextConnection(FirstConnection),
+	myStatConnections(0), myStatRequests(0), myStatBatches(0),
+	myStatBytesIn(0), myStatBytesOut(0), myStatErrors(0)
+{
+	if (myOptions.workers == 0)
+		myOptions.workers = std::max(1u, std::thread::hardware_concurrency());
+	if (myOptions.maxBatch == 0)
+		myOptions.maxBatch = 1;
+}
+
+SdrService::Stats SdrService::getStats() const
+{
+	Stats stats;
+	stats.connections = myStatConnections;
+	stats.requests = myStatRequests;
+	stats.batches = myStatBatches;
+	stats.bytesIn = myStatBytesIn;
+	stats.bytesOut = myStatBytesOut;
+	stats.errors = myStatErrors;
+	return stats;
+}
+
+void SdrService::workerLoop()
+{
+	//
+	// Each worker owns a warm SDR for the lifetime of the service.
+	//
+	MteSdrDisconnected sdr = MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes);
+	sdr.initSdr(myOptions.security);
+
+	for (;;)
+	{
+		std::unique_ptr<Batch> batch;
+		{
+			std::unique_lock<std::mutex> lock(myWorkMutex);
+			myWorkReady.wait(lock, [this] { return myStopping || !myWork.empty(); });
+			if (myStopping)
+				return;
+			batch = std::move(myWork.front());
+			myWork.pop_front();
+		}
+
+		processBatch(sdr, *batch);
+
+		{
+			std::lock_guard<std::mutex> lock(myDoneMutex);
+			myDone.push_back(std::move(batch));
+		}
+#if defined(__linux__)
+		uint64_t one = 1;
+		ssize_t rc = write(myWakeFd, &one, sizeof(one));
+		(void)rc;
+#endif
+	}
+}
+
+//
+// Appends one response frame to the output buffer.
+//
+static void appendResponse(std::vector<uint8_t>& out, const SdrFrameHeader& request,
+	SdrStatus status, const uint8_t* data, size_t dataLen)
+{
+	SdrFrameHeader header;
+	header.length = static_cast<uint32_t>(dataLen);
+	header.op = request.op;
+	header.status = static_cast<uint8_t>(status);
+	header.reserved = 0;
+	header.id = request.id;
+	size_t at = out.size();
+	out.resize(at + SdrHeaderBytes + dataLen);
+	sdrPackHeader(header, &out[at]);
+	if (dataLen != 0)
+		memcpy(&out[at + SdrHeaderBytes], data, dataLen);
+}
+
+void SdrService::processBatch(MteSdrDisconnected& sdr, Batch& batch)
+{
+	for (Request& request : batch.requests)
+	{
+		const uint8_t* payload = request.payload.empty() ? nullptr : request.payload.data();
+		try
+		{
+			switch (request.header.op)
+			{
+			case SdrOpPing:
+				appendResponse(batch.responses, request.header, SdrStatusOk, nullptr, 0);
+				break;
+			case SdrOpConceal:
+			{
+				//
+				// The leased result goes back to this worker's pool once copied.
+				//
+				MteBufferPool::Lease concealed = sdr.Conceal(payload, request.payload.size());
+				appendResponse(batch.responses, request.header, SdrStatusOk, concealed.data(), concealed.size());
+				break;
+			}
+			case SdrOpReveal:
+			{
+				MteBufferPool::Lease revealed = sdr.Reveal(payload, request.payload.size());
+				appendResponse(batch.responses, request.header, SdrStatusOk, revealed.data(), revealed.size());
+				break;
+			}
+			default:
+			{
+				static const char message[] = "Unknown operation";
+				appendResponse(batch.responses, request.header, SdrStatusBadRequest,
+					reinterpret_cast<const uint8_t*>(message), sizeof(message) - 1);
+				++myStatErrors;
+				break;
+			}
+			}
+		}
+		catch (const std::exception& e)
+		{
+			appendResponse(batch.responses, request.header, SdrStatusFailed,
+				reinterpret_cast<const uint8_t*>(e.what()), strlen(e.what()));
+			++myStatErrors;
+		}
+	}
+	//
+	// The requests are no longer needed; free them on the worker.
+	//
+	batch.requests.clear();
+}
+
+#if defined(__linux__)
+
+static void addToEpoll(int epfd, int fd, uint32_t events, uint64_t tag)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.u64 = tag;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		throw std::runtime_error(std::string("epoll_ctl failed: ") + strerror(errno));
+}
+
+SdrService::~SdrService()
+{
+	stop();
+	{
+		std::lock_guard<std::mutex> lock(myWorkMutex);
+		myWorkReady.notify_all();
+	}
+	for (auto& t : myWorkers)
+	{
+		if (t.joinable())
+			t.join();
+	}
+	for (auto& item : myConnections)
+		close(item.second->fd);
+	if (myUnixListener >= 0)
+	{
+		close(myUnixListener);
+		unlink(myOptions.unixPath.c_str());
+	}
+	if (myTcpListener >= 0)
+		close(myTcpListener);
+	if (myWakeFd >= 0)
+		close(myWakeFd);
+	if (myEpoll >= 0)
+		close(myEpoll);
+}
+
+void SdrService::stop()
+{
+	myStopping = true;
+	if (myWakeFd >= 0)
+	{
+		uint64_t one = 1;
+		ssize_t rc = write(myWakeFd, &one, sizeof(one));
+		(void)rc;
+	}
+}
+
+void SdrService::start()
+{
+	myEpoll = epoll_create1(EPOLL_CLOEXEC);
+	if (myEpoll < 0)
+		throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
+	myWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (myWakeFd < 0)
+		throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+	addToEpoll(myEpoll, myWakeFd, EPOLLIN, TagWake);
+
+	if (!myOptions.unixPath.empty())
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (myOptions.unixPath.size() >= sizeof(addr.sun_path))
+			throw std::runtime_error("Unix socket path is too long");
+		strcpy(addr.sun_path, myOptions.unixPath.c_str());
+		unlink(myOptions.unixPath.c_str());
+		myUnixListener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (myUnixListener < 0 ||
+			bind(myUnixListener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+			listen(myUnixListener, SOMAXCONN) != 0)
+			throw std::runtime_error("Unable to listen on " + myOptions.unixPath + ": " + strerror(errno));
+		addToEpoll(myEpoll, myUnixListener, EPOLLIN, TagUnix);
+	}
+
+	if (myOptions.tcpPort != 0)
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(static_cast<uint16_t>(myOptions.tcpPort));
+		if (inet_pton(AF_INET, myOptions.tcpAddress.c_str(), &addr.sin_addr) != 1)
+			throw std::runtime_error("Invalid TCP address " + myOptions.tcpAddress);
+		myTcpListener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		int on = 1;
+		if (myTcpListener < 0 ||
+			setsockopt(myTcpListener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+			bind(myTcpListener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+			listen(myTcpListener, SOMAXCONN) != 0)
+			throw std::runtime_error("Unable to listen on TCP port " + std::to_string(myOptions.tcpPort) + ": " + strerror(errno));
+		addToEpoll(myEpoll, myTcpListener, EPOLLIN, TagTcp);
+	}
+
+	if (myUnixListener < 0 && myTcpListener < 0)
+		throw std::runtime_error("No Unix socket path or TCP port was given");
+
+	for (size_t i = 0; i < myOptions.workers; i++)
+		myWorkers.emplace_back(&SdrService::workerLoop, this);
+}
+
+void SdrService::run()
+{
+	const int maxEvents = 256;
+	struct epoll_event events[maxEvents];
+	while (!myStopping)
+	{
+		int n = epoll_wait(myEpoll, events, maxEvents, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("epoll_wait failed: ") + strerror(errno));
+		}
+		for (int i = 0; i < n; i++)
+		{
+			uint64_t tag = events[i].data.u64;
+			if (tag == TagWake)
+			{
+				uint64_t count;
+				ssize_t rc = read(myWakeFd, &count, sizeof(count));
+				(void)rc;
+				drainCompletions();
+				continue;
+			}
+			if (tag == TagUnix || tag == TagTcp)
+			{
+				acceptAll(tag == TagUnix ? myUnixListener : myTcpListener);
+				continue;
+			}
+			auto item = myConnections.find(tag);
+			if (item == myConnections.end())
+				continue;
+			Connection& conn = *item->second;
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+			{
+				//
+				// These are reported whatever events are asked for, so stop
+				// watching the connection until its batch is done.
+				//
+				markClosing(conn);
+				if (conn.busy)
+					epoll_ctl(myEpoll, EPOLL_CTL_DEL, conn.fd, nullptr);
+			}
+			if (events[i].events & EPOLLOUT)
+				onWritable(conn);
+			if ((events[i].events & EPOLLIN) && !conn.closing)
+				onReadable(conn);
+			if (conn.closing && !conn.busy && conn.outStart == conn.out.size())
+				closeConnection(conn);
+		}
+	}
+}
+
+void SdrService::acceptAll(int listener)
+{
+	for (;;)
+	{
+		int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		if (listener == myTcpListener)
+		{
+			int on = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		}
+		std::unique_ptr<Connection> conn(new Connection());
+		conn->fd = fd;
+		conn->id = myNextConnection++;
+		addToEpoll(myEpoll, fd, EPOLLIN, conn->id);
+		myConnections[conn->id] = std::move(conn);
+		++myStatConnections;
+	}
+}
+
+void SdrService::onReadable(Connection& conn)
+{
+	//
+	// Read everything that is available.
+	//
+	const size_t chunk = 64 * 1024;
+	for (;;)
+	{
+		size_t used = conn.in.size();
+		conn.in.resize(used + chunk);
+		ssize_t rc = recv(conn.fd, &conn.in[used], chunk, 0);
+		conn.in.resize(used + (rc > 0 ? static_cast<size_t>(rc) : 0));
+		if (rc > 0)
+		{
+			myStatBytesIn += static_cast<uint64_t>(rc);
+			if (static_cast<size_t>(rc) < chunk)
+				break;
+			continue;
+		}
+		if (rc == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			markClosing(conn);
+		break;
+	}
+
+	//
+	// Split the input into complete requests; a partial frame stays in
+	// the buffer until the rest arrives.
+	//
+	while (conn.in.size() - conn.inStart >= SdrHeaderBytes)
+	{
+		SdrFrameHeader header = sdrUnpackHeader(&conn.in[conn.inStart]);
+		if (header.length > SdrMaxPayloadBytes)
+		{
+			markClosing(conn);
+			++myStatErrors;
+			break;
+		}
+		if (conn.in.size() - conn.inStart < SdrHeaderBytes + header.length)
+			break;
+		const uint8_t* payload = &conn.in[conn.inStart + SdrHeaderBytes];
+		Request request;
+		request.header = header;
+		request.payload.assign(payload, payload + header.length);
+		conn.pending.push_back(std::move(request));
+		conn.pendingBytes += header.length;
+		conn.inStart += SdrHeaderBytes + header.length;
+		++myStatRequests;
+	}
+	if (conn.inStart == conn.in.size())
+	{
+		conn.in.clear();
+		conn.inStart = 0;
+	}
+	else if (conn.inStart > conn.in.size() / 2)
+	{
+		conn.in.erase(conn.in.begin(), conn.in.begin() + conn.inStart);
+		conn.inStart = 0;
+	}
+
+	if (!conn.busy)
+		submit(conn);
+
+	//
+	// Stop reading while too much is waiting for the workers.
+	//
+	if (conn.reading && conn.pendingBytes > myOptions.maxPendingBytes)
+	{
+		conn.reading = false;
+		updateEvents(conn);
+	}
+}
+
+void SdrService::submit(Connection& conn)
+{
+	if (conn.pending.empty())
+		return;
+	std::unique_ptr<Batch> batch(new Batch());
+	batch->connection = conn.id;
+	if (conn.pending.size() <= myOptions.maxBatch)
+	{
+		batch->requests.swap(conn.pending);
+		conn.pendingBytes = 0;
+	}
+	else
+	{
+		auto end = conn.pending.begin() + static_cast<std::ptrdiff_t>(myOptions.maxBatch);
+		for (auto it = conn.pending.begin(); it != end; ++it)
+		{
+			conn.pendingBytes -= it->payload.size();
+			batch->requests.push_back(std::move(*it));
+		}
+		conn.pending.erase(conn.pending.begin(), end);
+	}
+	conn.busy = true;
+	++myStatBatches;
+
+	std::lock_guard<std::mutex> lock(myWorkMutex);
+	myWork.push_back(std::move(batch));
+	myWorkReady.notify_one();
+}
+
+void SdrService::drainCompletions()
+{
+	std::deque<std::unique_ptr<Batch> > done;
+	{
+		std::lock_guard<std::mutex> lock(myDoneMutex);
+		done.swap(myDone);
+	}
+	for (auto& batch : done)
+	{
+		auto item = myConnections.find(batch->connection);
+		if (item == myConnections.end())
+			continue;
+		Connection& conn = *item->second;
+		conn.busy = false;
+		if (conn.out.empty())
+		{
+			conn.out.swap(batch->responses);
+			conn.outStart = 0;
+		}
+		else
+		{
+			conn.out.insert(conn.out.end(), batch->responses.begin(), batch->responses.end());
+		}
+		onWritable(conn);
+
+		//
+		// Keep the pipeline going with whatever arrived meanwhile.
+		//
+		submit(conn);
+		if (!conn.reading && conn.pendingBytes <= myOptions.maxPendingBytes && !conn.closing)
+		{
+			conn.reading = true;
+			updateEvents(conn);
+		}
+		if (conn.closing && !conn.busy && conn.outStart == conn.out.size())
+			closeConnection(conn);
+	}
+}
+
+void SdrService::onWritable(Connection& conn)
+{
+	while (conn.outStart < conn.out.size())
+	{
+		ssize_t rc = send(conn.fd, &conn.out[conn.outStart], conn.out.size() - conn.outStart, MSG_NOSIGNAL);
+		if (rc > 0)
+		{
+			conn.outStart += static_cast<size_t>(rc);
+			myStatBytesOut += static_cast<uint64_t>(rc);
+			continue;
+		}
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			if (!conn.writing)
+			{
+				conn.writing = true;
+				updateEvents(conn);
+			}
+			return;
+		}
+		markClosing(conn);
+		conn.out.clear();
+		conn.outStart = 0;
+		return;
+	}
+	conn.out.clear();
+	conn.outStart = 0;
+	if (conn.writing)
+	{
+		conn.writing = false;
+		updateEvents(conn);
+	}
+}
+
+//
+// Marks the connection to be closed once its batch is done and its responses
+// are written. Its input is no longer wanted, so stop polling for it; a
+// level-triggered descriptor at end of file would otherwise wake epoll_wait
+// at once until the batch finishes.
+//
+void SdrService::markClosing(Connection& conn)
+{
+	conn.closing = true;
+	if (conn.reading)
+	{
+		conn.reading = false;
+		updateEvents(conn);
+	}
+}
+
+void SdrService::updateEvents(Connection& conn)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (conn.reading ? EPOLLIN : 0) | (conn.writing ? EPOLLOUT : 0);
+	ev.data.u64 = conn.id;
+	epoll_ctl(myEpoll, EPOLL_CTL_MOD, conn.fd, &ev);
+}
+
+void SdrService::closeConnection(Connection& conn)
+{
+	epoll_ctl(myEpoll, EPOLL_CTL_DEL, conn.fd, nullptr);
+	close(conn.fd);
+	//
+	// This destroys conn; a batch still with a worker is dropped when it
+	// completes.
+	//
+	myConnections.erase(conn.id);
+}
+
+#else
+
+SdrService::~SdrService()
+{
+}
+
+void SdrService::stop()
+{
+	myStopping = true;
+}
+
+void SdrService::start()
+{
+	throw std::runtime_error("The SDR service requires epoll and is only available on Linux.");
+}
+
+void SdrService::run()
+{
+}
+
+#endif
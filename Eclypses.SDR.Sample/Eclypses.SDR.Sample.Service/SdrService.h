@@ -0,0 +1,182 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SDRSERVICE_H
+#define SDRSERVICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "SdrProtocol.h"
+
+class MteSdrDisconnected;
+
+//******************************************************************************
+// Class SdrService
+//
+// A local Conceal/Reveal service. Clients connect over a Unix-domain socket
+// and/or TCP and send SdrProtocol frames.
+//
+// One thread runs an epoll event loop that owns every socket. All complete
+// requests read from a connection in one pass form a batch; a connection has
+// at most one batch with the workers at a time, so its responses stay in
+// request order while requests keep being read (pipelining). Batches are
+// processed by a pool of workers, each owning a warm MteSdrDisconnected, and
+// the encoded responses are handed back to the event loop to be written.
+//
+// To use, fill in the Options, construct, call start() and then run(). run()
+// blocks until stop() is called. Linux only.
+//******************************************************************************
+class SdrService
+{
+public:
+	struct Options
+	{
+		// Unix-domain socket path; blank for none.
+		std::string unixPath;
+		// TCP port on the loopback interface; 0 for none.
+		int tcpPort = 0;
+		// TCP address to bind to.
+		std::string tcpAddress = "127.0.0.1";
+		// The SDR security string.
+		std::string security = "SecurityString";
+		// Number of workers; 0 for one per hardware thread.
+		size_t workers = 0;
+		// The most requests in one batch.
+		size_t maxBatch = 64;
+		// Stop reading from a connection while this many bytes of requests
+		// are waiting for a worker.
+		size_t maxPendingBytes = 16 * 1024 * 1024;
+	};
+
+	struct Stats
+	{
+		uint64_t connections;
+		uint64_t requests;
+		uint64_t batches;
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		uint64_t errors;
+	};
+
+	explicit SdrService(const Options& options);
+	~SdrService();
+
+	//---------------------------------------------------------
+	// Creates the listening sockets and starts the workers.
+	// Throws an exception if a socket cannot be set up.
+	//---------------------------------------------------------
+	void start();
+
+	// Runs the event loop until stop() is called.
+	void run();
+
+	// Stops the event loop; safe to call from any thread or signal handler.
+	void stop();
+
+	Stats getStats() const;
+
+private:
+	struct Request
+	{
+		SdrFrameHeader header;
+		std::vector<uint8_t> payload;
+	};
+
+	// Requests from one connection, processed in order by one worker.
+	struct Batch
+	{
+		uint64_t connection;
+		std::vector<Request> requests;
+		std::vector<uint8_t> responses;
+	};
+
+	struct Connection
+	{
+		int fd;
+		uint64_t id;
+		std::vector<uint8_t> in;
+		size_t inStart = 0;
+		std::vector<uint8_t> out;
+		size_t outStart = 0;
+		std::vector<Request> pending;
+		size_t pendingBytes = 0;
+		bool busy = false;
+		bool reading = true;
+		bool writing = false;
+		bool closing = false;
+	};
+
+	void workerLoop();
+	void processBatch(MteSdrDisconnected& sdr, Batch& batch);
+
+	void acceptAll(int listener);
+	void onReadable(Connection& conn);
+	void onWritable(Connection& conn);
+	void drainCompletions();
+	void submit(Connection& conn);
+	void markClosing(Connection& conn);
+	void updateEvents(Connection& conn);
+	void closeConnection(Connection& conn);
+
+private:
+	Options myOptions;
+	std::atomic<bool> myStopping;
+
+	int myEpoll;
+	int myWakeFd;
+	int myUnixListener;
+	int myTcpListener;
+
+	std::unordered_map<uint64_t, std::unique_ptr<Connection> > myConnections;
+	uint64_t myNextConnection;
+
+	std::mutex myWorkMutex;
+	std::condition_variable myWorkReady;
+	std::deque<std::unique_ptr<Batch> > myWork;
+
+	std::mutex myDoneMutex;
+	std::deque<std::unique_ptr<Batch> > myDone;
+
+	std::vector<std::thread> myWorkers;
+
+	std::atomic<uint64_t> myStatConnections;
+	std::atomic<uint64_t> myStatRequests;
+	std::atomic<uint64_t> myStatBatches;
+	std::atomic<uint64_t> myStatBytesIn;
+	std::atomic<uint64_t> myStatBytesOut;
+	std::atomic<uint64_t> myStatErrors;
+};
+
+#endif // !SDRSERVICE_H
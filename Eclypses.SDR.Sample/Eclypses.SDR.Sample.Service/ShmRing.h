@@ -0,0 +1,396 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif
+
+//
+// The ring lives in memory shared between processes, so its atomics must not
+// fall back to a lock.
+//
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_INT_LOCK_FREE != 2
+#  error "ShmRing requires lock-free 32 and 64 bit atomics."
+#endif
+
+// The header in front of every message in a ring. The fields after the
+// sequence are the same as the SdrProtocol frame header.
+struct ShmSlot
+{
+	// Owned by the ring; the slot is ready to read when it is position + 1.
+	std::atomic<uint64_t> sequence;
+	// The ring position this slot was claimed for.
+	uint64_t position;
+	uint64_t id;
+	uint32_t length;
+	uint8_t op;
+	uint8_t status;
+	uint16_t reserved;
+
+	// The message bytes follow the header.
+	uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+	const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+};
+
+// The control block at the start of a ring. The counters written by each side
+// are on their own cache lines.
+struct ShmRingHeader
+{
+	uint32_t magic;
+	uint32_t slots;
+	uint32_t slotBytes;
+	uint32_t slotStride;
+
+	// The next position to claim; advanced by the producers.
+	alignas(64) std::atomic<uint64_t> head;
+	// The next position to read; advanced by the consumer.
+	alignas(64) std::atomic<uint64_t> tail;
+
+	// Bumped when a message is published while the consumer sleeps.
+	alignas(64) std::atomic<uint32_t> dataSignal;
+	std::atomic<uint32_t> dataWaiters;
+	// Bumped when a slot is released while a producer sleeps.
+	alignas(64) std::atomic<uint32_t> spaceSignal;
+	std::atomic<uint32_t> spaceWaiters;
+};
+
+//******************************************************************************
+// Class ShmRing
+//
+// A bounded ring of fixed size message slots in shared memory, for any number
+// of producers and one consumer. It is a view: the memory is owned by the
+// caller (normally a memfd mapped into both processes) and the same ring may
+// be viewed from several processes at once.
+//
+// Producers claim a slot, write the message into it in place and publish it;
+// the consumer peeks at the oldest message, uses it in place and releases it.
+// Each slot carries a sequence number, so producers only contend on the head
+// counter and the consumer never writes to a cache line a producer reads in
+// the common case.
+//
+// While the ring is busy no system calls are made. A side that finds nothing
+// to do spins briefly and then sleeps on a futex; the other side only makes
+// the wake call when it sees that someone is asleep.
+//******************************************************************************
+class ShmRing
+{
+public:
+	static const uint32_t Magic = 0x4D53524Eu;
+
+	ShmRing() : myHeader(nullptr), mySlots(nullptr), myMask(0), mySlotBytes(0), mySlotStride(0), mySpin(defaultSpin()) {}
+
+	// Polling only pays when the other side runs on another core, so do not
+	// spin on a single processor.
+	static unsigned defaultSpin()
+	{
+		return std::thread::hardware_concurrency() > 1 ? 2000 : 0;
+	}
+
+	//---------------------------------------------------------
+	// Returns the number of bytes needed for a ring of the given
+	// number of slots (a power of two) of slotBytes each.
+	//---------------------------------------------------------
+	static size_t bytesFor(uint32_t slots, uint32_t slotBytes)
+	{
+		return headerBytes() + static_cast<size_t>(slots) * strideFor(slotBytes);
+	}
+
+	//---------------------------------------------------------
+	// Formats a new ring in the memory, which must be at least
+	// bytesFor(slots, slotBytes) long and 64 byte aligned.
+	// Throws an exception if slots is not a power of two.
+	//---------------------------------------------------------
+	static ShmRing create(void* memory, uint32_t slots, uint32_t slotBytes)
+	{
+		if (slots == 0 || (slots & (slots - 1)) != 0)
+			throw std::runtime_error("The ring size must be a power of two.");
+		ShmRingHeader* header = new (memory) ShmRingHeader();
+		header->slots = slots;
+		header->slotBytes = slotBytes;
+		header->slotStride = static_cast<uint32_t>(strideFor(slotBytes));
+		header->head.store(0, std::memory_order_relaxed);
+		header->tail.store(0, std::memory_order_relaxed);
+		header->dataSignal.store(0, std::memory_order_relaxed);
+		header->dataWaiters.store(0, std::memory_order_relaxed);
+		header->spaceSignal.store(0, std::memory_order_relaxed);
+		header->spaceWaiters.store(0, std::memory_order_relaxed);
+		uint8_t* base = static_cast<uint8_t*>(memory) + headerBytes();
+		for (uint32_t i = 0; i < slots; i++)
+		{
+			ShmSlot* slot = new (base + static_cast<size_t>(i) * header->slotStride) ShmSlot();
+			slot->sequence.store(i, std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = Magic;
+		return attach(memory, bytesFor(slots, slotBytes));
+	}
+
+	//---------------------------------------------------------
+	// Views a ring formatted by create(), possibly in another
+	// process. Throws an exception if the memory is not a ring or
+	// is shorter than the ring claims to be.
+	//---------------------------------------------------------
+	static ShmRing attach(void* memory, size_t bytes)
+	{
+		//
+		// The peer can write the header at any time, so the geometry is
+		// read once, checked and kept; the header is not read for it again.
+		//
+		if (bytes < headerBytes())
+			throw std::runtime_error("The shared memory does not hold a valid ring.");
+		ShmRingHeader* header = static_cast<ShmRingHeader*>(memory);
+		uint32_t slots = header->slots;
+		uint32_t slotBytes = header->slotBytes;
+		uint32_t slotStride = header->slotStride;
+		if (header->magic != Magic ||
+			slots == 0 || (slots & (slots - 1)) != 0 ||
+			slotStride != strideFor(slotBytes) ||
+			bytesFor(slots, slotBytes) > bytes)
+			throw std::runtime_error("The shared memory does not hold a valid ring.");
+		ShmRing ring;
+		ring.myHeader = header;
+		ring.mySlots = static_cast<uint8_t*>(memory) + headerBytes();
+		ring.myMask = slots - 1;
+		ring.mySlotBytes = slotBytes;
+		ring.mySlotStride = slotStride;
+		return ring;
+	}
+
+	// The largest message a slot holds.
+	uint32_t slotBytes() const { return mySlotBytes; }
+
+	// Sets how many times to poll before sleeping.
+	void setSpin(unsigned spin) { mySpin = spin; }
+
+	//---------------------------------------------------------
+	// Claims the next free slot for writing, or returns nullptr if
+	// the ring is full. Safe to call from several producers.
+	//---------------------------------------------------------
+	ShmSlot* tryClaim()
+	{
+		uint64_t position = myHeader->head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			ShmSlot* slot = slotAt(position);
+			uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+			int64_t diff = static_cast<int64_t>(sequence - position);
+			if (diff == 0)
+			{
+				if (myHeader->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					slot->position = position;
+					return slot;
+				}
+			}
+			else if (diff < 0)
+				return nullptr;
+			else
+				position = myHeader->head.load(std::memory_order_relaxed);
+		}
+	}
+
+	//---------------------------------------------------------
+	// Claims a slot, waiting up to timeoutMs while the ring is
+	// full. Returns nullptr on timeout.
+	//---------------------------------------------------------
+	ShmSlot* claim(int timeoutMs)
+	{
+		return waitFor(myHeader->spaceSignal, myHeader->spaceWaiters, timeoutMs,
+			[this] { return tryClaim(); });
+	}
+
+	//---------------------------------------------------------
+	// Makes a claimed slot visible to the consumer and wakes it if
+	// it is asleep.
+	//---------------------------------------------------------
+	void publish(ShmSlot* slot)
+	{
+		slot->sequence.store(slot->position + 1, std::memory_order_release);
+		wake(myHeader->dataSignal, myHeader->dataWaiters);
+	}
+
+	//---------------------------------------------------------
+	// Returns the oldest published message, or nullptr if there is
+	// none. Consumer only.
+	//---------------------------------------------------------
+	ShmSlot* tryPeek()
+	{
+		uint64_t position = myHeader->tail.load(std::memory_order_relaxed);
+		ShmSlot* slot = slotAt(position);
+		if (slot->sequence.load(std::memory_order_acquire) != position + 1)
+			return nullptr;
+		return slot;
+	}
+
+	//---------------------------------------------------------
+	// Returns the oldest message, waiting up to timeoutMs for one.
+	// Returns nullptr on timeout. Consumer only.
+	//---------------------------------------------------------
+	ShmSlot* peek(int timeoutMs)
+	{
+		return waitFor(myHeader->dataSignal, myHeader->dataWaiters, timeoutMs,
+			[this] { return tryPeek(); });
+	}
+
+	//---------------------------------------------------------
+	// Frees the slot returned by peek() for the producers and wakes
+	// one if it is waiting. Consumer only.
+	//---------------------------------------------------------
+	void release(ShmSlot* slot)
+	{
+		uint64_t position = myHeader->tail.load(std::memory_order_relaxed);
+		slot->sequence.store(position + myMask + 1, std::memory_order_release);
+		myHeader->tail.store(position + 1, std::memory_order_relaxed);
+		wake(myHeader->spaceSignal, myHeader->spaceWaiters);
+	}
+
+	// Wakes every waiter on both sides, e.g. when shutting down.
+	void wakeAll()
+	{
+		myHeader->dataSignal.fetch_add(1);
+		myHeader->spaceSignal.fetch_add(1);
+		futexWake(myHeader->dataSignal);
+		futexWake(myHeader->spaceSignal);
+	}
+
+private:
+	static size_t headerBytes()
+	{
+		return (sizeof(ShmRingHeader) + 63) & ~static_cast<size_t>(63);
+	}
+
+	static size_t strideFor(uint32_t slotBytes)
+	{
+		return (sizeof(ShmSlot) + slotBytes + 63) & ~static_cast<size_t>(63);
+	}
+
+	ShmSlot* slotAt(uint64_t position) const
+	{
+		return reinterpret_cast<ShmSlot*>(mySlots + (position & myMask) * mySlotStride);
+	}
+
+	static void cpuRelax()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	//
+	// Polls, then sleeps until signalled. The waiter count is raised before
+	// the final poll and the publisher reads it after its store, so between
+	// the two fences at least one side sees the other and no wake is lost.
+	//
+	template <typename Poll>
+	ShmSlot* waitFor(std::atomic<uint32_t>& signal, std::atomic<uint32_t>& waiters,
+		int timeoutMs, Poll poll)
+	{
+		for (unsigned i = 0; i < mySpin; i++)
+		{
+			ShmSlot* slot = poll();
+			if (slot != nullptr)
+				return slot;
+			cpuRelax();
+		}
+		std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		for (;;)
+		{
+			uint32_t observed = signal.load(std::memory_order_acquire);
+			waiters.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ShmSlot* slot = poll();
+			if (slot != nullptr)
+			{
+				waiters.fetch_sub(1, std::memory_order_relaxed);
+				return slot;
+			}
+			int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+			if (remaining > 0)
+				futexWait(signal, observed, static_cast<int>(remaining));
+			waiters.fetch_sub(1, std::memory_order_relaxed);
+			slot = poll();
+			if (slot != nullptr || remaining <= 0)
+				return slot;
+		}
+	}
+
+	static void wake(std::atomic<uint32_t>& signal, std::atomic<uint32_t>& waiters)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_relaxed) == 0)
+			return;
+		signal.fetch_add(1, std::memory_order_release);
+		futexWake(signal);
+	}
+
+#if defined(__linux__)
+	// The futexes are shared between processes, so FUTEX_PRIVATE_FLAG is not used.
+	static void futexWait(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs)
+	{
+		struct timespec timeout;
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+	}
+
+	static void futexWake(std::atomic<uint32_t>& word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+#else
+	static void futexWait(std::atomic<uint32_t>&, uint32_t, int) {}
+	static void futexWake(std::atomic<uint32_t>&) {}
+#endif
+
+private:
+	ShmRingHeader* myHeader;
+	uint8_t* mySlots;
+	uint64_t myMask;
+	uint32_t mySlotBytes;
+	size_t mySlotStride;
+	unsigned mySpin;
+};
+
+#endif // !SHMRING_H
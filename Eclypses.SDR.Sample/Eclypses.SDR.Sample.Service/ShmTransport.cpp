@@ -0,0 +1,596 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "ShmTransport.h"
+
+#if defined(__linux__)
+#  include <poll.h>
+#  include <sys/mman.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+//
+// The control block at the start of a channel; the two rings follow it.
+//
+struct ShmChannelHeader
+{
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t requestOffset;
+	uint64_t responseOffset;
+	uint64_t totalBytes;
+	std::atomic<uint32_t> closed;
+};
+
+static const uint32_t ChannelMagic = 0x4D534348u;
+static const size_t ChannelHeaderBytes = 64;
+
+// How long a blocked side sleeps before checking for shutdown.
+static const int IdleCheckMs = 100;
+
+static size_t roundUp64(size_t bytes)
+{
+	return (bytes + 63) & ~static_cast<size_t>(63);
+}
+
+ShmChannel::ShmChannel() : myFd(-1), myMemory(nullptr), myBytes(0)
+{
+}
+
+bool ShmChannel::closed() const
+{
+	return myMemory == nullptr ||
+		static_cast<const ShmChannelHeader*>(myMemory)->closed.load(std::memory_order_acquire) != 0;
+}
+
+void ShmChannel::close()
+{
+	if (myMemory == nullptr)
+		return;
+	static_cast<ShmChannelHeader*>(myMemory)->closed.store(1, std::memory_order_release);
+	myRequests.wakeAll();
+	myResponses.wakeAll();
+}
+
+#if defined(__linux__)
+
+ShmChannel::~ShmChannel()
+{
+	if (myMemory != nullptr)
+		munmap(myMemory, myBytes);
+	if (myFd >= 0)
+		::close(myFd);
+}
+
+void ShmChannel::map(size_t bytes)
+{
+	void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, myFd, 0);
+	if (memory == MAP_FAILED)
+		throw std::runtime_error(std::string("Unable to map the channel: ") + strerror(errno));
+	myMemory = memory;
+	myBytes = bytes;
+}
+
+void ShmChannel::create(uint32_t slots, uint32_t slotBytes)
+{
+	size_t ringBytes = roundUp64(ShmRing::bytesFor(slots, slotBytes));
+	size_t total = ChannelHeaderBytes + 2 * ringBytes;
+	myFd = memfd_create("mte-sdr-channel", MFD_CLOEXEC);
+	if (myFd < 0 || ftruncate(myFd, static_cast<off_t>(total)) != 0)
+		throw std::runtime_error(std::string("Unable to create the channel: ") + strerror(errno));
+	map(total);
+
+	ShmChannelHeader* header = new (myMemory) ShmChannelHeader();
+	header->requestOffset = ChannelHeaderBytes;
+	header->responseOffset = ChannelHeaderBytes + ringBytes;
+	header->totalBytes = total;
+	header->closed.store(0, std::memory_order_relaxed);
+	uint8_t* base = static_cast<uint8_t*>(myMemory);
+	myRequests = ShmRing::create(base + header->requestOffset, slots, slotBytes);
+	myResponses = ShmRing::create(base + header->responseOffset, slots, slotBytes);
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = ChannelMagic;
+}
+
+void ShmChannel::attach(int fd)
+{
+	myFd = fd;
+	struct stat st;
+	if (fstat(myFd, &st) != 0 || static_cast<size_t>(st.st_size) < ChannelHeaderBytes)
+		throw std::runtime_error("The channel descriptor is not a channel.");
+	size_t total = static_cast<size_t>(st.st_size);
+	map(total);
+
+	//
+	// The peer wrote the layout; check it fits before trusting it.
+	//
+	const ShmChannelHeader* header = static_cast<const ShmChannelHeader*>(myMemory);
+	if (header->magic != ChannelMagic || header->totalBytes != total ||
+		header->requestOffset != ChannelHeaderBytes ||
+		header->responseOffset <= header->requestOffset ||
+		header->responseOffset >= total || header->responseOffset % 64 != 0)
+		throw std::runtime_error("The channel descriptor is not a channel.");
+	uint8_t* base = static_cast<uint8_t*>(myMemory);
+	myRequests = ShmRing::attach(base + header->requestOffset,
+		static_cast<size_t>(header->responseOffset - header->requestOffset));
+	myResponses = ShmRing::attach(base + header->responseOffset,
+		static_cast<size_t>(total - header->responseOffset));
+}
+
+//
+// Sends or receives one byte with an optional descriptor attached.
+//
+static bool sendWithFd(int socket, uint8_t byte, int fd)
+{
+	struct iovec iov;
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	union
+	{
+		char buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	if (fd >= 0)
+	{
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buffer;
+		msg.msg_controllen = sizeof(control.buffer);
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+	return sendmsg(socket, &msg, MSG_NOSIGNAL) == 1;
+}
+
+static bool receiveWithFd(int socket, uint8_t& byte, int& fd)
+{
+	fd = -1;
+	struct iovec iov;
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	union
+	{
+		char buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
+	ssize_t rc;
+	do
+	{
+		rc = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+	} while (rc < 0 && errno == EINTR);
+	if (rc != 1)
+		return false;
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	return true;
+}
+
+//
+// Returns true if the peer has closed its end of the socket.
+//
+static bool peerGone(int socket)
+{
+	struct pollfd pfd;
+	pfd.fd = socket;
+	pfd.events = POLLRDHUP;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) != 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR)) != 0;
+}
+
+ShmService::ShmService(const Options& options) :
+	myOptions(options), myStopping(false), myListener(-1),
+	myStatChannels(0), myStatRequests(0), myStatErrors(0)
+{
+}
+
+ShmService::~ShmService()
+{
+	stop();
+	for (auto& t : myThreads)
+	{
+		if (t.joinable())
+			t.join();
+	}
+	if (myListener >= 0)
+	{
+		::close(myListener);
+		unlink(myOptions.unixPath.c_str());
+	}
+}
+
+void ShmService::start()
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (myOptions.unixPath.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("Unix socket path is too long");
+	strcpy(addr.sun_path, myOptions.unixPath.c_str());
+	unlink(myOptions.unixPath.c_str());
+	myListener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (myListener < 0 ||
+		bind(myListener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+		listen(myListener, 64) != 0)
+		throw std::runtime_error("Unable to listen on " + myOptions.unixPath + ": " + strerror(errno));
+}
+
+void ShmService::run()
+{
+	while (!myStopping)
+	{
+		reapChannels();
+		struct pollfd pfd;
+		pfd.fd = myListener;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, IdleCheckMs) <= 0)
+			continue;
+		int socket = accept4(myListener, nullptr, nullptr, SOCK_CLOEXEC);
+		if (socket < 0)
+			continue;
+		std::lock_guard<std::mutex> lock(myThreadsMutex);
+		myThreads.emplace_back(&ShmService::serveChannel, this, socket);
+	}
+
+	//
+	// The threads take the lock as they finish, so join them without it.
+	//
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> lock(myThreadsMutex);
+		threads.swap(myThreads);
+	}
+	for (auto& t : threads)
+		t.join();
+	std::lock_guard<std::mutex> lock(myThreadsMutex);
+	myFinished.clear();
+}
+
+//
+// Joins the threads of channels that have closed, so a long-running service
+// keeps only the threads of its open channels.
+//
+void ShmService::reapChannels()
+{
+	std::lock_guard<std::mutex> lock(myThreadsMutex);
+	for (std::thread::id id : myFinished)
+	{
+		for (size_t i = 0; i < myThreads.size(); i++)
+		{
+			if (myThreads[i].get_id() == id)
+			{
+				myThreads[i].join();
+				myThreads.erase(myThreads.begin() + i);
+				break;
+			}
+		}
+	}
+	myFinished.clear();
+}
+
+void ShmService::serveChannel(int socket)
+{
+	try
+	{
+		uint8_t hello = 0;
+		int fd = -1;
+		if (!receiveWithFd(socket, hello, fd) || fd < 0)
+			throw std::runtime_error("The client did not send a channel.");
+		ShmChannel channel;
+		channel.attach(fd);
+		ShmRing& requests = channel.requests();
+		ShmRing& responses = channel.responses();
+		requests.setSpin(myOptions.spin);
+		responses.setSpin(myOptions.spin);
+
+		MteSdrDisconnected sdr = MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes);
+		sdr.initSdr(myOptions.security);
+		++myStatChannels;
+		if (!sendWithFd(socket, 1, -1))
+			throw std::runtime_error("The client went away.");
+
+		while (!myStopping && !channel.closed())
+		{
+			ShmSlot* request = requests.peek(IdleCheckMs);
+			if (request == nullptr)
+			{
+				if (peerGone(socket))
+					break;
+				continue;
+			}
+			//
+			// Responses are written in request order, so wait for room.
+			//
+			ShmSlot* response = nullptr;
+			while (response == nullptr && !myStopping && !channel.closed())
+			{
+				response = responses.claim(IdleCheckMs);
+				if (response == nullptr && peerGone(socket))
+					break;
+			}
+			if (response == nullptr)
+				break;
+			process(sdr, *request, requests.slotBytes(), *response, responses.slotBytes());
+			requests.release(request);
+			responses.publish(response);
+			++myStatRequests;
+		}
+		channel.close();
+	}
+	catch (const std::exception&)
+	{
+		++myStatErrors;
+	}
+	::close(socket);
+	std::lock_guard<std::mutex> lock(myThreadsMutex);
+	myFinished.push_back(std::this_thread::get_id());
+}
+
+ShmClient::~ShmClient()
+{
+	myChannel.close();
+	if (mySocket >= 0)
+		::close(mySocket);
+}
+
+void ShmClient::connect(const std::string& path, uint32_t slots, uint32_t slotBytes)
+{
+	myChannel.create(slots, slotBytes);
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("Unix socket path is too long");
+	strcpy(addr.sun_path, path.c_str());
+	mySocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (mySocket < 0 || ::connect(mySocket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+		throw std::runtime_error("Unable to connect to " + path + ": " + strerror(errno));
+
+	//
+	// Hand over the channel and wait for the worker to be ready.
+	//
+	uint8_t ready = 0;
+	int unused = -1;
+	if (!sendWithFd(mySocket, 0, myChannel.fd()) || !receiveWithFd(mySocket, ready, unused) || ready != 1)
+		throw std::runtime_error("The service did not accept the channel.");
+}
+
+#else
+
+ShmChannel::~ShmChannel()
+{
+}
+
+void ShmChannel::map(size_t)
+{
+}
+
+void ShmChannel::create(uint32_t, uint32_t)
+{
+	throw std::runtime_error("Shared memory channels are only available on Linux.");
+}
+
+void ShmChannel::attach(int)
+{
+	throw std::runtime_error("Shared memory channels are only available on Linux.");
+}
+
+ShmService::ShmService(const Options& options) :
+	myOptions(options), myStopping(false), myListener(-1),
+	myStatChannels(0), myStatRequests(0), myStatErrors(0)
+{
+}
+
+ShmService::~ShmService()
+{
+}
+
+void ShmService::start()
+{
+	throw std::runtime_error("The shared memory service is only available on Linux.");
+}
+
+void ShmService::run()
+{
+}
+
+void ShmService::serveChannel(int)
+{
+}
+
+void ShmService::reapChannels()
+{
+}
+
+ShmClient::~ShmClient()
+{
+}
+
+void ShmClient::connect(const std::string&, uint32_t, uint32_t)
+{
+	throw std::runtime_error("The shared memory client is only available on Linux.");
+}
+
+#endif
+
+void ShmService::stop()
+{
+	myStopping = true;
+}
+
+ShmService::Stats ShmService::getStats() const
+{
+	Stats stats;
+	stats.channels = myStatChannels;
+	stats.requests = myStatRequests;
+	stats.errors = myStatErrors;
+	return stats;
+}
+
+//
+// Sets the response to an error message.
+//
+static void setError(ShmSlot& response, SdrStatus status, const char* message, uint32_t responseBytes)
+{
+	size_t length = std::min<size_t>(strlen(message), responseBytes);
+	response.status = static_cast<uint8_t>(status);
+	response.length = static_cast<uint32_t>(length);
+	memcpy(response.data(), message, length);
+}
+
+void ShmService::process(MteSdrDisconnected& sdr, const ShmSlot& request, uint32_t requestBytes,
+	ShmSlot& response, uint32_t responseBytes)
+{
+	response.id = request.id;
+	response.op = request.op;
+	response.status = SdrStatusOk;
+	response.reserved = 0;
+	response.length = 0;
+
+	//
+	// The length was written by the client, so check it against the slot.
+	//
+	uint32_t requestLength = request.length;
+	if (requestLength > requestBytes)
+	{
+		setError(response, SdrStatusBadRequest, "The request is longer than a slot", responseBytes);
+		++myStatErrors;
+		return;
+	}
+	try
+	{
+		size_t resultLen = 0;
+		switch (request.op)
+		{
+		case SdrOpPing:
+			break;
+		case SdrOpConceal:
+		{
+			//
+			// The leased result goes back to this worker's pool once copied.
+			//
+			MteBufferPool::Lease concealed = sdr.Conceal(request.data(), requestLength);
+			resultLen = concealed.size();
+			if (resultLen <= responseBytes)
+			{
+				memcpy(response.data(), concealed.data(), resultLen);
+				response.length = static_cast<uint32_t>(resultLen);
+			}
+			else
+			{
+				setError(response, SdrStatusFailed, "The concealed data does not fit in a slot", responseBytes);
+				++myStatErrors;
+			}
+			break;
+		}
+		case SdrOpReveal:
+		{
+			MteBufferPool::Lease revealed = sdr.Reveal(request.data(), requestLength);
+			resultLen = revealed.size();
+			if (resultLen <= responseBytes)
+			{
+				memcpy(response.data(), revealed.data(), resultLen);
+				response.length = static_cast<uint32_t>(resultLen);
+			}
+			else
+			{
+				setError(response, SdrStatusFailed, "The revealed data does not fit in a slot", responseBytes);
+				++myStatErrors;
+			}
+			break;
+		}
+		default:
+			setError(response, SdrStatusBadRequest, "Unknown operation", responseBytes);
+			++myStatErrors;
+			break;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		setError(response, SdrStatusFailed, e.what(), responseBytes);
+		++myStatErrors;
+	}
+}
+
+ShmClient::ShmClient() : mySocket(-1), myNextId(1)
+{
+}
+
+void ShmClient::call(SdrOp op, const uint8_t* data, size_t dataLen, std::vector<uint8_t>& result)
+{
+	if (dataLen > requests().slotBytes())
+		throw std::runtime_error("The request is longer than a slot.");
+	ShmSlot* request = requests().claim(1000);
+	if (request == nullptr)
+		throw std::runtime_error("The service is not taking requests.");
+	request->id = myNextId++;
+	request->op = static_cast<uint8_t>(op);
+	request->status = 0;
+	request->reserved = 0;
+	request->length = static_cast<uint32_t>(dataLen);
+	if (dataLen != 0)
+		memcpy(request->data(), data, dataLen);
+	requests().publish(request);
+
+	ShmSlot* response = nullptr;
+	while (response == nullptr)
+	{
+		if (myChannel.closed())
+			throw std::runtime_error("The service closed the channel.");
+		response = responses().peek(IdleCheckMs);
+	}
+	result.assign(response->data(), response->data() + response->length);
+	uint8_t status = response->status;
+	responses().release(response);
+	if (status != SdrStatusOk)
+		throw std::runtime_error("The service returned an error: " + std::string(result.begin(), result.end()));
+}
@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#pragma once
+#ifndef SHMTRANSPORT_H
+#define SHMTRANSPORT_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SdrProtocol.h"
+#include "ShmRing.h"
+
+class MteSdrDisconnected;
+
+//******************************************************************************
+// Class ShmChannel
+//
+// One memfd holding a request ring and a response ring. The client creates
+// the channel and passes the file descriptor to the service over a Unix-domain
+// socket; from then on both processes work on the same pages and messages are
+// never copied through the kernel.
+//******************************************************************************
+class ShmChannel
+{
+public:
+	ShmChannel();
+	~ShmChannel();
+
+	//---------------------------------------------------------
+	// Creates and maps a new channel with "slots" messages of up
+	// to slotBytes each in both rings. Throws an exception on
+	// failure.
+	//---------------------------------------------------------
+	void create(uint32_t slots, uint32_t slotBytes);
+
+	//---------------------------------------------------------
+	// Maps a channel created by a peer; takes ownership of the
+	// descriptor. Throws an exception if it is not a channel.
+	//---------------------------------------------------------
+	void attach(int fd);
+
+	int fd() const { return myFd; }
+	ShmRing& requests() { return myRequests; }
+	ShmRing& responses() { return myResponses; }
+
+	// Returns true once either side has closed the channel.
+	bool closed() const;
+
+	// Marks the channel closed and wakes anyone waiting on it.
+	void close();
+
+private:
+	void map(size_t bytes);
+
+	int myFd;
+	void* myMemory;
+	size_t myBytes;
+	ShmRing myRequests;
+	ShmRing myResponses;
+
+	ShmChannel(const ShmChannel&);
+	ShmChannel& operator=(const ShmChannel&);
+};
+
+//******************************************************************************
+// Class ShmService
+//
+// The shared memory counterpart of SdrService for processes on the same host.
+// A client connects to the Unix-domain socket and sends the descriptor of a
+// ShmChannel; the service maps it and dedicates a worker, owning a warm
+// MteSdrDisconnected, to that channel.
+//
+// Requests are SdrProtocol operations written in place into the request ring;
+// the worker reads them in place, makes each result in a buffer from its pool
+// and copies it into the response ring, in request order. Several threads of a client may share one
+// channel's request ring. The socket stays open only so either side notices
+// when the other goes away.
+//
+// To use, fill in the Options, construct, call start() and then run(). run()
+// blocks until stop() is called. Linux only.
+//******************************************************************************
+class ShmService
+{
+public:
+	struct Options
+	{
+		// Unix-domain socket path that channels are handed over on.
+		std::string unixPath = "/tmp/mte-sdr-shm.sock";
+		// The SDR security string.
+		std::string security = "SecurityString";
+		// How many times a worker polls an idle ring before sleeping.
+		unsigned spin = ShmRing::defaultSpin();
+	};
+
+	struct Stats
+	{
+		uint64_t channels;
+		uint64_t requests;
+		uint64_t errors;
+	};
+
+	explicit ShmService(const Options& options);
+	~ShmService();
+
+	//---------------------------------------------------------
+	// Creates the listening socket. Throws an exception if it
+	// cannot be set up.
+	//---------------------------------------------------------
+	void start();
+
+	// Accepts channels until stop() is called, then waits for
+	// their workers to finish.
+	void run();
+
+	// Stops the service; safe to call from any thread or signal handler.
+	void stop();
+
+	Stats getStats() const;
+
+private:
+	void serveChannel(int socket);
+	void reapChannels();
+	void process(MteSdrDisconnected& sdr, const ShmSlot& request, uint32_t requestBytes,
+		ShmSlot& response, uint32_t responseBytes);
+
+private:
+	Options myOptions;
+	std::atomic<bool> myStopping;
+	int myListener;
+
+	std::mutex myThreadsMutex;
+	std::vector<std::thread> myThreads;
+	// The channel threads that have finished and are waiting to be joined.
+	std::vector<std::thread::id> myFinished;
+
+	std::atomic<uint64_t> myStatChannels;
+	std::atomic<uint64_t> myStatRequests;
+	std::atomic<uint64_t> myStatErrors;
+};
+
+//******************************************************************************
+// Class ShmClient
+//
+// Connects a new ShmChannel to a ShmService. Callers write requests in place:
+// claim a slot from requests(), fill in op, id, length and data(), and
+// publish it; then peek at responses() and release each one when done with
+// it. call() does all of this for a single request.
+//
+// Throws an exception on failure. Linux only.
+//******************************************************************************
+class ShmClient
+{
+public:
+	ShmClient();
+	~ShmClient();
+
+	//---------------------------------------------------------
+	// Creates a channel of "slots" messages of up to slotBytes
+	// each and hands it to the service listening on path. Returns
+	// once the service's worker is ready.
+	//---------------------------------------------------------
+	void connect(const std::string& path, uint32_t slots, uint32_t slotBytes);
+
+	ShmRing& requests() { return myChannel.requests(); }
+	ShmRing& responses() { return myChannel.responses(); }
+
+	// Sends one request and waits for its response. Throws an exception
+	// if the service reports an error or does not answer.
+	void call(SdrOp op, const uint8_t* data, size_t dataLen, std::vector<uint8_t>& result);
+
+private:
+	int mySocket;
+	uint64_t myNextId;
+	ShmChannel myChannel;
+
+	ShmClient(const ShmClient&);
+	ShmClient& operator=(const ShmClient&);
+};
+
+#endif // !SHMTRANSPORT_H
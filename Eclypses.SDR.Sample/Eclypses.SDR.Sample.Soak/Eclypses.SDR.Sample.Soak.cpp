@@ -0,0 +1,282 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "MteBase.h"
+#include "MteSdr.h"
+#include "MteSdrDisconnected.h"
+#include "BenchAlloc.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(disable:4996)
+#endif
+
+std::string getItemFromSettings(std::string key) {
+	std::ifstream file("./settings.txt");
+	std::string s;
+	while (std::getline(file, s)) {
+		std::size_t found = s.find(key);
+		if (found != std::string::npos) {
+			std::size_t eq = s.find('=');
+			if (eq != std::string::npos) {
+				return s.substr(eq + 1);
+			}
+		}
+	}
+	return "";
+}
+
+static void usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Eclypses.SDR.Sample.Soak [--calls N] [--sizes n,n,...] [--threads N] [--checkpoints N]" << std::endl;
+	std::cout << "                           [--report seconds]" << std::endl;
+	std::cout << "      Runs N Conceal / Reveal pairs (default 2000000) over each thread's SDR, cycling through" << std::endl;
+	std::cout << "      the sizes (default 16,256,4096,65536), and fails if the live bytes of the SDR buffers or" << std::endl;
+	std::cout << "      the number of live heap allocations grew between the first checkpoint and any later one." << std::endl;
+	std::cout << "      --report prints the SDR memory every interval while it runs." << std::endl;
+}
+
+static std::vector<size_t> parseList(const std::string& list)
+{
+	std::vector<size_t> values;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		if (comma > start)
+			values.push_back(std::strtoul(list.substr(start, comma - start).c_str(), nullptr, 10));
+		start = comma + 1;
+	}
+	return values;
+}
+
+//
+// The SDR memory and the heap allocations still live, taken while no
+// Conceal or Reveal is running.
+//
+struct Checkpoint
+{
+	std::vector<MteSdrAlloc::SiteStats> sites;
+	uint64_t liveAllocations;
+};
+
+static uint64_t liveAllocations()
+{
+	BenchAllocCounts counts = benchAllocCounts();
+	return counts.allocations - counts.frees;
+}
+
+// Counts the allocations before making the list of sites, so a checkpoint
+// does not count itself.
+static Checkpoint checkpoint()
+{
+	Checkpoint c;
+	c.liveAllocations = liveAllocations();
+	c.sites = MteSdr::getAllocStats();
+	return c;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "Eclypses MteSdr Soak Test" << std::endl;
+
+	uint64_t calls = 2000000;
+	std::vector<size_t> sizes = parseList("16,256,4096,65536");
+	size_t threads = 1;
+	size_t checkpoints = 10;
+	double reportSeconds = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--calls" && hasValue)
+			calls = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--sizes" && hasValue)
+			sizes = parseList(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+			threads = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--checkpoints" && hasValue)
+			checkpoints = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--report" && hasValue)
+			reportSeconds = std::atof(argv[++i]);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (sizes.empty() || threads == 0 || checkpoints < 2)
+	{
+		usage();
+		return 1;
+	}
+
+	//
+	// Initialize MTE license.
+	//
+	std::string company = getItemFromSettings("LicensedCompany");
+	std::string license = getItemFromSettings("LicenseKey");
+	if (!MteBase::initLicense(company.c_str(), license.c_str()))
+	{
+		std::cerr << "License init error ("
+			<< MteBase::getStatusName(mte_status_license_error)
+			<< "): "
+			<< MteBase::getStatusDescription(mte_status_license_error)
+			<< std::endl;
+		return mte_status_license_error;
+	}
+	std::cout << "Version of MTE Library: " << MteBase::getVersion() << " - licensed to: " << company << std::endl;
+	std::cout << "---------------------------" << std::endl;
+
+	size_t maxSize = 0;
+	for (size_t size : sizes)
+		maxSize = std::max(maxSize, size);
+	std::vector<uint8_t> payload(maxSize);
+	MteRandom::getBytes(payload.data(), payload.size());
+
+	std::vector<std::unique_ptr<MteSdrDisconnected> > sdrs;
+	for (size_t t = 0; t < threads; t++)
+	{
+		sdrs.emplace_back(new MteSdrDisconnected((mte_sdr_random)MteRandom::getBytes));
+		sdrs.back()->initSdr("SecurityString");
+	}
+
+	//
+	// Runs pairs on every thread; throws if a value does not round trip.
+	//
+	auto runPairs = [&](uint64_t pairsPerThread)
+	{
+		std::vector<std::thread> workers;
+		std::vector<std::string> errors(threads);
+		for (size_t t = 0; t < threads; t++)
+		{
+			workers.emplace_back([&, t]
+				{
+					try
+					{
+						MteSdrDisconnected& sdr = *sdrs[t];
+						for (uint64_t i = 0; i < pairsPerThread; i++)
+						{
+							size_t size = sizes[i % sizes.size()];
+							size_t concealedBytes;
+							uint8_t* concealed = sdr.Conceal(payload.data(), size, concealedBytes);
+							size_t clearBytes;
+							sdr.Reveal(concealed, concealedBytes, clearBytes);
+							delete[] concealed;
+							if (clearBytes != size)
+								throw std::runtime_error("A revealed value has the wrong size.");
+						}
+					}
+					catch (const std::exception& e)
+					{
+						errors[t] = e.what();
+					}
+				});
+		}
+		for (auto& w : workers)
+			w.join();
+		for (const std::string& e : errors)
+		{
+			if (!e.empty())
+				throw std::runtime_error(e);
+		}
+	};
+
+	if (reportSeconds > 0)
+		MteSdr::startAllocReport(std::cout, reportSeconds);
+	bool failed = false;
+	try
+	{
+		//
+		// The first checkpoint is after the first share of the calls, by
+		// when every size has been used on every thread, so the scratch
+		// buffers have reached their size and anything allocated once, by
+		// the library or the tool, has been.
+		//
+		uint64_t perThread = calls / threads;
+		std::cout << "Running " << perThread * threads << " Conceal / Reveal pairs on " << threads
+			<< " thread(s) with " << checkpoints << " checkpoints" << std::endl;
+		runPairs(std::max<uint64_t>(perThread / checkpoints, sizes.size() * 2));
+		Checkpoint first = checkpoint();
+		// The later checkpoints count this one's list of sites.
+		first.liveAllocations = liveAllocations();
+		std::cout << "checkpoint 1: SDR live bytes " << MteSdrAlloc::liveBytes(first.sites) << ", live allocations "
+			<< first.liveAllocations << std::endl;
+		for (size_t c = 2; c <= checkpoints; c++)
+		{
+			uint64_t done = perThread * (c - 1) / checkpoints;
+			runPairs(perThread * c / checkpoints - done);
+			Checkpoint now = checkpoint();
+			int64_t growth = static_cast<int64_t>(MteSdrAlloc::liveBytes(now.sites)) -
+				static_cast<int64_t>(MteSdrAlloc::liveBytes(first.sites));
+			int64_t allocationGrowth = static_cast<int64_t>(now.liveAllocations) - static_cast<int64_t>(first.liveAllocations);
+			std::cout << "checkpoint " << c << ": " << perThread * c / checkpoints * threads << " pairs, SDR live bytes "
+				<< MteSdrAlloc::liveBytes(now.sites) << " (" << (growth >= 0 ? "+" : "") << growth << "), live allocations "
+				<< now.liveAllocations << " (" << (allocationGrowth >= 0 ? "+" : "") << allocationGrowth << ")" << std::endl;
+			if (growth > 0 || allocationGrowth > 0)
+			{
+				for (size_t s = 0; s < now.sites.size(); s++)
+				{
+					if (now.sites[s].liveBytes > first.sites[s].liveBytes)
+					{
+						std::cout << "  " << now.sites[s].name << " grew by "
+							<< now.sites[s].liveBytes - first.sites[s].liveBytes << " bytes" << std::endl;
+					}
+				}
+				failed = true;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		failed = true;
+	}
+	MteSdr::stopAllocReport();
+
+	std::cout << std::endl;
+	MteSdrAlloc::print(std::cout, MteSdr::getAllocStats());
+	if (failed)
+	{
+		std::cout << "FAILED: memory grew during the soak." << std::endl;
+		return 1;
+	}
+	std::cout << "PASSED: no growth." << std::endl;
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef ChromeTrace_h
+#define ChromeTrace_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class ChromeTrace
+//
+// Records timed spans on every thread and writes them as Chrome trace_event
+// JSON, which chrome://tracing and https://ui.perfetto.dev display as a
+// timeline with one row per thread.
+//
+// To use, call start() with the file to write, then put a ChromeTrace::Span on
+// the stack around each piece of work. Each thread records into its own buffer
+// and the file is written by finish(), which start() also registers to run at
+// exit. Nothing is recorded until start() is called; until then a Span costs
+// one load.
+//
+// Span names and categories are not copied, so they must be string literals.
+//******************************************************************************
+class ChromeTrace
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  //----------------------------------------------------------
+  // Starts recording, to be written to the given file. At most
+  // maxEventsPerThread spans are kept per thread; later spans
+  // are counted as dropped.
+  //----------------------------------------------------------
+  static void start(const std::string &path, size_t maxEventsPerThread = 1u << 20)
+  {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.path = path;
+    s.maxEvents.store(maxEventsPerThread, std::memory_order_relaxed);
+    s.originTicks.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    if (!s.registered)
+    {
+      s.registered = true;
+      std::atexit(finishAtExit);
+    }
+    s.enabled.store(true, std::memory_order_release);
+  }
+
+  static bool enabled()
+  {
+    return state().enabled.load(std::memory_order_acquire);
+  }
+
+  // Names the calling thread in the timeline.
+  static void setThreadName(const char *name)
+  {
+    if (!enabled())
+      return;
+    Buffer *buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->name = name;
+  }
+
+  //-----------------------------------------------------------
+  // Stops recording and writes the file. Returns false if the
+  // file could not be written. Does nothing if not recording.
+  //-----------------------------------------------------------
+  static bool finish()
+  {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.enabled.exchange(false))
+      return true;
+    FILE *f = fopen(s.path.c_str(), "w");
+    if (f == nullptr)
+      return false;
+    uint64_t dropped = 0;
+    fputs("{\"traceEvents\":[\n", f);
+    bool first = true;
+    for (const std::unique_ptr<Buffer> &b : s.buffers)
+    {
+      std::lock_guard<std::mutex> bufferLock(b->mutex);
+      fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+        first ? "" : ",\n", b->tid, b->name.c_str());
+      first = false;
+      for (const Event &e : b->events)
+      {
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+          e.name, e.category, b->tid, static_cast<double>(e.startNs) / 1000.0,
+          static_cast<double>(e.durationNs) / 1000.0);
+        if (e.bytes >= 0)
+          fprintf(f, ",\"args\":{\"bytes\":%lld}", static_cast<long long>(e.bytes));
+        fputc('}', f);
+      }
+      dropped += b->dropped;
+      b->events.clear();
+      b->dropped = 0;
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%llu}}\n",
+      static_cast<unsigned long long>(dropped));
+    bool ok = ferror(f) == 0;
+    ok = fclose(f) == 0 && ok;
+    return ok;
+  }
+
+  //--------------------------------------------------------
+  // Records a span from construction to destruction, if the
+  // trace was started at construction. bytes, if not -1, is
+  // shown as an argument of the span.
+  //--------------------------------------------------------
+  class Span
+  {
+  public:
+    Span(const char *name, const char *category = "sdr", int64_t bytes = -1) :
+      myName(name), myCategory(category), myBytes(bytes), myActive(enabled())
+    {
+      if (myActive)
+        myStart = Clock::now();
+    }
+
+    ~Span()
+    {
+      if (myActive)
+        record(myName, myCategory, myStart, Clock::now(), myBytes);
+    }
+
+    void setBytes(int64_t bytes) { myBytes = bytes; }
+
+  private:
+    Span(const Span &);
+    Span &operator=(const Span &);
+
+    const char *myName;
+    const char *myCategory;
+    int64_t myBytes;
+    bool myActive;
+    Clock::time_point myStart;
+  };
+
+private:
+  struct Event
+  {
+    const char *name;
+    const char *category;
+    int64_t startNs;
+    int64_t durationNs;
+    int64_t bytes;
+  };
+
+  // One per thread; owned by the State so it outlives its thread.
+  struct Buffer
+  {
+    std::mutex mutex;
+    unsigned tid;
+    std::string name;
+    std::vector<Event> events;
+    uint64_t dropped;
+  };
+
+  struct State
+  {
+    std::mutex mutex;
+    std::atomic<bool> enabled;
+    bool registered;
+    std::string path;
+    // Read by record() without the lock, as tracing may be restarted
+    // while other threads record.
+    std::atomic<size_t> maxEvents;
+    std::atomic<Clock::rep> originTicks;
+    std::vector<std::unique_ptr<Buffer> > buffers;
+
+    State() : enabled(false), registered(false), maxEvents(0), originTicks(0) {}
+  };
+
+  static State &state()
+  {
+    static State s;
+    return s;
+  }
+
+  static void finishAtExit()
+  {
+    finish();
+  }
+
+  static Buffer *localBuffer()
+  {
+    static thread_local Buffer *buffer = nullptr;
+    if (buffer == nullptr)
+    {
+      State &s = state();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.buffers.emplace_back(new Buffer());
+      buffer = s.buffers.back().get();
+      buffer->tid = static_cast<unsigned>(s.buffers.size());
+      buffer->name = "thread " + std::to_string(buffer->tid);
+      buffer->dropped = 0;
+    }
+    return buffer;
+  }
+
+  static void record(const char *name, const char *category, Clock::time_point start,
+    Clock::time_point end, int64_t bytes)
+  {
+    State &s = state();
+    Buffer *buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (buffer->events.size() >= s.maxEvents.load(std::memory_order_relaxed))
+    {
+      buffer->dropped++;
+      return;
+    }
+    Event e;
+    e.name = name;
+    e.category = category;
+    Clock::time_point origin(Clock::duration(s.originTicks.load(std::memory_order_relaxed)));
+    e.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count();
+    e.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    e.bytes = bytes;
+    buffer->events.push_back(e);
+  }
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteBase64_h
+#define MteBase64_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define MTE_BASE64_X86 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#endif
+
+// GCC and Clang compile each vector routine for its instruction set only;
+// MSVC accepts the intrinsics anywhere.
+#if defined(MTE_BASE64_X86) && (defined(__GNUC__) || defined(__clang__))
+#  define MTE_BASE64_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define MTE_BASE64_TARGET(isa)
+#endif
+
+//******************************************************************************
+// Class MteBase64
+//
+// Base64 (RFC 4648) with the contracts of mte_base64_encode() and
+// mte_base64_decode(), so it can replace them: the output is null
+// terminated, decoding ignores bytes outside the alphabet and assumes
+// missing padding, and a decode may be in place.
+//
+// On x86 the bulk of the data goes through AVX2 or SSSE3, whichever is the
+// best the CPU has, chosen at run time; the ends and anything invalid go
+// through the scalar code. Elsewhere the scalar code does it all. setIsa()
+// chooses a slower one, for comparison.
+//
+// Thread safe.
+//******************************************************************************
+class MteBase64
+{
+public:
+  enum Isa
+  {
+    Scalar,
+    Ssse3,
+    Avx2
+  };
+
+  static const char *isaName(Isa isa)
+  {
+    static const char *names[] = { "scalar", "ssse3", "avx2" };
+    return names[isa];
+  }
+
+  // The best instruction set the CPU supports.
+  static Isa detected()
+  {
+    static const Isa best = detect();
+    return best;
+  }
+
+  // The instruction set in use.
+  static Isa isa()
+  {
+    return static_cast<Isa>(selected().load(std::memory_order_relaxed));
+  }
+
+  // Uses the instruction set, or the best supported below it.
+  static void setIsa(Isa isa)
+  {
+    selected().store(isa < detected() ? isa : detected(), std::memory_order_relaxed);
+  }
+
+  // The encode buffer bytes for the data bytes, with the null terminator.
+  static size_t encodeBytes(size_t bytes) { return (bytes + 2) / 3 * 4 + 1; }
+
+  // The decode buffer bytes for the Base64 bytes, with the null terminator.
+  static size_t decodeBytes(size_t bytes) { return (bytes + 3) / 4 * 3 + 1; }
+
+  // Encodes the data to encoded, which must hold encodeBytes(bytes). Returns
+  // the encoded length without the null terminator.
+  static size_t encode(const void *data, size_t bytes, char *encoded)
+  {
+    const uint8_t *in = static_cast<const uint8_t *>(data);
+    size_t done = 0;
+#if defined(MTE_BASE64_X86)
+    switch (isa())
+    {
+    case Avx2: done = encodeAvx2(in, bytes, encoded); break;
+    case Ssse3: done = encodeSsse3(in, bytes, encoded); break;
+    default: break;
+    }
+#endif
+    char *out = encoded + done / 3 * 4;
+    out += encodeScalar(in + done, bytes - done, out);
+    *out = '\0';
+    return static_cast<size_t>(out - encoded);
+  }
+
+  // Decodes the Base64 to decoded, which must hold decodeBytes(bytes) and
+  // may be the Base64 buffer. Returns the decoded length without the null
+  // terminator.
+  static size_t decode(const void *base64, size_t bytes, void *decoded)
+  {
+    const char *in = static_cast<const char *>(base64);
+    uint8_t *out = static_cast<uint8_t *>(decoded);
+    size_t done = 0;
+#if defined(MTE_BASE64_X86)
+    switch (isa())
+    {
+    case Avx2: done = decodeAvx2(in, bytes, out); break;
+    case Ssse3: done = decodeSsse3(in, bytes, out); break;
+    default: break;
+    }
+#endif
+    size_t length = done / 4 * 3;
+    length += decodeScalar(in + done, bytes - done, out + length);
+    out[length] = '\0';
+    return length;
+  }
+
+  // Appends the encoded data to the string.
+  static void append(const void *data, size_t bytes, std::string &out)
+  {
+    size_t at = out.size();
+    out.resize(at + encodeBytes(bytes));
+    out.resize(at + encode(data, bytes, &out[at]));
+  }
+
+private:
+  static std::atomic<int> &selected()
+  {
+    static std::atomic<int> isa(detected());
+    return isa;
+  }
+
+  static Isa detect()
+  {
+#if defined(MTE_BASE64_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int leaves = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    // AVX needs the OS to save the YMM registers.
+    bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (avx && leaves >= 7)
+    {
+      __cpuidex(info, 7, 0);
+      avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    return avx2 ? Avx2 : ssse3 ? Ssse3 : Scalar;
+#elif defined(MTE_BASE64_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? Avx2 : __builtin_cpu_supports("ssse3") ? Ssse3 : Scalar;
+#else
+    return Scalar;
+#endif
+  }
+
+  static const char *alphabet()
+  {
+    return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  }
+
+  // The 6 bit value of each byte, or 64 for a byte outside the alphabet.
+  static const uint8_t *values()
+  {
+    struct Table
+    {
+      uint8_t v[256];
+      Table()
+      {
+        for (int i = 0; i < 256; i++)
+          v[i] = 64;
+        for (int i = 0; i < 64; i++)
+          v[static_cast<uint8_t>(alphabet()[i])] = static_cast<uint8_t>(i);
+      }
+    };
+    static const Table table;
+    return table.v;
+  }
+
+  static size_t encodeScalar(const uint8_t *in, size_t bytes, char *out)
+  {
+    const char *a = alphabet();
+    char *start = out;
+    size_t i = 0;
+    for (; i + 3 <= bytes; i += 3)
+    {
+      uint32_t v = (static_cast<uint32_t>(in[i]) << 16) | (static_cast<uint32_t>(in[i + 1]) << 8) | in[i + 2];
+      *out++ = a[(v >> 18) & 63];
+      *out++ = a[(v >> 12) & 63];
+      *out++ = a[(v >> 6) & 63];
+      *out++ = a[v & 63];
+    }
+    if (i < bytes)
+    {
+      uint32_t v = static_cast<uint32_t>(in[i]) << 16;
+      if (i + 1 < bytes)
+        v |= static_cast<uint32_t>(in[i + 1]) << 8;
+      *out++ = a[(v >> 18) & 63];
+      *out++ = a[(v >> 12) & 63];
+      *out++ = i + 1 < bytes ? a[(v >> 6) & 63] : '=';
+      *out++ = '=';
+    }
+    return static_cast<size_t>(out - start);
+  }
+
+  // Decodes, skipping bytes outside the alphabet; a final group of 2 or 3
+  // characters gives 1 or 2 bytes.
+  static size_t decodeScalar(const char *in, size_t bytes, uint8_t *out)
+  {
+    const uint8_t *v = values();
+    uint8_t *start = out;
+    uint32_t group = 0;
+    int count = 0;
+    for (size_t i = 0; i < bytes; i++)
+    {
+      uint8_t value = v[static_cast<uint8_t>(in[i])];
+      if (value == 64)
+        continue;
+      group = (group << 6) | value;
+      if (++count == 4)
+      {
+        *out++ = static_cast<uint8_t>(group >> 16);
+        *out++ = static_cast<uint8_t>(group >> 8);
+        *out++ = static_cast<uint8_t>(group);
+        group = 0;
+        count = 0;
+      }
+    }
+    if (count >= 2)
+    {
+      group <<= 6 * (4 - count);
+      *out++ = static_cast<uint8_t>(group >> 16);
+      if (count == 3)
+        *out++ = static_cast<uint8_t>(group >> 8);
+    }
+    return static_cast<size_t>(out - start);
+  }
+
+#if defined(MTE_BASE64_X86)
+  //------------------------------------------------------------
+  // The vector routines (W. Mula and D. Lemire, "Faster Base64
+  // Encoding and Decoding Using AVX2 Instructions"). Each does
+  // whole blocks while there is room to load and store a full
+  // vector, and returns the input bytes it did; the caller does
+  // the rest. Decoding stops at the first block with a byte
+  // outside the alphabet, padding included.
+  //------------------------------------------------------------
+
+  // Spreads 12 bytes in each lane to 16 indexes of 6 bits.
+  MTE_BASE64_TARGET("ssse3")
+  static __m128i encodeIndexes(__m128i in)
+  {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+  }
+
+  // Maps the indexes to the alphabet by adding an offset per range.
+  MTE_BASE64_TARGET("ssse3")
+  static __m128i encodeAscii(__m128i indexes)
+  {
+    __m128i range = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indexes);
+  }
+
+  MTE_BASE64_TARGET("ssse3")
+  static size_t encodeSsse3(const uint8_t *in, size_t bytes, char *out)
+  {
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 12, out += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out), encodeAscii(encodeIndexes(v)));
+    }
+    return i;
+  }
+
+  MTE_BASE64_TARGET("avx2")
+  static size_t encodeAvx2(const uint8_t *in, size_t bytes, char *out)
+  {
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5);
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+      10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 24, out += 32)
+    {
+      // 12 bytes to each lane.
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+      v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, spread), shuffle);
+      __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+      __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+      __m256i indexes = _mm256_or_si256(t0, t1);
+      __m256i range = _mm256_subs_epu8(indexes, _mm256_set1_epi8(51));
+      range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indexes), _mm256_set1_epi8(13)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indexes));
+    }
+    return i + encodeSsse3(in + i, bytes - i, out);
+  }
+
+  // The decode tables: a byte is in the alphabet when the lo and hi entries
+  // of its nibbles share no bit, and its value is the byte plus the roll
+  // entry of its high nibble ('/' has one of its own).
+  MTE_BASE64_TARGET("ssse3")
+  static size_t decodeSsse3(const char *in, size_t bytes, uint8_t *out)
+  {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2f = _mm_set1_epi8(0x2f);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    // Leave 8 bytes for the scalar code, so the 4 bytes stored past the
+    // output are within the buffer.
+    for (; i + 24 <= bytes; i += 16, out += 12)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+      __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask2f);
+      __m128i lo = _mm_shuffle_epi8(lutLo, _mm_and_si128(v, mask2f));
+      __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+      if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0)
+        break;
+      __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask2f), hiNibbles));
+      v = _mm_add_epi8(v, roll);
+      v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+      v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(v, pack));
+    }
+    return i;
+  }
+
+  MTE_BASE64_TARGET("avx2")
+  static size_t decodeAvx2(const char *in, size_t bytes, uint8_t *out)
+  {
+    const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+    size_t i = 0;
+    // Leave 16 bytes for the SSSE3 and scalar code, so the 8 bytes stored
+    // past the output are within the buffer.
+    for (; i + 48 <= bytes; i += 32, out += 24)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+      __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask2f);
+      __m256i lo = _mm256_shuffle_epi8(lutLo, _mm256_and_si256(v, mask2f));
+      __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+      if (!_mm256_testz_si256(lo, hi))
+        break;
+      __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, mask2f), hiNibbles));
+      v = _mm256_add_epi8(v, roll);
+      v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+      v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+      v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack), join);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), v);
+    }
+    return i + decodeSsse3(in + i, bytes - i, out);
+  }
+#endif
+};
+
+#endif
@@ -0,0 +1,256 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteBatch_h
+#define MteBatch_h
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MteBase.h"
+
+//******************************************************************************
+// Class MteBatch
+//
+// Encodes a batch of messages back to back into one caller provided buffer,
+// and decodes such a buffer, so a whole batch goes out in one send or
+// writev() instead of one framed send per message. The encoders and
+// decoders are MteEnc and MteMkeEnc, MteDec and MteMkeDec.
+//
+// Each message is encoded with the offset overload of encode() straight
+// into the batch buffer, after the one before it, so nothing is copied out
+// of the encoder's own buffer. The table has the offset and length of each
+// encoded message. Decoding is the same the other way round: each entry of
+// the table is decoded with the offset overload of decode() into the
+// decoded buffer, after the one before it.
+//
+// The table goes with the batch as a header from writeTable(): the count
+// and the lengths, 32-bit little-endian. The offsets follow from the
+// lengths, as the messages are back to back.
+//
+// A buffer too small throws an exception; MTE errors are returned.
+//******************************************************************************
+class MteBatch
+{
+public:
+  // Where a message is in a batch buffer.
+  struct Entry
+  {
+    size_t offset;
+    size_t bytes;
+  };
+
+  // A message to encode.
+  struct Message
+  {
+    Message(const void *d, size_t n) : data(d), bytes(n) {}
+    const void *data;
+    size_t bytes;
+  };
+
+  // Returns the buffer size in bytes needed to encode the messages.
+  template <class Enc>
+  static size_t encodeBuffBytes(const Enc &encoder,
+                                const std::vector<Message> &messages)
+  {
+    size_t bytes = 0;
+    for (const Message &m : messages)
+      bytes += encoder.getBuffBytes(m.bytes);
+    return bytes;
+  }
+
+  //---------------------------------------------------------------
+  // Encodes the messages back to back into the encoded buffer of
+  // encodedBytes bytes, at least encodeBuffBytes(). Sets the table
+  // to an entry per message encoded. Returns the status; on error
+  // the table has the messages encoded before the one that failed.
+  //---------------------------------------------------------------
+  template <class Enc>
+  static mte_status encode(Enc &encoder, const std::vector<Message> &messages,
+                           void *encoded, size_t encodedBytes,
+                           std::vector<Entry> &table)
+  {
+    table.clear();
+    table.reserve(messages.size());
+    uint8_t *out = static_cast<uint8_t *>(encoded);
+    size_t end = 0;
+    for (const Message &m : messages)
+    {
+      if (encodedBytes - end < encoder.getBuffBytes(m.bytes))
+        throw std::runtime_error("The batch buffer of " + std::to_string(encodedBytes) +
+          " bytes is too small to encode " + std::to_string(messages.size()) + " messages");
+      size_t encOff = end;
+      size_t encBytes = 0;
+      mte_status status = encoder.encode(m.data, 0, m.bytes, out, encOff, encBytes);
+      if (status != mte_status_success)
+        return status;
+      end = pack(out, end, encOff, encBytes, table);
+    }
+    return mte_status_success;
+  }
+
+  // Returns the buffer size in bytes needed to decode the table's messages.
+  template <class Dec>
+  static size_t decodeBuffBytes(const Dec &decoder, const std::vector<Entry> &table)
+  {
+    size_t bytes = 0;
+    for (const Entry &e : table)
+      bytes += decoder.getBuffBytes(e.bytes);
+    return bytes;
+  }
+
+  //-----------------------------------------------------------------
+  // Decodes the encoded messages in the table, from the batch of
+  // encodedBytes bytes, back to back into the decoded buffer of
+  // decodedBytes bytes, at least decodeBuffBytes(). Sets decTable to
+  // an entry per message decoded. Returns the first status that is
+  // not success. Statuses that are not errors, such as sequencing
+  // warnings, do not stop the batch; an error does, and decTable then
+  // has the messages decoded before it. Throws an exception if an
+  // entry is outside the batch.
+  //-----------------------------------------------------------------
+  template <class Dec>
+  static mte_status decode(Dec &decoder, const void *encoded, size_t encodedBytes,
+                           const std::vector<Entry> &table,
+                           void *decoded, size_t decodedBytes,
+                           std::vector<Entry> &decTable)
+  {
+    decTable.clear();
+    decTable.reserve(table.size());
+    uint8_t *out = static_cast<uint8_t *>(decoded);
+    size_t end = 0;
+    mte_status result = mte_status_success;
+    for (const Entry &e : table)
+    {
+      if (e.offset > encodedBytes || e.bytes > encodedBytes - e.offset)
+        throw std::runtime_error("A message of the batch table is outside the " +
+          std::to_string(encodedBytes) + " byte batch");
+      if (decodedBytes - end < decoder.getBuffBytes(e.bytes))
+        throw std::runtime_error("The batch buffer of " + std::to_string(decodedBytes) +
+          " bytes is too small to decode " + std::to_string(table.size()) + " messages");
+      size_t decOff = end;
+      size_t decBytes = 0;
+      mte_status status = decoder.decode(encoded, e.offset, e.bytes, out, decOff, decBytes);
+      if (MteBase::statusIsError(status))
+        return status;
+      if (result == mte_status_success)
+        result = status;
+      end = pack(out, end, decOff, decBytes, decTable);
+    }
+    return result;
+  }
+
+  // Returns the length in bytes of the table's batch.
+  static size_t batchBytes(const std::vector<Entry> &table)
+  {
+    return table.empty() ? 0 : table.back().offset + table.back().bytes;
+  }
+
+  // Returns the length in bytes of the batch header for count messages.
+  static size_t tableBytes(size_t count)
+  {
+    return 4 * (count + 1);
+  }
+
+  // Appends the table as a batch header to out.
+  static void writeTable(const std::vector<Entry> &table, std::vector<uint8_t> &out)
+  {
+    out.reserve(out.size() + tableBytes(table.size()));
+    putUint32(table.size(), out);
+    for (const Entry &e : table)
+      putUint32(e.bytes, out);
+  }
+
+  //-------------------------------------------------------------
+  // Reads a batch header from data of the given length into the
+  // table. Returns the header length in bytes, the offset of the
+  // batch in data, once data holds the header and the whole batch
+  // after it. Returns 0 while more bytes are needed; once the
+  // header is complete the table is read anyway, so the caller can
+  // see from batchBytes() how large the batch is before waiting
+  // for it.
+  //-------------------------------------------------------------
+  static size_t readTable(const void *data, size_t bytes, std::vector<Entry> &table)
+  {
+    const uint8_t *in = static_cast<const uint8_t *>(data);
+    table.clear();
+    if (bytes < 4)
+      return 0;
+    size_t count = getUint32(in);
+    if ((bytes - 4) / 4 < count)
+      return 0;
+    size_t header = tableBytes(count);
+    table.reserve(count);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      Entry e;
+      e.offset = static_cast<size_t>(offset);
+      e.bytes = getUint32(in + 4 * (i + 1));
+      offset += e.bytes;
+      if (offset > SIZE_MAX - header)
+        throw std::runtime_error("The batch table describes a batch too large to hold");
+      table.push_back(e);
+    }
+    return header + offset <= bytes ? header : 0;
+  }
+
+private:
+  //------------------------------------------------------------
+  // Moves a message the wrapper put at off down to end, if not
+  // there already, records it in the table and returns the new
+  // end of the buffer.
+  //------------------------------------------------------------
+  static size_t pack(uint8_t *buffer, size_t end, size_t off, size_t bytes,
+                     std::vector<Entry> &table)
+  {
+    if (off != end)
+      memmove(buffer + end, buffer + off, bytes);
+    Entry e;
+    e.offset = end;
+    e.bytes = bytes;
+    table.push_back(e);
+    return end + bytes;
+  }
+
+  static void putUint32(size_t value, std::vector<uint8_t> &out)
+  {
+    if (value > UINT32_MAX)
+      throw std::runtime_error("A batch length is over 32 bits: " + std::to_string(value));
+    for (int i = 0; i < 4; i++)
+      out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+
+  static size_t getUint32(const uint8_t *in)
+  {
+    return static_cast<size_t>(in[0]) | static_cast<size_t>(in[1]) << 8 |
+      static_cast<size_t>(in[2]) << 16 | static_cast<size_t>(in[3]) << 24;
+  }
+};
+
+#endif
@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteBufferPool_h
+#define MteBufferPool_h
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MteSdrAlloc.h"
+
+//******************************************************************************
+// Class MteBufferPool
+//
+// Output buffers that are reused instead of allocated for every message.
+// acquire() leases a buffer of at least the bytes asked for from one of the
+// size classes, the powers of two from MinClassBytes to MaxClassBytes; a
+// larger request is allocated to size and freed when done.
+//
+// A lease is move-only and gives its buffer back when destroyed, to a free
+// list of the thread that destroys it. Each thread keeps up to
+// MaxCachedPerClass buffers of each class and MaxCachedBytes in all; a
+// buffer given back to a full list is freed. Once a thread's lists hold the
+// buffers it uses, leasing takes no lock and makes no heap allocation. The
+// lists are freed when the thread exits, or by trim().
+//
+// The pool's buffers count as MteSdrAlloc::PooledBuffer, live whether leased
+// or cached.
+//******************************************************************************
+class MteBufferPool
+{
+public:
+  static const size_t MinClassBytes = 64;
+  static const size_t MaxClassBytes = 16 * 1024 * 1024;
+  static const size_t MaxCachedPerClass = 8;
+  static const size_t MaxCachedBytes = 64 * 1024 * 1024;
+
+  //------------------------------------------------------------
+  // A leased buffer. data() and size() are the bytes in use, as
+  // set by setData(); a new lease uses its whole capacity.
+  //------------------------------------------------------------
+  class Lease
+  {
+  public:
+    Lease() : myBuffer(nullptr), myCapacity(0), myOffset(0), mySize(0) {}
+
+    Lease(Lease &&other) :
+      myBuffer(other.myBuffer), myCapacity(other.myCapacity),
+      myOffset(other.myOffset), mySize(other.mySize)
+    {
+      other.myBuffer = nullptr;
+      other.myCapacity = other.myOffset = other.mySize = 0;
+    }
+
+    Lease &operator=(Lease &&other)
+    {
+      if (this != &other)
+      {
+        reset();
+        myBuffer = other.myBuffer;
+        myCapacity = other.myCapacity;
+        myOffset = other.myOffset;
+        mySize = other.mySize;
+        other.myBuffer = nullptr;
+        other.myCapacity = other.myOffset = other.mySize = 0;
+      }
+      return *this;
+    }
+
+    ~Lease() { reset(); }
+
+    uint8_t *data() { return myBuffer + myOffset; }
+    const uint8_t *data() const { return myBuffer + myOffset; }
+    size_t size() const { return mySize; }
+    size_t capacity() const { return myCapacity; }
+
+    // True if the lease holds a buffer.
+    explicit operator bool() const { return myBuffer != nullptr; }
+
+    // Uses the size bytes that start offset bytes into the buffer.
+    void setData(size_t offset, size_t size)
+    {
+      myOffset = offset;
+      mySize = size;
+    }
+
+    // Gives the buffer back to the pool now.
+    void reset()
+    {
+      if (myBuffer == nullptr)
+        return;
+      MteBufferPool::giveBack(myBuffer, myCapacity);
+      myBuffer = nullptr;
+      myCapacity = myOffset = mySize = 0;
+    }
+
+  private:
+    friend class MteBufferPool;
+
+    Lease(uint8_t *buffer, size_t capacity) :
+      myBuffer(buffer), myCapacity(capacity), myOffset(0), mySize(capacity) {}
+
+    Lease(const Lease &);
+    Lease &operator=(const Lease &);
+
+    uint8_t *myBuffer;
+    size_t myCapacity;
+    size_t myOffset;
+    size_t mySize;
+  };
+
+  // Leases a buffer of at least the given bytes.
+  static Lease acquire(size_t bytes)
+  {
+    int sizeClass = classOf(bytes);
+    if (sizeClass < 0 || cacheGone())
+      return Lease(MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::PooledBuffer, bytes), bytes);
+    size_t capacity = classBytes(sizeClass);
+    ThreadCache &cache = threadCache();
+    size_t &count = cache.counts[sizeClass];
+    if (count == 0)
+      return Lease(MteSdrAlloc::allocate<uint8_t>(MteSdrAlloc::PooledBuffer, capacity), capacity);
+    cache.bytes -= capacity;
+    return Lease(cache.buffers[sizeClass][--count], capacity);
+  }
+
+  // Frees the buffers cached by the calling thread.
+  static void trim()
+  {
+    if (!cacheGone())
+      threadCache().clear();
+  }
+
+private:
+  static const int ClassCount = 19;
+
+  // The cached buffers of one thread, by size class.
+  struct ThreadCache
+  {
+    uint8_t *buffers[ClassCount][MaxCachedPerClass];
+    size_t counts[ClassCount];
+    size_t bytes;
+
+    ThreadCache() : counts(), bytes(0) {}
+
+    ~ThreadCache()
+    {
+      clear();
+      cacheGone() = true;
+    }
+
+    void clear()
+    {
+      for (int c = 0; c < ClassCount; c++)
+      {
+        while (counts[c] > 0)
+          MteSdrAlloc::release(MteSdrAlloc::PooledBuffer, buffers[c][--counts[c]], classBytes(c));
+      }
+      bytes = 0;
+    }
+  };
+
+  // The size class that holds the bytes, or -1 if none does.
+  static int classOf(size_t bytes)
+  {
+    if (bytes > MaxClassBytes)
+      return -1;
+    int sizeClass = 0;
+    while (classBytes(sizeClass) < bytes)
+      sizeClass++;
+    return sizeClass;
+  }
+
+  static size_t classBytes(int sizeClass)
+  {
+    return MinClassBytes << sizeClass;
+  }
+
+  static void giveBack(uint8_t *buffer, size_t capacity)
+  {
+    int sizeClass = classOf(capacity);
+    if (sizeClass >= 0 && classBytes(sizeClass) == capacity && !cacheGone())
+    {
+      ThreadCache &cache = threadCache();
+      size_t &count = cache.counts[sizeClass];
+      if (count < MaxCachedPerClass && cache.bytes + capacity <= MaxCachedBytes)
+      {
+        cache.buffers[sizeClass][count++] = buffer;
+        cache.bytes += capacity;
+        return;
+      }
+    }
+    MteSdrAlloc::release(MteSdrAlloc::PooledBuffer, buffer, capacity);
+  }
+
+  static ThreadCache &threadCache()
+  {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  // Set once the thread's cache is destroyed at thread exit; a lease given
+  // back after that is freed.
+  static bool &cacheGone()
+  {
+    thread_local bool gone = false;
+    return gone;
+  }
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteFixed_h
+#define MteFixed_h
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "MteBase.h"
+#include "MteEnc.h"
+#include "MteDec.h"
+#include "MteMkeEnc.h"
+#include "MteMkeDec.h"
+
+//******************************************************************************
+// Class MteFixed
+//
+// The options this build of MTE was made with, from mte_settings.h, as
+// compile-time constants, and compile-time bounds on the buffer sizes of
+// the encoders and decoders that use them.
+//
+// The library computes the exact sizes at run time, so the bounds leave
+// OverheadBytes for the header, verifiers, padding and hash. The classes
+// below check the library's sizes against them when they are constructed.
+//******************************************************************************
+struct MteFixed
+{
+  // Whether the library takes its options at run time. When not, the
+  // options below are the only ones it supports.
+  static const bool Runtime = MTE_RUNTIME != 0;
+
+  static const mte_drbgs Drbg = MTE_DRBG_ENUM;
+  static const size_t TokBytes = MTE_TOKBYTES;
+  static const mte_verifiers Verifiers = MTE_VERIFIERS_ENUM;
+  static const mte_ciphers Cipher = MTE_CIPHER_ENUM;
+  static const mte_hashes Hash = MTE_HASH_ENUM;
+
+  static const size_t OverheadBytes = 256;
+
+  // Bounds on the encode buffer size in bytes given the data length in
+  // bytes: the core MTE replaces each byte with a token; MKE encrypts.
+  static constexpr size_t encodeBound(size_t dataBytes)
+  {
+    return dataBytes * TokBytes + OverheadBytes;
+  }
+  static constexpr size_t mkeEncodeBound(size_t dataBytes)
+  {
+    return dataBytes + OverheadBytes;
+  }
+
+  // Bound on the decode buffer size in bytes given the encoded length.
+  static constexpr size_t decodeBound(size_t encodedBytes)
+  {
+    return encodedBytes + OverheadBytes;
+  }
+
+  // Throws if the library needs more than the bound.
+  static void checkBound(size_t needed, size_t bound, const char *what)
+  {
+    if (needed > bound)
+      throw std::runtime_error(std::string(what) + " needs " + std::to_string(needed) +
+        " bytes; the compile-time bound is " + std::to_string(bound) +
+        ". Raise MteFixed::OverheadBytes.");
+  }
+};
+
+//******************************************************************************
+// Class MteFixedEnc
+//
+// An encoder of type Enc, MteEnc or MteMkeEnc, with the build's options that
+// encodes messages of up to MaxBytes into a buffer inside the object, sized
+// at compile time, instead of the heap buffer the base grows on demand.
+// BuffBytes is the compile-time bound on the encode buffer for MaxBytes; a
+// caller can also use it to encode with the offset overload of encode()
+// into a buffer of its own on the stack. Longer messages are encoded by the
+// base as usual.
+//
+// Use it through MteEncT and MteMkeEncT.
+//******************************************************************************
+template <class Enc, size_t MaxBytes, size_t BuffBytes>
+class MteFixedEnc : public Enc
+{
+public:
+  static const size_t maxBytes = MaxBytes;
+  static const size_t buffBytes = BuffBytes;
+
+  // Constructor using the options defined in mte_settings.h. Throws if the
+  // library needs more than BuffBytes for MaxBytes.
+  MteFixedEnc()
+  {
+    MteFixed::checkBound(Enc::getBuffBytes(MaxBytes), BuffBytes, "The encoder");
+  }
+
+  using Enc::encode;
+
+  // Encode the given data of the given length in bytes. Returns the encoded
+  // version and sets encodedBytes to the length of the encoded version in
+  // bytes and status to the status. The encoded version is in the object's
+  // own buffer if dataBytes is at most MaxBytes.
+  const void *encode(const void *data, size_t dataBytes,
+                     size_t& encodedBytes,
+                     mte_status& status)
+  {
+    if (dataBytes > MaxBytes)
+      return Enc::encode(data, dataBytes, encodedBytes, status);
+    size_t encOff = 0;
+    status = Enc::encode(data, 0, dataBytes, myBuff, encOff, encodedBytes);
+    if (status != mte_status_success)
+    {
+      encodedBytes = 0;
+      return nullptr;
+    }
+    return myBuff + encOff;
+  }
+
+private:
+  alignas(16) uint8_t myBuff[BuffBytes];
+};
+
+//******************************************************************************
+// Class MteFixedDec
+//
+// The decoder to go with MteFixedEnc: a decoder of type Dec, MteDec or
+// MteMkeDec, that decodes encoded messages of up to EncodedBytes, what
+// MteFixedEnc makes of MaxBytes, into a buffer inside the object of
+// BuffBytes. Longer ones are decoded by the base as usual.
+//
+// Use it through MteDecT and MteMkeDecT.
+//******************************************************************************
+template <class Dec, size_t EncodedBytes, size_t BuffBytes>
+class MteFixedDec : public Dec
+{
+public:
+  static const size_t encodedBytes = EncodedBytes;
+  static const size_t buffBytes = BuffBytes;
+
+  // Constructor using the options defined in mte_settings.h and the given
+  // timestamp and sequence windows. Throws if the library needs more than
+  // BuffBytes for EncodedBytes.
+  MteFixedDec(MTE_UINT64_T tWindow = 0, MTE_INT32_T sWindow = 0) :
+    Dec(tWindow, sWindow)
+  {
+    MteFixed::checkBound(Dec::getBuffBytes(EncodedBytes), BuffBytes, "The decoder");
+  }
+
+  using Dec::decode;
+
+  // Decode the given encoded version of the given length in bytes. Returns
+  // the decoded data and sets decodedBytes to the length of the decoded data
+  // in bytes and status to the status. The decoded data is in the object's
+  // own buffer if encodedBytes is at most EncodedBytes.
+  void *decode(const void *encoded, size_t encodedBytes,
+               size_t& decodedBytes,
+               mte_status& status)
+  {
+    if (encodedBytes > EncodedBytes)
+      return Dec::decode(encoded, encodedBytes, decodedBytes, status);
+    size_t decOff = 0;
+    status = Dec::decode(encoded, 0, encodedBytes, myBuff, decOff, decodedBytes);
+    if (MteBase::statusIsError(status))
+    {
+      decodedBytes = 0;
+      return nullptr;
+    }
+    return myBuff + decOff;
+  }
+
+private:
+  alignas(16) uint8_t myBuff[BuffBytes];
+};
+
+//
+// The build's encoders and decoders for messages of up to MaxBytes.
+//
+template <size_t MaxBytes = 256>
+using MteEncT = MteFixedEnc<MteEnc, MaxBytes, MteFixed::encodeBound(MaxBytes)>;
+
+template <size_t MaxBytes = 256>
+using MteDecT = MteFixedDec<MteDec, MteFixed::encodeBound(MaxBytes),
+                            MteFixed::decodeBound(MteFixed::encodeBound(MaxBytes))>;
+
+template <size_t MaxBytes = 256>
+using MteMkeEncT = MteFixedEnc<MteMkeEnc, MaxBytes, MteFixed::mkeEncodeBound(MaxBytes)>;
+
+template <size_t MaxBytes = 256>
+using MteMkeDecT = MteFixedDec<MteMkeDec, MteFixed::mkeEncodeBound(MaxBytes),
+                               MteFixed::decodeBound(MteFixed::mkeEncodeBound(MaxBytes))>;
+
+#endif
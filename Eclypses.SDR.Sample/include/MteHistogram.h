@@ -0,0 +1,217 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteHistogram_h
+#define MteHistogram_h
+
+#include <cstdint>
+#include <cstring>
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+//******************************************************************************
+// Class MteHistogram
+//
+// A log-linear (HDR style) histogram of unsigned values such as latencies.
+// Every power of two is split into 32 equal buckets, so any recorded value is
+// known to within about 3%, and values from 0 to 2^40 are covered in a fixed
+// 9 KB with no allocation. Larger values are counted in the last bucket.
+//
+// Recording is not thread safe; record into one histogram per thread and
+// merge them.
+//******************************************************************************
+class MteHistogram
+{
+public:
+  static const unsigned SubBucketBits = 5;
+  static const unsigned SubBuckets = 1u << SubBucketBits;
+  static const unsigned MaxBits = 40;
+  static const unsigned BucketCount = (MaxBits - SubBucketBits + 1) * SubBuckets;
+
+  MteHistogram()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    memset(myCounts, 0, sizeof(myCounts));
+    myCount = 0;
+    myTotal = 0;
+  }
+
+  // Records a value.
+  void record(uint64_t value)
+  {
+    add(bucketOf(value), 1, value);
+  }
+
+  // Adds count values to a bucket; total is the sum of those values.
+  void add(unsigned bucket, uint64_t count, uint64_t total)
+  {
+    myCounts[bucket] += count;
+    myCount += count;
+    myTotal += total;
+  }
+
+  // Adds the counts of another histogram to this one.
+  void merge(const MteHistogram &other)
+  {
+    for (unsigned i = 0; i < BucketCount; ++i)
+    {
+      myCounts[i] += other.myCounts[i];
+    }
+    myCount += other.myCount;
+    myTotal += other.myTotal;
+  }
+
+  // Removes the counts of an earlier copy of this histogram, leaving what was
+  // recorded since the copy was taken.
+  void subtract(const MteHistogram &earlier)
+  {
+    for (unsigned i = 0; i < BucketCount; ++i)
+    {
+      myCounts[i] -= earlier.myCounts[i];
+    }
+    myCount -= earlier.myCount;
+    myTotal -= earlier.myTotal;
+  }
+
+  uint64_t count() const
+  {
+    return myCount;
+  }
+
+  uint64_t total() const
+  {
+    return myTotal;
+  }
+
+  uint64_t bucketCount(unsigned bucket) const
+  {
+    return myCounts[bucket];
+  }
+
+  double mean() const
+  {
+    return myCount == 0 ? 0 : static_cast<double>(myTotal) / static_cast<double>(myCount);
+  }
+
+  // Returns the lowest value of the lowest non-empty bucket; 0 if empty.
+  uint64_t min() const
+  {
+    for (unsigned i = 0; i < BucketCount; ++i)
+    {
+      if (myCounts[i] != 0)
+        return lowerBound(i);
+    }
+    return 0;
+  }
+
+  // Returns the highest value of the highest non-empty bucket; 0 if empty.
+  uint64_t max() const
+  {
+    for (unsigned i = BucketCount; i-- > 0;)
+    {
+      if (myCounts[i] != 0)
+        return upperBound(i);
+    }
+    return 0;
+  }
+
+  //-----------------------------------------------------------
+  // Returns the value below which the given percentage (0-100)
+  // of the recorded values fall, to within the bucket width.
+  // Returns 0 if the histogram is empty.
+  //-----------------------------------------------------------
+  uint64_t percentile(double percent) const
+  {
+    if (myCount == 0)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(percent / 100.0 * static_cast<double>(myCount) + 0.5);
+    if (rank < 1)
+      rank = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < BucketCount; ++i)
+    {
+      seen += myCounts[i];
+      if (seen >= rank)
+        return upperBound(i);
+    }
+    return max();
+  }
+
+  // Returns the bucket a value is counted in.
+  static unsigned bucketOf(uint64_t value)
+  {
+    if (value < 2 * SubBuckets)
+      return static_cast<unsigned>(value);
+    unsigned msb = highestBit(value);
+    if (msb >= MaxBits)
+      return BucketCount - 1;
+    unsigned shift = msb - SubBucketBits;
+    return shift * SubBuckets + static_cast<unsigned>(value >> shift);
+  }
+
+  // Returns the lowest value counted in a bucket.
+  static uint64_t lowerBound(unsigned bucket)
+  {
+    if (bucket < 2 * SubBuckets)
+      return bucket;
+    unsigned shift = bucket / SubBuckets - 1;
+    return static_cast<uint64_t>(bucket % SubBuckets + SubBuckets) << shift;
+  }
+
+  // Returns the highest value counted in a bucket.
+  static uint64_t upperBound(unsigned bucket)
+  {
+    return bucket + 1 < BucketCount ? lowerBound(bucket + 1) - 1 : ~uint64_t(0);
+  }
+
+private:
+  static unsigned highestBit(uint64_t value)
+  {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<unsigned>(index);
+#elif defined(__GNUC__)
+    return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned index = 0;
+    while (value >>= 1)
+      ++index;
+    return index;
+#endif
+  }
+
+private:
+  uint64_t myCounts[BucketCount];
+  uint64_t myCount;
+  uint64_t myTotal;
+};
+
+#endif
@@ -0,0 +1,383 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteInstancePool_h
+#define MteInstancePool_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MteBase.h"
+
+//******************************************************************************
+// Class MteInstancePool
+//
+// Ready MTE objects for new sessions without paying for construction or
+// instantiation on the session setup path. T is MteEnc, MteDec, MteMkeEnc or
+// MteMkeDec.
+//
+// acquire() takes an idle object, or makes one with the factory, restores
+// the given saved state into it with restoreState() and leases it out. When
+// the lease is destroyed the object's state is overwritten with the pool's
+// own throwaway state, so no session's state is left behind, and the object
+// is kept for the next acquire().
+//
+// The saved states come from save(), which copies into a recycled buffer;
+// give buffers back with recycle(). prepare() instantiates states ahead of
+// time, off the setup path, for acquirePrepared() to hand out, each used
+// once. Never restore the same state into two sessions.
+//
+// The pool is thread safe and must outlive its leases. Errors throw an
+// exception.
+//******************************************************************************
+template <class T>
+class MteInstancePool
+{
+public:
+  // A saved state.
+  typedef std::vector<uint8_t> State;
+
+  // Makes a new object. The default constructs T with the default options.
+  typedef std::function<T *()> Factory;
+
+  // Instantiates an object for a new session: sets the entropy, nonce or
+  // their callbacks as needed and calls instantiate(). Returns the status.
+  typedef std::function<mte_status(T &)> Instantiator;
+
+  struct Stats
+  {
+    // Objects made by the factory and objects reused.
+    uint64_t created;
+    uint64_t reused;
+    // States restored, and instantiations, by prepare() or on demand.
+    uint64_t restored;
+    uint64_t instantiated;
+    // Prepared states handed out.
+    uint64_t preparedUsed;
+  };
+
+  //---------------------------------------------------
+  // An object leased from the pool, returned to it when
+  // the lease is destroyed.
+  //---------------------------------------------------
+  class Lease
+  {
+  public:
+    Lease() : myPool(nullptr), myInstance(nullptr) {}
+
+    Lease(Lease &&other) : myPool(other.myPool), myInstance(other.myInstance)
+    {
+      other.myPool = nullptr;
+      other.myInstance = nullptr;
+    }
+
+    Lease &operator=(Lease &&other)
+    {
+      if (this != &other)
+      {
+        reset();
+        myPool = other.myPool;
+        myInstance = other.myInstance;
+        other.myPool = nullptr;
+        other.myInstance = nullptr;
+      }
+      return *this;
+    }
+
+    ~Lease() { reset(); }
+
+    T *get() const { return myInstance; }
+    T *operator->() const { return myInstance; }
+    T &operator*() const { return *myInstance; }
+    explicit operator bool() const { return myInstance != nullptr; }
+
+    // Returns the object to the pool now.
+    void reset()
+    {
+      if (myInstance == nullptr)
+        return;
+      myPool->release(myInstance);
+      myPool = nullptr;
+      myInstance = nullptr;
+    }
+
+  private:
+    friend class MteInstancePool;
+
+    Lease(MteInstancePool *pool, T *instance) : myPool(pool), myInstance(instance) {}
+
+    Lease(const Lease &);
+    Lease &operator=(const Lease &);
+
+    MteInstancePool *myPool;
+    T *myInstance;
+  };
+
+  //------------------------------------------------------------
+  // Keeps up to maxIdle idle objects and as many state buffers.
+  // Makes one object now to learn the state size and make the
+  // throwaway state.
+  //------------------------------------------------------------
+  explicit MteInstancePool(size_t maxIdle, Factory factory = Factory()) :
+    myMaxIdle(maxIdle), myFactory(factory), myStateBytes(0),
+    myCreated(0), myReused(0), myRestored(0), myInstantiated(0), myPreparedUsed(0)
+  {
+    if (!myFactory)
+      myFactory = [] { return new T(); };
+    T *instance = myFactory();
+    std::vector<uint8_t> entropy(std::max<size_t>(1, MteBase::getDrbgsEntropyMinBytes(instance->getDrbg())), 0);
+    instance->setEntropy(entropy.data(), entropy.size());
+    instance->setNonce(0);
+    mte_status status = instance->instantiate("MteInstancePool");
+    const void *saved = status == mte_status_success ? instance->saveState(myStateBytes) : nullptr;
+    if (saved == nullptr)
+    {
+      delete instance;
+      throw std::runtime_error(std::string("Error instantiating the pool state (") +
+        MteBase::getStatusName(status) + "): " + MteBase::getStatusDescription(status));
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(saved);
+    myScrubState.assign(bytes, bytes + myStateBytes);
+    myCreated++;
+    myIdle.push_back(instance);
+  }
+
+  ~MteInstancePool()
+  {
+    for (T *instance : myIdle)
+      delete instance;
+  }
+
+  // The length of a saved state in bytes.
+  size_t stateBytes() const { return myStateBytes; }
+
+  // Makes idle objects until there are count, at most maxIdle.
+  void warm(size_t count)
+  {
+    for (;;)
+    {
+      {
+        std::lock_guard<std::mutex> lock(myMutex);
+        if (myIdle.size() >= count || myIdle.size() >= myMaxIdle)
+          return;
+      }
+      T *instance = myFactory();
+      myCreated++;
+      std::lock_guard<std::mutex> lock(myMutex);
+      myIdle.push_back(instance);
+    }
+  }
+
+  // Leases an object restored from the saved state.
+  Lease acquire(const State &state)
+  {
+    if (state.size() != myStateBytes)
+      throw std::runtime_error("The saved state is " + std::to_string(state.size()) +
+        " bytes; the pool's are " + std::to_string(myStateBytes));
+    return acquire(state.data());
+  }
+
+  // As above, from stateBytes() bytes of saved state.
+  Lease acquire(const void *state)
+  {
+    T *instance = take();
+    mte_status status = instance->restoreState(state);
+    if (status != mte_status_success)
+    {
+      release(instance);
+      throw std::runtime_error(std::string("Error restoring the state (") +
+        MteBase::getStatusName(status) + "): " + MteBase::getStatusDescription(status));
+    }
+    myRestored++;
+    return Lease(this, instance);
+  }
+
+  // Saves the object's state to a recycled buffer.
+  State save(T &instance)
+  {
+    size_t bytes = 0;
+    const uint8_t *saved = static_cast<const uint8_t *>(instance.saveState(bytes));
+    if (saved == nullptr)
+      throw std::runtime_error("Error saving the state");
+    State state;
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      if (!myBuffers.empty())
+      {
+        state.swap(myBuffers.back());
+        myBuffers.pop_back();
+      }
+    }
+    state.assign(saved, saved + bytes);
+    return state;
+  }
+
+  // Gives a state buffer back for save() to reuse.
+  void recycle(State &&state)
+  {
+    std::lock_guard<std::mutex> lock(myMutex);
+    if (myBuffers.size() < myMaxIdle)
+    {
+      myBuffers.push_back(State());
+      myBuffers.back().swap(state);
+    }
+  }
+
+  // Instantiates count states ahead for acquirePrepared().
+  void prepare(size_t count, const Instantiator &instantiator)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      Lease lease(this, take());
+      instantiate(*lease, instantiator);
+      State state = save(*lease);
+      std::lock_guard<std::mutex> lock(myMutex);
+      myPrepared.push_back(State());
+      myPrepared.back().swap(state);
+    }
+  }
+
+  // The prepared states not yet handed out.
+  size_t prepared() const
+  {
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myPrepared.size();
+  }
+
+  //-----------------------------------------------------------
+  // Leases an object restored from a prepared state, or, when
+  // none is left, one instantiated now with the instantiator.
+  //-----------------------------------------------------------
+  Lease acquirePrepared(const Instantiator &instantiator)
+  {
+    State state;
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      if (!myPrepared.empty())
+      {
+        state.swap(myPrepared.back());
+        myPrepared.pop_back();
+      }
+    }
+    if (state.empty())
+      return acquireNew(instantiator);
+    Lease lease = acquire(state);
+    myPreparedUsed++;
+    //
+    // The state is in the object now; wipe the copy before reuse.
+    //
+    std::fill(state.begin(), state.end(), 0);
+    recycle(std::move(state));
+    return lease;
+  }
+
+  // Leases an object instantiated now with the instantiator.
+  Lease acquireNew(const Instantiator &instantiator)
+  {
+    Lease lease(this, take());
+    instantiate(*lease, instantiator);
+    return lease;
+  }
+
+  Stats stats() const
+  {
+    Stats s;
+    s.created = myCreated.load();
+    s.reused = myReused.load();
+    s.restored = myRestored.load();
+    s.instantiated = myInstantiated.load();
+    s.preparedUsed = myPreparedUsed.load();
+    return s;
+  }
+
+private:
+  MteInstancePool(const MteInstancePool &);
+  MteInstancePool &operator=(const MteInstancePool &);
+
+  // Takes an idle object or makes one.
+  T *take()
+  {
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      if (!myIdle.empty())
+      {
+        T *instance = myIdle.back();
+        myIdle.pop_back();
+        myReused++;
+        return instance;
+      }
+    }
+    myCreated++;
+    return myFactory();
+  }
+
+  void instantiate(T &instance, const Instantiator &instantiator)
+  {
+    mte_status status = instantiator(instance);
+    if (status != mte_status_success)
+      throw std::runtime_error(std::string("Error instantiating (") +
+        MteBase::getStatusName(status) + "): " + MteBase::getStatusDescription(status));
+    myInstantiated++;
+  }
+
+  // Overwrites the object's state and keeps it if there is room.
+  void release(T *instance)
+  {
+    if (instance->restoreState(myScrubState.data()) == mte_status_success)
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      if (myIdle.size() < myMaxIdle)
+      {
+        myIdle.push_back(instance);
+        return;
+      }
+    }
+    delete instance;
+  }
+
+  size_t myMaxIdle;
+  Factory myFactory;
+  size_t myStateBytes;
+  State myScrubState;
+
+  mutable std::mutex myMutex;
+  std::vector<T *> myIdle;
+  std::vector<State> myBuffers;
+  std::vector<State> myPrepared;
+
+  std::atomic<uint64_t> myCreated;
+  std::atomic<uint64_t> myReused;
+  std::atomic<uint64_t> myRestored;
+  std::atomic<uint64_t> myInstantiated;
+  std::atomic<uint64_t> myPreparedUsed;
+};
+
+#endif
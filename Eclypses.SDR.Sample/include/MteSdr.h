@@ -49,6 +49,11 @@
 #include "mte_sdr.h"
 #include "MteRandom.h"
 #include "MteBase.h"
+#include "MteSdrProbes.h"
+#include "MteSdrStats.h"
+#include "MteSdrCapture.h"
+#include "MteSdrAlloc.h"
+#include "MteBufferPool.h"
 
 typedef void(*mte_sdr_random)(void *buff, size_t bytes);
 
@@ -132,6 +137,55 @@ public:
   //-------------------------------------------------------------------
   void removeSdr();
 
+  //--------------------------------------------------------------
+  // Returns the statistics of every SDR in the process: latency
+  // histograms and byte counts of encrypt, decrypt, the random
+  // callback, buffer growth and the storage methods, indexed by
+  // MteSdrStats::Phase. Recording is off until enabled; it may be
+  // turned on and off at any time.
+  //--------------------------------------------------------------
+  static std::vector<MteSdrStats::PhaseStats> getStats();
+
+  static void setStatsEnabled(bool enable);
+
+  static void resetStats();
+
+  //--------------------------------------------------------------
+  // Starts recording the operations of every SDR in the process
+  // to a capture file (see MteSdrCapture), which the load
+  // generator can replay. No key or value is recorded. Throws an
+  // exception if the file cannot be created.
+  //--------------------------------------------------------------
+  static void startCapture(const std::string &path);
+
+  static void stopCapture();
+
+  //--------------------------------------------------------------
+  // Returns the heap buffers of every SDR in the process by call
+  // site (see MteSdrAlloc): counts, bytes, and the live and peak
+  // bytes. startAllocReport() prints them to the stream every
+  // interval until stopAllocReport().
+  //--------------------------------------------------------------
+  static std::vector<MteSdrAlloc::SiteStats> getAllocStats();
+
+  static void startAllocReport(std::ostream &out, double seconds);
+
+  static void stopAllocReport();
+
+  // The memory this SDR holds.
+  struct Footprint
+  {
+    // The encoder and decoder states.
+    size_t stateBytes;
+    // The capacity of the encrypt and decrypt scratch buffers.
+    size_t scratchBytes;
+    // The records written to memory and their encrypted bytes.
+    size_t memoryRecords;
+    size_t memoryRecordBytes;
+  };
+
+  Footprint getFootprint() const;
+
   //------------------------------------
   // Internal function to combine a path
   // and a file name.
@@ -187,6 +241,15 @@ protected:
   virtual uint8_t *readRecord(const std::string &location, const std::string &key,
     size_t &valueBytes);
 
+  //--------------------------------------------------------
+  // Frees a record returned by readRecord() once the SDR is
+  // done with it. The default deletes it.
+  //
+  // Override this method if your readRecord() returns memory
+  // it still owns, or allocates differently.
+  //--------------------------------------------------------
+  virtual void releaseRecord(uint8_t *value, size_t valueBytes);
+
   //--------------------------------------------------------
   // Writes a record.
   // Throws an exception on failure.
@@ -212,17 +275,40 @@ protected:
   //--------------------------------------------------------
   virtual void removeRecord(const std::string &location, const std::string &key);
 
-private:
+  //-----------------------------------------------------------
+  // Call readRecord(), writeRecord() and removeRecord() with the
+  // phase statistics and probes. The SDR and its derivations call
+  // the storage through these.
+  //-----------------------------------------------------------
+  uint8_t *tracedReadRecord(const std::string &location, const std::string &key,
+    size_t &valueBytes);
+
+  void tracedWriteRecord(const std::string &location, const std::string &key,
+    const uint8_t *value, size_t valueBytes);
+
+  void tracedRemoveRecord(const std::string &location, const std::string &key);
+
   //-------------------------------------------------------
-  // Encrypts the given data. Returns the encrypted data.
+  // Encrypts the given data. Returns the encrypted data,
+  // which is valid until the next call.
   //-------------------------------------------------------
   const uint8_t *encrypt(const uint8_t *data, size_t dataBytes, size_t &encryptedBytes, mte_status &status);
 
   //-------------------------------------------------------
-  // Decrypts the given encrypted data. Returns the decrypted data.
+  // Decrypts the given encrypted data. Returns the decrypted
+  // data, which is valid until the next call.
   //-------------------------------------------------------
   const uint8_t *decrypt(const uint8_t *encryptedData, size_t encryptedBytes, size_t &decryptedBytes, mte_status &status);
 
+  //-------------------------------------------------------
+  // As encrypt() and decrypt(), but into a buffer leased
+  // from MteBufferPool, which stays valid while the lease
+  // is held. The lease's data() and size() are the result.
+  //-------------------------------------------------------
+  MteBufferPool::Lease encryptLease(const uint8_t *data, size_t dataBytes, mte_status &status);
+
+  MteBufferPool::Lease decryptLease(const uint8_t *encryptedData, size_t encryptedBytes, mte_status &status);
+
 
 private:
   mte_sdr_random myRandomCallback;
@@ -230,12 +316,15 @@ private:
   void *myPassword;
   size_t myPasswordBytes;
   std::map<std::string, std::pair<size_t, uint8_t *> > memRecords;
+  size_t myMemRecordBytes;
 
   // The encoder state.
   MTE_HANDLE *myEncoder;
+  size_t myEncoderBytes;
 
   // The decoder state.
   MTE_HANDLE *myDecoder;
+  size_t myDecoderBytes;
 
   // Encoder buffer.
   uint8_t *myEncBuff;
@@ -254,6 +343,9 @@ private:
 
   static bool isNullOrWhitespace(const std::string &s);
 
+  // Frees every memory record.
+  void clearMemRecords();
+
   //-------------------------------------------------
    // Internal function to create a path, creating all
    // subdirectories as needed in the process.
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteSdrAlloc_h
+#define MteSdrAlloc_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+//******************************************************************************
+// Class MteSdrAlloc
+//
+// Counts the heap buffers of the SDR by call site: how many were allocated
+// and freed, their bytes, and the bytes still live and at their peak. The
+// live bytes of the encrypt and decrypt sites are the scratch buffer
+// capacities, and those of the record sites are what the memory stores hold.
+//
+// Some buffers are handed to the caller, who frees them with delete[]: the
+// result of Conceal() and of the tools' readFile(). They stop counting as
+// live when handed out.
+//
+// Accounting is always on, as live bytes must see every allocation. Each
+// allocation and free costs a few relaxed atomic operations; define
+// MTE_SDR_NO_ALLOC_ACCOUNTING to compile them out.
+//******************************************************************************
+class MteSdrAlloc
+{
+public:
+  enum Site
+  {
+    // The copy of the SDR password.
+    Password,
+    // The encoder and decoder states.
+    EncoderState,
+    DecoderState,
+    // The encrypt and decrypt scratch buffers.
+    EncryptBuffer,
+    DecryptBuffer,
+    // Records written to memory with MteSdr::write().
+    MemoryRecord,
+    // Records read from storage by MteSdr::readRecord().
+    StorageRecord,
+    // Records in the MteSdrDisconnected store.
+    DisconnectedRecord,
+    // Files read by the tools' readFile().
+    FileRead,
+    // Buffers owned by MteBufferPool, leased or cached.
+    PooledBuffer,
+    SiteCount
+  };
+
+  // The counts of one site.
+  struct SiteStats
+  {
+    const char *name;
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t handedOut;
+    uint64_t bytesAllocated;
+    uint64_t bytesFreed;
+    uint64_t bytesHandedOut;
+    uint64_t liveBytes;
+    uint64_t peakLiveBytes;
+
+    uint64_t liveCount() const { return allocations - frees - handedOut; }
+  };
+
+  static const char *siteName(Site site)
+  {
+    static const char *names[] = {
+      "password", "encoder state", "decoder state", "encrypt buffer", "decrypt buffer",
+      "memory record", "storage record", "disconnected record", "file read",
+      "pooled buffer"
+    };
+    return names[site];
+  }
+
+  // Allocates count elements with new[] and counts them against the site.
+  template <typename T>
+  static T *allocate(Site site, size_t count)
+  {
+    T *p = new T[count];
+    allocated(site, count * sizeof(T));
+    return p;
+  }
+
+  // Frees with delete[] what allocate() returned; null is ignored.
+  template <typename T>
+  static void release(Site site, T *p, size_t count)
+  {
+    if (p == nullptr)
+      return;
+    freed(site, count * sizeof(T));
+    delete[] p;
+  }
+
+  // Counts a buffer from allocate() as given to a caller to free.
+  static void handOut(Site site, size_t bytes)
+  {
+#if !defined(MTE_SDR_NO_ALLOC_ACCOUNTING)
+    Counters &c = counters()[site];
+    c.handedOut.fetch_add(1, std::memory_order_relaxed);
+    c.bytesHandedOut.fetch_add(bytes, std::memory_order_relaxed);
+    c.live.fetch_sub(bytes, std::memory_order_relaxed);
+#else
+    (void)site;
+    (void)bytes;
+#endif
+  }
+
+  static void allocated(Site site, size_t bytes)
+  {
+#if !defined(MTE_SDR_NO_ALLOC_ACCOUNTING)
+    Counters &c = counters()[site];
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.bytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t live = c.live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t peak = c.peak.load(std::memory_order_relaxed);
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+#else
+    (void)site;
+    (void)bytes;
+#endif
+  }
+
+  static void freed(Site site, size_t bytes)
+  {
+#if !defined(MTE_SDR_NO_ALLOC_ACCOUNTING)
+    Counters &c = counters()[site];
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    c.bytesFreed.fetch_add(bytes, std::memory_order_relaxed);
+    c.live.fetch_sub(bytes, std::memory_order_relaxed);
+#else
+    (void)site;
+    (void)bytes;
+#endif
+  }
+
+  // Returns the counts of every site, indexed by Site.
+  static std::vector<SiteStats> snapshot()
+  {
+    std::vector<SiteStats> stats(SiteCount);
+    for (int s = 0; s < SiteCount; s++)
+    {
+      const Counters &c = counters()[s];
+      SiteStats &st = stats[s];
+      st.name = siteName(static_cast<Site>(s));
+      st.allocations = c.allocations.load(std::memory_order_relaxed);
+      st.frees = c.frees.load(std::memory_order_relaxed);
+      st.handedOut = c.handedOut.load(std::memory_order_relaxed);
+      st.bytesAllocated = c.bytesAllocated.load(std::memory_order_relaxed);
+      st.bytesFreed = c.bytesFreed.load(std::memory_order_relaxed);
+      st.bytesHandedOut = c.bytesHandedOut.load(std::memory_order_relaxed);
+      st.liveBytes = c.live.load(std::memory_order_relaxed);
+      st.peakLiveBytes = c.peak.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+
+  // The live bytes of every site together.
+  static uint64_t liveBytes(const std::vector<SiteStats> &stats)
+  {
+    uint64_t total = 0;
+    for (const SiteStats &s : stats)
+      total += s.liveBytes;
+    return total;
+  }
+
+  // Writes the counts as a table.
+  static void print(std::ostream &out, const std::vector<SiteStats> &stats)
+  {
+    out << std::left << std::setw(21) << "site" << std::right
+      << std::setw(12) << "allocs" << std::setw(12) << "frees" << std::setw(12) << "handed out"
+      << std::setw(16) << "bytes" << std::setw(10) << "live" << std::setw(14) << "live bytes"
+      << std::setw(14) << "peak bytes" << std::endl;
+    for (const SiteStats &s : stats)
+    {
+      if (s.allocations == 0)
+        continue;
+      out << std::left << std::setw(21) << s.name << std::right
+        << std::setw(12) << s.allocations << std::setw(12) << s.frees << std::setw(12) << s.handedOut
+        << std::setw(16) << s.bytesAllocated << std::setw(10) << s.liveCount()
+        << std::setw(14) << s.liveBytes << std::setw(14) << s.peakLiveBytes << std::endl;
+    }
+    out << std::left << std::setw(21) << "total live bytes" << std::right << std::setw(90)
+      << liveBytes(stats) << std::endl;
+  }
+
+  //-------------------------------------------------------------
+  // Prints the counts to the stream every interval, on a thread
+  // of its own, until stopReport(). The stream must outlive it.
+  //-------------------------------------------------------------
+  static void startReport(std::ostream &out, double seconds)
+  {
+    stopReport();
+    Reporter &r = reporter();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.stop = false;
+    r.thread = std::thread([&out, seconds]
+      {
+        Reporter &r = reporter();
+        std::unique_lock<std::mutex> lock(r.mutex);
+        std::chrono::duration<double> interval(seconds);
+        while (!r.cv.wait_for(lock, interval, [&r] { return r.stop; }))
+        {
+          char time[32];
+          std::time_t now = std::time(nullptr);
+          std::strftime(time, sizeof(time), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+          out << "SDR memory at " << time << std::endl;
+          print(out, snapshot());
+        }
+      });
+  }
+
+  static void stopReport()
+  {
+    Reporter &r = reporter();
+    {
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.stop = true;
+    }
+    r.cv.notify_all();
+    if (r.thread.joinable())
+      r.thread.join();
+  }
+
+private:
+  // Each site on its own cache lines, so sites used by different threads
+  // do not contend.
+  struct alignas(64) Counters
+  {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> handedOut;
+    std::atomic<uint64_t> bytesAllocated;
+    std::atomic<uint64_t> bytesFreed;
+    std::atomic<uint64_t> bytesHandedOut;
+    std::atomic<uint64_t> live;
+    std::atomic<uint64_t> peak;
+  };
+
+  struct Reporter
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    bool stop = true;
+
+    ~Reporter()
+    {
+      if (thread.joinable())
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          stop = true;
+        }
+        cv.notify_all();
+        thread.join();
+      }
+    }
+  };
+
+  static Counters *counters()
+  {
+    static Counters c[SiteCount];
+    return c;
+  }
+
+  static Reporter &reporter()
+  {
+    static Reporter r;
+    return r;
+  }
+};
+
+#endif
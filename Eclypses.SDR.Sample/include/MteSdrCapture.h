@@ -0,0 +1,338 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteSdrCapture_h
+#define MteSdrCapture_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//******************************************************************************
+// Class MteSdrCapture
+//
+// Records the operations of every MteSdr in the process to a compact binary
+// file, so a real workload can be replayed later against another backend or
+// configuration. Each record holds the operation, a 64-bit FNV-1a hash of the
+// SDR location and key (so the same key in two SDRs is two keys), the size of
+// the clear value, the start time and the recording thread; no key or value
+// is ever written. Capture is off until start() is called; when off each
+// operation costs one relaxed load.
+//
+// Only the outermost operation on a thread is recorded, so a Conceal() is one
+// record, not the write, read and remove it is made of.
+//
+// The file is a 16 byte header, "MTESDRC1" then the version and the record
+// size as 32-bit little-endian integers, followed by the records:
+//   uint64 start time in nanoseconds since start()
+//   uint64 key hash (0 for Conceal and Reveal)
+//   uint32 clear value bytes
+//   uint16 thread, numbered from 0 in order of first record
+//   uint8  operation
+//   uint8  flags
+// all little-endian. Records are in order of completion, so the start times
+// are not quite sorted.
+//******************************************************************************
+class MteSdrCapture
+{
+public:
+  enum Operation
+  {
+    Read,
+    Write,
+    Remove,
+    Conceal,
+    Reveal,
+    OperationCount
+  };
+
+  enum Flags
+  {
+    // The record was written to or read from memory.
+    ToMemory = 1,
+    // The operation threw an exception.
+    Failed = 2
+  };
+
+  struct Record
+  {
+    uint64_t startNs;
+    uint64_t keyHash;
+    uint32_t valueBytes;
+    uint16_t thread;
+    uint8_t operation;
+    uint8_t flags;
+  };
+
+  static const uint32_t Version = 1;
+  static const size_t HeaderBytes = 16;
+  static const size_t RecordBytes = 24;
+
+  static bool enabled()
+  {
+    return state().file.load(std::memory_order_relaxed) != nullptr;
+  }
+
+  //--------------------------------------------------------------
+  // Starts recording to a file, replacing any earlier capture.
+  // Throws an exception if the file cannot be created.
+  //--------------------------------------------------------------
+  static void start(const std::string &path)
+  {
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+      throw std::runtime_error("Unable to create capture file " + path);
+    uint8_t header[HeaderBytes];
+    std::memcpy(header, "MTESDRC1", 8);
+    putLittle(header + 8, Version, 4);
+    putLittle(header + 12, RecordBytes, 4);
+    std::fwrite(header, 1, sizeof(header), file);
+
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    closeLocked(s);
+    if (!s.atExit)
+    {
+      // Write out the buffer of a capture still running at exit.
+      std::atexit(stop);
+      s.atExit = true;
+    }
+    s.origin = std::chrono::steady_clock::now();
+    s.file.store(file, std::memory_order_release);
+  }
+
+  // Stops recording, writing out what is buffered.
+  static void stop()
+  {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    closeLocked(s);
+  }
+
+  static const char *operationName(Operation operation)
+  {
+    static const char *names[] = { "read", "write", "remove", "conceal", "reveal" };
+    return operation < OperationCount ? names[operation] : "unknown";
+  }
+
+  // The 64-bit FNV-1a hash of a location, a zero byte and a key.
+  static uint64_t hashKey(const std::string &location, const std::string &key)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : location)
+      hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    hash *= 1099511628211ull;
+    for (char c : key)
+      hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    return hash;
+  }
+
+  //--------------------------------------------------------------
+  // Reads a capture file. Throws an exception if it cannot be read
+  // or is not a capture.
+  //--------------------------------------------------------------
+  static std::vector<Record> read(const std::string &path)
+  {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+      throw std::runtime_error("Unable to open capture file " + path);
+    std::vector<Record> records;
+    uint8_t header[HeaderBytes];
+    bool valid = std::fread(header, 1, sizeof(header), file) == sizeof(header) &&
+      std::memcmp(header, "MTESDRC1", 8) == 0 &&
+      getLittle(header + 8, 4) == Version &&
+      getLittle(header + 12, 4) == RecordBytes;
+    uint8_t bytes[RecordBytes];
+    while (valid && std::fread(bytes, 1, sizeof(bytes), file) == sizeof(bytes))
+    {
+      Record r;
+      r.startNs = getLittle(bytes, 8);
+      r.keyHash = getLittle(bytes + 8, 8);
+      r.valueBytes = static_cast<uint32_t>(getLittle(bytes + 16, 4));
+      r.thread = static_cast<uint16_t>(getLittle(bytes + 20, 2));
+      r.operation = bytes[22];
+      r.flags = bytes[23];
+      if (r.operation >= OperationCount)
+      {
+        valid = false;
+        break;
+      }
+      records.push_back(r);
+    }
+    std::fclose(file);
+    if (!valid)
+      throw std::runtime_error(path + " is not an SDR capture file");
+    return records;
+  }
+
+  //-------------------------------------------------------------
+  // Records an operation from construction to destruction, if
+  // capture was on at construction and no outer operation on this
+  // thread is being recorded. Call succeeded() when it completes;
+  // one destroyed without it, by an exception, is marked Failed.
+  //-------------------------------------------------------------
+  class Scope
+  {
+  public:
+    Scope(Operation operation, const std::string &location, const std::string *key, bool toMemory = false) :
+      myActive(enabled() && depth() == 0), myRecord()
+    {
+      if (!myActive)
+        return;
+      depth()++;
+      myRecord.startNs = 0;
+      myRecord.keyHash = key != nullptr ? hashKey(location, *key) : 0;
+      myRecord.valueBytes = 0;
+      myRecord.thread = 0;
+      myRecord.operation = static_cast<uint8_t>(operation);
+      myRecord.flags = static_cast<uint8_t>((toMemory ? ToMemory : 0) | Failed);
+      myStart = std::chrono::steady_clock::now();
+    }
+
+    ~Scope()
+    {
+      if (!myActive)
+        return;
+      depth()--;
+      append(myRecord, myStart);
+    }
+
+    // Marks a read or remove that found the record in memory.
+    void setToMemory() { myRecord.flags |= ToMemory; }
+
+    // Marks the operation complete with the size of its clear value.
+    void succeeded(size_t valueBytes)
+    {
+      myRecord.valueBytes = valueBytes > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(valueBytes);
+      myRecord.flags &= static_cast<uint8_t>(~Failed);
+    }
+
+  private:
+    Scope(const Scope &);
+    Scope &operator=(const Scope &);
+
+    static int &depth()
+    {
+      static thread_local int d = 0;
+      return d;
+    }
+
+    bool myActive;
+    Record myRecord;
+    std::chrono::steady_clock::time_point myStart;
+  };
+
+private:
+  // Records buffered before a write.
+  static const size_t BufferRecords = 4096;
+
+  struct State
+  {
+    std::mutex mutex;
+    std::atomic<FILE *> file;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<uint8_t> buffer;
+    std::atomic<uint16_t> threads;
+    bool atExit;
+
+    State() : file(nullptr), threads(0), atExit(false) {}
+  };
+
+  static State &state()
+  {
+    static State s;
+    return s;
+  }
+
+  static uint16_t threadNumber()
+  {
+    static thread_local int number = -1;
+    if (number < 0)
+      number = state().threads.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<uint16_t>(number);
+  }
+
+  static void append(Record record, std::chrono::steady_clock::time_point start)
+  {
+    record.thread = threadNumber();
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    FILE *file = s.file.load(std::memory_order_relaxed);
+    if (file == nullptr || start < s.origin)
+      return;
+    record.startNs = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(start - s.origin).count());
+    size_t at = s.buffer.size();
+    s.buffer.resize(at + RecordBytes);
+    uint8_t *bytes = s.buffer.data() + at;
+    putLittle(bytes, record.startNs, 8);
+    putLittle(bytes + 8, record.keyHash, 8);
+    putLittle(bytes + 16, record.valueBytes, 4);
+    putLittle(bytes + 20, record.thread, 2);
+    bytes[22] = record.operation;
+    bytes[23] = record.flags;
+    if (s.buffer.size() >= BufferRecords * RecordBytes)
+      flushLocked(s, file);
+  }
+
+  static void flushLocked(State &s, FILE *file)
+  {
+    if (!s.buffer.empty())
+      std::fwrite(s.buffer.data(), 1, s.buffer.size(), file);
+    s.buffer.clear();
+  }
+
+  static void closeLocked(State &s)
+  {
+    FILE *file = s.file.exchange(nullptr);
+    if (file == nullptr)
+      return;
+    flushLocked(s, file);
+    std::fclose(file);
+  }
+
+  static void putLittle(uint8_t *bytes, uint64_t value, int count)
+  {
+    for (int i = 0; i < count; i++)
+      bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+
+  static uint64_t getLittle(const uint8_t *bytes, int count)
+  {
+    uint64_t value = 0;
+    for (int i = count - 1; i >= 0; i--)
+      value = (value << 8) | bytes[i];
+    return value;
+  }
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteSdrProbes_h
+#define MteSdrProbes_h
+
+//******************************************************************************
+// USDT (user statically defined tracing) probes in the SDR operations, for
+// perf, bpftrace and SystemTap on Linux. A probe is a single nop until a tracer
+// attaches to it, so they are always compiled in when <sys/sdt.h> (from the
+// systemtap-sdt-dev or systemtap-sdt-devel package) is available. Define
+// MTE_SDR_NO_PROBES to leave them out.
+//
+// The provider is "mte_sdr". The probes and their arguments:
+//   encrypt_entry(data bytes)
+//   encrypt_return(data bytes, encrypted bytes, status)
+//   decrypt_entry(encrypted bytes)
+//   decrypt_return(encrypted bytes, decrypted bytes, status)
+//   random_entry(bytes)
+//   random_return(bytes)
+//   read_record_entry(key length)
+//   read_record_return(key length, value bytes)
+//   write_record_entry(key length, value bytes)
+//   write_record_return(key length, value bytes)
+//   remove_record_entry(key length)
+//   remove_record_return(key length)
+//   buffer_realloc(buffer: 0 encrypt 1 decrypt, old bytes, new bytes)
+//
+// For example, the distribution of encrypted sizes:
+//   bpftrace -e 'usdt:./Eclypses.SDR.Sample.Producer:mte_sdr:encrypt_return
+//     { @bytes = hist(arg1); }'
+//******************************************************************************
+#if !defined(MTE_SDR_NO_PROBES) && defined(__linux__) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define MTE_SDR_HAVE_PROBES 1
+#  endif
+#endif
+
+#if defined(MTE_SDR_HAVE_PROBES)
+#  define MTE_SDR_PROBE1(name, a1) DTRACE_PROBE1(mte_sdr, name, a1)
+#  define MTE_SDR_PROBE2(name, a1, a2) DTRACE_PROBE2(mte_sdr, name, a1, a2)
+#  define MTE_SDR_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(mte_sdr, name, a1, a2, a3)
+#else
+#  define MTE_SDR_PROBE1(name, a1) do { } while (0)
+#  define MTE_SDR_PROBE2(name, a1, a2) do { } while (0)
+#  define MTE_SDR_PROBE3(name, a1, a2, a3) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,378 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef MteSdrStats_h
+#define MteSdrStats_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#endif
+
+#include "MteHistogram.h"
+
+//******************************************************************************
+// Class MteSdrStats
+//
+// Latency histograms and byte counters for the phases of the SDR operations,
+// shared by every MteSdr in the process. Recording is off until enabled with
+// setEnabled(); when off each phase costs one relaxed load.
+//
+// Each thread records into its own shard, so recording takes no lock and
+// makes no atomic read-modify-write. A snapshot merges every shard. Shards are
+// reused by later threads once their thread exits, so their number is bounded
+// by the most threads that ever recorded at once.
+//
+// Latencies are recorded in ticks of the fastest clock available (the time
+// stamp counter on x86) and converted to nanoseconds in the snapshot.
+//******************************************************************************
+class MteSdrStats
+{
+public:
+  enum Phase
+  {
+    // mte_sdr_encrypt(), which includes the random callback.
+    Encrypt,
+    // mte_sdr_decrypt().
+    Decrypt,
+    // The random callback.
+    Random,
+    // Growing the encrypt or decrypt buffer.
+    EncryptRealloc,
+    DecryptRealloc,
+    // The readRecord() and writeRecord() storage methods.
+    ReadRecord,
+    WriteRecord,
+    PhaseCount
+  };
+
+  // The statistics of one phase since the last reset.
+  struct PhaseStats
+  {
+    const char *name;
+    uint64_t count;
+    uint64_t bytes;
+    // The latencies in clock ticks.
+    MteHistogram ticks;
+    double nsPerTick;
+
+    double meanNs() const { return ticks.mean() * nsPerTick; }
+    double maxNs() const { return count == 0 ? 0 : static_cast<double>(ticks.max()) * nsPerTick; }
+    double percentileNs(double percent) const
+    {
+      return static_cast<double>(ticks.percentile(percent)) * nsPerTick;
+    }
+  };
+
+  static bool enabled()
+  {
+    return enabledFlag().load(std::memory_order_relaxed);
+  }
+
+  static void setEnabled(bool enable)
+  {
+    clockOrigin();
+    enabledFlag().store(enable, std::memory_order_relaxed);
+  }
+
+  static const char *phaseName(Phase phase)
+  {
+    static const char *names[PhaseCount] = {
+      "encrypt", "decrypt", "random", "encrypt-realloc", "decrypt-realloc",
+      "read-record", "write-record"
+    };
+    return names[phase];
+  }
+
+  //------------------------------------------------------------
+  // Returns the statistics of every phase, indexed by Phase, for
+  // everything recorded since the last reset.
+  //------------------------------------------------------------
+  static std::vector<PhaseStats> snapshot()
+  {
+    std::vector<PhaseStats> stats(PhaseCount);
+    collect(stats);
+    double nsPerTick = clockNsPerTick();
+    std::lock_guard<std::mutex> lock(baselineMutex());
+    const std::vector<PhaseStats> &base = baseline();
+    for (unsigned p = 0; p < PhaseCount; ++p)
+    {
+      stats[p].name = phaseName(static_cast<Phase>(p));
+      if (!base.empty())
+      {
+        stats[p].ticks.subtract(base[p].ticks);
+        stats[p].bytes -= base[p].bytes;
+      }
+      stats[p].count = stats[p].ticks.count();
+      stats[p].nsPerTick = nsPerTick;
+    }
+    return stats;
+  }
+
+  // Starts the statistics from zero.
+  static void reset()
+  {
+    std::vector<PhaseStats> stats(PhaseCount);
+    collect(stats);
+    std::lock_guard<std::mutex> lock(baselineMutex());
+    baseline().swap(stats);
+  }
+
+  // Writes a table of the statistics.
+  static void print(std::ostream &out, const std::vector<PhaseStats> &stats)
+  {
+    out << std::left << std::setw(16) << "phase" << std::right
+      << std::setw(12) << "count" << std::setw(14) << "bytes"
+      << std::setw(11) << "mean ns" << std::setw(11) << "p50 ns"
+      << std::setw(11) << "p99 ns" << std::setw(11) << "p99.9 ns"
+      << std::setw(12) << "max ns" << std::endl;
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(0);
+    for (const PhaseStats &s : stats)
+    {
+      if (s.count == 0)
+        continue;
+      out << std::left << std::setw(16) << s.name << std::right
+        << std::setw(12) << s.count << std::setw(14) << s.bytes
+        << std::setw(11) << s.meanNs() << std::setw(11) << s.percentileNs(50)
+        << std::setw(11) << s.percentileNs(99) << std::setw(11) << s.percentileNs(99.9)
+        << std::setw(12) << s.maxNs() << std::endl;
+    }
+    out.unsetf(std::ios::floatfield);
+    out.precision(precision);
+  }
+
+  //-------------------------------------------------------------
+  // Times a phase from construction to destruction, if recording
+  // was enabled at construction.
+  //-------------------------------------------------------------
+  class Timer
+  {
+  public:
+    Timer(Phase phase, uint64_t bytes) :
+      myPhase(phase), myBytes(bytes), myStart(enabled() ? now() : 0)
+    {
+    }
+
+    ~Timer()
+    {
+      if (myStart != 0)
+        record(myPhase, now() - myStart, myBytes);
+    }
+
+    // Sets the bytes when they are only known after the phase.
+    void setBytes(uint64_t bytes) { myBytes = bytes; }
+
+  private:
+    Timer(const Timer &);
+    Timer &operator=(const Timer &);
+
+    Phase myPhase;
+    uint64_t myBytes;
+    uint64_t myStart;
+  };
+
+  // Records one occurrence of a phase.
+  static void record(Phase phase, uint64_t ticks, uint64_t bytes)
+  {
+    PhaseCounters &counters = localShard()->phases[phase];
+    bump(counters.ticks, ticks);
+    bump(counters.bytes, bytes);
+    bump(counters.counts[MteHistogram::bucketOf(ticks)], 1);
+  }
+
+  // Returns the current clock ticks.
+  static uint64_t now()
+  {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+  }
+
+private:
+  struct PhaseCounters
+  {
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> counts[MteHistogram::BucketCount];
+  };
+
+  struct Shard
+  {
+    PhaseCounters phases[PhaseCount];
+    std::atomic<bool> inUse;
+    Shard *next;
+  };
+
+  // Holds a shard for the life of a thread.
+  struct ShardLease
+  {
+    Shard *shard;
+
+    ShardLease() : shard(acquireShard()) {}
+    ~ShardLease() { shard->inUse.store(false, std::memory_order_release); }
+  };
+
+  // Only the owning thread writes a shard, so a plain load and store is
+  // enough; they are atomic only so a snapshot may read them.
+  static void bump(std::atomic<uint64_t> &counter, uint64_t value)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  // The pointer is cached in a thread_local that needs no construction, as
+  // those are the cheapest to reach.
+  static Shard *localShard()
+  {
+    static thread_local Shard *shard = nullptr;
+    if (shard == nullptr)
+      shard = leaseShard();
+    return shard;
+  }
+
+  static Shard *leaseShard()
+  {
+    static thread_local ShardLease lease;
+    return lease.shard;
+  }
+
+  static Shard *acquireShard()
+  {
+    std::atomic<Shard *> &head = shards();
+    for (Shard *s = head.load(std::memory_order_acquire); s != nullptr; s = s->next)
+    {
+      bool inUse = false;
+      if (!s->inUse.load(std::memory_order_relaxed) &&
+        s->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+      {
+        return s;
+      }
+    }
+    // Value initialization zeroes the counters. Shards are never freed.
+    Shard *s = new Shard();
+    s->inUse.store(true, std::memory_order_relaxed);
+    s->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return s;
+  }
+
+  // Sums every shard, from the start of the process.
+  static void collect(std::vector<PhaseStats> &stats)
+  {
+    for (Shard *s = shards().load(std::memory_order_acquire); s != nullptr; s = s->next)
+    {
+      for (unsigned p = 0; p < PhaseCount; ++p)
+      {
+        const PhaseCounters &counters = s->phases[p];
+        uint64_t ticks = counters.ticks.load(std::memory_order_relaxed);
+        for (unsigned b = 0; b < MteHistogram::BucketCount; ++b)
+        {
+          uint64_t count = counters.counts[b].load(std::memory_order_relaxed);
+          if (count != 0)
+          {
+            stats[p].ticks.add(b, count, 0);
+          }
+        }
+        stats[p].ticks.add(0, 0, ticks);
+        stats[p].bytes += counters.bytes.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static std::atomic<bool> &enabledFlag()
+  {
+    static std::atomic<bool> flag(false);
+    return flag;
+  }
+
+  static std::atomic<Shard *> &shards()
+  {
+    static std::atomic<Shard *> head(nullptr);
+    return head;
+  }
+
+  static std::mutex &baselineMutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static std::vector<PhaseStats> &baseline()
+  {
+    static std::vector<PhaseStats> stats;
+    return stats;
+  }
+
+  struct ClockOrigin
+  {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+
+    ClockOrigin() : ticks(now()), time(std::chrono::steady_clock::now()) {}
+  };
+
+  static const ClockOrigin &clockOrigin()
+  {
+    static ClockOrigin origin;
+    return origin;
+  }
+
+  //----------------------------------------------------------
+  // Measures the tick rate against the steady clock since the
+  // origin, waiting until enough time has passed to be exact.
+  //----------------------------------------------------------
+  static double clockNsPerTick()
+  {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    const ClockOrigin &origin = clockOrigin();
+    std::chrono::steady_clock::time_point time;
+    uint64_t ticks;
+    do
+    {
+      time = std::chrono::steady_clock::now();
+      ticks = now();
+    } while (time - origin.time < std::chrono::milliseconds(20));
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin.time).count());
+    return ns / static_cast<double>(ticks - origin.ticks);
+#else
+    return 1.0;
+#endif
+  }
+};
+
+#endif
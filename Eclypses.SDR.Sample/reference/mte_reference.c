@@ -0,0 +1,520 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) Eclypses, Inc.
+ *
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+/*******************************************************************************
+ * Reference implementation of the MTE functions the samples use.
+ *
+ * This is a stand-in for the licensed Eclypses MTE library so that the
+ * wrappers, the storage code and the tools can be built, tested and profiled
+ * on machines that cannot link the library. Build with
+ * "make MTE_SDR_REFERENCE=1".
+ *
+ * IT IS NOT ENCRYPTION. The transform only keeps the contracts of the real
+ * library: the state and buffer sizes, the output expansion, the random
+ * callback for the nonce, the decode offset, the password rules and the
+ * status codes. Never use it to protect real data.
+ *
+ * An encoded message is a nonce from the random callback, the data xor'ed
+ * with a keystream derived from the password and the nonce, and a check
+ * value of the data, so a wrong password or corrupt input fails to decode.
+ *
+ * The cost of the real library can be approximated by setting these
+ * environment variables; the time is spent in a busy loop on every call:
+ *   MTE_REFERENCE_CALL_NS  nanoseconds per encrypt or decrypt call
+ *   MTE_REFERENCE_BYTE_NS  nanoseconds per byte of data (may be fractional)
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(linux) || defined(__linux__) || defined(__APPLE__)
+#  include <time.h>
+#endif
+
+#include "mte_base.h"
+#include "mte_version.h"
+#include "mte_init.h"
+#include "mte_license.h"
+#include "mte_sdr.h"
+#include "mte_base64.h"
+
+/* The bytes added to every encoded message. */
+#ifndef MTE_REFERENCE_NONCE_BYTES
+#  define MTE_REFERENCE_NONCE_BYTES 16
+#endif
+#ifndef MTE_REFERENCE_CHECK_BYTES
+#  define MTE_REFERENCE_CHECK_BYTES 8
+#endif
+#define MTE_REFERENCE_OVERHEAD \
+  (MTE_REFERENCE_NONCE_BYTES + MTE_REFERENCE_CHECK_BYTES)
+
+/* Marks a state that mte_sdr_enc_buff_bytes() was called on. */
+#define MTE_REFERENCE_MAGIC 0x5244534546455245ULL
+
+typedef struct mte_reference_state_
+{
+  uint64_t magic;
+  uint64_t data_bytes;
+} mte_reference_state;
+
+static double mte_reference_call_ns = 0;
+static double mte_reference_byte_ns = 0;
+
+
+
+/****************************************************************************
+ * Reads the cost model from the environment.
+ ****************************************************************************/
+static void mte_reference_load_costs(void) {
+  const char *value = getenv("MTE_REFERENCE_CALL_NS");
+  mte_reference_call_ns = value != NULL ? atof(value) : 0;
+  value = getenv("MTE_REFERENCE_BYTE_NS");
+  mte_reference_byte_ns = value != NULL ? atof(value) : 0;
+}
+
+/****************************************************************************
+ * Busy waits for the modelled cost of processing the given bytes.
+ ****************************************************************************/
+static void mte_reference_spend(MTE_SIZE_T bytes) {
+#if defined(linux) || defined(__linux__) || defined(__APPLE__)
+  double ns = mte_reference_call_ns + mte_reference_byte_ns * (double)bytes;
+  struct timespec now;
+  uint64_t deadline;
+  if (ns < 1)
+    return;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  deadline = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec +
+             (uint64_t)ns;
+  do
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  while ((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec <
+         deadline);
+#else
+  (void)bytes;
+#endif
+}
+
+static uint64_t mte_reference_mix(uint64_t x) {
+  /* The splitmix64 finalizer. */
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/****************************************************************************
+ * Derives the keystream seed from the password and the nonce.
+ ****************************************************************************/
+static uint64_t mte_reference_seed(const uint8_t *password,
+                                   MTE_SIZE_T password_bytes,
+                                   const uint8_t *nonce) {
+  uint64_t seed = 0xCBF29CE484222325ULL;
+  MTE_SIZE_T i;
+  for (i = 0; i < password_bytes; ++i)
+    seed = (seed ^ password[i]) * 0x100000001B3ULL;
+  for (i = 0; i < MTE_REFERENCE_NONCE_BYTES; ++i)
+    seed = (seed ^ nonce[i]) * 0x100000001B3ULL;
+  return mte_reference_mix(seed);
+}
+
+/****************************************************************************
+ * Xors bytes of input with the keystream into output, and returns the check
+ * value of the clear data (the input when encoding, the output when
+ * decoding).
+ ****************************************************************************/
+static uint64_t mte_reference_transform(uint64_t seed, const uint8_t *input,
+                                        uint8_t *output, MTE_SIZE_T bytes,
+                                        int encoding) {
+  uint64_t check = seed ^ (uint64_t)bytes;
+  uint64_t counter = 0;
+  MTE_SIZE_T i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t word, clear;
+    uint64_t key = mte_reference_mix(seed + 0x9E3779B97F4A7C15ULL * ++counter);
+    memcpy(&word, input + i, 8);
+    clear = encoding ? word : word ^ key;
+    word ^= key;
+    memcpy(output + i, &word, 8);
+    check = (check ^ clear) * 0x100000001B3ULL;
+    check ^= check >> 29;
+  }
+  if (i < bytes) {
+    uint64_t key = mte_reference_mix(seed + 0x9E3779B97F4A7C15ULL * ++counter);
+    for (; i < bytes; ++i, key >>= 8) {
+      uint8_t clear = encoding ? input[i] : (uint8_t)(input[i] ^ key);
+      output[i] = (uint8_t)(input[i] ^ key);
+      check = (check ^ clear) * 0x100000001B3ULL;
+    }
+  }
+  return mte_reference_mix(check);
+}
+
+/****************************************************************************
+ * Returns true if the password follows the rules of the real library: at
+ * least 8 bytes and no byte value more than twice, unless it is a GUID
+ * string.
+ ****************************************************************************/
+static int mte_reference_password_ok(const uint8_t *password,
+                                     MTE_SIZE_T password_bytes) {
+  uint8_t counts[256];
+  MTE_SIZE_T i;
+  int guid = password_bytes == 36;
+  if (password == NULL || password_bytes < 8)
+    return 0;
+  for (i = 0; guid && i < password_bytes; ++i) {
+    uint8_t c = password[i];
+    if (i == 8 || i == 13 || i == 18 || i == 23)
+      guid = c == '-';
+    else
+      guid = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+             (c >= 'A' && c <= 'F');
+  }
+  if (guid)
+    return 1;
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < password_bytes; ++i)
+    if (++counts[password[i]] > 2)
+      return 0;
+  return 1;
+}
+
+static void mte_reference_put_check(uint8_t *out, uint64_t check) {
+  int i;
+  for (i = 0; i < MTE_REFERENCE_CHECK_BYTES; ++i, check >>= 8)
+    out[i] = (uint8_t)check;
+}
+
+/******************************************************************************
+ * The SDR functions.                                                         *
+ ******************************************************************************/
+MTE_SIZE_T mte_sdr_enc_state_bytes(void) {
+  return sizeof(mte_reference_state);
+}
+
+MTE_SIZE_T mte_sdr_dec_state_bytes(void) {
+  return sizeof(mte_reference_state);
+}
+
+MTE_SIZE_T mte_sdr_enc_buff_bytes(MTE_HANDLE state, MTE_SIZE_T data_bytes) {
+  mte_reference_state *s = (mte_reference_state *)state;
+  s->magic = MTE_REFERENCE_MAGIC;
+  s->data_bytes = data_bytes;
+  return data_bytes + MTE_REFERENCE_OVERHEAD;
+}
+
+MTE_SIZE_T mte_sdr_dec_buff_bytes(MTE_HANDLE state, MTE_SIZE_T data_bytes) {
+  mte_reference_state *s = (mte_reference_state *)state;
+  if (data_bytes < MTE_REFERENCE_OVERHEAD)
+    return 0;
+  s->magic = MTE_REFERENCE_MAGIC;
+  s->data_bytes = data_bytes;
+  /* The data is decoded in place, after the nonce; see the off argument. */
+  return data_bytes;
+}
+
+mte_status mte_sdr_encrypt(MTE_HANDLE state, const void *data,
+                           MTE_SIZE_T *bytes, void *encoded,
+                           const void *password, MTE_SIZE_T password_bytes,
+                           mte_sdr_get_random rnd_cb, void *context) {
+  mte_reference_state *s = (mte_reference_state *)state;
+  uint8_t *out = (uint8_t *)encoded;
+  uint64_t seed, check;
+  if (s == NULL || bytes == NULL || out == NULL || rnd_cb == NULL ||
+      (data == NULL && *bytes != 0))
+    return mte_status_invalid_input;
+  if (s->magic != MTE_REFERENCE_MAGIC || *bytes > s->data_bytes)
+    return mte_status_invalid_input;
+  if (!mte_reference_password_ok((const uint8_t *)password, password_bytes))
+    return mte_status_invalid_input;
+
+  rnd_cb(context, out, MTE_REFERENCE_NONCE_BYTES);
+  seed = mte_reference_seed((const uint8_t *)password, password_bytes, out);
+  check = mte_reference_transform(seed, (const uint8_t *)data,
+                                  out + MTE_REFERENCE_NONCE_BYTES, *bytes, 1);
+  mte_reference_put_check(out + MTE_REFERENCE_NONCE_BYTES + *bytes, check);
+  mte_reference_spend(*bytes);
+  *bytes += MTE_REFERENCE_OVERHEAD;
+  return mte_status_success;
+}
+
+mte_status mte_sdr_decrypt(MTE_HANDLE state, const void *encoded,
+                           MTE_SIZE_T *bytes, void *decoded, MTE_UINT8_T *off,
+                           const void *password, MTE_SIZE_T password_bytes) {
+  mte_reference_state *s = (mte_reference_state *)state;
+  const uint8_t *in = (const uint8_t *)encoded;
+  uint8_t *out = (uint8_t *)decoded;
+  uint8_t expected[MTE_REFERENCE_CHECK_BYTES];
+  MTE_SIZE_T data_bytes;
+  uint64_t seed, check;
+  if (s == NULL || bytes == NULL || in == NULL || out == NULL || off == NULL)
+    return mte_status_invalid_input;
+  if (s->magic != MTE_REFERENCE_MAGIC || *bytes > s->data_bytes ||
+      *bytes < MTE_REFERENCE_OVERHEAD)
+    return mte_status_invalid_input;
+  if (!mte_reference_password_ok((const uint8_t *)password, password_bytes))
+    return mte_status_invalid_input;
+
+  data_bytes = *bytes - MTE_REFERENCE_OVERHEAD;
+  seed = mte_reference_seed((const uint8_t *)password, password_bytes, in);
+  check = mte_reference_transform(seed, in + MTE_REFERENCE_NONCE_BYTES,
+                                  out + MTE_REFERENCE_NONCE_BYTES, data_bytes,
+                                  0);
+  mte_reference_put_check(expected, check);
+  mte_reference_spend(data_bytes);
+  if (memcmp(expected, in + MTE_REFERENCE_NONCE_BYTES + data_bytes,
+             MTE_REFERENCE_CHECK_BYTES) != 0)
+    return mte_status_checksum_mismatch;
+  *off = MTE_REFERENCE_NONCE_BYTES;
+  *bytes = data_bytes;
+  return mte_status_success;
+}
+
+/******************************************************************************
+ * Initialization and licensing. Any license is accepted.                     *
+ ******************************************************************************/
+MTE_BOOL mte_init(mte_init_info_cb cb, void *context) {
+  (void)cb;
+  (void)context;
+  mte_reference_load_costs();
+  return MTE_TRUE;
+}
+
+MTE_BOOL mte_license_init(const char *company, const char *license) {
+  (void)company;
+  (void)license;
+  return MTE_TRUE;
+}
+
+/******************************************************************************
+ * The base information. Only the "none" algorithms are provided.             *
+ ******************************************************************************/
+static const char *mte_reference_status_names[] = {
+  "mte_status_success", "mte_status_invalid_input", "mte_status_unsupported",
+  "mte_status_drbg_error", "mte_status_drbg_catastrophic",
+  "mte_status_drbg_seedlife_reached", "mte_status_cipher_test_failed",
+  "mte_status_hash_test_failed", "mte_status_output_inhibited",
+  "mte_status_impl_error", "mte_status_license_error",
+  "mte_status_token_does_not_exist", "mte_status_checksum_mismatch",
+  "mte_status_digest_mismatch", "mte_status_time_before_exceeded",
+  "mte_status_time_after_exceeded", "mte_status_seq_outside_window",
+  "mte_status_seq_async_replay", "mte_status_seq_mismatch"
+};
+
+static const char *mte_reference_status_descriptions[] = {
+  "No error occurred.", "Invalid input.", "Unsupported operation.",
+  "A normal DRBG error occurred.", "A catastrophic DRBG error occurred.",
+  "The seedlife has been reached.", "A cipher algorithm self-test failed.",
+  "A hash algorithm self-test failed.",
+  "Output is inhibited due to an error state or self-test.",
+  "Implementation error.", "License error.", "No such token exists.",
+  "Checksum mismatch.", "Hash digest mismatch.",
+  "The message was received too long before it was sent.",
+  "The message was received too long after it was sent.",
+  "The sequence number is outside the window.",
+  "The sequence number has already been seen in async mode.",
+  "Sequencing could not be resynchronized."
+};
+
+#define MTE_REFERENCE_STATUS_COUNT \
+  (sizeof(mte_reference_status_names) / sizeof(mte_reference_status_names[0]))
+
+const char *mte_base_version(void) {
+  return MTE_VERSION "-reference";
+}
+
+MTE_SIZE8_T mte_base_status_count(void) {
+  return (MTE_SIZE8_T)MTE_REFERENCE_STATUS_COUNT;
+}
+
+const char *mte_base_status_name(mte_status status) {
+  return (size_t)status < MTE_REFERENCE_STATUS_COUNT ?
+         mte_reference_status_names[status] : "";
+}
+
+const char *mte_base_status_description(mte_status status) {
+  return (size_t)status < MTE_REFERENCE_STATUS_COUNT ?
+         mte_reference_status_descriptions[status] : "";
+}
+
+mte_status mte_base_status_code(const char *name) {
+  size_t i;
+  for (i = 0; name != NULL && i < MTE_REFERENCE_STATUS_COUNT; ++i)
+    if (strcmp(name, mte_reference_status_names[i]) == 0)
+      return (mte_status)i;
+  return mte_status_invalid_input;
+}
+
+MTE_BOOL mte_base_status_is_error(mte_status status) {
+  return status != mte_status_success ? MTE_TRUE : MTE_FALSE;
+}
+
+MTE_SIZE8_T mte_base_drbgs_count(void) { return 1; }
+const char *mte_base_drbgs_name(mte_drbgs algo) {
+  return algo == mte_drbgs_none ? "none" : "";
+}
+mte_drbgs mte_base_drbgs_algo(const char *name) {
+  (void)name;
+  return mte_drbgs_none;
+}
+MTE_SIZE8_T mte_base_drbgs_sec_strength_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_SIZE8_T mte_base_drbgs_personal_min_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_SIZE_T mte_base_drbgs_personal_max_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_SIZE8_T mte_base_drbgs_entropy_min_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_SIZE_T mte_base_drbgs_entropy_max_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_SIZE8_T mte_base_drbgs_nonce_min_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_SIZE8_T mte_base_drbgs_nonce_max_bytes(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+MTE_UINT64_T mte_base_drbgs_reseed_interval(mte_drbgs algo) {
+  (void)algo;
+  return 0;
+}
+void mte_base_drbgs_incr_inst_error(MTE_BOOL flag) { (void)flag; }
+void mte_base_drbgs_incr_gen_error(MTE_BOOL flag, MTE_SIZE_T after) {
+  (void)flag;
+  (void)after;
+}
+
+MTE_SIZE8_T mte_base_verifiers_count(void) { return 1; }
+const char *mte_base_verifiers_name(mte_verifiers algo) {
+  return algo == mte_verifiers_none ? "none" : "";
+}
+mte_verifiers mte_base_verifiers_algo(const char *name) {
+  (void)name;
+  return mte_verifiers_none;
+}
+
+MTE_SIZE8_T mte_base_ciphers_count(void) { return 1; }
+const char *mte_base_ciphers_name(mte_ciphers algo) {
+  return algo == mte_ciphers_none ? "none" : "";
+}
+mte_ciphers mte_base_ciphers_algo(const char *name) {
+  (void)name;
+  return mte_ciphers_none;
+}
+MTE_SIZE8_T mte_base_ciphers_block_bytes(mte_ciphers algo) {
+  (void)algo;
+  return 0;
+}
+
+MTE_SIZE8_T mte_base_hashes_count(void) { return 1; }
+const char *mte_base_hashes_name(mte_hashes algo) {
+  return algo == mte_hashes_none ? "none" : "";
+}
+mte_hashes mte_base_hashes_algo(const char *name) {
+  (void)name;
+  return mte_hashes_none;
+}
+
+/******************************************************************************
+ * Base64, with the contracts of the library: null terminated output, bytes   *
+ * outside the alphabet ignored and missing padding assumed.                  *
+ ******************************************************************************/
+static const char mte_reference_b64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+MTE_SIZE_T mte_base64_encode_bytes(MTE_SIZE_T in_bytes) {
+  return (in_bytes + 2) / 3 * 4 + 1;
+}
+
+MTE_SIZE_T mte_base64_encode(const void *data, MTE_SIZE_T bytes, char *encoded) {
+  const uint8_t *in = (const uint8_t *)data;
+  char *out = encoded;
+  MTE_SIZE_T i = 0;
+  for (; i + 3 <= bytes; i += 3) {
+    uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+    *out++ = mte_reference_b64[(v >> 18) & 63];
+    *out++ = mte_reference_b64[(v >> 12) & 63];
+    *out++ = mte_reference_b64[(v >> 6) & 63];
+    *out++ = mte_reference_b64[v & 63];
+  }
+  if (i < bytes) {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < bytes)
+      v |= (uint32_t)in[i + 1] << 8;
+    *out++ = mte_reference_b64[(v >> 18) & 63];
+    *out++ = mte_reference_b64[(v >> 12) & 63];
+    *out++ = i + 1 < bytes ? mte_reference_b64[(v >> 6) & 63] : '=';
+    *out++ = '=';
+  }
+  *out = '\0';
+  return (MTE_SIZE_T)(out - encoded);
+}
+
+MTE_SIZE_T mte_base64_decode_bytes(MTE_SIZE_T in_bytes) {
+  return (in_bytes + 3) / 4 * 3 + 1;
+}
+
+MTE_SIZE_T mte_base64_decode(const void *base64, MTE_SIZE_T bytes,
+                             void *decoded) {
+  const char *in = (const char *)base64;
+  uint8_t *out = (uint8_t *)decoded;
+  uint8_t *start = out;
+  uint32_t group = 0;
+  int count = 0;
+  MTE_SIZE_T i;
+  for (i = 0; i < bytes; i++) {
+    const char *p = in[i] != '\0' ? strchr(mte_reference_b64, in[i]) : NULL;
+    if (p == NULL)
+      continue;
+    group = (group << 6) | (uint32_t)(p - mte_reference_b64);
+    if (++count == 4) {
+      *out++ = (uint8_t)(group >> 16);
+      *out++ = (uint8_t)(group >> 8);
+      *out++ = (uint8_t)group;
+      group = 0;
+      count = 0;
+    }
+  }
+  if (count >= 2) {
+    group <<= 6 * (4 - count);
+    *out++ = (uint8_t)(group >> 16);
+    if (count == 3)
+      *out++ = (uint8_t)(group >> 8);
+  }
+  *out = '\0';
+  return (MTE_SIZE_T)(out - start);
+}